@@ -60,6 +60,7 @@ std::string MapcrafterConfigHelper::generateTemplateJavascript() const {
 		js += "\ttileSize: " + util::str(32 * it->getTextureSize()) + ",\n";
 		js += "\tmaxZoom: " + util::str(getMapZoomlevel(it->getShortName())) + ",\n";
 		js += "\timageFormat: \"" + it->getImageFormatSuffix() + "\",\n";
+		js += "\ttilePack: " + std::string(it->packTiles() ? "true" : "false") + ",\n";
 
 		js += "\trotations: [";
 		auto rotations = it->getRotations();
@@ -75,6 +75,8 @@ void MapSection::preParse(const INIConfigSection& section,
 	render_leaves_transparent.setDefault(true);
 	render_biomes.setDefault(true);
 	use_image_mtimes.setDefault(true);
+	use_chunk_hashes.setDefault(false);
+	pack_tiles.setDefault(false);
 }
 
 bool MapSection::parseField(const std::string key, const std::string value,
@@ -122,6 +124,10 @@ bool MapSection::parseField(const std::string key, const std::string value,
 		render_biomes.load(key, value, validation);
 	} else if (key == "use_image_mtimes") {
 		use_image_mtimes.load(key, value, validation);
+	} else if (key == "use_chunk_hashes") {
+		use_chunk_hashes.load(key, value, validation);
+	} else if (key == "pack_tiles") {
+		pack_tiles.load(key, value, validation);
 	} else
 		return false;
 	return true;
@@ -212,5 +218,13 @@ bool MapSection::useImageModificationTimes() const {
 	return use_image_mtimes.getValue();
 }
 
+bool MapSection::useChunkHashes() const {
+	return use_chunk_hashes.getValue();
+}
+
+bool MapSection::packTiles() const {
+	return pack_tiles.getValue();
+}
+
 } /* namespace config */
 } /* namespace mapcrafter */
@@ -72,6 +72,8 @@ public:
 	bool renderLeavesTransparent() const;
 	bool renderBiomes() const;
 	bool useImageModificationTimes() const;
+	bool useChunkHashes() const;
+	bool packTiles() const;
 
 private:
 	fs::path config_dir;
@@ -91,6 +93,7 @@ private:
 
 	Field<double> lighting_intensity;
 	Field<bool> render_unknown_blocks, render_leaves_transparent, render_biomes, use_image_mtimes;
+	Field<bool> use_chunk_hashes, pack_tiles;
 };
 
 } /* namespace config */
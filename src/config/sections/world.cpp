@@ -21,9 +21,25 @@
 
 #include "../iniconfig.h"
 
+#include <sstream>
+
 namespace mapcrafter {
 namespace config {
 
+namespace {
+
+/**
+ * Parses a block position in the form of <x>,<z>,<y>.
+ */
+bool parseBlockPos(const std::string& str, mc::BlockPos& pos) {
+	std::stringstream ss(str);
+	char comma1 = 0, comma2 = 0;
+	ss >> pos.x >> comma1 >> pos.z >> comma2 >> pos.y;
+	return !ss.fail() && ss.eof() && comma1 == ',' && comma2 == ',';
+}
+
+}
+
 WorldSection::WorldSection(bool global)
 	: dimension(mc::Dimension::OVERWORLD) {
 	setGlobal(global);
@@ -44,6 +60,8 @@ void WorldSection::preParse(const INIConfigSection& section,
 	default_view.setDefault("");
 	default_zoom.setDefault(0);
 	default_rotation.setDefault(-1);
+
+	render_hotspots.setDefault("");
 }
 
 bool WorldSection::parseField(const std::string key, const std::string value,
@@ -73,6 +91,9 @@ bool WorldSection::parseField(const std::string key, const std::string value,
 		default_rotation.setValue(rotation);
 	}
 
+	else if (key == "render_hotspots")
+		render_hotspots.load(key, value, validation);
+
 	else if (key == "crop_min_y") {
 		if (min_y.load(key, value, validation))
 			worldcrop.setMinY(min_y.getValue());
@@ -120,6 +141,26 @@ void WorldSection::postParse(const INIConfigSection& section,
 		validation.push_back(ValidationMessage::error(
 				"The default zoom level must be bigger or equal to 0 ('default_zoom')."));
 
+	// the default view is also the first position rendered with priority
+	render_hotspots_list.clear();
+	mc::BlockPos pos;
+	if (!default_view.getValue().empty()) {
+		if (parseBlockPos(default_view.getValue(), pos))
+			render_hotspots_list.push_back(pos);
+		else
+			validation.push_back(ValidationMessage::error("Invalid default view '"
+					+ default_view.getValue() + "', use the format <x>,<z>,<y>!"));
+	}
+	std::stringstream hotspots(render_hotspots.getValue());
+	std::string hotspot;
+	while (hotspots >> hotspot) {
+		if (parseBlockPos(hotspot, pos))
+			render_hotspots_list.push_back(pos);
+		else
+			validation.push_back(ValidationMessage::error("Invalid render hotspot '"
+					+ hotspot + "', use the format <x>,<z>,<y>!"));
+	}
+
 	// validate the world croppping
 	bool crop_rectangular = min_x.isLoaded() || max_x.isLoaded() || min_z.isLoaded() || max_z.isLoaded();
 	bool crop_circular = center_x.isLoaded() || center_z.isLoaded() || radius.isLoaded();
@@ -180,6 +221,10 @@ int WorldSection::getDefaultRotation() const {
 	return default_rotation.getValue();
 }
 
+const std::vector<mc::BlockPos>& WorldSection::getRenderHotspots() const {
+	return render_hotspots_list;
+}
+
 const mc::WorldCrop WorldSection::getWorldCrop() const {
 	return worldcrop;
 }
@@ -26,6 +26,7 @@
 #include "../../mc/worldcrop.h"
 
 #include <string>
+#include <vector>
 #include <boost/filesystem.hpp>
 
 namespace fs = boost::filesystem;
@@ -59,6 +60,12 @@ public:
 	int getDefaultZoom() const;
 	int getDefaultRotation() const;
 
+	/**
+	 * Returns the positions whose tiles are rendered first when rendering with
+	 * priority: The default view (if specified) and the render hotspots.
+	 */
+	const std::vector<mc::BlockPos>& getRenderHotspots() const;
+
 	const mc::WorldCrop getWorldCrop() const;
 	bool needsWorldCentering() const;
 
@@ -72,6 +79,9 @@ private:
 	Field<std::string> default_view;
 	Field<int> default_zoom, default_rotation;
 
+	Field<std::string> render_hotspots;
+	std::vector<mc::BlockPos> render_hotspots_list;
+
 	Field<int> min_y, max_y;
 	Field<int> min_x, max_x, min_z, max_z;
 	Field<int> center_x, center_z, radius;
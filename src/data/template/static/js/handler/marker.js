@@ -2,13 +2,30 @@ MarkerHandler.prototype = new BaseHandler();
 
 /**
  * Is responsible to show the markers from the markers.js.
+ *
+ * The generated markers can also be split into buckets (see the bucket-size option of
+ * mapcrafter_markers), a bucket is a JSON file with the markers of a square area of a
+ * world. The buckets are loaded when they are visible.
  */
 function MarkerHandler(markers) {
 	this.layerGroups = {};
 	this.markers = markers;
 	this.visible = {};
+	
+	// buckets of the current world of every marker group (bucket key -> loaded?)
+	this.buckets = {};
 }
 
+MarkerHandler.prototype.create = function() {
+	var handler = (function(self) {
+		return function() {
+			self.loadVisibleBuckets();
+		};
+	})(this);
+	
+	this.ui.lmap.on("moveend", handler);
+};
+
 MarkerHandler.prototype.onMapChange = function(name, rotation) {
 	for(var group in this.layerGroups)
 		this.ui.lmap.removeLayer(this.layerGroups[group]);
@@ -30,10 +47,12 @@ MarkerHandler.prototype.onMapChange = function(name, rotation) {
 	};
 	
 	var world = this.ui.getCurrentMapConfig().world;
+	this.buckets = {};
 	for(var i = 0; i < this.markers.length; i++) {
 		var groupInfo = this.markers[i];
 		var group = groupInfo.id;
-		if(!(world in groupInfo.markers)) {
+		var hasBuckets = groupInfo.buckets && world in groupInfo.buckets;
+		if(!(world in groupInfo.markers) && !hasBuckets) {
 			// create empty layer group
 			this.layerGroups[group] = L.layerGroup();
 			continue;
@@ -42,13 +61,21 @@ MarkerHandler.prototype.onMapChange = function(name, rotation) {
 		if(!groupInfo.createMarker)
 			groupInfo.createMarker = createDefaultMarker;
 		
-		var markers = groupInfo.markers[world];
 		var layerGroup = L.layerGroup();
-		for(var j = 0; j < markers.length; j++) {
-			var markerInfo = markers[j];
-			var marker = groupInfo.createMarker(this.ui, groupInfo, markerInfo);
-			if(marker != null)
-				marker.addTo(layerGroup);
+		if(hasBuckets) {
+			// the markers of the buckets are added when the buckets are loaded
+			var buckets = groupInfo.buckets[world];
+			this.buckets[group] = {};
+			for(var j = 0; j < buckets.length; j++)
+				this.buckets[group][buckets[j][0] + "." + buckets[j][1]] = false;
+		} else {
+			var markers = groupInfo.markers[world];
+			for(var j = 0; j < markers.length; j++) {
+				var markerInfo = markers[j];
+				var marker = groupInfo.createMarker(this.ui, groupInfo, markerInfo);
+				if(marker != null)
+					marker.addTo(layerGroup);
+			}
 		}
 		
 		this.layerGroups[group] = layerGroup;
@@ -64,6 +91,63 @@ MarkerHandler.prototype.onMapChange = function(name, rotation) {
 		this.show(group, this.visible[group]);
 };
 
+MarkerHandler.prototype.loadVisibleBuckets = function() {
+	// get the visible area of the world,
+	// use the corners of the map view on the bottom and on the top of the world
+	var bounds = this.ui.lmap.getBounds();
+	var corners = [bounds.getNorthWest(), bounds.getNorthEast(),
+		bounds.getSouthWest(), bounds.getSouthEast()];
+	var min = null, max = null;
+	for(var i = 0; i < corners.length; i++) {
+		for(var y = 0; y <= 256; y += 256) {
+			var xzy = this.ui.latLngToMC(corners[i], y);
+			if(min === null) {
+				min = [xzy[0], xzy[1]];
+				max = [xzy[0], xzy[1]];
+			}
+			min = [Math.min(min[0], xzy[0]), Math.min(min[1], xzy[1])];
+			max = [Math.max(max[0], xzy[0]), Math.max(max[1], xzy[1])];
+		}
+	}
+	
+	var world = this.ui.getCurrentMapConfig().world;
+	for(var i = 0; i < this.markers.length; i++) {
+		var groupInfo = this.markers[i];
+		var group = groupInfo.id;
+		if(!(group in this.buckets) || !this.visible[group])
+			continue;
+		
+		var size = groupInfo.bucketSize;
+		for(var bx = Math.floor(min[0] / size); bx <= Math.floor(max[0] / size); bx++) {
+			for(var bz = Math.floor(min[1] / size); bz <= Math.floor(max[1] / size); bz++) {
+				var key = bx + "." + bz;
+				if(this.buckets[group][key] !== false)
+					continue;
+				this.buckets[group][key] = true;
+				this.loadBucket(groupInfo, this.layerGroups[group],
+					"markers/" + group + "/" + world + "/" + key + ".json");
+			}
+		}
+	}
+};
+
+MarkerHandler.prototype.loadBucket = function(groupInfo, layerGroup, url) {
+	var ui = this.ui;
+	var xhr = new XMLHttpRequest();
+	xhr.open("GET", url, true);
+	xhr.onload = function() {
+		if(xhr.status != 200)
+			return;
+		var markers = JSON.parse(xhr.responseText);
+		for(var i = 0; i < markers.length; i++) {
+			var marker = groupInfo.createMarker(ui, groupInfo, markers[i]);
+			if(marker != null)
+				marker.addTo(layerGroup);
+		}
+	};
+	xhr.send();
+};
+
 MarkerHandler.prototype.getMarkerGroups = function() {
 	var groups = [];
 	for(var i = 0; i < this.markers.length; i++)
@@ -78,4 +162,6 @@ MarkerHandler.prototype.show = function(group, visible) {
 	if(!visible && this.ui.lmap.hasLayer(layer))
 		this.ui.lmap.removeLayer(layer);
 	this.visible[group] = visible;
+	if(visible && group in this.buckets)
+		this.loadVisibleBuckets();
 };
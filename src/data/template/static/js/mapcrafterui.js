@@ -1,29 +1,274 @@
+/**
+ * Loads the tiles of a map rotation from a tile pack (see pack_tiles option): The header
+ * and the page table of the index file are loaded at first, the pages of the index and
+ * the tile images are loaded with HTTP range requests when they are required.
+ *
+ * The keys of the tiles in the index are 64 bit integers (zoom level and quadtree code
+ * of the tile path), they are handled as pairs of the high and low 32 bits here.
+ */
+function MCTilePack(url) {
+	this.url = url;
+	
+	this.header = null;
+	this.headerCallbacks = null;
+	this.pages = {};
+	this.pageCallbacks = {};
+}
+
+MCTilePack.prototype.loadRange = function(file, start, length, callback) {
+	var xhr = new XMLHttpRequest();
+	xhr.open("GET", this.url + "/" + file, true);
+	xhr.responseType = "arraybuffer";
+	xhr.setRequestHeader("Range", "bytes=" + start + "-" + (start + length - 1));
+	xhr.onload = function() {
+		if(xhr.status == 206)
+			callback(xhr.response);
+		else if(xhr.status == 200)
+			// the web server doesn't support range requests and sent the whole file
+			callback(xhr.response.slice(start, start + length));
+		else
+			callback(null);
+	};
+	xhr.onerror = function() {
+		callback(null);
+	};
+	xhr.send();
+};
+
+MCTilePack.prototype.loadHeader = function(callback) {
+	if(this.header !== null) {
+		callback(this.header);
+		return;
+	}
+	if(this.headerCallbacks !== null) {
+		this.headerCallbacks.push(callback);
+		return;
+	}
+	
+	var self = this;
+	this.headerCallbacks = [callback];
+	var done = function(header) {
+		var callbacks = self.headerCallbacks;
+		self.header = header;
+		self.headerCallbacks = null;
+		for(var i = 0; i < callbacks.length; i++)
+			callbacks[i](header);
+	};
+	
+	this.loadRange("tiles.idx", 0, 24, function(data) {
+		if(data === null || data.byteLength < 24) {
+			done(null);
+			return;
+		}
+		// magic bytes "MCTI" and version
+		var view = new DataView(data);
+		if(view.getUint32(0) != 0x4d435449 || view.getInt32(4) != 1) {
+			done(null);
+			return;
+		}
+		var header = {
+			generation: view.getInt32(8),
+			count: view.getInt32(12),
+			pageSize: view.getInt32(16),
+			pageCount: view.getInt32(20),
+			pageKeys: [],
+		};
+		if(header.pageCount == 0) {
+			done(header);
+			return;
+		}
+		
+		// the page table contains the key of the first tile of every page
+		self.loadRange("tiles.idx", 24, header.pageCount * 8, function(data) {
+			if(data === null || data.byteLength < header.pageCount * 8) {
+				done(null);
+				return;
+			}
+			var view = new DataView(data);
+			for(var i = 0; i < header.pageCount; i++)
+				header.pageKeys.push([view.getUint32(8 * i), view.getUint32(8 * i + 4)]);
+			done(header);
+		});
+	});
+};
+
+MCTilePack.prototype.loadPage = function(header, page, callback) {
+	if(page in this.pages) {
+		callback(this.pages[page]);
+		return;
+	}
+	if(page in this.pageCallbacks) {
+		this.pageCallbacks[page].push(callback);
+		return;
+	}
+	
+	var self = this;
+	this.pageCallbacks[page] = [callback];
+	var first = page * header.pageSize;
+	var count = Math.min(header.pageSize, header.count - first);
+	var start = 24 + header.pageCount * 8 + first * 20;
+	this.loadRange("tiles.idx", start, count * 20, function(data) {
+		var entries = null;
+		if(data !== null && data.byteLength == count * 20) {
+			// every entry consists of key, offset (64 bit each) and size (32 bit)
+			var view = new DataView(data);
+			entries = [];
+			for(var i = 0; i < count; i++) {
+				entries.push({
+					key: [view.getUint32(20 * i), view.getUint32(20 * i + 4)],
+					offset: view.getUint32(20 * i + 8) * 4294967296 + view.getUint32(20 * i + 12),
+					size: view.getUint32(20 * i + 16),
+				});
+			}
+			self.pages[page] = entries;
+		}
+		
+		var callbacks = self.pageCallbacks[page];
+		delete self.pageCallbacks[page];
+		for(var i = 0; i < callbacks.length; i++)
+			callbacks[i](entries);
+	});
+};
+
+MCTilePack.compareKeys = function(a, b) {
+	if(a[0] != b[0])
+		return a[0] < b[0] ? -1 : 1;
+	if(a[1] != b[1])
+		return a[1] < b[1] ? -1 : 1;
+	return 0;
+};
+
+MCTilePack.getTileKey = function(path) {
+	// the zoom level is stored in the highest 6 bits,
+	// the quadtree code (2 bits per part) in the lowest bits
+	var high = 0, low = 0;
+	for(var i = 0; i < path.length; i++) {
+		high = ((high << 2) | (low >>> 30)) >>> 0;
+		low = ((low << 2) | (path[i] - 1)) >>> 0;
+	}
+	high = (high | (path.length << 26)) >>> 0;
+	return [high, low];
+};
+
+MCTilePack.prototype.loadTile = function(path, type, callback) {
+	var self = this;
+	var key = MCTilePack.getTileKey(path);
+	this.loadHeader(function(header) {
+		if(header === null || header.pageCount == 0) {
+			callback(null);
+			return;
+		}
+		
+		// find the last page whose first key is not greater than the key of the tile
+		var low = 0, high = header.pageCount - 1;
+		while(low < high) {
+			var middle = Math.ceil((low + high) / 2);
+			if(MCTilePack.compareKeys(header.pageKeys[middle], key) <= 0)
+				low = middle;
+			else
+				high = middle - 1;
+		}
+		
+		self.loadPage(header, low, function(entries) {
+			var entry = null;
+			var low = 0, high = entries === null ? -1 : entries.length - 1;
+			while(low <= high) {
+				var middle = Math.floor((low + high) / 2);
+				var cmp = MCTilePack.compareKeys(entries[middle].key, key);
+				if(cmp == 0) {
+					entry = entries[middle];
+					break;
+				} else if(cmp < 0)
+					low = middle + 1;
+				else
+					high = middle - 1;
+			}
+			if(entry === null) {
+				callback(null);
+				return;
+			}
+			
+			self.loadRange("tiles." + header.generation + ".pack", entry.offset, entry.size,
+					function(data) {
+				callback(data === null ? null : new Blob([data], {type: type}));
+			});
+		});
+	});
+};
+
 var MCTileLayer = L.TileLayer.extend({
 	initialize: function(url, options) {
 		this._url = url;
 		
 		this.imageFormat = options["imageFormat"];
+		this.pack = options["tilePack"] ? new MCTilePack(url) : null;
 		
 		L.setOptions(this, options);
 	},
 	
-	getTileUrl: function(tile) {
+	getTilePath: function(tile) {
 		var zoom = this._map.getZoom();
+		if(tile.x < 0 || tile.x >= Math.pow(2, zoom) || tile.y < 0 || tile.y >= Math.pow(2, zoom))
+			return null;
+		var path = [];
+		for(var z = zoom - 1; z >= 0; --z) {
+			var x = Math.floor(tile.x / Math.pow(2, z)) % 2;
+			var y = Math.floor(tile.y / Math.pow(2, z)) % 2;
+			path.push(x + 2 * y + 1);
+		}
+		return path;
+	},
+	
+	getTileUrl: function(tile) {
+		var path = this.getTilePath(tile);
 		var url = this._url;
-		if(tile.x < 0 || tile.x >= Math.pow(2, zoom) || tile.y < 0 || tile.y >= Math.pow(2, zoom)) {
+		if(path === null) {
 			url += "/blank";
-		} else if(zoom == 0) {
+		} else if(path.length == 0) {
 			url += "/base";
 		} else {
-			for(var z = zoom - 1; z >= 0; --z) {
-				var x = Math.floor(tile.x / Math.pow(2, z)) % 2;
-				var y = Math.floor(tile.y / Math.pow(2, z)) % 2;
-				url += "/" + (x + 2 * y + 1);
-			}
+			url += "/" + path.join("/");
 		}
 		url = url + "." + this.imageFormat;
 		return url;
 	},
+	
+	_loadTile: function(tile, tilePoint) {
+		if(this.pack === null) {
+			L.TileLayer.prototype._loadTile.call(this, tile, tilePoint);
+			return;
+		}
+		
+		// the tile images are loaded from the tile pack, the image elements get
+		// object URLs of the loaded image data
+		tile._layer = this;
+		tile.onload = function() {
+			if(this.src.indexOf("blob:") == 0)
+				URL.revokeObjectURL(this.src);
+			this._layer._tileOnLoad.call(this);
+		};
+		tile.onerror = this._tileOnError;
+		this._adjustTilePoint(tilePoint);
+		
+		var path = this.getTilePath(tilePoint);
+		if(path === null) {
+			tile.onerror();
+			return;
+		}
+		// the image elements are reused, so the tile may show another tile already
+		// when the image data was loaded
+		var key = path.join("/");
+		tile._packTile = key;
+		var type = this.imageFormat == "png" ? "image/png" : "image/jpeg";
+		this.pack.loadTile(path, type, function(blob) {
+			if(tile._packTile !== key)
+				return;
+			if(blob === null)
+				tile.onerror();
+			else
+				tile.src = URL.createObjectURL(blob);
+		});
+	},
 });
 
 /**
@@ -188,6 +433,7 @@ MapcrafterUI.prototype.createTileLayer = function(name, config, rotation) {
 		tileSize: config.tileSize,
 		noWrap: true,
 		imageFormat: config.imageFormat,
+		tilePack: config.tilePack,
 	});
 	
 	return layer;
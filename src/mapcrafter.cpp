@@ -23,6 +23,7 @@
 #include "version.h"
 
 #include <iostream>
+#include <sstream>
 #include <string>
 #include <cstring>
 #include <boost/program_options.hpp>
@@ -39,6 +40,9 @@ int main(int argc, char** argv) {
 	std::string output_dir;
 	std::vector<std::string> render_skip, render_auto, render_force;
 	int jobs;
+	std::string metrics_file, metrics_prometheus_file;
+	std::string shard;
+	int merge_shards;
 
 	po::options_description all("Allowed options");
 	all.add_options()
@@ -59,7 +63,23 @@ int main(int argc, char** argv) {
 
 		("jobs,j", po::value<int>(&jobs),
 			"the count of jobs to render the map")
-		("batch,b", "deactivates the animated progress bar");
+		("batch,b", "deactivates the animated progress bar")
+		("priority", "renders the tiles around the default view and the render "
+			"hotspots of the worlds first")
+
+		("metrics", po::value<std::string>(&metrics_file),
+			"writes render metrics (timings, tiles/s, cache hit rates) as JSON to this file")
+		("metrics-prometheus", po::value<std::string>(&metrics_prometheus_file),
+			"writes render metrics to this file for the textfile collector "
+			"of the Prometheus node exporter")
+		("profile", "measures the time spent in the render stages and shows it "
+			"for every rendered rotation")
+
+		("shard", po::value<std::string>(&shard),
+			"renders only the shard i/N of the required tiles (for example 2/4), "
+			"the tiles are composed afterwards with --merge-shards")
+		("merge-shards", po::value<int>(&merge_shards),
+			"composes the remaining tiles after rendering with N shards");
 
 	po::variables_map vm;
 	try {
@@ -131,6 +151,37 @@ int main(int argc, char** argv) {
 		opts.jobs = 1;
 
 	opts.batch = vm.count("batch");
+	opts.priority = vm.count("priority");
+	opts.metrics_file = metrics_file;
+	opts.metrics_prometheus_file = metrics_prometheus_file;
+	opts.profile = vm.count("profile");
+
+	opts.shards = 0;
+	opts.shard = 0;
+	opts.merge_shards = vm.count("merge-shards");
+	if (vm.count("shard") && opts.merge_shards) {
+		std::cout << "You can't render a shard and merge the shards at the same time!"
+				<< std::endl;
+		return 1;
+	}
+	if (vm.count("shard")) {
+		char separator;
+		std::istringstream ss(shard);
+		if (!(ss >> opts.shard >> separator >> opts.shards) || separator != '/'
+				|| !ss.eof() || opts.shards < 1 || opts.shard < 1
+				|| opts.shard > opts.shards) {
+			std::cout << "Invalid shard '" << shard << "', it must be specified as i/N "
+					<< "with 1 <= i <= N!" << std::endl;
+			return 1;
+		}
+	}
+	if (opts.merge_shards) {
+		opts.shards = merge_shards;
+		if (opts.shards < 1) {
+			std::cout << "The count of shards must be at least 1!" << std::endl;
+			return 1;
+		}
+	}
 	renderer::RenderManager manager(opts);
 	if (!manager.run())
 		return 1;
@@ -20,6 +20,7 @@
 #include "chunk.h"
 
 #include <cmath>
+#include <cstring>
 #include <iostream>
 
 namespace mapcrafter {
@@ -53,23 +54,24 @@ void Chunk::setWorldCrop(const WorldCrop& worldcrop) {
 bool Chunk::readNBT(const char* data, size_t len, nbt::Compression compression) {
 	clear();
 
-	nbt::NBTFile nbt;
+	nbt::Document nbt;
 	nbt.readNBT(data, len, compression);
 
 	// find "level" tag
-	if (!nbt.hasTag<nbt::TagCompound>("Level")) {
+	const nbt::TagNode* level = nbt.getRoot().getTag<nbt::TagCompound>("Level");
+	if (level == nullptr) {
 		std::cerr << "Warning: Corrupt chunk (No level tag)!" << std::endl;
 		return false;
 	}
-	const nbt::TagCompound& level = nbt.findTag<nbt::TagCompound>("Level");
 
 	// then find x/z pos of the chunk
-	if (!level.hasTag<nbt::TagInt>("xPos") || !level.hasTag<nbt::TagInt>("zPos")) {
+	const nbt::TagNode* xpos = level->getTag<nbt::TagInt>("xPos");
+	const nbt::TagNode* zpos = level->getTag<nbt::TagInt>("zPos");
+	if (xpos == nullptr || zpos == nullptr) {
 		std::cerr << "Warning: Corrupt chunk (No x/z position found)!" << std::endl;
 		return false;
 	}
-	chunkpos_original = ChunkPos(level.findTag<nbt::TagInt>("xPos").payload,
-	                             level.findTag<nbt::TagInt>("zPos").payload);
+	chunkpos_original = ChunkPos(xpos->getInt(), zpos->getInt());
 	chunkpos = chunkpos_original;
 	if (rotation)
 		chunkpos.rotate(rotation);
@@ -78,9 +80,9 @@ bool Chunk::readNBT(const char* data, size_t len, nbt::Compression compression)
 	// check whether this chunk is completely contained within the cropped world
 	chunk_completely_contained = worldcrop.isChunkCompletelyContained(chunkpos_original);
 
-	if (level.hasArray<nbt::TagByteArray>("Biomes", 256)) {
-		const nbt::TagByteArray& biomes_tag = level.findTag<nbt::TagByteArray>("Biomes");
-		std::copy(biomes_tag.payload.begin(), biomes_tag.payload.end(), biomes);
+	const nbt::TagNode* biomes_tag = level->getArray<nbt::TagByteArray>("Biomes", 256);
+	if (biomes_tag != nullptr) {
+		std::copy(biomes_tag->getBytes(), biomes_tag->getBytes() + 256, biomes);
 	} else
 		std::cerr << "Warning: Corrupt chunk at " << chunkpos.x << ":" << chunkpos.z
 				<< " (No biome data found)!" << std::endl;
@@ -88,47 +90,38 @@ bool Chunk::readNBT(const char* data, size_t len, nbt::Compression compression)
 	// find sections list
 	// ignore it if section list does not exist, can happen sometimes with the empty
 	// chunks of the end
-	if (!level.hasList<nbt::TagCompound>("Sections"))
-		return true;
-	
-	const nbt::TagList& sections_tag = level.findTag<nbt::TagList>("Sections");
-	if (sections_tag.tag_type != nbt::TagCompound::TAG_TYPE)
+	const nbt::TagNode* sections_tag = level->getList<nbt::TagCompound>("Sections");
+	if (sections_tag == nullptr)
 		return true;
 
 	// go through all sections
-	for (auto it = sections_tag.payload.begin(); it != sections_tag.payload.end(); ++it) {
-		const nbt::TagCompound& section_tag = (*it)->cast<nbt::TagCompound>();
-		
+	for (const nbt::TagNode* section_tag = sections_tag->begin();
+			section_tag != sections_tag->end(); ++section_tag) {
+		const nbt::TagNode* y = section_tag->getTag<nbt::TagByte>("Y");
+		const nbt::TagNode* blocks = section_tag->getArray<nbt::TagByteArray>("Blocks", 4096);
+		const nbt::TagNode* data = section_tag->getArray<nbt::TagByteArray>("Data", 2048);
+		const nbt::TagNode* block_light = section_tag->getArray<nbt::TagByteArray>("BlockLight", 2048);
+		const nbt::TagNode* sky_light = section_tag->getArray<nbt::TagByteArray>("SkyLight", 2048);
+
 		// make sure section is valid
-		if (!section_tag.hasTag<nbt::TagByte>("Y")
-				|| !section_tag.hasArray<nbt::TagByteArray>("Blocks", 4096)
-				|| !section_tag.hasArray<nbt::TagByteArray>("Data", 2048)
-				|| !section_tag.hasArray<nbt::TagByteArray>("BlockLight", 2048)
-				|| !section_tag.hasArray<nbt::TagByteArray>("SkyLight", 2048))
+		if (y == nullptr || blocks == nullptr || data == nullptr
+				|| block_light == nullptr || sky_light == nullptr)
 			continue;
-		
-		const nbt::TagByte& y = section_tag.findTag<nbt::TagByte>("Y");
-		if (y.payload >= CHUNK_HEIGHT)
+		if (y->getInt() >= CHUNK_HEIGHT)
 			continue;
-		const nbt::TagByteArray& blocks = section_tag.findTag<nbt::TagByteArray>("Blocks");
-		const nbt::TagByteArray& data = section_tag.findTag<nbt::TagByteArray>("Data");
-
-		const nbt::TagByteArray& block_light = section_tag.findTag<nbt::TagByteArray>("BlockLight");
-		const nbt::TagByteArray& sky_light = section_tag.findTag<nbt::TagByteArray>("SkyLight");
 
 		// create a ChunkSection-object
 		ChunkSection section;
-		section.y = y.payload;
-		std::copy(blocks.payload.begin(), blocks.payload.end(), section.blocks);
-		if (!section_tag.hasArray<nbt::TagByteArray>("Add", 2048))
+		section.y = y->getInt();
+		std::copy(blocks->getBytes(), blocks->getBytes() + 4096, section.blocks);
+		const nbt::TagNode* add = section_tag->getArray<nbt::TagByteArray>("Add", 2048);
+		if (add == nullptr)
 			std::fill(&section.add[0], &section.add[2048], 0);
-		else {
-			const nbt::TagByteArray& add = section_tag.findTag<nbt::TagByteArray>("Add");
-			std::copy(add.payload.begin(), add.payload.end(), section.add);
-		}
-		std::copy(data.payload.begin(), data.payload.end(), section.data);
-		std::copy(block_light.payload.begin(), block_light.payload.end(), section.block_light);
-		std::copy(sky_light.payload.begin(), sky_light.payload.end(), section.sky_light);
+		else
+			std::copy(add->getBytes(), add->getBytes() + 2048, section.add);
+		std::copy(data->getBytes(), data->getBytes() + 2048, section.data);
+		std::copy(block_light->getBytes(), block_light->getBytes() + 2048, section.block_light);
+		std::copy(sky_light->getBytes(), sky_light->getBytes() + 2048, section.sky_light);
 
 		// add this section to the section list
 		section_offsets[section.y] = sections.size();
@@ -247,6 +240,41 @@ uint8_t Chunk::getBiomeAt(const LocalBlockPos& pos) const {
 	return biomes[z * 16 + x];
 }
 
+/**
+ * A simple and fast (not cryptographic) hash function working on 64 bit words.
+ * The length of the data must be a multiple of 8.
+ */
+uint64_t hashData(const uint8_t* data, size_t len, uint64_t hash) {
+	for (size_t i = 0; i < len; i += 8) {
+		uint64_t word;
+		std::memcpy(&word, data + i, 8);
+		hash ^= word;
+		hash *= 0x100000001b3ULL;
+		hash ^= hash >> 29;
+	}
+	return hash;
+}
+
+uint32_t Chunk::getSectionHash(int section, bool include_light) const {
+	if (!hasSection(section))
+		return 0;
+	const ChunkSection& s = sections[section_offsets[section]];
+
+	uint64_t hash = 0xcbf29ce484222325ULL ^ s.y;
+	hash = hashData(s.blocks, sizeof(s.blocks), hash);
+	hash = hashData(s.add, sizeof(s.add), hash);
+	hash = hashData(s.data, sizeof(s.data), hash);
+	if (include_light) {
+		hash = hashData(s.block_light, sizeof(s.block_light), hash);
+		hash = hashData(s.sky_light, sizeof(s.sky_light), hash);
+	}
+	hash = hashData(biomes, sizeof(biomes), hash);
+
+	// 0 is reserved for not existing sections
+	uint32_t result = (hash >> 32) ^ hash;
+	return result == 0 ? 1 : result;
+}
+
 const ChunkPos& Chunk::getPos() const {
 	return chunkpos;
 }
@@ -112,6 +112,16 @@ public:
 	 */
 	uint8_t getBiomeAt(const LocalBlockPos& pos) const;
 
+	/**
+	 * Returns a hash of the contents of a specific section (block IDs, block data values,
+	 * the biomes of the chunk and, if include_light is set, also the lighting data).
+	 * Returns 0 if the section does not exist.
+	 *
+	 * The hash is calculated from the raw (not rotated, not cropped) section data and is
+	 * used to find out whether the contents of a section actually changed.
+	 */
+	uint32_t getSectionHash(int section, bool include_light = true) const;
+
 	/**
 	 * Returns the position of the chunk. This position may be, depending on the map,
 	 * the rotated version of the original position.
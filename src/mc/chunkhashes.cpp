@@ -0,0 +1,169 @@
+/*
+ * Copyright 2012-2014 Moritz Hilscher
+ *
+ * This file is part of Mapcrafter.
+ *
+ * Mapcrafter is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Mapcrafter is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Mapcrafter.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "chunkhashes.h"
+
+#include "../util.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+namespace mapcrafter {
+namespace mc {
+
+// magic bytes and version of the index file format
+const char CHUNKHASHES_MAGIC[4] = {'M', 'C', 'C', 'H'};
+const int CHUNKHASHES_VERSION = 1;
+
+ChunkHashes::ChunkHashes() {
+	for (int i = 0; i < CHUNK_HEIGHT; i++)
+		sections[i] = 0;
+}
+
+uint16_t ChunkHashes::compare(const ChunkHashes& other) const {
+	uint16_t changed = 0;
+	for (int i = 0; i < CHUNK_HEIGHT; i++)
+		if (sections[i] != other.sections[i])
+			changed |= 1 << i;
+	return changed;
+}
+
+ChunkHashes ChunkHashes::byChunk(const Chunk& chunk, bool include_light) {
+	ChunkHashes hashes;
+	for (int i = 0; i < CHUNK_HEIGHT; i++)
+		hashes.sections[i] = chunk.getSectionHash(i, include_light);
+	return hashes;
+}
+
+ChunkHashIndex::ChunkHashIndex(bool include_light)
+	: include_light(include_light) {
+}
+
+ChunkHashIndex::~ChunkHashIndex() {
+}
+
+bool ChunkHashIndex::read(const std::string& filename) {
+	chunks.clear();
+
+	std::ifstream in(filename.c_str(), std::ios::binary);
+	if (!in)
+		return false;
+
+	char magic[4];
+	int32_t version, light, count;
+	if (!in.read(magic, 4) || std::memcmp(magic, CHUNKHASHES_MAGIC, 4) != 0
+			|| !util::readBigEndian(in, version) || version != CHUNKHASHES_VERSION
+			|| !util::readBigEndian(in, light) || !util::readBigEndian(in, count))
+		return false;
+	// the hashes are useless if they were calculated with other data
+	if ((light != 0) != include_light)
+		return false;
+
+	for (int32_t i = 0; i < count; i++) {
+		int32_t x, z, mask;
+		if (!util::readBigEndian(in, x) || !util::readBigEndian(in, z)
+				|| !util::readBigEndian(in, mask)) {
+			chunks.clear();
+			return false;
+		}
+
+		// only the hashes of existing sections are stored
+		ChunkHashes hashes;
+		for (int j = 0; j < CHUNK_HEIGHT; j++) {
+			if (!(mask & (1 << j)))
+				continue;
+			if (!util::readBigEndian(in, hashes.sections[j])) {
+				chunks.clear();
+				return false;
+			}
+		}
+		chunks[ChunkPos(x, z)] = hashes;
+	}
+
+	return true;
+}
+
+bool ChunkHashIndex::write(const std::string& filename) const {
+	// write to a temporary file at first and rename it then,
+	// so an aborted write can't leave a corrupted index behind
+	std::string tmp_filename = filename + ".tmp";
+	std::ofstream out(tmp_filename.c_str(), std::ios::binary);
+	if (!out)
+		return false;
+
+	out.write(CHUNKHASHES_MAGIC, 4);
+	util::writeBigEndian<int32_t>(out, CHUNKHASHES_VERSION);
+	util::writeBigEndian<int32_t>(out, include_light);
+	util::writeBigEndian<int32_t>(out, chunks.size());
+
+	for (auto it = chunks.begin(); it != chunks.end(); ++it) {
+		int32_t mask = 0;
+		for (int i = 0; i < CHUNK_HEIGHT; i++)
+			if (it->second.sections[i] != 0)
+				mask |= 1 << i;
+
+		util::writeBigEndian<int32_t>(out, it->first.x);
+		util::writeBigEndian<int32_t>(out, it->first.z);
+		util::writeBigEndian<int32_t>(out, mask);
+		for (int i = 0; i < CHUNK_HEIGHT; i++)
+			if (mask & (1 << i))
+				util::writeBigEndian(out, it->second.sections[i]);
+	}
+
+	out.close();
+	if (out.fail())
+		return false;
+	return std::rename(tmp_filename.c_str(), filename.c_str()) == 0;
+}
+
+bool ChunkHashIndex::isIncludingLight() const {
+	return include_light;
+}
+
+bool ChunkHashIndex::empty() const {
+	return chunks.empty();
+}
+
+int ChunkHashIndex::getChunksCount() const {
+	return chunks.size();
+}
+
+bool ChunkHashIndex::hasChunk(const ChunkPos& chunk) const {
+	return chunks.count(chunk) != 0;
+}
+
+const ChunkHashes& ChunkHashIndex::getChunk(const ChunkPos& chunk) const {
+	return chunks.at(chunk);
+}
+
+void ChunkHashIndex::setChunk(const ChunkPos& chunk, const ChunkHashes& hashes) {
+	chunks[chunk] = hashes;
+}
+
+const std::map<ChunkPos, ChunkHashes>& ChunkHashIndex::getChunks() const {
+	return chunks;
+}
+
+void ChunkHashIndex::clear() {
+	chunks.clear();
+}
+
+}
+}
@@ -0,0 +1,122 @@
+/*
+ * Copyright 2012-2014 Moritz Hilscher
+ *
+ * This file is part of Mapcrafter.
+ *
+ * Mapcrafter is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Mapcrafter is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Mapcrafter.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef CHUNKHASHES_H_
+#define CHUNKHASHES_H_
+
+#include "chunk.h"
+#include "pos.h"
+
+#include <map>
+#include <string>
+#include <stdint.h>
+
+namespace mapcrafter {
+namespace mc {
+
+/**
+ * The content hashes of the sections of a chunk.
+ */
+struct ChunkHashes {
+	ChunkHashes();
+
+	// the hash of every section, 0 if the section does not exist
+	uint32_t sections[CHUNK_HEIGHT];
+
+	/**
+	 * Returns a bitmask of the sections whose hashes differ from the ones of another
+	 * chunk (bit n is set if section n changed).
+	 */
+	uint16_t compare(const ChunkHashes& other) const;
+
+	/**
+	 * Calculates the section hashes of a loaded chunk.
+	 */
+	static ChunkHashes byChunk(const Chunk& chunk, bool include_light = true);
+};
+
+/**
+ * This class is a persistent index with the content hashes of the sections of all
+ * chunks of a world. It is stored with a rendered map and used for incremental
+ * rendering to find out whether the contents of a chunk actually changed -- Minecraft
+ * updates the chunk timestamps every time it saves a chunk, even if nothing changed.
+ */
+class ChunkHashIndex {
+public:
+	ChunkHashIndex(bool include_light = true);
+	~ChunkHashIndex();
+
+	/**
+	 * Reads the index from a file. Returns false if the file does not exist, is
+	 * corrupted or was created with a different lighting setting. The index is empty
+	 * in this case.
+	 */
+	bool read(const std::string& filename);
+
+	/**
+	 * Writes the index to a file. The file is replaced atomically.
+	 */
+	bool write(const std::string& filename) const;
+
+	/**
+	 * Returns whether the lighting data of the chunks is included in the hashes.
+	 */
+	bool isIncludingLight() const;
+
+	/**
+	 * Returns whether the index is empty.
+	 */
+	bool empty() const;
+
+	/**
+	 * Returns the count of chunks in the index.
+	 */
+	int getChunksCount() const;
+
+	/**
+	 * Returns whether a specific chunk is contained in the index.
+	 */
+	bool hasChunk(const ChunkPos& chunk) const;
+
+	/**
+	 * Returns/Sets the hashes of a specific chunk.
+	 */
+	const ChunkHashes& getChunk(const ChunkPos& chunk) const;
+	void setChunk(const ChunkPos& chunk, const ChunkHashes& hashes);
+
+	/**
+	 * Returns all chunks in the index.
+	 */
+	const std::map<ChunkPos, ChunkHashes>& getChunks() const;
+
+	/**
+	 * Removes all chunks from the index.
+	 */
+	void clear();
+
+private:
+	bool include_light;
+
+	std::map<ChunkPos, ChunkHashes> chunks;
+};
+
+}
+}
+
+#endif /* CHUNKHASHES_H_ */
@@ -19,136 +19,18 @@
 
 #include "nbt.h"
 
+#include "../util.h"
+
+#include <algorithm>
+#include <cstring>
 #include <fstream>
-#include <boost/iostreams/copy.hpp>
-#include <boost/iostreams/filtering_stream.hpp>
-#include <boost/iostreams/filter/gzip.hpp>
-#include <boost/iostreams/filter/zlib.hpp>
+#include <iterator>
+#include <zlib.h>
 
 namespace mapcrafter {
 namespace mc {
 namespace nbt {
 
-namespace nbtstream {
-template<typename T>
-T read(std::istream& stream) {
-}
-
-template<>
-int8_t read<int8_t>(std::istream& stream) {
-	int8_t value;
-	stream.read(reinterpret_cast<char*>(&value), sizeof(value));
-	return value;
-}
-
-template<>
-int16_t read<int16_t>(std::istream& stream) {
-	int16_t value;
-	stream.read(reinterpret_cast<char*>(&value), sizeof(value));
-	return util::bigEndian16(value);
-}
-
-template<>
-int32_t read<int32_t>(std::istream& stream) {
-	int32_t value;
-	stream.read(reinterpret_cast<char*>(&value), sizeof(value));
-	return util::bigEndian32(value);
-}
-
-template<>
-int64_t read<int64_t>(std::istream& stream) {
-	int64_t value;
-	stream.read(reinterpret_cast<char*>(&value), sizeof(value));
-	return util::bigEndian64(value);
-}
-
-template<>
-float read<float>(std::istream& stream) {
-	union {
-		int32_t tmp;
-		float myfloat;
-	};
-	stream.read(reinterpret_cast<char*>(&tmp), sizeof(int32_t));
-	tmp = util::bigEndian32(tmp);
-	return myfloat;
-}
-
-template<>
-double read<double>(std::istream& stream) {
-	union {
-		int64_t tmp;
-		double mydouble;
-	};
-	stream.read(reinterpret_cast<char*>(&tmp), sizeof(int64_t));
-	tmp = util::bigEndian64(tmp);
-	return mydouble;
-}
-
-template<>
-std::string read<std::string>(std::istream& stream) {
-	std::string value;
-	int16_t length = read<int16_t>(stream);
-	value.resize(length);
-	stream.read(&value[0], length);
-	return value;
-}
-
-template<typename T>
-void write(std::ostream& stream, T value) {
-}
-
-template<>
-void write<int8_t>(std::ostream& stream, int8_t value) {
-	stream.write(reinterpret_cast<char*>(&value), sizeof(value));
-}
-
-template<>
-void write<int16_t>(std::ostream& stream, int16_t value) {
-	int16_t tmp = util::bigEndian16(value);
-	stream.write(reinterpret_cast<char*>(&tmp), sizeof(value));
-}
-
-template<>
-void write<int32_t>(std::ostream& stream, int32_t value) {
-	int32_t tmp = util::bigEndian32(value);
-	stream.write(reinterpret_cast<char*>(&tmp), sizeof(value));
-}
-
-template<>
-void write<int64_t>(std::ostream& stream, int64_t value) {
-	int64_t tmp = util::bigEndian64(value);
-	stream.write(reinterpret_cast<char*>(&tmp), sizeof(value));
-}
-
-template<>
-void write<float>(std::ostream& stream, float value) {
-	union {
-		int32_t tmp;
-		float myfloat;
-	};
-	myfloat = value;
-	tmp = util::bigEndian32(tmp);
-	stream.write(reinterpret_cast<char*>(&tmp), sizeof(int32_t));
-}
-
-template<>
-void write<double>(std::ostream& stream, double value) {
-	union {
-		int64_t tmp;
-		double myfloat;
-	};
-	myfloat = value;
-	tmp = util::bigEndian64(tmp);
-	stream.write(reinterpret_cast<char*>(&tmp), sizeof(int64_t));
-}
-
-template<>
-void write<std::string>(std::ostream& stream, std::string value) {
-	write<int16_t>(stream, value.size());
-	stream.write(value.c_str(), value.size());
-}
-}
-
 Tag::Tag(int8_t type)
 	: type(type), named(false), write_type(true) {
 }
@@ -186,15 +68,15 @@ void Tag::setName(const std::string& name, bool set_named) {
 	this->name = name;
 }
 
-Tag& Tag::read(std::istream& stream) {
+Tag& Tag::read(NBTReader& reader) {
 	return *this;
 }
 
-void Tag::write(std::ostream& stream) const {
+void Tag::write(NBTWriter& writer) const {
 	if (write_type)
-		nbtstream::write<int8_t>(stream, type);
+		writer.write<int8_t>(type);
 	if (named)
-		nbtstream::write<std::string>(stream, name);
+		writer.write(name);
 }
 
 void Tag::dump(std::ostream& stream, const std::string& indendation) const {
@@ -204,14 +86,14 @@ Tag* Tag::clone() const {
 	return new Tag(*this);
 }
 
-Tag& TagString::read(std::istream& stream) {
-	payload = nbtstream::read<std::string>(stream);
+Tag& TagString::read(NBTReader& reader) {
+	payload = reader.read<std::string>();
 	return *this;
 }
 
-void TagString::write(std::ostream& stream) const {
-	Tag::write(stream);
-	nbtstream::write<std::string>(stream, payload);
+void TagString::write(NBTWriter& writer) const {
+	Tag::write(writer);
+	writer.write(payload);
 }
 
 void TagString::dump(std::ostream& stream, const std::string& indendation) const {
@@ -245,15 +127,15 @@ void TagList::operator=(const TagList& other) {
 		payload.push_back(TagPtr((*it)->clone()));
 }
 
-Tag& TagList::read(std::istream& stream) {
-	tag_type = nbtstream::read<int8_t>(stream);
-	int32_t length = nbtstream::read<int32_t>(stream);
+Tag& TagList::read(NBTReader& reader) {
+	tag_type = reader.read<int8_t>();
+	int32_t length = reader.readLength();
 	for (int32_t i = 0; i < length; i++) {
 		Tag* tag = createTag(tag_type);
 		if (tag == nullptr)
 			throw NBTError(std::string("Unknown tag type with id ") + util::str(static_cast<int>(tag_type))
 						   + ". NBT data stream may be corrupted.");
-		tag->read(stream);
+		tag->read(reader);
 		tag->setWriteType(false);
 		tag->setNamed(false);
 		payload.push_back(TagPtrType<Tag>(tag));
@@ -261,14 +143,14 @@ Tag& TagList::read(std::istream& stream) {
 	return *this;
 }
 
-void TagList::write(std::ostream& stream) const {
-	Tag::write(stream);
-	nbtstream::write<int8_t>(stream, tag_type);
-	nbtstream::write<int32_t>(stream, payload.size());
+void TagList::write(NBTWriter& writer) const {
+	Tag::write(writer);
+	writer.write<int8_t>(tag_type);
+	writer.write<int32_t>(payload.size());
 	for (auto it = payload.begin(); it != payload.end(); ++it) {
 		(*it)->setWriteType(false);
 		(*it)->setNamed(false);
-		(*it)->write(stream);
+		(*it)->write(writer);
 	}
 }
 
@@ -309,17 +191,17 @@ void TagCompound::operator=(const TagCompound& other) {
 		payload[it->first] = TagPtr(it->second->clone());
 }
 
-Tag& TagCompound::read(std::istream& stream) {
+Tag& TagCompound::read(NBTReader& reader) {
 	while (1) {
-		int8_t tag_type = nbtstream::read<int8_t>(stream);
+		int8_t tag_type = reader.read<int8_t>();
 		if (tag_type == TagEnd::TAG_TYPE)
 			break;
-		std::string name = nbtstream::read<std::string>(stream);
+		std::string name = reader.read<std::string>();
 		Tag* tag = createTag(tag_type);
 		if (tag == nullptr)
 			throw NBTError(std::string("Unknown tag type with id ") + util::str(static_cast<int>(tag_type))
 						   + ". NBT data stream may be corrupted.");
-		tag->read(stream);
+		tag->read(reader);
 		tag->setName(name);
 		tag->setWriteType(true);
 		payload[name] = TagPtr(tag);
@@ -327,14 +209,14 @@ Tag& TagCompound::read(std::istream& stream) {
 	return *this;
 }
 
-void TagCompound::write(std::ostream& stream) const {
-	Tag::write(stream);
+void TagCompound::write(NBTWriter& writer) const {
+	Tag::write(writer);
 	for (auto it = payload.begin(); it != payload.end(); ++it) {
 		it->second->setWriteType(true);
 		it->second->setNamed(true);
-		it->second->write(stream);
+		it->second->write(writer);
 	}
-	nbtstream::write<int8_t>(stream, TagEnd::TAG_TYPE);
+	writer.write<int8_t>(TagEnd::TAG_TYPE);
 }
 
 void TagCompound::dump(std::ostream& stream, const std::string& indendation) const {
@@ -357,15 +239,17 @@ bool TagCompound::hasTag(const std::string& name) const {
 }
 
 Tag& TagCompound::findTag(const std::string& name) {
-	if (!hasTag(name))
+	auto it = payload.find(name);
+	if (it == payload.end())
 		throw TagNotFound();
-	return *payload[name];
+	return *it->second;
 }
 
 const Tag& TagCompound::findTag(const std::string& name) const {
-	if (!hasTag(name))
+	auto it = payload.find(name);
+	if (it == payload.end())
 		throw TagNotFound();
-	return *payload.at(name);
+	return *it->second;
 }
 
 void TagCompound::addTag(const std::string& name, const Tag& tag) {
@@ -375,81 +259,118 @@ void TagCompound::addTag(const std::string& name, const Tag& tag) {
 	payload[name] = TagPtr(tag_ptr);
 }
 
-NBTFile::NBTFile() {
-}
-
-NBTFile::~NBTFile() {
-}
-
-void NBTFile::decompressStream(std::istream& stream, std::stringstream& decompressed,
-        Compression compression) {
+void decompress(const char* data, size_t len, Compression compression,
+		std::vector<char>& decompressed) {
+	util::ScopedTimer timer(util::ProfileStage::DECOMPRESS);
 	if (compression == Compression::NO_COMPRESSION) {
-		decompressed << stream.rdbuf();
+		decompressed.insert(decompressed.end(), data, data + len);
 		return;
 	}
-	boost::iostreams::filtering_streambuf<boost::iostreams::input> in;
-	if (compression == Compression::GZIP) {
-		in.push(boost::iostreams::gzip_decompressor());
-	} else if (compression == Compression::ZLIB) {
-		in.push(boost::iostreams::zlib_decompressor());
-	}
-	try {
-		in.push(stream);
-		boost::iostreams::copy(in, decompressed);
-	} catch (boost::iostreams::gzip_error &e) {
-		throw NBTError(
-		        "Error while decompressing gzip data: " + std::string(e.what()) + " ("
-		                + util::str(e.error()) + ")");
-	} catch (boost::iostreams::zlib_error &e) {
-		throw NBTError(
-		        "Error while decompressing zlib data: " + std::string(e.what()) + " ("
-		                + util::str(e.error()) + ")");
+
+	bool gzip = compression == Compression::GZIP;
+	z_stream stream;
+	std::memset(&stream, 0, sizeof(stream));
+	// 15 bits window size, +16 for the gzip format
+	if (inflateInit2(&stream, gzip ? 15 + 16 : 15) != Z_OK)
+		throw NBTError("Unable to initialize zlib!");
+	stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data));
+	stream.avail_in = len;
+
+	// start with a guess of the decompressed size and grow the buffer if required
+	size_t size = decompressed.size();
+	decompressed.resize(size + std::max(len * 4, (size_t) 4096));
+	int status;
+	do {
+		if (size == decompressed.size())
+			decompressed.resize(size * 2);
+		stream.next_out = reinterpret_cast<Bytef*>(&decompressed[size]);
+		stream.avail_out = decompressed.size() - size;
+		status = inflate(&stream, Z_NO_FLUSH);
+		size = decompressed.size() - stream.avail_out;
+	} while (status == Z_OK);
+	inflateEnd(&stream);
+	decompressed.resize(size);
+
+	if (status != Z_STREAM_END)
+		throw NBTError(std::string("Error while decompressing ") + (gzip ? "gzip" : "zlib")
+				+ " data: " + (stream.msg != nullptr ? stream.msg : "unexpected end of data")
+				+ " (" + util::str(status) + ")");
+}
+
+void compress(const char* data, size_t len, Compression compression,
+		std::vector<char>& compressed) {
+	if (compression == Compression::NO_COMPRESSION) {
+		compressed.insert(compressed.end(), data, data + len);
+		return;
 	}
+
+	z_stream stream;
+	std::memset(&stream, 0, sizeof(stream));
+	if (deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED,
+			compression == Compression::GZIP ? 15 + 16 : 15, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+		throw NBTError("Unable to initialize zlib!");
+	stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data));
+	stream.avail_in = len;
+
+	// the buffer is big enough to compress everything in one call
+	size_t size = compressed.size();
+	compressed.resize(size + deflateBound(&stream, len));
+	stream.next_out = reinterpret_cast<Bytef*>(&compressed[size]);
+	stream.avail_out = compressed.size() - size;
+	int status = deflate(&stream, Z_FINISH);
+	compressed.resize(compressed.size() - stream.avail_out);
+	deflateEnd(&stream);
+
+	if (status != Z_STREAM_END)
+		throw NBTError("Error while compressing data (" + util::str(status) + ")");
 }
 
-void NBTFile::readCompressed(std::istream& stream, Compression compression) {
-	std::stringstream decompressed(std::ios::in | std::ios::out | std::ios::binary);
-	decompressStream(stream, decompressed, compression);
-	int8_t type = ((TagByte&) TagByte().read(decompressed)).payload;
+NBTFile::NBTFile() {
+}
+
+NBTFile::~NBTFile() {
+}
+
+void NBTFile::readUncompressed(const char* data, size_t len) {
+	util::ScopedTimer timer(util::ProfileStage::NBT_PARSE);
+	NBTReader reader(data, len);
+	int8_t type = reader.read<int8_t>();
 	if (type != TagCompound::TAG_TYPE)
 		throw NBTError("First tag is not a tag compound!");
-	std::string name = ((TagString&) TagString().read(decompressed)).payload;
-	TagCompound::read(decompressed);
+	std::string name = reader.read<std::string>();
+	TagCompound::read(reader);
 	setName(name);
 }
 
 void NBTFile::readNBT(std::istream& stream, Compression compression) {
-	readCompressed(stream, compression);
+	std::vector<char> buffer((std::istreambuf_iterator<char>(stream)),
+			std::istreambuf_iterator<char>());
+	readNBT(buffer.data(), buffer.size(), compression);
 }
 
 void NBTFile::readNBT(const char* filename, Compression compression) {
 	std::ifstream file(filename, std::ios::binary);
 	if (!file)
 		throw NBTError(std::string("Unable to open file '") + filename + "'!");
-	readCompressed(file, compression);
+	readNBT(file, compression);
 	file.close();
 }
 
 void NBTFile::readNBT(const char* buffer, size_t len, Compression compression) {
-	std::stringstream stream(std::ios::in | std::ios::out | std::ios::binary);
-	stream.write(buffer, len);
-	readCompressed(stream, compression);
+	// uncompressed data can be read directly from the buffer
+	if (compression == Compression::NO_COMPRESSION) {
+		readUncompressed(buffer, len);
+		return;
+	}
+	std::vector<char> decompressed;
+	decompress(buffer, len, compression, decompressed);
+	readUncompressed(decompressed.data(), decompressed.size());
 }
 
 void NBTFile::writeNBT(std::ostream& stream, Compression compression) {
-	std::stringstream in(std::ios::in | std::ios::out | std::ios::binary);
-	boost::iostreams::filtering_streambuf<boost::iostreams::input> out;
-	if (compression == Compression::GZIP) {
-		out.push(boost::iostreams::gzip_compressor());
-	} else if (compression == Compression::ZLIB) {
-		out.push(boost::iostreams::zlib_compressor());
-	} else {
-		write(stream);
-		return;
-	}
-	out.push(in);
-	write(in);
-	boost::iostreams::copy(out, stream);
+	std::vector<char> buffer;
+	writeNBT(buffer, compression);
+	stream.write(buffer.data(), buffer.size());
 }
 
 void NBTFile::writeNBT(const char* filename, Compression compression) {
@@ -460,6 +381,14 @@ void NBTFile::writeNBT(const char* filename, Compression compression) {
 	file.close();
 }
 
+void NBTFile::writeNBT(std::vector<char>& buffer, Compression compression) {
+	std::vector<char> uncompressed;
+	NBTWriter writer(compression == Compression::NO_COMPRESSION ? buffer : uncompressed);
+	write(writer);
+	if (compression != Compression::NO_COMPRESSION)
+		compress(uncompressed.data(), uncompressed.size(), compression, buffer);
+}
+
 Tag* createTag(int8_t type) {
 	switch (type) {
 	case TagByte::TAG_TYPE:
@@ -489,6 +418,254 @@ Tag* createTag(int8_t type) {
 	}
 }
 
+TagNode::TagNode()
+	: type(TagEnd::TAG_TYPE), list_type(TagEnd::TAG_TYPE), name_length(0), length(0),
+	  name(nullptr), int_value(0) {
+}
+
+int8_t TagNode::getType() const {
+	return type;
+}
+
+std::string TagNode::getName() const {
+	return std::string(name, name_length);
+}
+
+bool TagNode::hasName(const std::string& name) const {
+	return name.size() == name_length && std::memcmp(name.data(), this->name, name_length) == 0;
+}
+
+int64_t TagNode::getInt() const {
+	return int_value;
+}
+
+double TagNode::getDouble() const {
+	return double_value;
+}
+
+std::string TagNode::getString() const {
+	return std::string(data, length);
+}
+
+const int8_t* TagNode::getBytes() const {
+	return reinterpret_cast<const int8_t*>(data);
+}
+
+int32_t TagNode::getIntArrayEntry(int32_t index) const {
+	return nbtbytes::load<int32_t>(data + 4 * index);
+}
+
+int32_t TagNode::getLength() const {
+	return length;
+}
+
+int8_t TagNode::getListType() const {
+	return list_type;
+}
+
+const TagNode* TagNode::begin() const {
+	if (type != TagList::TAG_TYPE && type != TagCompound::TAG_TYPE)
+		return nullptr;
+	return children;
+}
+
+const TagNode* TagNode::end() const {
+	if (type != TagList::TAG_TYPE && type != TagCompound::TAG_TYPE)
+		return nullptr;
+	return children + length;
+}
+
+const TagNode* TagNode::getTag(const std::string& name, int8_t type) const {
+	if (this->type != TagCompound::TAG_TYPE)
+		return nullptr;
+	// compounds have just a few tags, a linear search is fine
+	for (const TagNode* tag = begin(); tag != end(); ++tag)
+		if (tag->hasName(name))
+			return tag->type == type ? tag : nullptr;
+	return nullptr;
+}
+
+void TagNode::dump(std::ostream& stream, const std::string& indendation, bool named) const {
+	const char* type_name = "TAG_Unknown";
+	if (type >= 0 && type <= 11)
+		type_name = TAG_NAMES[type];
+	stream << indendation << type_name;
+	if (named)
+		stream << "(\"" << getName() << "\")";
+	stream << ": ";
+
+	switch (type) {
+	case TagByte::TAG_TYPE:
+	case TagShort::TAG_TYPE:
+	case TagInt::TAG_TYPE:
+	case TagLong::TAG_TYPE:
+		stream << int_value << std::endl;
+		break;
+	case TagFloat::TAG_TYPE:
+		stream << (float) double_value << std::endl;
+		break;
+	case TagDouble::TAG_TYPE:
+		stream << double_value << std::endl;
+		break;
+	case TagString::TAG_TYPE:
+		stream << getString() << std::endl;
+		break;
+	case TagByteArray::TAG_TYPE:
+	case TagIntArray::TAG_TYPE:
+		stream << length << " entries" << std::endl;
+		break;
+	case TagList::TAG_TYPE:
+		stream << length << " entries of type " << static_cast<int>(list_type) << std::endl;
+		stream << indendation << "{" << std::endl;
+		for (const TagNode* tag = begin(); tag != end(); ++tag)
+			tag->dump(stream, indendation + "   ", false);
+		stream << indendation << "}" << std::endl;
+		break;
+	case TagCompound::TAG_TYPE: {
+		stream << length << " entries" << std::endl;
+		stream << indendation << "{" << std::endl;
+		// sorted by name like the tags of a TagCompound
+		std::vector<const TagNode*> tags;
+		for (const TagNode* tag = begin(); tag != end(); ++tag)
+			tags.push_back(tag);
+		std::stable_sort(tags.begin(), tags.end(), [](const TagNode* a, const TagNode* b) {
+			return a->getName() < b->getName();
+		});
+		for (auto it = tags.begin(); it != tags.end(); ++it)
+			(*it)->dump(stream, indendation + "   ", true);
+		stream << indendation << "}" << std::endl;
+		break;
+	}
+	default:
+		stream << std::endl;
+	}
+}
+
+Document::Document() {
+}
+
+Document::~Document() {
+}
+
+void Document::readNBT(const char* buffer, size_t len, Compression compression) {
+	data.clear();
+	decompress(buffer, len, compression, data);
+	parse();
+}
+
+void Document::readNBT(const char* filename, Compression compression) {
+	std::ifstream file(filename, std::ios::binary);
+	if (!file)
+		throw NBTError(std::string("Unable to open file '") + filename + "'!");
+	std::vector<char> buffer((std::istreambuf_iterator<char>(file)),
+			std::istreambuf_iterator<char>());
+	readNBT(buffer.data(), buffer.size(), compression);
+}
+
+const TagNode& Document::getRoot() const {
+	return root;
+}
+
+void Document::parse() {
+	util::ScopedTimer timer(util::ProfileStage::NBT_PARSE);
+	tags.clear();
+	pending.clear();
+	NBTReader reader(data.data(), data.size());
+
+	root = TagNode();
+	root.type = reader.read<int8_t>();
+	if (root.type != TagCompound::TAG_TYPE)
+		throw NBTError("First tag is not a tag compound!");
+	root.name_length = reader.read<uint16_t>();
+	root.name = reader.readBytes(root.name_length);
+	readPayload(reader, root);
+
+	// the tags array doesn't change anymore, so the children can be resolved to pointers
+	for (auto it = tags.begin(); it != tags.end(); ++it)
+		resolveChildren(*it);
+	resolveChildren(root);
+}
+
+void Document::readPayload(NBTReader& reader, TagNode& tag) {
+	switch (tag.type) {
+	case TagByte::TAG_TYPE:
+		tag.int_value = reader.read<int8_t>();
+		break;
+	case TagShort::TAG_TYPE:
+		tag.int_value = reader.read<int16_t>();
+		break;
+	case TagInt::TAG_TYPE:
+		tag.int_value = reader.read<int32_t>();
+		break;
+	case TagLong::TAG_TYPE:
+		tag.int_value = reader.read<int64_t>();
+		break;
+	case TagFloat::TAG_TYPE:
+		tag.double_value = reader.read<float>();
+		break;
+	case TagDouble::TAG_TYPE:
+		tag.double_value = reader.read<double>();
+		break;
+	case TagByteArray::TAG_TYPE:
+		tag.length = reader.readLength();
+		tag.data = reader.readBytes(tag.length);
+		break;
+	case TagIntArray::TAG_TYPE:
+		tag.length = reader.readLength();
+		tag.data = reader.readBytes(4 * (size_t) tag.length);
+		break;
+	case TagString::TAG_TYPE:
+		tag.length = reader.read<uint16_t>();
+		tag.data = reader.readBytes(tag.length);
+		break;
+	case TagList::TAG_TYPE: {
+		tag.list_type = reader.read<int8_t>();
+		int32_t length = reader.readLength();
+		size_t first_pending = pending.size();
+		for (int32_t i = 0; i < length; i++) {
+			TagNode child;
+			child.type = tag.list_type;
+			readPayload(reader, child);
+			pending.push_back(child);
+		}
+		finishChildren(tag, first_pending);
+		break;
+	}
+	case TagCompound::TAG_TYPE: {
+		size_t first_pending = pending.size();
+		while (true) {
+			TagNode child;
+			child.type = reader.read<int8_t>();
+			if (child.type == TagEnd::TAG_TYPE)
+				break;
+			child.name_length = reader.read<uint16_t>();
+			child.name = reader.readBytes(child.name_length);
+			readPayload(reader, child);
+			pending.push_back(child);
+		}
+		finishChildren(tag, first_pending);
+		break;
+	}
+	default:
+		throw NBTError(std::string("Unknown tag type with id ") + util::str(static_cast<int>(tag.type))
+					   + ". NBT data stream may be corrupted.");
+	}
+}
+
+void Document::finishChildren(TagNode& tag, size_t first_pending) {
+	// the tags of nested lists/compounds are already moved to the tags array,
+	// so the remaining pending tags are exactly the children of this tag
+	tag.length = pending.size() - first_pending;
+	tag.first_child = tags.size();
+	tags.insert(tags.end(), pending.begin() + first_pending, pending.end());
+	pending.resize(first_pending);
+}
+
+void Document::resolveChildren(TagNode& tag) {
+	if (tag.type == TagList::TAG_TYPE || tag.type == TagCompound::TAG_TYPE)
+		tag.children = tags.data() + tag.first_child;
+}
+
 }
 }
 }
@@ -23,6 +23,7 @@
 #include "../util.h"
 
 #include <cstdint>
+#include <cstring>
 #include <exception>
 #include <iostream>
 #include <map>
@@ -106,14 +107,167 @@ void dumpTag(std::ostream& stream, const std::string& indendation, T tag, P payl
 	stream << ": " << payloadrepr << std::endl;
 }
 
-namespace nbtstream {
+namespace nbtbytes {
+// conversion of scalar values from/to their bits for the big endian byte order
 template<typename T>
-T read(std::istream& stream);
+T fromBits(uint64_t bits) {
+	return static_cast<T>(bits);
+}
+
+template<>
+inline float fromBits<float>(uint64_t bits) {
+	uint32_t tmp = bits;
+	float value;
+	std::memcpy(&value, &tmp, sizeof(value));
+	return value;
+}
+
+template<>
+inline double fromBits<double>(uint64_t bits) {
+	double value;
+	std::memcpy(&value, &bits, sizeof(value));
+	return value;
+}
+
+template<typename T>
+uint64_t toBits(T value) {
+	return static_cast<uint64_t>(value);
+}
+
+template<>
+inline uint64_t toBits<float>(float value) {
+	uint32_t tmp;
+	std::memcpy(&tmp, &value, sizeof(tmp));
+	return tmp;
+}
+
+template<>
+inline uint64_t toBits<double>(double value) {
+	uint64_t tmp;
+	std::memcpy(&tmp, &value, sizeof(tmp));
+	return tmp;
+}
 
 template<typename T>
-void write(std::ostream& stream, T t);
+T load(const char* data) {
+	uint64_t bits = 0;
+	for (size_t i = 0; i < sizeof(T); i++)
+		bits = (bits << 8) | static_cast<uint8_t>(data[i]);
+	return fromBits<T>(bits);
+}
+
+template<typename T>
+void store(char* data, T value) {
+	uint64_t bits = toBits<T>(value);
+	for (size_t i = 0; i < sizeof(T); i++)
+		data[i] = (bits >> (8 * (sizeof(T) - i - 1))) & 0xff;
+}
+}
+
+/**
+ * Reads NBT data (big endian byte order) directly from a memory buffer.
+ * Throws an NBTError if the data ends unexpectedly.
+ */
+class NBTReader {
+public:
+	NBTReader(const char* data, size_t len)
+		: ptr(data), end(data + len) {}
+
+	/**
+	 * Returns a pointer to the next bytes and skips them.
+	 */
+	const char* readBytes(size_t bytes) {
+		if (static_cast<size_t>(end - ptr) < bytes)
+			throw NBTError("Unexpected end of NBT data!");
+		const char* data = ptr;
+		ptr += bytes;
+		return data;
+	}
+
+	template<typename T>
+	T read() {
+		return nbtbytes::load<T>(readBytes(sizeof(T)));
+	}
+
+	/**
+	 * Reads the length of an array/list, throws an NBTError if it's negative.
+	 */
+	int32_t readLength() {
+		int32_t length = read<int32_t>();
+		if (length < 0)
+			throw NBTError("Negative length of NBT list or array!");
+		return length;
+	}
+
+	template<typename T>
+	void readArray(std::vector<T>& values, int32_t length) {
+		const char* data = readBytes(length * sizeof(T));
+		values.resize(length);
+		if (sizeof(T) == 1) {
+			if (length > 0)
+				std::memcpy(&values[0], data, length);
+		} else {
+			for (int32_t i = 0; i < length; i++)
+				values[i] = nbtbytes::load<T>(data + i * sizeof(T));
+		}
+	}
+
+private:
+	const char* ptr;
+	const char* end;
+};
+
+template<>
+inline std::string NBTReader::read<std::string>() {
+	uint16_t length = read<uint16_t>();
+	return std::string(readBytes(length), length);
 }
 
+/**
+ * Writes NBT data (big endian byte order) into a growable memory buffer.
+ */
+class NBTWriter {
+public:
+	NBTWriter(std::vector<char>& buffer)
+		: buffer(buffer) {}
+
+	/**
+	 * Appends the specified count of bytes to the buffer and returns a pointer to them.
+	 */
+	char* writeBytes(size_t bytes) {
+		size_t size = buffer.size();
+		buffer.resize(size + bytes);
+		return buffer.data() + size;
+	}
+
+	template<typename T>
+	void write(T value) {
+		nbtbytes::store<T>(writeBytes(sizeof(T)), value);
+	}
+
+	void write(const std::string& value) {
+		write<int16_t>(value.size());
+		if (!value.empty())
+			std::memcpy(writeBytes(value.size()), value.data(), value.size());
+	}
+
+	template<typename T>
+	void writeArray(const std::vector<T>& values) {
+		write<int32_t>(values.size());
+		char* data = writeBytes(values.size() * sizeof(T));
+		if (sizeof(T) == 1) {
+			if (!values.empty())
+				std::memcpy(data, &values[0], values.size());
+		} else {
+			for (size_t i = 0; i < values.size(); i++)
+				nbtbytes::store<T>(data + i * sizeof(T), values[i]);
+		}
+	}
+
+private:
+	std::vector<char>& buffer;
+};
+
 class Tag {
 protected:
 	int8_t type;
@@ -126,17 +280,18 @@ public:
 
 	int8_t getType() const;
 	
+	// the type is checked, so there is no need for a dynamic_cast
 	template<typename T>
 	T& cast() {
 		if (type == T::TAG_TYPE)
-			return dynamic_cast<T&>(*this);
+			return static_cast<T&>(*this);
 		throw InvalidTagCast();
 	}
 
 	template<typename T>
 	const T& cast() const {
 		if (type == T::TAG_TYPE)
-			return dynamic_cast<const T&>(*this);
+			return static_cast<const T&>(*this);
 		throw InvalidTagCast();
 	}
 
@@ -149,8 +304,8 @@ public:
 	const std::string& getName() const;
 	void setName(const std::string& name, bool set_named = true);
 
-	virtual Tag& read(std::istream& stream);
-	virtual void write(std::ostream& stream) const;
+	virtual Tag& read(NBTReader& reader);
+	virtual void write(NBTWriter& writer) const;
 	virtual void dump(std::ostream& stream, const std::string& indendation = "") const;
 	virtual Tag* clone() const;
 };
@@ -167,14 +322,14 @@ class ScalarTag: public Tag {
 public:
 	ScalarTag(T payload = 0) : Tag(TAG_TYPE), payload(payload) {}
 
-	Tag& read(std::istream& stream) {
-		payload = nbtstream::read<T>(stream);
+	Tag& read(NBTReader& reader) {
+		payload = reader.read<T>();
 		return *this;
 	}
 
-	void write(std::ostream& stream) const {
-		Tag::write(stream);
-		nbtstream::write<T>(stream, payload);
+	void write(NBTWriter& writer) const {
+		Tag::write(writer);
+		writer.write<T>(payload);
 	}
 
 	void dump(std::ostream& stream, const std::string& indendation = "") const {
@@ -206,27 +361,14 @@ public:
 	TagArray() : Tag(TAG_TYPE) {}
 	TagArray(const std::vector<T>& payload) : Tag(TAG_TYPE), payload(payload) {}
 
-	Tag& read(std::istream& stream) {
-		int32_t length = nbtstream::read<int32_t>(stream);
-		payload.resize(length);
-		if (std::is_same<T, int8_t>::value)
-			stream.read(reinterpret_cast<char*>(&payload[0]), length * sizeof(T));
-		else {
-			for (int32_t i = 0; i < length; i++)
-				payload[i] = nbtstream::read<T>(stream);
-		}
+	Tag& read(NBTReader& reader) {
+		reader.readArray(payload, reader.readLength());
 		return *this;
 	}
 	
-	void write(std::ostream& stream) const {
-		Tag::write(stream);
-		nbtstream::write<int32_t>(stream, payload.size());
-		if (std::is_same<T, int8_t>::value)
-			stream.write(reinterpret_cast<const char*>(&payload[0]), payload.size() * sizeof(T));
-		else {
-			for (size_t i = 0; i < payload.size(); i++)
-				nbtstream::write<T>(stream, payload[i]);
-		}
+	void write(NBTWriter& writer) const {
+		Tag::write(writer);
+		writer.writeArray(payload);
 	}
 	
 	void dump(std::ostream& stream, const std::string& indendation = "") const {
@@ -250,8 +392,8 @@ public:
 	TagString() : Tag(TAG_TYPE) {}
 	TagString(const std::string& payload) : Tag(TAG_TYPE), payload(payload) {}
 
-	Tag& read(std::istream& stream);
-	void write(std::ostream& stream) const;
+	Tag& read(NBTReader& reader);
+	void write(NBTWriter& writer) const;
 	void dump(std::ostream& stream, const std::string& indendation = "") const;
 	Tag* clone() const;
 
@@ -278,8 +420,8 @@ public:
 
 	void operator=(const TagList& other);
 
-	Tag& read(std::istream& stream);
-	void write(std::ostream& stream) const;
+	Tag& read(NBTReader& reader);
+	void write(NBTWriter& writer) const;
 	void dump(std::ostream& stream, const std::string& indendation = "") const;
 	Tag* clone() const;
 
@@ -297,8 +439,8 @@ public:
 
 	void operator=(const TagCompound& other);
 
-	Tag& read(std::istream& stream);
-	void write(std::ostream& stream) const;
+	Tag& read(NBTReader& reader);
+	void write(NBTWriter& writer) const;
 	void dump(std::ostream& stream, const std::string& indendation = "") const;
 	Tag* clone() const;
 
@@ -351,25 +493,184 @@ public:
 };
 
 class NBTFile: public TagCompound {
-private:
-	void decompressStream(std::istream& stream, std::stringstream& decompressed,
-	        Compression compression);
 public:
 	NBTFile();
 	NBTFile(const std::string name) : TagCompound(name) {}
 	~NBTFile();
 
-	void readCompressed(std::istream& stream, Compression compression = Compression::GZIP);
 	void readNBT(std::istream& stream, Compression compression = Compression::GZIP);
 	void readNBT(const char* filename, Compression compression = Compression::GZIP);
 	void readNBT(const char* buffer, size_t len, Compression compression = Compression::GZIP);
 
 	void writeNBT(std::ostream& stream, Compression compression = Compression::GZIP);
 	void writeNBT(const char* filename, Compression compression = Compression::GZIP);
+	void writeNBT(std::vector<char>& buffer, Compression compression = Compression::GZIP);
+
+private:
+	void readUncompressed(const char* data, size_t len);
 };
 
 Tag* createTag(int8_t type);
 
+/**
+ * Decompresses/Compresses NBT data and appends it to a buffer.
+ * The data is (de)compressed with zlib in one go.
+ */
+void decompress(const char* data, size_t len, Compression compression,
+		std::vector<char>& decompressed);
+void compress(const char* data, size_t len, Compression compression,
+		std::vector<char>& compressed);
+
+/**
+ * A tag of an NBT document. The tags are type-tagged values, the names, strings and
+ * arrays are not copied, they point into the data of the document.
+ *
+ * The tags of a compound or list are stored consecutively, a tag is only valid as long
+ * as its document is.
+ */
+class TagNode {
+public:
+	TagNode();
+
+	int8_t getType() const;
+	std::string getName() const;
+	bool hasName(const std::string& name) const;
+
+	/**
+	 * Returns the value of a byte/short/int/long tag.
+	 */
+	int64_t getInt() const;
+
+	/**
+	 * Returns the value of a float/double tag.
+	 */
+	double getDouble() const;
+
+	/**
+	 * Returns the value of a string tag.
+	 */
+	std::string getString() const;
+
+	/**
+	 * Returns the entries of a byte array / an entry of an int array.
+	 */
+	const int8_t* getBytes() const;
+	int32_t getIntArrayEntry(int32_t index) const;
+
+	/**
+	 * Returns the count of entries of an array/list or the count of tags of a compound.
+	 */
+	int32_t getLength() const;
+
+	/**
+	 * Returns the type of the tags of a list.
+	 */
+	int8_t getListType() const;
+
+	/**
+	 * Returns the tags of a list/compound.
+	 */
+	const TagNode* begin() const;
+	const TagNode* end() const;
+
+	/**
+	 * Returns the tag of a compound with the specified name and type, or nullptr if the
+	 * compound has no such tag.
+	 */
+	const TagNode* getTag(const std::string& name, int8_t type) const;
+
+	template<typename T>
+	const TagNode* getTag(const std::string& name) const {
+		return getTag(name, T::TAG_TYPE);
+	}
+
+	/**
+	 * Returns the array with the specified name if it has the specified length
+	 * (or any length if len is -1), otherwise nullptr.
+	 */
+	template<typename T>
+	const TagNode* getArray(const std::string& name, int32_t len = -1) const {
+		static_assert(std::is_same<T, TagByteArray>::value
+				|| std::is_same<T, TagIntArray>::value,
+			"Only TagByteArray and TagIntArray are allowed as template argument!");
+		const TagNode* tag = getTag<T>(name);
+		if (tag == nullptr || (len != -1 && tag->length != len))
+			return nullptr;
+		return tag;
+	}
+
+	/**
+	 * Returns the list with the specified name if it contains tags of the specified type.
+	 */
+	template<typename T>
+	const TagNode* getList(const std::string& name) const {
+		const TagNode* tag = getTag<TagList>(name);
+		if (tag == nullptr || tag->list_type != T::TAG_TYPE)
+			return nullptr;
+		return tag;
+	}
+
+	void dump(std::ostream& stream, const std::string& indendation = "",
+			bool named = true) const;
+
+private:
+	int8_t type, list_type;
+	uint16_t name_length;
+	int32_t length;
+	const char* name;
+
+	union {
+		int64_t int_value;
+		double double_value;
+		// string/array data
+		const char* data;
+		// tags of a list/compound, an index into the tags of the document while reading
+		size_t first_child;
+		const TagNode* children;
+	};
+
+	friend class Document;
+};
+
+/**
+ * A read-only NBT tag tree. The decompressed data and all tags of the document are
+ * stored in two arrays instead of allocating every tag (and its name) on its own.
+ *
+ * Use this to read NBT data, the Tag classes are still required to create and write
+ * NBT data.
+ */
+class Document {
+public:
+	Document();
+	~Document();
+
+	// the tags point into the data and tags arrays of the document,
+	// so a copy would point into the arrays of the original document
+	Document(const Document& other) = delete;
+	Document& operator=(const Document& other) = delete;
+
+	void readNBT(const char* buffer, size_t len, Compression compression = Compression::GZIP);
+	void readNBT(const char* filename, Compression compression = Compression::GZIP);
+
+	/**
+	 * Returns the root compound of the document.
+	 */
+	const TagNode& getRoot() const;
+
+private:
+	std::vector<char> data;
+	std::vector<TagNode> tags;
+	TagNode root;
+
+	// the tags of the lists/compounds being read
+	std::vector<TagNode> pending;
+
+	void parse();
+	void readPayload(NBTReader& reader, TagNode& tag);
+	void finishChildren(TagNode& tag, size_t first_pending);
+	void resolveChildren(TagNode& tag);
+};
+
 }
 }
 }
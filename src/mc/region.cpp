@@ -19,7 +19,10 @@
 
 #include "region.h"
 
+#include "../util.h"
+
 #include <cstdlib>
+#include <cstring>
 #include <fstream>
 
 namespace mapcrafter {
@@ -27,28 +30,35 @@ namespace mc {
 
 RegionFile::RegionFile()
 	: rotation(0) {
+	clearChunks();
 }
 
 RegionFile::RegionFile(const std::string& filename)
 	: filename(filename), rotation(0) {
 	regionpos_original = RegionPos::byFilename(filename);
 	regionpos = regionpos_original;
+	clearChunks();
 }
 
 RegionFile::~RegionFile() {
 }
 
+void RegionFile::clearChunks() {
+	for (int i = 0; i < 1024; i++) {
+		chunk_exists[i] = false;
+		chunk_timestamps[i] = 0;
+		chunk_data_compression[i] = 0;
+	}
+}
+
 bool RegionFile::readHeaders(std::ifstream& file, int chunk_offsets[1024]) {
 	if (!file)
 		return false;
 
 	containing_chunks.clear();
-	for (int i = 0; i < 1024; i++) {
+	clearChunks();
+	for (int i = 0; i < 1024; i++)
 		chunk_offsets[i] = 0;
-		chunk_exists[i] = false;
-		chunk_timestamps[i] = 0;
-		chunk_data_compression[i] = 0;
-	}
 
 	file.seekg(0, std::ios::end);
 	int filesize = file.tellg();
@@ -68,7 +78,8 @@ bool RegionFile::readHeaders(std::ifstream& file, int chunk_offsets[1024]) {
 			int offset = util::bigEndian32(tmp << 8) * 4096;
 			//uint8_t sectors = ((uint8_t*) &tmp)[3];
 
-			file.seekg(4096, std::ios::cur);
+			// the timestamps are in the second 4096 bytes of the header
+			file.seekg(4096 + 4 * (x + z * 32), std::ios::beg);
 			int timestamp;
 			file.read(reinterpret_cast<char*>(&timestamp), 4);
 			timestamp = util::bigEndian32(timestamp);
@@ -117,6 +128,7 @@ void RegionFile::setWorldCrop(const WorldCrop& worldcrop) {
 }
 
 bool RegionFile::read() {
+	util::ScopedTimer timer(util::ProfileStage::REGION_READ);
 	std::ifstream file(filename.c_str(), std::ios_base::binary);
 	int chunk_offsets[1024];
 	if (!readHeaders(file, chunk_offsets))
@@ -147,6 +159,42 @@ bool RegionFile::read() {
 	return true;
 }
 
+bool RegionFile::readChunks(const RegionFile::ChunkMap& chunks) {
+	util::ScopedTimer timer(util::ProfileStage::REGION_READ);
+	std::ifstream file(filename.c_str(), std::ios_base::binary);
+	int chunk_offsets[1024];
+	if (!readHeaders(file, chunk_offsets))
+		return false;
+	file.seekg(0, std::ios::end);
+	int filesize = file.tellg();
+
+	for (auto it = chunks.begin(); it != chunks.end(); ++it) {
+		if (!hasChunk(*it))
+			continue;
+		size_t i = getChunkIndex(*it);
+		int offset = chunk_offsets[i];
+		if (offset == 0 || offset + 5 > filesize)
+			return false;
+
+		// read data size and compression type, then only the data of this chunk
+		int size;
+		uint8_t compression;
+		file.seekg(offset, std::ios::beg);
+		file.read(reinterpret_cast<char*>(&size), 4);
+		file.read(reinterpret_cast<char*>(&compression), 1);
+		size = util::bigEndian32(size) - 1;
+		if (size < 0 || offset + 5 + size > filesize)
+			return false;
+
+		chunk_data_compression[i] = compression;
+		chunk_data[i].resize(size);
+		if (size > 0)
+			file.read(reinterpret_cast<char*>(&chunk_data[i][0]), size);
+	}
+
+	return true;
+}
+
 bool RegionFile::readOnlyHeaders() {
 	std::ifstream file(filename.c_str(), std::ios_base::binary);
 	int chunk_offsets[1024];
@@ -159,59 +207,42 @@ bool RegionFile::write(std::string filename) const {
 	if (filename.empty())
 		throw std::invalid_argument("You have to specify a filename!");
 
-	uint32_t offsets[1024];
-	for (int i = 0; i < 1024; i++)
-		offsets[i] = 0;
-
-	std::stringstream out_data, out_header;
-
-	// write chunk data to a temporary string stream
-	int position = 8192;
+	// the header with offsets and timestamps is filled in after the chunk data
+	std::vector<char> out(8192, 0);
 	for (int i = 0; i < 1024; i++) {
 		if (chunk_data[i].size() == 0)
 			continue;
 		// pad every chunk data with zeros to the next n*4096 bytes
-		if (position % 4096 != 0) {
-			int append = 4096 - position % 4096;
-			position += append;
-			for (int j = 0; j < append; j++)
-				out_data.put(0);
-		}
+		if (out.size() % 4096 != 0)
+			out.resize(out.size() + 4096 - out.size() % 4096, 0);
 
 		// calculate the offset, the chunk starts at 4096*offset bytes
-		offsets[i] = position / 4096;
+		uint32_t offset = util::bigEndian32(out.size() / 4096) >> 8;
+		std::memcpy(&out[4 * i], &offset, 4);
 
 		// get chunk data, size and compression type
 		const std::vector<uint8_t>& data = chunk_data[i];
-		uint32_t size = data.size();
-		size = util::bigEndian32(size + 1);
+		uint32_t size = util::bigEndian32(data.size() + 1);
 		uint8_t compression = chunk_data_compression[i];
 
 		// append everything to the data
-		out_data.write(reinterpret_cast<char*>(&size), 4);
-		out_data.write(reinterpret_cast<char*>(&compression), 1);
-		out_data.write(reinterpret_cast<const char*>(&data[0]), data.size());
-		position += data.size() + 5;
+		out.insert(out.end(), reinterpret_cast<char*>(&size), reinterpret_cast<char*>(&size) + 4);
+		out.push_back(compression);
+		out.insert(out.end(), data.begin(), data.end());
 	}
 
-	// create the header with offsets and timestamps
 	for (int i = 0; i < 1024; i++) {
-		int offset_big_endian = util::bigEndian32(offsets[i]) >> 8;
-		out_header.write(reinterpret_cast<char*>(&offset_big_endian), 4);
-	}
-
-	for (int i = 0; i < 1024; i++) {
-		int timestamp_big_endian = util::bigEndian32(chunk_timestamps[i]);
-		out_header.write(reinterpret_cast<char*>(&timestamp_big_endian), 4);
+		uint32_t timestamp = util::bigEndian32(chunk_timestamps[i]);
+		std::memcpy(&out[4096 + 4 * i], &timestamp, 4);
 	}
 
 	// write complete region file
-	std::ofstream out(filename, std::ios::binary);
-	if (!out)
+	std::ofstream file(filename, std::ios::binary);
+	if (!file)
 		return false;
-	out << out_header.rdbuf() << out_data.rdbuf();
-	out.close();
-	return !out.fail();
+	file.write(out.data(), out.size());
+	file.close();
+	return !file.fail();
 }
 
 const std::string& RegionFile::getFilename() const {
@@ -63,6 +63,13 @@ public:
 	 */
 	bool read();
 
+	/**
+	 * Reads only the data of the specified chunks (and the headers of the region file).
+	 * Use this instead of read() if you need just a few chunks of the region.
+	 * Returns false if the region file is corrupted.
+	 */
+	bool readChunks(const RegionFile::ChunkMap& chunks);
+
 	/**
 	 * Reads only the headers (timestamps and which chunks exist) of the region file.
 	 * Returns false if the region header is corrupted (size < 8192).
@@ -157,6 +164,12 @@ private:
 	uint8_t chunk_data_compression[1024];
 	std::vector<uint8_t> chunk_data[1024];
 
+	/**
+	 * Resets the headers of all chunks, so a new region file can be created with
+	 * the setChunk* methods.
+	 */
+	void clearChunks();
+
 	/**
 	 * Reads the headers of a region file.
 	 */
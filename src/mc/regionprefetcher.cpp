@@ -0,0 +1,149 @@
+/*
+ * Copyright 2012-2014 Moritz Hilscher
+ *
+ * This file is part of Mapcrafter.
+ *
+ * Mapcrafter is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Mapcrafter is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Mapcrafter.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "regionprefetcher.h"
+
+#include "../util.h"
+
+namespace mapcrafter {
+namespace mc {
+
+RegionPrefetcher::RegionPrefetcher(const World& world, int threads, int capacity)
+	: world(world), capacity(capacity), hits(0), waits(0), stopped(false) {
+	for (int i = 0; i < threads; i++)
+		this->threads.push_back(std::thread(&RegionPrefetcher::run, this));
+}
+
+RegionPrefetcher::~RegionPrefetcher() {
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		stopped = true;
+		condition_queue.notify_all();
+		condition_loaded.notify_all();
+	}
+	for (size_t i = 0; i < threads.size(); i++)
+		threads[i].join();
+}
+
+void RegionPrefetcher::prefetch(const RegionPos& pos) {
+	if (!world.hasRegion(pos))
+		return;
+	std::unique_lock<std::mutex> lock(mutex);
+	if (stopped || entries.count(pos))
+		return;
+	entries[pos] = Entry();
+	queue.push_back(pos);
+	condition_queue.notify_one();
+}
+
+bool RegionPrefetcher::hasRegion(const RegionPos& pos) const {
+	std::unique_lock<std::mutex> lock(mutex);
+	auto it = entries.find(pos);
+	return it != entries.end() && it->second.loaded && it->second.valid;
+}
+
+bool RegionPrefetcher::getRegion(const RegionPos& pos, RegionFile& region) {
+	std::unique_lock<std::mutex> lock(mutex);
+	auto it = entries.find(pos);
+	if (it == entries.end())
+		return false;
+
+	// the region is not read yet, the caller can read it now as well
+	if (!it->second.loading && !it->second.loaded) {
+		for (auto queue_it = queue.begin(); queue_it != queue.end(); ++queue_it)
+			if (*queue_it == pos) {
+				queue.erase(queue_it);
+				break;
+			}
+		entries.erase(it);
+		return false;
+	}
+
+	if (it->second.loading) {
+		waits++;
+		while (!stopped && it->second.loading)
+			condition_loaded.wait(lock);
+		// the entry may have been removed meanwhile
+		it = entries.find(pos);
+		if (it == entries.end() || !it->second.loaded)
+			return false;
+	}
+	if (!it->second.valid)
+		return false;
+
+	// mark the region as taken recently
+	for (auto loaded_it = loaded.begin(); loaded_it != loaded.end(); ++loaded_it)
+		if (*loaded_it == pos) {
+			loaded.splice(loaded.end(), loaded, loaded_it);
+			break;
+		}
+	hits++;
+	// the regions are shared, so copy it without holding the lock
+	std::shared_ptr<RegionFile> prefetched = it->second.region;
+	lock.unlock();
+	region = *prefetched;
+	return true;
+}
+
+int RegionPrefetcher::getHits() const {
+	std::unique_lock<std::mutex> lock(mutex);
+	return hits;
+}
+
+int RegionPrefetcher::getWaits() const {
+	std::unique_lock<std::mutex> lock(mutex);
+	return waits;
+}
+
+void RegionPrefetcher::run() {
+	std::unique_lock<std::mutex> lock(mutex);
+	while (true) {
+		while (!stopped && queue.empty())
+			condition_queue.wait(lock);
+		if (stopped)
+			return;
+
+		RegionPos pos = queue.front();
+		queue.pop_front();
+		entries[pos].loading = true;
+
+		// read the region without holding the lock
+		lock.unlock();
+		std::shared_ptr<RegionFile> region(new RegionFile);
+		bool valid = world.getRegion(pos, *region) && region->read();
+		lock.lock();
+
+		Entry& entry = entries[pos];
+		entry.loading = false;
+		entry.loaded = true;
+		entry.valid = valid;
+		if (valid)
+			entry.region = region;
+		loaded.push_back(pos);
+		// remove the regions taken least recently if there are too many
+		while (loaded.size() > (size_t) capacity) {
+			entries.erase(loaded.front());
+			loaded.pop_front();
+		}
+		condition_loaded.notify_all();
+	}
+}
+
+}
+}
@@ -0,0 +1,109 @@
+/*
+ * Copyright 2012-2014 Moritz Hilscher
+ *
+ * This file is part of Mapcrafter.
+ *
+ * Mapcrafter is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Mapcrafter is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Mapcrafter.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef REGIONPREFETCHER_H_
+#define REGIONPREFETCHER_H_
+
+#include "pos.h"
+#include "region.h"
+#include "world.h"
+
+#include <condition_variable>
+#include <deque>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace mapcrafter {
+namespace mc {
+
+/**
+ * This class reads region files on a few I/O threads ahead of time, so the render
+ * threads don't need to wait for the disk when they need a region which is not in their
+ * world cache yet.
+ *
+ * The regions which will be needed soon are added with prefetch, the world caches then
+ * take them with getRegion instead of reading them themselves. At most capacity regions
+ * are kept in memory, the ones which were taken least recently are removed first.
+ */
+class RegionPrefetcher {
+public:
+	RegionPrefetcher(const World& world, int threads = 2, int capacity = 8);
+	~RegionPrefetcher();
+
+	/**
+	 * Adds a region to the queue of regions to read. Regions which are already read or
+	 * queued (and regions which don't exist) are ignored.
+	 */
+	void prefetch(const RegionPos& pos);
+
+	/**
+	 * Returns whether a region is already read completely (and valid).
+	 */
+	bool hasRegion(const RegionPos& pos) const;
+
+	/**
+	 * Copies a prefetched region. If the region is just being read, this waits until the
+	 * region is read. Returns false if the region was not prefetched (or is invalid), it
+	 * is removed from the queue then, because the caller reads it itself.
+	 */
+	bool getRegion(const RegionPos& pos, RegionFile& region);
+
+	/**
+	 * Returns how many regions were taken from the prefetcher and how many of them
+	 * were not read completely yet when they were requested.
+	 */
+	int getHits() const;
+	int getWaits() const;
+
+private:
+	/**
+	 * The state of a region in the prefetcher.
+	 */
+	struct Entry {
+		Entry() : loading(false), loaded(false), valid(false) {}
+
+		bool loading, loaded, valid;
+		std::shared_ptr<RegionFile> region;
+	};
+
+	void run();
+
+	World world;
+	int capacity;
+
+	std::map<RegionPos, Entry> entries;
+	// queued regions to read, and the read regions (least recently taken first)
+	std::deque<RegionPos> queue;
+	std::list<RegionPos> loaded;
+
+	int hits, waits;
+	bool stopped;
+	mutable std::mutex mutex;
+	std::condition_variable condition_queue, condition_loaded;
+	std::vector<std::thread> threads;
+};
+
+}
+}
+
+#endif /* REGIONPREFETCHER_H_ */
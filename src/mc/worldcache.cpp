@@ -59,29 +59,43 @@ int WorldCache::getChunkCacheIndex(const ChunkPos& pos) const {
 	return (((pos.x + 131072) & CMASK) * CWIDTH + (pos.z + 131072)) & CMASK;
 }
 
+void WorldCache::setRegionPrefetcher(std::shared_ptr<RegionPrefetcher> prefetcher) {
+	this->prefetcher = prefetcher;
+}
+
 RegionFile* WorldCache::getRegion(const RegionPos& pos) {
 	CacheEntry<RegionPos, RegionFile>& entry = regioncache[getRegionCacheIndex(pos)];
 	// check if region is already in cache
 	if (entry.used && entry.key == pos) {
-		//regionstats.hits++;
+		regionstats.hits++;
 		return &entry.value;
 	}
 
 	// if not try to load the region
+	regionstats.misses++;
+
+	// take the region from the prefetcher if it was already read
+	if (prefetcher && prefetcher->getRegion(pos, entry.value)) {
+		entry.used = true;
+		entry.key = pos;
+		return &entry.value;
+	}
 
 	// region does not exist, region in cache was not modified
-	if (!world.getRegion(pos, entry.value))
+	if (!world.getRegion(pos, entry.value)) {
+		regionstats.not_found++;
 		return nullptr;
+	}
 
 	if (!entry.value.read()) {
 		// the region is not valid, region in cache was probably modified
+		regionstats.invalid++;
 		entry.used = false;
 		return nullptr;
 	}
 
 	entry.used = true;
 	entry.key = pos;
-	//regionstats.misses++;
 	return &entry.value;
 }
 
@@ -89,33 +103,36 @@ Chunk* WorldCache::getChunk(const ChunkPos& pos) {
 	CacheEntry<ChunkPos, Chunk>& entry = chunkcache[getChunkCacheIndex(pos)];
 	// check if chunk is already in cache
 	if (entry.used && entry.key == pos) {
-		//chunkstats.hits++;
+		chunkstats.hits++;
 		return &entry.value;
 	}
+	chunkstats.misses++;
 
 	// if not try to get the region of the chunk from the cache
 	RegionFile* region = getRegion(pos.getRegion());
 	if (region == nullptr) {
-		//chunkstats.unavailable++;
+		chunkstats.region_not_found++;
 		return nullptr;
 	}
 
 	// then try to load the chunk
 	int status = region->loadChunk(pos, entry.value);
 	// the chunk does not exist, chunk in cache was not modified
-	if (status == RegionFile::CHUNK_DOES_NOT_EXIST)
+	if (status == RegionFile::CHUNK_DOES_NOT_EXIST) {
+		chunkstats.not_found++;
 		return nullptr;
+	}
 
+	chunkstats.decoded_bytes += region->getChunkData(pos).size();
 	if (status != RegionFile::CHUNK_OK) {
-		//chunkstats.unavailable++;
 		// the chunk is not valid, chunk in cache was probably modified
+		chunkstats.invalid++;
 		entry.used = false;
 		return nullptr;
 	}
 
 	entry.used = true;
 	entry.key = pos;
-	//chunkstats.misses++;
 	return &entry.value;
 }
 
@@ -23,8 +23,11 @@
 #include "chunk.h"
 #include "pos.h"
 #include "region.h"
+#include "regionprefetcher.h"
 #include "world.h"
 
+#include <memory>
+
 namespace mapcrafter {
 namespace mc {
 
@@ -50,13 +53,35 @@ const int GET_SKY_LIGHT = 16;
 const int GET_LIGHT = GET_BLOCK_LIGHT | GET_SKY_LIGHT;
 
 /**
- * Some cache statistics for debugging. Not used at the moment.
+ * Some cache statistics, used for the render metrics.
  *
  * Maybe add a set of corrupt chunks/regions to dump them at the end of the rendering.
  */
 struct CacheStats {
 	CacheStats()
-			: hits(0), misses(0), region_not_found(0), not_found(0), invalid(0) {
+			: hits(0), misses(0), region_not_found(0), not_found(0), invalid(0),
+			  decoded_bytes(0) {
+	}
+
+	CacheStats& operator+=(const CacheStats& other) {
+		hits += other.hits;
+		misses += other.misses;
+		region_not_found += other.region_not_found;
+		not_found += other.not_found;
+		invalid += other.invalid;
+		decoded_bytes += other.decoded_bytes;
+		return *this;
+	}
+
+	CacheStats operator-(const CacheStats& other) const {
+		CacheStats stats = *this;
+		stats.hits -= other.hits;
+		stats.misses -= other.misses;
+		stats.region_not_found -= other.region_not_found;
+		stats.not_found -= other.not_found;
+		stats.invalid -= other.invalid;
+		stats.decoded_bytes -= other.decoded_bytes;
+		return stats;
 	}
 
 	void print(const std::string& name) const {
@@ -65,15 +90,19 @@ struct CacheStats {
 				  << "  misses: " << misses << std::endl
 				  << "  region_not_found: " << region_not_found << std::endl
 				  << "  not_found: " << not_found << std::endl
-				  << "  invalid: " << invalid << std::endl;
+				  << "  invalid: " << invalid << std::endl
+				  << "  decoded_bytes: " << decoded_bytes << std::endl;
 	}
 
-	int hits;
-	int misses;
+	uint64_t hits;
+	uint64_t misses;
 
 	int region_not_found;
 	int not_found;
 	int invalid;
+
+	// size of the decoded (compressed) chunk data
+	uint64_t decoded_bytes;
 };
 
 /**
@@ -127,12 +156,20 @@ private:
 	CacheStats regionstats;
 	CacheStats chunkstats;
 
+	std::shared_ptr<RegionPrefetcher> prefetcher;
+
 	int getRegionCacheIndex(const RegionPos& pos) const;
 	int getChunkCacheIndex(const ChunkPos& pos) const;
 
 public:
 	WorldCache(const World& world = World());
 
+	/**
+	 * Sets a prefetcher to take the regions from (if they were prefetched) instead of
+	 * reading them.
+	 */
+	void setRegionPrefetcher(std::shared_ptr<RegionPrefetcher> prefetcher);
+
 	RegionFile* getRegion(const RegionPos& pos);
 	Chunk* getChunk(const ChunkPos& pos);
 
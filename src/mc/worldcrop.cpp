@@ -147,5 +147,15 @@ bool WorldCrop::isBlockContainedY(const mc::BlockPos& block) const {
 	return bounds_y.contains(block.y);
 }
 
+std::string WorldCrop::toString() const {
+	std::stringstream ss;
+	ss << "y=" << bounds_y.toString();
+	if (type == RECTANGULAR)
+		ss << " x=" << bounds_x.toString() << " z=" << bounds_z.toString();
+	else
+		ss << " center=" << center << " radius=" << radius;
+	return ss.str();
+}
+
 }
 }
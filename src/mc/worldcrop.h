@@ -22,6 +22,9 @@
 
 #include "pos.h"
 
+#include <sstream>
+#include <string>
+
 namespace mapcrafter {
 namespace mc {
 
@@ -52,6 +55,11 @@ public:
 	 */
 	bool contains(T value) const;
 
+	/**
+	 * Returns a string representation of the bounds, for example "[-42,inf]".
+	 */
+	std::string toString() const;
+
 private:
 	// minimum, maximum
 	T min, max;
@@ -124,6 +132,12 @@ public:
 	 */
 	bool isBlockContainedY(const mc::BlockPos& block) const;
 
+	/**
+	 * Returns a string representation of the boundaries. Two world crops with the same
+	 * string representation crop the world in the same way.
+	 */
+	std::string toString() const;
+
 private:
 	// type of world boundaries -- either RECTANGULAR or CIRCULAR
 	int type;
@@ -197,6 +211,23 @@ bool Bounds<T>::contains(T value) const {
 	return min <= value && value <= max;
 }
 
+template <typename T>
+std::string Bounds<T>::toString() const {
+	std::stringstream ss;
+	ss << "[";
+	if (min_set)
+		ss << min;
+	else
+		ss << "-inf";
+	ss << ",";
+	if (max_set)
+		ss << max;
+	else
+		ss << "inf";
+	ss << "]";
+	return ss.str();
+}
+
 }
 }
 
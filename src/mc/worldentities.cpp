@@ -19,6 +19,14 @@
 
 #include "worldentities.h"
 
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <sstream>
+#include <thread>
+
 namespace mapcrafter {
 namespace mc {
 
@@ -52,159 +60,536 @@ const std::string& SignEntity::getText() const {
 	return text;
 }
 
+// magic bytes and version of the index file format
+const char ENTITIES_INDEX_MAGIC[4] = {'M', 'C', 'E', 'I'};
+const int ENTITIES_INDEX_VERSION = 1;
+
+namespace {
+
+/**
+ * Extracts the signs from the decompressed NBT data of a chunk. The data is read as a
+ * stream and everything except the tile entities is skipped, so no tag tree is built.
+ */
+class SignScanner {
+public:
+	SignScanner(const std::vector<char>& data)
+		: ptr(reinterpret_cast<const uint8_t*>(data.data())), end(ptr + data.size()) {
+	}
+
+	void scan(std::vector<SignEntity>& signs) {
+		if (readByte() != nbt::TagCompound::TAG_TYPE)
+			throw nbt::NBTError("First tag is not a tag compound!");
+		skip(readShort());
+
+		// go to the tile entities of the level compound
+		if (!findTag(nbt::TagCompound::TAG_TYPE, "Level")
+				|| !findTag(nbt::TagList::TAG_TYPE, "TileEntities"))
+			return;
+		int8_t type = readByte();
+		int32_t length = readLength();
+		// empty lists may have any tag type
+		if (type != nbt::TagCompound::TAG_TYPE) {
+			for (int32_t i = 0; i < length; i++)
+				skipPayload(type);
+			return;
+		}
+		for (int32_t i = 0; i < length; i++)
+			scanEntity(signs);
+	}
+
+private:
+	const uint8_t* ptr;
+	const uint8_t* end;
+
+	const uint8_t* skip(size_t bytes) {
+		if ((size_t) (end - ptr) < bytes)
+			throw nbt::NBTError("Unexpected end of NBT data!");
+		const uint8_t* data = ptr;
+		ptr += bytes;
+		return data;
+	}
+
+	int8_t readByte() {
+		return *skip(1);
+	}
+
+	uint16_t readShort() {
+		const uint8_t* data = skip(2);
+		return (data[0] << 8) | data[1];
+	}
+
+	int32_t readInt() {
+		const uint8_t* data = skip(4);
+		return ((uint32_t) data[0] << 24) | (data[1] << 16) | (data[2] << 8) | data[3];
+	}
+
+	int32_t readLength() {
+		int32_t length = readInt();
+		if (length < 0)
+			throw nbt::NBTError("Negative length of NBT list or array!");
+		return length;
+	}
+
+	std::string readString() {
+		uint16_t length = readShort();
+		return std::string(reinterpret_cast<const char*>(skip(length)), length);
+	}
+
+	/**
+	 * Skips the tags of the current compound until a tag with the specified type and
+	 * name is found. The payload of this tag is read next then.
+	 */
+	bool findTag(int8_t type, const std::string& name) {
+		while (true) {
+			int8_t tag_type = readByte();
+			if (tag_type == nbt::TagEnd::TAG_TYPE)
+				return false;
+			uint16_t length = readShort();
+			const char* tag_name = reinterpret_cast<const char*>(skip(length));
+			if (tag_type == type && name.compare(0, std::string::npos, tag_name, length) == 0)
+				return true;
+			skipPayload(tag_type);
+		}
+	}
+
+	void skipPayload(int8_t type) {
+		switch (type) {
+		case nbt::TagByte::TAG_TYPE: skip(1); break;
+		case nbt::TagShort::TAG_TYPE: skip(2); break;
+		case nbt::TagInt::TAG_TYPE:
+		case nbt::TagFloat::TAG_TYPE: skip(4); break;
+		case nbt::TagLong::TAG_TYPE:
+		case nbt::TagDouble::TAG_TYPE: skip(8); break;
+		case nbt::TagByteArray::TAG_TYPE: skip(readLength()); break;
+		case nbt::TagIntArray::TAG_TYPE: skip(4 * (size_t) readLength()); break;
+		case nbt::TagString::TAG_TYPE: skip(readShort()); break;
+		case nbt::TagList::TAG_TYPE: {
+			int8_t tag_type = readByte();
+			int32_t length = readLength();
+			for (int32_t i = 0; i < length; i++)
+				skipPayload(tag_type);
+			break;
+		}
+		case nbt::TagCompound::TAG_TYPE: {
+			int8_t tag_type;
+			while ((tag_type = readByte()) != nbt::TagEnd::TAG_TYPE) {
+				skip(readShort());
+				skipPayload(tag_type);
+			}
+			break;
+		}
+		default:
+			throw nbt::NBTError("Unknown tag type " + util::str((int) type) + "!");
+		}
+	}
+
+	void scanEntity(std::vector<SignEntity>& signs) {
+		std::string id;
+		int32_t x = 0, y = 0, z = 0;
+		int found_pos = 0;
+		SignEntity::Lines lines;
+
+		int8_t tag_type;
+		while ((tag_type = readByte()) != nbt::TagEnd::TAG_TYPE) {
+			std::string name = readString();
+			if (tag_type == nbt::TagString::TAG_TYPE) {
+				if (name == "id")
+					id = readString();
+				else if (name.size() == 5 && name.compare(0, 4, "Text") == 0
+						&& name[4] >= '1' && name[4] <= '4')
+					lines[name[4] - '1'] = readString();
+				else
+					skipPayload(tag_type);
+			} else if (tag_type == nbt::TagInt::TAG_TYPE
+					&& name.size() == 1 && (name[0] == 'x' || name[0] == 'y' || name[0] == 'z')) {
+				int32_t value = readInt();
+				if (name[0] == 'x')
+					x = value;
+				else if (name[0] == 'y')
+					y = value;
+				else
+					z = value;
+				found_pos++;
+			} else
+				skipPayload(tag_type);
+		}
+
+		if (id == "Sign" && found_pos == 3)
+			signs.push_back(SignEntity(mc::BlockPos(x, z, y), lines));
+	}
+};
+
+}
+
+EntityCacheEntry::EntityCacheEntry()
+	: mtime(0), offset(0), size(0) {
+}
+
 WorldEntitiesCache::WorldEntitiesCache(const World& world)
-	: world(world), cache_file(world.getRegionDir() / "entities.nbt.gz") {
+	: world(world), cache_dir(world.getRegionDir()), generation(0) {
 }
 
 WorldEntitiesCache::~WorldEntitiesCache() {
 }
 
-int WorldEntitiesCache::readCacheFile() {
-	if (!fs::exists(cache_file))
-		return 0;
-
-	nbt::NBTFile nbt_file;
-	nbt_file.readNBT(cache_file.string().c_str(), nbt::Compression::GZIP);
-
-	nbt::TagList nbt_regions = nbt_file.findTag<nbt::TagList>("regions");
-	for (auto region_it = nbt_regions.payload.begin();
-			region_it != nbt_regions.payload.end(); ++region_it) {
-		nbt::TagCompound region = (*region_it)->cast<nbt::TagCompound>();
-		nbt::TagList chunks = region.findTag<nbt::TagList>("chunks");
-		mc::RegionPos region_pos;
-		region_pos.x = region.findTag<nbt::TagInt>("x").payload;
-		region_pos.z = region.findTag<nbt::TagInt>("z").payload;
-
-		for (auto chunk_it = chunks.payload.begin(); chunk_it != chunks.payload.end();
-				++chunk_it) {
-			nbt::TagCompound chunk = (*chunk_it)->cast<nbt::TagCompound>();
-			nbt::TagList entities = chunk.findTag<nbt::TagList>("entities");
-			mc::ChunkPos chunk_pos;
-			chunk_pos.x = chunk.findTag<nbt::TagInt>("x").payload;
-			chunk_pos.z = chunk.findTag<nbt::TagInt>("z").payload;
-
-			for (auto entity_it = entities.payload.begin();
-					entity_it != entities.payload.end(); ++entity_it) {
-				nbt::TagCompound entity = (*entity_it)->cast<nbt::TagCompound>();
-				this->entities[region_pos][chunk_pos].push_back(entity);
-			}
+fs::path WorldEntitiesCache::getIndexPath() const {
+	return cache_dir / "entities.idx";
+}
+
+fs::path WorldEntitiesCache::getDataPath(int generation) const {
+	return cache_dir / ("entities." + util::str(generation) + ".dat");
+}
+
+bool WorldEntitiesCache::readIndex() {
+	index.clear();
+	std::ifstream in(getIndexPath().string().c_str(), std::ios::binary);
+	if (!in)
+		return false;
+
+	char magic[4];
+	int32_t version, count;
+	if (!in.read(magic, 4) || std::memcmp(magic, ENTITIES_INDEX_MAGIC, 4) != 0
+			|| !util::readBigEndian(in, version) || version != ENTITIES_INDEX_VERSION
+			|| !util::readBigEndian(in, generation)
+			|| !util::readBigEndian(in, count) || count < 0)
+		return false;
+
+	for (int32_t i = 0; i < count; i++) {
+		RegionPos pos;
+		EntityCacheEntry entry;
+		if (!util::readBigEndian(in, pos.x) || !util::readBigEndian(in, pos.z)
+				|| !util::readBigEndian(in, entry.mtime)
+				|| !util::readBigEndian(in, entry.offset)
+				|| !util::readBigEndian(in, entry.size)) {
+			index.clear();
+			return false;
 		}
+		index[pos] = entry;
+	}
+	return true;
+}
+
+bool WorldEntitiesCache::writeIndex() const {
+	// write to a temporary file at first and rename it then,
+	// so an aborted write can't leave a corrupted index behind
+	std::string filename = getIndexPath().string();
+	std::string tmp_filename = filename + ".tmp";
+	std::ofstream out(tmp_filename.c_str(), std::ios::binary);
+	if (!out)
+		return false;
+
+	out.write(ENTITIES_INDEX_MAGIC, 4);
+	util::writeBigEndian<int32_t>(out, ENTITIES_INDEX_VERSION);
+	util::writeBigEndian<int32_t>(out, generation);
+	util::writeBigEndian<int32_t>(out, index.size());
+	for (auto it = index.begin(); it != index.end(); ++it) {
+		util::writeBigEndian<int32_t>(out, it->first.x);
+		util::writeBigEndian<int32_t>(out, it->first.z);
+		util::writeBigEndian<int64_t>(out, it->second.mtime);
+		util::writeBigEndian<uint64_t>(out, it->second.offset);
+		util::writeBigEndian<uint32_t>(out, it->second.size);
 	}
 
-	return fs::last_write_time(cache_file);
+	out.close();
+	if (out.fail())
+		return false;
+	return std::rename(tmp_filename.c_str(), filename.c_str()) == 0;
 }
 
-void WorldEntitiesCache::writeCacheFile() const {
-	nbt::NBTFile nbt_file;
-	nbt::TagList nbt_regions(nbt::TagCompound::TAG_TYPE);
+bool WorldEntitiesCache::readBlock(std::istream& in, const EntityCacheEntry& entry,
+		ChunkSigns& chunk_signs) {
+	std::string data(entry.size, '\0');
+	in.seekg(entry.offset);
+	if (data.empty() || !in.read(&data[0], data.size())) {
+		in.clear();
+		return false;
+	}
 
-	for (auto region_it = entities.begin(); region_it != entities.end(); ++region_it) {
-		nbt::TagCompound nbt_region;
-		nbt_region.addTag("x", nbt::TagInt(region_it->first.x));
-		nbt_region.addTag("z", nbt::TagInt(region_it->first.z));
-		nbt::TagList nbt_chunks(nbt::TagCompound::TAG_TYPE);
-		for (auto chunk_it = region_it->second.begin();
-				chunk_it != region_it->second.end(); ++chunk_it) {
-			nbt::TagCompound nbt_chunk;
-			nbt_chunk.addTag("x", nbt::TagInt(chunk_it->first.x));
-			nbt_chunk.addTag("z", nbt::TagInt(chunk_it->first.z));
-			nbt::TagList nbt_entities(nbt::TagCompound::TAG_TYPE);
-			for (auto entity_it = chunk_it->second.begin();
-					entity_it != chunk_it->second.end(); ++entity_it) {
-				nbt_entities.payload.push_back(nbt::TagPtr(entity_it->clone()));
+	std::istringstream block(data);
+	int32_t chunks;
+	if (!util::readBigEndian(block, chunks) || chunks < 0)
+		return false;
+	for (int32_t i = 0; i < chunks; i++) {
+		ChunkPos chunk_pos;
+		int32_t count;
+		if (!util::readBigEndian(block, chunk_pos.x) || !util::readBigEndian(block, chunk_pos.z)
+				|| !util::readBigEndian(block, count) || count < 0)
+			return false;
+		std::vector<SignEntity>& signs = chunk_signs[chunk_pos];
+		signs.clear();
+		for (int32_t j = 0; j < count; j++) {
+			mc::BlockPos pos;
+			SignEntity::Lines lines;
+			if (!util::readBigEndian(block, pos.x) || !util::readBigEndian(block, pos.z)
+					|| !util::readBigEndian(block, pos.y))
+				return false;
+			for (int k = 0; k < 4; k++) {
+				uint16_t length;
+				if (!util::readBigEndian(block, length))
+					return false;
+				lines[k].resize(length);
+				if (length > 0 && !block.read(&lines[k][0], length))
+					return false;
 			}
-			nbt_chunk.addTag("entities", nbt_entities);
-			nbt_chunks.payload.push_back(nbt::TagPtr(nbt_chunk.clone()));
+			signs.push_back(SignEntity(pos, lines));
 		}
-		nbt_region.addTag("chunks", nbt_chunks);
-		nbt_regions.payload.push_back(nbt::TagPtr(nbt_region.clone()));
 	}
+	return true;
+}
 
-	nbt_file.addTag("regions", nbt_regions);
-	nbt_file.writeNBT(cache_file.string().c_str(), nbt::Compression::GZIP);
+void WorldEntitiesCache::writeBlock(std::ostream& out, const ChunkSigns& chunk_signs) {
+	util::writeBigEndian<int32_t>(out, chunk_signs.size());
+	for (auto chunk_it = chunk_signs.begin(); chunk_it != chunk_signs.end(); ++chunk_it) {
+		util::writeBigEndian<int32_t>(out, chunk_it->first.x);
+		util::writeBigEndian<int32_t>(out, chunk_it->first.z);
+		util::writeBigEndian<int32_t>(out, chunk_it->second.size());
+		for (auto sign_it = chunk_it->second.begin();
+				sign_it != chunk_it->second.end(); ++sign_it) {
+			util::writeBigEndian<int32_t>(out, sign_it->getPos().x);
+			util::writeBigEndian<int32_t>(out, sign_it->getPos().z);
+			util::writeBigEndian<int32_t>(out, sign_it->getPos().y);
+			for (int i = 0; i < 4; i++) {
+				const std::string& line = sign_it->getLines()[i];
+				uint16_t length = std::min(line.size(), (size_t) 0xffff);
+				util::writeBigEndian<uint16_t>(out, length);
+				out.write(line.data(), length);
+			}
+		}
+	}
 }
 
-void WorldEntitiesCache::update(bool verbose) {
-	int timestamp = readCacheFile();
+bool WorldEntitiesCache::scanRegion(const RegionPos& region_pos, int64_t timestamp,
+		ChunkSigns& chunk_signs) const {
+	// the cache is shared by all world crops,
+	// so the region is scanned without the crop of the world
+	RegionFile region(world.getRegionPath(region_pos).string());
+	if (!region.readOnlyHeaders())
+		return false;
+
+	// forget the chunks which were removed from the region
+	auto chunks = region.getContainingChunks();
+	for (auto chunk_it = chunk_signs.begin(); chunk_it != chunk_signs.end(); ) {
+		if (!chunks.count(chunk_it->first))
+			chunk_it = chunk_signs.erase(chunk_it);
+		else
+			++chunk_it;
+	}
+
+	// and read only the data of the changed chunks
+	RegionFile::ChunkMap changed;
+	for (auto chunk_it = chunks.begin(); chunk_it != chunks.end(); ++chunk_it)
+		if (region.getChunkTimestamp(*chunk_it) >= timestamp
+				|| !chunk_signs.count(*chunk_it))
+			changed.insert(*chunk_it);
+	if (changed.empty())
+		return true;
+	if (!region.readChunks(changed))
+		return false;
+
+	std::vector<char> decompressed;
+	for (auto chunk_it = changed.begin(); chunk_it != changed.end(); ++chunk_it) {
+		std::vector<SignEntity>& signs = chunk_signs[*chunk_it];
+		signs.clear();
+		try {
+			const std::vector<uint8_t>& data = region.getChunkData(*chunk_it);
+			decompressed.clear();
+			nbt::decompress(reinterpret_cast<const char*>(data.data()), data.size(),
+					(nbt::Compression) region.getChunkDataCompression(*chunk_it), decompressed);
+			util::ScopedTimer timer(util::ProfileStage::NBT_PARSE);
+			SignScanner(decompressed).scan(signs);
+		} catch (const nbt::NBTError& err) {
+			std::cerr << "Error: Unable to read chunk at " << *chunk_it << ": "
+					<< err.what() << std::endl;
+		}
+	}
+	return true;
+}
+
+bool WorldEntitiesCache::compact(std::fstream& data, uint64_t& data_size) {
+	// copy all used blocks into a new data file
+	std::string filename = getDataPath(generation + 1).string();
+	std::fstream compacted(filename.c_str(),
+			std::ios::in | std::ios::out | std::ios::binary | std::ios::trunc);
+	std::map<RegionPos, EntityCacheEntry> compacted_index;
+	uint64_t offset = 0;
+	std::string block;
+	for (auto it = index.begin(); compacted && it != index.end(); ++it) {
+		block.resize(it->second.size);
+		data.seekg(it->second.offset);
+		data.read(&block[0], block.size());
+		if (!data)
+			break;
+		compacted.write(block.data(), block.size());
+
+		EntityCacheEntry& entry = compacted_index[it->first];
+		entry = it->second;
+		entry.offset = offset;
+		offset += block.size();
+	}
+	compacted.flush();
+
+	if (!data || !compacted) {
+		data.clear();
+		compacted.close();
+		std::remove(filename.c_str());
+		return false;
+	}
+
+	data.close();
+	data.swap(compacted);
+	index.swap(compacted_index);
+	generation++;
+	data_size = offset;
+	return true;
+}
 
+void WorldEntitiesCache::update(bool verbose, int threads) {
 	if (verbose)
 		std::cout << "World '" << world.getRegionDir().string() << "':" << std::endl;
 
-	auto regions = world.getAvailableRegions();
-	int i = 0;
-	for (auto region_it = regions.begin(); region_it != regions.end(); ++region_it) {
-		i++;
-		if (verbose) {
-			std::cout << "(" << i << "/" << regions.size() << ") ";
-			std::cout << "Region " << *region_it << std::endl;
-		}
-
-		if (fs::last_write_time(world.getRegionPath(*region_it)) < timestamp)
-			continue;
-		RegionFile region;
-		world.getRegion(*region_it, region);
-		region.read();
+	// use the existing cache if there is a valid index and the data file has all blocks
+	bool existing = readIndex() && fs::exists(getDataPath(generation));
+	if (existing) {
+		uint64_t size = fs::file_size(getDataPath(generation));
+		for (auto it = index.begin(); it != index.end(); ++it)
+			if (it->second.offset + it->second.size > size)
+				existing = false;
+	}
+	if (!existing) {
+		index.clear();
+		generation = 0;
+	}
 
-		auto chunks = region.getContainingChunks();
-		for (auto chunk_it = chunks.begin(); chunk_it != chunks.end(); ++chunk_it) {
-			if (region.getChunkTimestamp(*chunk_it) < timestamp)
-				continue;
+	std::ios::openmode mode = std::ios::in | std::ios::out | std::ios::binary;
+	if (!existing)
+		mode |= std::ios::trunc;
+	std::fstream data(getDataPath(generation).string().c_str(), mode);
+	if (!data) {
+		std::cerr << "Error: Unable to open entity cache file "
+				<< getDataPath(generation) << "!" << std::endl;
+		return;
+	}
 
-			this->entities[*region_it][*chunk_it].clear();
+	auto available_regions = world.getAvailableRegions();
+	std::vector<RegionPos> regions(available_regions.begin(), available_regions.end());
+	std::vector<ChunkSigns> region_signs(regions.size());
+	std::vector<int64_t> region_mtimes(regions.size());
+	// vector<bool> can't be written concurrently
+	std::vector<char> region_changed(regions.size(), 0);
+
+	// the threads take the regions one after another,
+	// read the cached ones and scan the changed ones
+	std::atomic<size_t> next_region(0);
+	size_t regions_done = 0;
+	std::mutex mutex;
+	auto process = [&]() {
+		std::ifstream in(getDataPath(generation).string().c_str(), std::ios::binary);
+		for (size_t i = next_region++; i < regions.size(); i = next_region++) {
+			region_mtimes[i] = fs::last_write_time(world.getRegionPath(regions[i]));
+
+			auto entry = index.find(regions[i]);
+			bool cached = entry != index.end()
+					&& readBlock(in, entry->second, region_signs[i]);
+			if (!cached)
+				region_signs[i].clear();
+			if (!cached || entry->second.mtime != region_mtimes[i]) {
+				// with an old block, only the chunks changed since then are scanned
+				int64_t timestamp = cached ? entry->second.mtime : 0;
+				region_changed[i] = 1;
+				if (!scanRegion(regions[i], timestamp, region_signs[i])) {
+					std::unique_lock<std::mutex> lock(mutex);
+					std::cerr << "Error: Unable to read region " << regions[i] << "!"
+							<< std::endl;
+				}
+			}
 
-			mc::nbt::NBTFile nbt;
-			const std::vector<uint8_t>& data = region.getChunkData(*chunk_it);
-			nbt.readNBT(reinterpret_cast<const char*>(&data[0]), data.size(),
-					mc::nbt::Compression::ZLIB);
-
-			nbt::TagCompound& level = nbt.findTag<nbt::TagCompound>("Level");
-			nbt::TagList& entities = level.findTag<nbt::TagList>("TileEntities");
-			for (auto entity_it = entities.payload.begin();
-					entity_it != entities.payload.end(); ++entity_it) {
-				nbt::TagCompound entity = (*entity_it)->cast<nbt::TagCompound>();
-				this->entities[*region_it][*chunk_it].push_back(entity);
+			if (verbose) {
+				std::unique_lock<std::mutex> lock(mutex);
+				std::cout << "(" << ++regions_done << "/" << regions.size() << ") ";
+				std::cout << "Region " << regions[i];
+				std::cout << (region_changed[i] ? "" : " (cached)") << std::endl;
 			}
 		}
+	};
+
+	threads = std::max(1, std::min(threads, (int) regions.size()));
+	std::vector<std::thread> workers;
+	for (int i = 1; i < threads; i++)
+		workers.push_back(std::thread(process));
+	process();
+	for (auto it = workers.begin(); it != workers.end(); ++it)
+		it->join();
+
+	// append the blocks of the changed regions to the data file
+	data.seekp(0, std::ios::end);
+	uint64_t data_size = data.tellp();
+	bool changed = !existing;
+	for (size_t i = 0; i < regions.size(); i++) {
+		if (region_changed[i]) {
+			std::ostringstream block;
+			writeBlock(block, region_signs[i]);
+			std::string block_data = block.str();
+			data.write(block_data.data(), block_data.size());
+
+			EntityCacheEntry& entry = index[regions[i]];
+			entry.mtime = region_mtimes[i];
+			entry.offset = data_size;
+			entry.size = block_data.size();
+			data_size += block_data.size();
+			changed = true;
+		}
+		signs[regions[i]].swap(region_signs[i]);
+	}
+
+	// forget the regions which do not exist anymore
+	for (auto it = index.begin(); it != index.end(); ) {
+		if (!fs::exists(world.getRegionPath(it->first))) {
+			it = index.erase(it);
+			changed = true;
+		} else
+			++it;
 	}
 
-	writeCacheFile();
+	// the cache file of older versions isn't used anymore
+	boost::system::error_code error;
+	fs::remove(cache_dir / "entities.nbt.gz", error);
+
+	if (!changed)
+		return;
+	data.flush();
+	uint64_t used_size = 0;
+	for (auto it = index.begin(); it != index.end(); ++it)
+		used_size += it->second.size;
+
+	// compact the data file if more than half of it is unused,
+	// the old data file is removed after the new index is written
+	int old_generation = generation;
+	if (!data || (data_size > 2 * used_size && !compact(data, data_size))
+			|| !writeIndex()) {
+		std::cerr << "Error: Unable to write entity cache file "
+				<< getIndexPath() << "!" << std::endl;
+		return;
+	}
+	if (generation != old_generation)
+		fs::remove(getDataPath(old_generation), error);
 }
 
 std::vector<SignEntity> WorldEntitiesCache::getSigns(WorldCrop worldcrop) const {
 	std::vector<SignEntity> signs;
 
-	for (auto region_it = entities.begin(); region_it != entities.end(); ++region_it) {
+	for (auto region_it = this->signs.begin(); region_it != this->signs.end(); ++region_it) {
 		if (!worldcrop.isRegionContained(region_it->first))
 			continue;
 		for (auto chunk_it = region_it->second.begin();
 				chunk_it != region_it->second.end(); ++chunk_it) {
 			if (!worldcrop.isChunkContained(chunk_it->first))
 				continue;
-			for (auto entity_it = chunk_it->second.begin();
-					entity_it != chunk_it->second.end(); ++entity_it) {
-				const nbt::TagCompound& entity = *entity_it;
-
-				if (entity.findTag<nbt::TagString>("id").payload != "Sign")
+			for (auto sign_it = chunk_it->second.begin();
+					sign_it != chunk_it->second.end(); ++sign_it) {
+				if (!worldcrop.isBlockContainedXZ(sign_it->getPos())
+						|| !worldcrop.isBlockContainedY(sign_it->getPos()))
 					continue;
-
-				mc::BlockPos pos(
-					entity.findTag<nbt::TagInt>("x").payload,
-					entity.findTag<nbt::TagInt>("z").payload,
-					entity.findTag<nbt::TagInt>("y").payload
-				);
-
-				if (!worldcrop.isBlockContainedXZ(pos)
-						|| !worldcrop.isBlockContainedY(pos))
-					continue;
-
-				mc::SignEntity::Lines lines = {{
-					entity.findTag<nbt::TagString>("Text1").payload,
-					entity.findTag<nbt::TagString>("Text2").payload,
-					entity.findTag<nbt::TagString>("Text3").payload,
-					entity.findTag<nbt::TagString>("Text4").payload
-				}};
-
-				signs.push_back(mc::SignEntity(pos, lines));
+				signs.push_back(*sign_it);
 			}
 		}
 	}
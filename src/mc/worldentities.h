@@ -27,7 +27,9 @@
 #include "../util.h"
 
 #include <array>
+#include <fstream>
 #include <map>
+#include <string>
 #include <vector>
 #include <boost/filesystem.hpp>
 
@@ -66,33 +68,81 @@ private:
 	std::string text;
 };
 
+/**
+ * The position of the cached signs of a region in the data file of the entity cache
+ * and the modification time of the region file when it was scanned.
+ */
+struct EntityCacheEntry {
+	EntityCacheEntry();
+
+	int64_t mtime;
+	uint64_t offset;
+	uint32_t size;
+};
+
+/**
+ * Caches the signs of a world.
+ *
+ * The signs are stored per region in blocks which are appended to a data file
+ * (entities.<generation>.dat in the region directory). An index file (entities.idx)
+ * stores the position of the block of every region and the modification time of the
+ * region file it was created from. An update scans only the regions modified since then,
+ * appends new blocks for them and rewrites the index. The blocks of regions outside the
+ * world crop are not read at all. Like a tile pack, the data file is compacted if more
+ * than half of it is unused.
+ */
 class WorldEntitiesCache {
 public:
 	WorldEntitiesCache(const World& world);
 	~WorldEntitiesCache();
 
 	/**
-	 * Updates the entity cache.
+	 * Updates the entity cache. The changed regions are scanned with the specified
+	 * count of threads.
 	 */
-	void update(bool verbose = false);
+	void update(bool verbose = false, int threads = 1);
 
 	std::vector<SignEntity> getSigns(WorldCrop crop = WorldCrop()) const;
 private:
 	World world;
-	fs::path cache_file;
+	fs::path cache_dir;
+
+	// generation of the data file and the index of the region blocks
+	int generation;
+	std::map<RegionPos, EntityCacheEntry> index;
 
-	std::map<RegionPos, std::map<ChunkPos, std::vector<nbt::TagCompound> > > entities;
+	// the signs of the regions in the world crop, only the data needed for the markers
+	typedef std::map<ChunkPos, std::vector<SignEntity> > ChunkSigns;
+	std::map<RegionPos, ChunkSigns> signs;
+
+	fs::path getIndexPath() const;
+	fs::path getDataPath(int generation) const;
+
+	/**
+	 * Reads/Writes the index file. The index is replaced atomically.
+	 */
+	bool readIndex();
+	bool writeIndex() const;
+
+	/**
+	 * Reads the block of a region from the data file / serializes the signs of a region
+	 * as block.
+	 */
+	static bool readBlock(std::istream& in, const EntityCacheEntry& entry,
+			ChunkSigns& chunk_signs);
+	static void writeBlock(std::ostream& out, const ChunkSigns& chunk_signs);
 
 	/**
-	 * Reads the file with the cached entities and returns a timestamp when this cache
-	 * was updated the last time.
+	 * Scans the chunks of a region which were changed since the specified timestamp
+	 * and extracts their signs. Returns false if the region file is corrupted.
 	 */
-	int readCacheFile();
+	bool scanRegion(const RegionPos& region_pos, int64_t timestamp,
+			ChunkSigns& chunk_signs) const;
 
 	/**
-	 * Writes the file with the cached entities.
+	 * Copies all used blocks into a data file with the next generation number.
 	 */
-	void writeCacheFile() const;
+	bool compact(std::fstream& data, uint64_t& data_size);
 };
 
 } /* namespace mc */
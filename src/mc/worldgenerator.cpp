@@ -0,0 +1,499 @@
+/*
+ * Copyright 2012-2014 Moritz Hilscher
+ *
+ * This file is part of Mapcrafter.
+ *
+ * Mapcrafter is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Mapcrafter is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Mapcrafter.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "worldgenerator.h"
+
+#include "region.h"
+#include "../util.h"
+
+#include <algorithm>
+#include <atomic>
+#include <ctime>
+#include <iostream>
+#include <mutex>
+#include <thread>
+
+namespace mapcrafter {
+namespace mc {
+
+// block IDs used by the generator
+const uint8_t AIR = 0, STONE = 1, GRASS = 2, DIRT = 3, BEDROCK = 7, WATER = 9, LAVA = 11,
+		SAND = 12, GRAVEL = 13, LOG = 17, LEAVES = 18, GLASS = 20, TALL_GRASS = 31,
+		SNOW_LAYER = 78, ICE = 79, STAINED_GLASS = 95, STAINED_CLAY = 159;
+
+// biomes used if the world has many biomes:
+// plains, desert, extreme hills, forest, taiga, swampland, ice plains, jungle,
+// savanna and mesa
+const uint8_t BIOMES[] = {1, 2, 3, 4, 5, 6, 12, 21, 35, 37};
+const int BIOMES_COUNT = sizeof(BIOMES) / sizeof(BIOMES[0]);
+
+// height of the tree trunks
+const int TREE_HEIGHT = 5;
+
+WorldGeneratorSettings::WorldGeneratorSettings()
+	: seed(0), width(64), length(64), terrain(GeneratorTerrain::FLAT), height(64),
+	  amplitude(24), caves(0), water_level(0), biomes(false), transparent(0),
+	  timestamp(time(NULL)) {
+}
+
+bool WorldGeneratorSettings::setPreset(const std::string& preset) {
+	terrain = GeneratorTerrain::FLAT;
+	caves = 0;
+	water_level = 0;
+	biomes = false;
+	transparent = 0;
+
+	if (preset == "flat")
+		return true;
+	terrain = GeneratorTerrain::NOISE;
+	if (preset == "noise")
+		return true;
+	else if (preset == "caves")
+		caves = 0.4;
+	else if (preset == "water")
+		water_level = height + amplitude / 2;
+	else if (preset == "biomes")
+		biomes = true;
+	else if (preset == "transparent")
+		transparent = 0.5;
+	else if (preset == "stress") {
+		caves = 0.4;
+		water_level = height;
+		biomes = true;
+		transparent = 0.5;
+	} else
+		return false;
+	return true;
+}
+
+WorldGenerator::WorldGenerator(const WorldGeneratorSettings& settings)
+	: settings(settings) {
+}
+
+WorldGenerator::~WorldGenerator() {
+}
+
+const WorldGeneratorSettings& WorldGenerator::getSettings() const {
+	return settings;
+}
+
+bool WorldGenerator::hasChunk(const ChunkPos& chunk) const {
+	int min_x = -settings.width / 2, min_z = -settings.length / 2;
+	return chunk.x >= min_x && chunk.x < min_x + settings.width
+			&& chunk.z >= min_z && chunk.z < min_z + settings.length;
+}
+
+std::vector<RegionPos> WorldGenerator::getRegions() const {
+	int min_x = -settings.width / 2, min_z = -settings.length / 2;
+	std::vector<RegionPos> regions;
+	if (settings.width <= 0 || settings.length <= 0)
+		return regions;
+	for (int z = util::floordiv(min_z, 32);
+			z <= util::floordiv(min_z + settings.length - 1, 32); z++)
+		for (int x = util::floordiv(min_x, 32);
+				x <= util::floordiv(min_x + settings.width - 1, 32); x++)
+			regions.push_back(RegionPos(x, z));
+	return regions;
+}
+
+uint32_t WorldGenerator::random(int x, int y, int z, uint32_t salt) const {
+	// hash the position (murmur3 finalizer)
+	uint32_t h = settings.seed ^ (salt * 0x9e3779b9);
+	h ^= x * 0x85ebca6b;
+	h = (h << 13) | (h >> 19);
+	h ^= y * 0xc2b2ae35;
+	h = (h << 13) | (h >> 19);
+	h ^= z * 0x27d4eb2f;
+	h ^= h >> 16;
+	h *= 0x85ebca6b;
+	h ^= h >> 13;
+	h *= 0xc2b2ae35;
+	h ^= h >> 16;
+	return h;
+}
+
+/**
+ * Returns a smooth interpolation factor (0 to 1) of the position of a coordinate
+ * in its noise cell.
+ */
+double smoothstep(int value, int cell, int scale) {
+	double t = (double) (value - cell * scale) / scale;
+	return t * t * (3 - 2 * t);
+}
+
+double lerp(double a, double b, double t) {
+	return a + (b - a) * t;
+}
+
+double WorldGenerator::noise2D(int x, int z, int scale, uint32_t salt) const {
+	int cx = util::floordiv(x, scale), cz = util::floordiv(z, scale);
+	double tx = smoothstep(x, cx, scale), tz = smoothstep(z, cz, scale);
+	double v[2][2];
+	for (int i = 0; i < 2; i++)
+		for (int j = 0; j < 2; j++)
+			v[i][j] = random(cx + i, 0, cz + j, salt) / 2147483647.5 - 1;
+	return lerp(lerp(v[0][0], v[1][0], tx), lerp(v[0][1], v[1][1], tx), tz);
+}
+
+void WorldGenerator::noiseColumn(int x, int z, int scale, uint32_t salt,
+		double* values, int count) const {
+	int cx = util::floordiv(x, scale), cz = util::floordiv(z, scale);
+	double tx = smoothstep(x, cx, scale), tz = smoothstep(z, cz, scale);
+
+	// interpolate the noise in the x/z plane for every layer of noise cells,
+	// then interpolate between the layers
+	double below = 0, above = 0;
+	for (int y = 0; y < count; y++) {
+		int cy = y / scale;
+		if (y % scale == 0) {
+			double v[2][2][2];
+			for (int i = 0; i < 2; i++)
+				for (int j = 0; j < 2; j++)
+					for (int k = 0; k < 2; k++)
+						v[i][j][k] = random(cx + i, cy + j, cz + k, salt) / 2147483647.5 - 1;
+			below = lerp(lerp(v[0][0][0], v[1][0][0], tx), lerp(v[0][0][1], v[1][0][1], tx), tz);
+			above = lerp(lerp(v[0][1][0], v[1][1][0], tx), lerp(v[0][1][1], v[1][1][1], tx), tz);
+		}
+		values[y] = lerp(below, above, smoothstep(y, cy, scale));
+	}
+}
+
+int WorldGenerator::getHeight(int x, int z) const {
+	int height = settings.height;
+	if (settings.terrain == GeneratorTerrain::NOISE) {
+		double noise = noise2D(x, z, 64, 1) * 0.6 + noise2D(x, z, 32, 2) * 0.3
+				+ noise2D(x, z, 8, 3) * 0.1;
+		height += noise * settings.amplitude;
+	}
+	// leave some space for the trees
+	return std::max(1, std::min(height, 255 - TREE_HEIGHT - 3));
+}
+
+uint8_t WorldGenerator::getBiome(int x, int z) const {
+	if (!settings.biomes)
+		return BIOMES[0];
+	// distort the coordinates a bit to get irregular biome borders
+	int bx = x + noise2D(x, z, 16, 4) * 16;
+	int bz = z + noise2D(x, z, 16, 5) * 16;
+	return BIOMES[random(util::floordiv(bx, 64), 0, util::floordiv(bz, 64), 6) % BIOMES_COUNT];
+}
+
+bool WorldGenerator::isTree(int x, int z) const {
+	if (settings.transparent <= 0
+			|| random(x, 0, z, 7) >= settings.transparent * 0.05 * 4294967295.0)
+		return false;
+	return getHeight(x, z) >= settings.water_level;
+}
+
+void WorldGenerator::generateColumn(int x, int z, uint8_t* ids, uint8_t* data) const {
+	std::fill(ids, ids + 256, AIR);
+	std::fill(data, data + 256, 0);
+
+	int height = getHeight(x, z);
+	int water_level = std::min(settings.water_level, 255);
+	uint8_t biome = getBiome(x, z);
+	bool underwater = height < water_level;
+
+	// the ground: bedrock, stone, some dirt and the top block
+	ids[0] = BEDROCK;
+	for (int y = 1; y <= height; y++)
+		ids[y] = y < height - 3 ? STONE : DIRT;
+	if (underwater)
+		ids[height] = height < water_level - 5 ? GRAVEL : SAND;
+	else if (biome == 2)
+		ids[height] = ids[height - 1] = SAND;
+	else if (biome == 37) {
+		ids[height] = ids[height - 1] = STAINED_CLAY;
+		data[height] = 1;
+		data[height - 1] = 14;
+	} else
+		ids[height] = GRASS;
+
+	// caves, with lava at the bottom
+	if (settings.caves > 0) {
+		double threshold = 1 - 2 * settings.caves;
+		double noise1[256], noise2[256];
+		noiseColumn(x, z, 16, 8, noise1, height);
+		noiseColumn(x, z, 8, 9, noise2, height);
+		for (int y = 2; y < height - 3; y++) {
+			if (noise1[y] * 0.7 + noise2[y] * 0.3 > threshold)
+				ids[y] = y <= 10 ? LAVA : AIR;
+		}
+	}
+
+	// water (frozen in ice plains)
+	for (int y = height + 1; y <= water_level; y++)
+		ids[y] = WATER;
+	if (underwater && biome == 12)
+		ids[water_level] = ICE;
+	if (underwater)
+		return;
+	if (biome == 12)
+		ids[height + 1] = SNOW_LAYER;
+
+	// the transparent blocks: trees with leaves and glass, stained glass and tall grass
+	if (settings.transparent <= 0)
+		return;
+	uint8_t wood = biome == 5 ? 1 : (biome == 21 ? 3 : 0);
+	if (isTree(x, z)) {
+		for (int y = height + 1; y <= height + TREE_HEIGHT; y++) {
+			ids[y] = LOG;
+			data[y] = wood;
+		}
+		ids[height + TREE_HEIGHT + 1] = LEAVES;
+		data[height + TREE_HEIGHT + 1] = wood;
+	}
+	for (int dx = -2; dx <= 2; dx++)
+		for (int dz = -2; dz <= 2; dz++) {
+			if ((dx == 0 && dz == 0) || !isTree(x + dx, z + dz))
+				continue;
+			int top = getHeight(x + dx, z + dz) + TREE_HEIGHT;
+			int bottom = top - 2;
+			if (std::abs(dx) == 2 || std::abs(dz) == 2)
+				top--;
+			for (int y = bottom; y <= top + 1; y++)
+				if (ids[y] == AIR || ids[y] == SNOW_LAYER) {
+					ids[y] = LEAVES;
+					data[y] = wood;
+				}
+		}
+
+	if (ids[height + 1] != AIR && ids[height + 1] != SNOW_LAYER)
+		return;
+	if (random(x, 1, z, 10) >= settings.transparent * 4294967295.0)
+		return;
+	uint32_t type = random(x, 2, z, 11);
+	int size = 1 + (type >> 8) % 4;
+	if (type % 4 == 0 && ids[height] == GRASS) {
+		ids[height + 1] = TALL_GRASS;
+		data[height + 1] = 1;
+	} else if (type % 4 == 1) {
+		for (int y = height + 1; y <= height + size; y++)
+			ids[y] = GLASS;
+	} else if (type % 4 == 2) {
+		for (int y = height + 1; y <= height + size; y++) {
+			ids[y] = STAINED_GLASS;
+			data[y] = (type >> 16) % 16;
+		}
+	} else {
+		for (int y = height + 1; y <= height + (size + 1) / 2; y++)
+			ids[y] = LEAVES;
+	}
+}
+
+/**
+ * Adds a byte array tag with some data to a compound tag.
+ */
+void addByteArray(nbt::TagCompound& tag, const std::string& name,
+		const uint8_t* data, size_t len) {
+	tag.addTag(name, nbt::TagByteArray());
+	std::vector<int8_t>& payload = tag.findTag<nbt::TagByteArray>(name).payload;
+	payload.assign(reinterpret_cast<const int8_t*>(data),
+			reinterpret_cast<const int8_t*>(data) + len);
+}
+
+void WorldGenerator::generateChunk(const ChunkPos& chunk, nbt::NBTFile& nbt) const {
+	// block IDs and data values of all columns (index: x*16 + z)
+	std::vector<uint8_t> ids(256 * 256), data(256 * 256);
+	uint8_t biomes[256];
+	int32_t heightmap[256];
+	for (int x = 0; x < 16; x++)
+		for (int z = 0; z < 16; z++) {
+			int bx = chunk.x * 16 + x, bz = chunk.z * 16 + z;
+			generateColumn(bx, bz, &ids[(x * 16 + z) * 256], &data[(x * 16 + z) * 256]);
+			biomes[z * 16 + x] = getBiome(bx, bz);
+		}
+
+	// the sky light goes down from the top of the world, it is reduced by some
+	// transparent blocks and stopped by all other blocks (it does not spread to the
+	// sides, so caves are completely dark)
+	std::vector<uint8_t> sky(256 * 256);
+	for (int i = 0; i < 256; i++) {
+		int light = 15;
+		for (int y = 255; y >= 0; y--) {
+			uint8_t id = ids[i * 256 + y];
+			if (id == LEAVES)
+				light = std::max(0, light - 1);
+			else if (id == WATER || id == ICE)
+				light = std::max(0, light - 3);
+			else if (id != AIR && id != GLASS && id != STAINED_GLASS
+					&& id != TALL_GRASS && id != SNOW_LAYER)
+				light = 0;
+			sky[i * 256 + y] = light;
+		}
+	}
+
+	// the sections, only the ones with blocks are stored
+	uint8_t blocks[4096], block_data[2048], block_light[2048], sky_light[2048];
+	nbt::TagList sections(nbt::TagCompound::TAG_TYPE);
+	for (int section = 0; section < CHUNK_HEIGHT; section++) {
+		bool empty = true;
+		std::fill(&block_data[0], &block_data[2048], 0);
+		std::fill(&block_light[0], &block_light[2048], 0);
+		std::fill(&sky_light[0], &sky_light[2048], 0);
+		for (int x = 0; x < 16; x++)
+			for (int z = 0; z < 16; z++)
+				for (int y = section * 16; y < section * 16 + 16; y++) {
+					int index = (x * 16 + z) * 256 + y;
+					int offset = ((y % 16) * 16 + z) * 16 + x;
+					int shift = (offset % 2) * 4;
+					blocks[offset] = ids[index];
+					block_data[offset / 2] |= data[index] << shift;
+					sky_light[offset / 2] |= sky[index] << shift;
+					if (ids[index] == LAVA)
+						block_light[offset / 2] |= 15 << shift;
+					empty = empty && ids[index] == AIR;
+				}
+		if (empty)
+			continue;
+
+		nbt::TagCompound section_tag;
+		section_tag.addTag("Y", nbt::TagByte(section));
+		addByteArray(section_tag, "Blocks", blocks, 4096);
+		addByteArray(section_tag, "Data", block_data, 2048);
+		addByteArray(section_tag, "BlockLight", block_light, 2048);
+		addByteArray(section_tag, "SkyLight", sky_light, 2048);
+		sections.payload.push_back(nbt::TagPtr(section_tag.clone()));
+	}
+
+	for (int x = 0; x < 16; x++)
+		for (int z = 0; z < 16; z++) {
+			int y = 255;
+			while (y > 0 && ids[(x * 16 + z) * 256 + y] == AIR)
+				y--;
+			heightmap[z * 16 + x] = y + 1;
+		}
+
+	nbt.addTag("Level", nbt::TagCompound());
+	nbt::TagCompound& level = nbt.findTag<nbt::TagCompound>("Level");
+	level.addTag("xPos", nbt::TagInt(chunk.x));
+	level.addTag("zPos", nbt::TagInt(chunk.z));
+	level.addTag("LastUpdate", nbt::TagLong(settings.timestamp));
+	level.addTag("InhabitedTime", nbt::TagLong(0));
+	level.addTag("TerrainPopulated", nbt::TagByte(1));
+	level.addTag("LightPopulated", nbt::TagByte(1));
+	level.addTag("V", nbt::TagByte(1));
+	addByteArray(level, "Biomes", biomes, 256);
+	level.addTag("HeightMap", nbt::TagIntArray(std::vector<int32_t>(heightmap, heightmap + 256)));
+	level.addTag("Sections", sections);
+	level.addTag("Entities", nbt::TagList(nbt::TagCompound::TAG_TYPE));
+	level.addTag("TileEntities", nbt::TagList(nbt::TagCompound::TAG_TYPE));
+}
+
+std::vector<uint8_t> WorldGenerator::generateChunkData(const ChunkPos& chunk) const {
+	nbt::NBTFile nbt;
+	generateChunk(chunk, nbt);
+
+	std::vector<char> data;
+	nbt.writeNBT(data, nbt::Compression::ZLIB);
+	return std::vector<uint8_t>(data.begin(), data.end());
+}
+
+int WorldGenerator::generateRegion(const RegionPos& region,
+		const std::string& filename) const {
+	RegionFile file(filename);
+	int count = 0;
+	for (int z = 0; z < 32; z++)
+		for (int x = 0; x < 32; x++) {
+			ChunkPos chunk(region.x * 32 + x, region.z * 32 + z);
+			if (!hasChunk(chunk))
+				continue;
+			file.setChunkData(chunk, generateChunkData(chunk),
+					(uint8_t) nbt::Compression::ZLIB);
+			file.setChunkTimestamp(chunk, settings.timestamp);
+			count++;
+		}
+	if (!file.write())
+		return -1;
+	return count;
+}
+
+bool WorldGenerator::writeLevelDat(const fs::path& filename) const {
+	nbt::NBTFile nbt;
+	nbt.addTag("Data", nbt::TagCompound());
+	nbt::TagCompound& data = nbt.findTag<nbt::TagCompound>("Data");
+	data.addTag("LevelName", nbt::TagString("Generated world " + util::str(settings.seed)));
+	data.addTag("version", nbt::TagInt(19133));
+	data.addTag("RandomSeed", nbt::TagLong(settings.seed));
+	data.addTag("generatorName", nbt::TagString("flat"));
+	data.addTag("GameType", nbt::TagInt(1));
+	data.addTag("LastPlayed", nbt::TagLong((int64_t) settings.timestamp * 1000));
+	data.addTag("SpawnX", nbt::TagInt(0));
+	data.addTag("SpawnY", nbt::TagInt(getHeight(0, 0) + 1));
+	data.addTag("SpawnZ", nbt::TagInt(0));
+
+	try {
+		nbt.writeNBT(filename.string().c_str(), nbt::Compression::GZIP);
+	} catch (nbt::NBTError& ex) {
+		std::cerr << "Error: Unable to write " << filename << ": " << ex.what() << std::endl;
+		return false;
+	}
+	return true;
+}
+
+bool WorldGenerator::generate(const fs::path& world_dir, int threads,
+		util::IProgressHandler* progress) const {
+	fs::path region_dir = world_dir / "region";
+	if (!fs::is_directory(region_dir) && !fs::create_directories(region_dir)) {
+		std::cerr << "Error: Unable to create region directory " << region_dir << "!"
+				<< std::endl;
+		return false;
+	}
+	if (!writeLevelDat(world_dir / "level.dat"))
+		return false;
+
+	std::vector<RegionPos> regions = getRegions();
+	if (progress != nullptr)
+		progress->setMax(regions.size());
+
+	// the regions are distributed dynamically to the threads
+	std::atomic<size_t> next_region(0);
+	std::atomic<bool> ok(true);
+	std::mutex progress_mutex;
+	int regions_done = 0;
+	auto worker = [&]() {
+		size_t i;
+		while (ok && (i = next_region++) < regions.size()) {
+			const RegionPos& region = regions[i];
+			fs::path filename = region_dir / ("r." + util::str(region.x)
+					+ "." + util::str(region.z) + ".mca");
+			if (generateRegion(region, filename.string()) == -1) {
+				std::cerr << "Error: Unable to write region file " << filename << "!"
+						<< std::endl;
+				ok = false;
+			}
+
+			std::unique_lock<std::mutex> lock(progress_mutex);
+			regions_done++;
+			if (progress != nullptr)
+				progress->setValue(regions_done);
+		}
+	};
+
+	std::vector<std::thread> workers;
+	for (int i = 1; i < threads; i++)
+		workers.push_back(std::thread(worker));
+	worker();
+	for (size_t i = 0; i < workers.size(); i++)
+		workers[i].join();
+	return ok;
+}
+
+}
+}
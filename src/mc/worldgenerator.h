@@ -0,0 +1,193 @@
+/*
+ * Copyright 2012-2014 Moritz Hilscher
+ *
+ * This file is part of Mapcrafter.
+ *
+ * Mapcrafter is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Mapcrafter is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Mapcrafter.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef WORLDGENERATOR_H_
+#define WORLDGENERATOR_H_
+
+#include "nbt.h"
+#include "pos.h"
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include <boost/filesystem.hpp>
+
+namespace fs = boost::filesystem;
+
+namespace mapcrafter {
+namespace util {
+class IProgressHandler;
+}
+
+namespace mc {
+
+/**
+ * The terrain types of generated worlds.
+ */
+enum class GeneratorTerrain {
+	// every column has the same height
+	FLAT,
+	// hills and valleys from a height noise
+	NOISE
+};
+
+/**
+ * The settings of a generated world. The default settings generate flat terrain
+ * without caves, water, biomes and transparent blocks.
+ */
+struct WorldGeneratorSettings {
+	WorldGeneratorSettings();
+
+	// seed of all noise functions, the same seed always generates the same world
+	uint32_t seed;
+
+	// size of the world in chunks, the world is centered at the chunk 0:0
+	int width, length;
+
+	GeneratorTerrain terrain;
+	// height of the flat terrain / average height of the noise terrain
+	int height;
+	// maximum height difference of the noise terrain to the average height
+	int amplitude;
+
+	// approximate fraction (0 to 1) of the underground blocks carved out as caves
+	double caves;
+	// columns below this height are filled with water (0 = no water)
+	int water_level;
+	// whether to use many different biomes (or only plains)
+	bool biomes;
+	// approximate fraction (0 to 1) of the surface columns with transparent blocks
+	// (trees with leaves, glass, tall grass)
+	double transparent;
+
+	// timestamp of the chunks in the region files
+	uint32_t timestamp;
+
+	/**
+	 * Sets the settings of a named preset: flat, noise, caves, water, biomes,
+	 * transparent or stress (all of them combined). Returns false if there is no
+	 * preset with this name.
+	 */
+	bool setPreset(const std::string& preset);
+};
+
+/**
+ * This class generates deterministic Anvil worlds (region files with chunks in the
+ * NBT format) for benchmarks and stress tests.
+ *
+ * All blocks are calculated from noise functions of the global block positions, so
+ * every chunk can be generated independently and the generated world does not depend
+ * on the order or the count of threads used to generate it.
+ */
+class WorldGenerator {
+public:
+	WorldGenerator(const WorldGeneratorSettings& settings = WorldGeneratorSettings());
+	~WorldGenerator();
+
+	/**
+	 * Returns the settings of the generator.
+	 */
+	const WorldGeneratorSettings& getSettings() const;
+
+	/**
+	 * Returns whether a chunk is part of the generated world.
+	 */
+	bool hasChunk(const ChunkPos& chunk) const;
+
+	/**
+	 * Returns the regions of the generated world.
+	 */
+	std::vector<RegionPos> getRegions() const;
+
+	/**
+	 * Generates the NBT data of a chunk.
+	 */
+	void generateChunk(const ChunkPos& chunk, nbt::NBTFile& nbt) const;
+
+	/**
+	 * Generates the zlib compressed NBT data of a chunk, like it is stored in a
+	 * region file.
+	 */
+	std::vector<uint8_t> generateChunkData(const ChunkPos& chunk) const;
+
+	/**
+	 * Generates a region with all its chunks of the world and writes it to a file.
+	 * Returns the count of generated chunks, or -1 if the file could not be written.
+	 */
+	int generateRegion(const RegionPos& region, const std::string& filename) const;
+
+	/**
+	 * Generates the whole world (level.dat and all region files) into a world directory
+	 * with a specific count of threads. The count of generated region files is reported
+	 * to the progress handler. Returns false if a file could not be written.
+	 */
+	bool generate(const fs::path& world_dir, int threads = 1,
+			util::IProgressHandler* progress = nullptr) const;
+
+private:
+	WorldGeneratorSettings settings;
+
+	/**
+	 * Returns a pseudo random number (0 to 2^32-1) of a position.
+	 */
+	uint32_t random(int x, int y, int z, uint32_t salt) const;
+
+	/**
+	 * Returns a smooth value noise (-1 to 1) of a 2D position with a specific scale
+	 * (size of the noise cells in blocks).
+	 */
+	double noise2D(int x, int z, int scale, uint32_t salt) const;
+
+	/**
+	 * Calculates the 3D value noise (-1 to 1) of the lowest count blocks of a block
+	 * column.
+	 */
+	void noiseColumn(int x, int z, int scale, uint32_t salt, double* values,
+			int count = 256) const;
+
+	/**
+	 * Returns the terrain height of a block column.
+	 */
+	int getHeight(int x, int z) const;
+
+	/**
+	 * Returns the biome ID of a block column.
+	 */
+	uint8_t getBiome(int x, int z) const;
+
+	/**
+	 * Returns whether there is a tree trunk in a block column.
+	 */
+	bool isTree(int x, int z) const;
+
+	/**
+	 * Calculates the block IDs and data values of a block column.
+	 */
+	void generateColumn(int x, int z, uint8_t* ids, uint8_t* data) const;
+
+	/**
+	 * Writes the level.dat file of the world.
+	 */
+	bool writeLevelDat(const fs::path& filename) const;
+};
+
+}
+}
+
+#endif /* WORLDGENERATOR_H_ */
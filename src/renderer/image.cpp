@@ -23,7 +23,9 @@
 
 #include <jpeglib.h>
 #include <algorithm>
+#include <cstdlib>
 #include <iostream>
+#include <iterator>
 #include <fstream>
 
 namespace mapcrafter {
@@ -230,6 +232,22 @@ void RGBAImage::clear() {
 	std::fill(data.begin(), data.end(), 0);
 }
 
+uint64_t RGBAImage::hash() const {
+	// a simple and fast (not cryptographic) hash function working on two pixels at once
+	uint64_t hash = 0xcbf29ce484222325ULL ^ ((uint64_t) width << 32) ^ height;
+	for (size_t i = 0; i < data.size(); i += 2) {
+		uint64_t word = data[i];
+		if (i + 1 < data.size())
+			word |= (uint64_t) data[i + 1] << 32;
+		hash ^= word;
+		hash *= 0x100000001b3ULL;
+		hash ^= hash >> 29;
+	}
+
+	// 0 is reserved for not available hashes
+	return hash == 0 ? 1 : hash;
+}
+
 RGBAImage RGBAImage::clip(int x, int y, int width, int height) const {
 	RGBAImage image(width, height);
 	for (int xx = 0; xx < width && xx + x < this->width; xx++) {
@@ -396,10 +414,13 @@ bool RGBAImage::readPNG(const std::string& filename) {
 	if (!file) {
 		return false;
 	}
+	return readPNG(file);
+}
 
+bool RGBAImage::readPNG(std::istream& stream) {
 	uint8_t png_signature[8];
-	file.read((char*) &png_signature, 8);
-	if (png_sig_cmp(png_signature, 0, 8) != 0)
+	stream.read((char*) &png_signature, 8);
+	if (!stream || png_sig_cmp(png_signature, 0, 8) != 0)
 		return false;
 
 	png_structp png = png_create_read_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
@@ -418,7 +439,7 @@ bool RGBAImage::readPNG(const std::string& filename) {
 		return false;
 	}
 
-	png_set_read_fn(png, (png_voidp) &file, pngReadData);
+	png_set_read_fn(png, (png_voidp) &stream, pngReadData);
 	png_set_sig_bytes(png, 8);
 
 	png_read_info(png, info);
@@ -455,10 +476,14 @@ bool RGBAImage::readPNG(const std::string& filename) {
 
 bool RGBAImage::writePNG(const std::string& filename) const {
 	std::ofstream file(filename.c_str(), std::ios::binary);
-	if (!file) {
+	if (!file || !writePNG(file)) {
 		return false;
 	}
+	file.close();
+	return !file.fail();
+}
 
+bool RGBAImage::writePNG(std::ostream& stream) const {
 	png_structp png = png_create_write_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
 	if (png == NULL)
 		return false;
@@ -474,7 +499,7 @@ bool RGBAImage::writePNG(const std::string& filename) const {
 		return false;
 	}
 
-	png_set_write_fn(png, (png_voidp) &file, pngWriteData, NULL);
+	png_set_write_fn(png, (png_voidp) &stream, pngWriteData, NULL);
 	png_set_IHDR(png, info, width, height, 8, PNG_COLOR_TYPE_RGB_ALPHA,
 	        PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_DEFAULT, PNG_FILTER_TYPE_DEFAULT);
 
@@ -490,10 +515,9 @@ bool RGBAImage::writePNG(const std::string& filename) const {
 	else
 		png_write_png(png, info, PNG_TRANSFORM_IDENTITY, NULL);
 
-	file.close();
 	delete[] rows;
 	png_destroy_write_struct(&png, &info);
-	return true;
+	return !stream.fail();
 }
 
 /*
@@ -546,6 +570,19 @@ my_error_exit (j_common_ptr cinfo)
 }
 
 bool RGBAImage::readJPEG(const std::string& filename) {
+	std::ifstream file(filename.c_str(), std::ios::binary);
+	if (!file)
+		return false;
+	return readJPEG(file);
+}
+
+bool RGBAImage::readJPEG(std::istream& stream) {
+	// read the whole compressed image, it is decompressed from memory
+	std::string data((std::istreambuf_iterator<char>(stream)),
+			std::istreambuf_iterator<char>());
+	if (data.empty())
+		return false;
+
 	/* This struct contains the JPEG decompression parameters and pointers to
 	 * working space (which is allocated as needed by the JPEG library).
 	 */
@@ -556,22 +593,9 @@ bool RGBAImage::readJPEG(const std::string& filename) {
 	 */
 	struct my_error_mgr jerr;
 	/* More stuff */
-	FILE * infile;		/* source file */
 	JSAMPARRAY buffer;		/* Output row buffer */
 	int row_stride;		/* physical row width in output buffer */
 
-	/* In this example we want to open the input file before doing anything else,
-	 * so that the setjmp() error recovery below can assume the file is open.
-	 * VERY IMPORTANT: use "b" option to fopen() if you are on a machine that
-	 * requires it in order to read binary files.
-	 */
-
-	if ((infile = fopen(filename.c_str(), "rb")) == NULL) {
-		//fprintf(stderr, "can't open %s\n", filename.c_str());
-		//return 0;
-		return false;
-	}
-
 	/* Step 1: allocate and initialize JPEG decompression object */
 
 	/* We set up the normal JPEG error routines, then override error_exit. */
@@ -580,18 +604,17 @@ bool RGBAImage::readJPEG(const std::string& filename) {
 	/* Establish the setjmp return context for my_error_exit to use. */
 	if (setjmp(jerr.setjmp_buffer)) {
 		/* If we get here, the JPEG code has signaled an error.
-		 * We need to clean up the JPEG object, close the input file, and return.
+		 * We need to clean up the JPEG object and return.
 		 */
 		jpeg_destroy_decompress(&cinfo);
-		fclose(infile);
-		return 0;
+		return false;
 	}
 	/* Now we can initialize the JPEG decompression object. */
 	jpeg_create_decompress(&cinfo);
 
-	/* Step 2: specify data source (eg, a file) */
+	/* Step 2: specify data source (here the memory buffer) */
 
-	jpeg_stdio_src(&cinfo, infile);
+	jpeg_mem_src(&cinfo, (unsigned char*) data.data(), data.size());
 
 	/* Step 3: read file parameters with jpeg_read_header() */
 
@@ -664,13 +687,6 @@ bool RGBAImage::readJPEG(const std::string& filename) {
 	/* This is an important step since it will release a good deal of memory. */
 	jpeg_destroy_decompress(&cinfo);
 
-	/* After finish_decompress, we can close the input file.
-	 * Here we postpone it until after no more JPEG errors are possible,
-	 * so as to simplify the setjmp error logic above.	(Actually, I don't
-	 * think that jpeg_destroy can do an error exit, but why assume anything...)
-	 */
-	fclose(infile);
-
 	/* At this point you may want to check to see whether any corrupt-data
 	 * warnings occurred (test whether jerr.pub.num_warnings is nonzero).
 	 */
@@ -682,6 +698,15 @@ bool RGBAImage::readJPEG(const std::string& filename) {
 
 bool RGBAImage::writeJPEG(const std::string& filename, int quality,
 		RGBAPixel background) const {
+	std::ofstream file(filename.c_str(), std::ios::binary);
+	if (!file || !writeJPEG(file, quality, background))
+		return false;
+	file.close();
+	return !file.fail();
+}
+
+bool RGBAImage::writeJPEG(std::ostream& stream, int quality,
+		RGBAPixel background) const {
 
 	/* This struct contains the JPEG compression parameters and pointers to
 	 * working space (which is allocated as needed by the JPEG library).
@@ -700,7 +725,8 @@ bool RGBAImage::writeJPEG(const std::string& filename, int quality,
 	 */
 	struct jpeg_error_mgr jerr;
 	/* More stuff */
-	FILE * outfile;		/* target file */
+	unsigned char* outbuffer = NULL;	/* target memory buffer */
+	unsigned long outsize = 0;
 
 	/* Step 1: allocate and initialize JPEG compression object */
 
@@ -713,20 +739,10 @@ bool RGBAImage::writeJPEG(const std::string& filename, int quality,
 	/* Now we can initialize the JPEG compression object. */
 	jpeg_create_compress(&cinfo);
 
-	/* Step 2: specify data destination (eg, a file) */
+	/* Step 2: specify data destination (here a memory buffer,
+	 * which is allocated by the library and written to the stream afterwards) */
 	/* Note: steps 2 and 3 can be done in either order. */
-
-	/* Here we use the library-supplied code to send compressed data to a
-	 * stdio stream.	You can also write your own code to do something else.
-	 * VERY IMPORTANT: use "b" option to fopen() if you are on a machine that
-	 * requires it in order to write binary files.
-	 */
-	if ((outfile = fopen(filename.c_str(), "wb")) == NULL) {
-		//fprintf(stderr, "can't open %s\n", filename.c_str());
-		//exit(1);
-		return false;
-	}
-	jpeg_stdio_dest(&cinfo, outfile);
+	jpeg_mem_dest(&cinfo, &outbuffer, &outsize);
 
 	/* Step 3: set parameters for compression */
 
@@ -790,16 +806,17 @@ bool RGBAImage::writeJPEG(const std::string& filename, int quality,
 	/* Step 6: Finish compression */
 
 	jpeg_finish_compress(&cinfo);
-	/* After finish_compress, we can close the output file. */
-	fclose(outfile);
+	/* After finish_compress, we can write the compressed data to the stream. */
+	stream.write((const char*) outbuffer, outsize);
 
 	/* Step 7: release JPEG compression object */
 
 	/* This is an important step since it will release a good deal of memory. */
 	jpeg_destroy_compress(&cinfo);
+	free(outbuffer);
 
 	/* And we're done! */
-	return true;
+	return !stream.fail();
 }
 
 }
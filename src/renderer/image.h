@@ -22,6 +22,7 @@
 
 #include <png.h>
 #include <cstdint>
+#include <iostream>
 #include <string>
 #include <vector>
 
@@ -83,6 +84,11 @@ public:
 	void fill(RGBAPixel color, int x1, int y1, int w, int h);
 	void clear();
 
+	/**
+	 * Returns a hash of the size and the pixels of the image (never 0).
+	 */
+	uint64_t hash() const;
+
 	RGBAImage clip(int x, int y, int width, int height) const;
 	RGBAImage colorize(double r, double g, double b, double a = 1) const;
 	RGBAImage colorize(uint8_t r, uint8_t g, uint8_t b, uint8_t a = 255) const;
@@ -97,11 +103,16 @@ public:
 	void resizeHalf(RGBAImage& dest) const;
 
 	bool readPNG(const std::string& filename);
+	bool readPNG(std::istream& stream);
 	bool writePNG(const std::string& filename) const;
+	bool writePNG(std::ostream& stream) const;
 
 	bool readJPEG(const std::string& filename);
+	bool readJPEG(std::istream& stream);
 	bool writeJPEG(const std::string& filename, int quality,
 			RGBAPixel background = rgba(255, 255, 255, 255)) const;
+	bool writeJPEG(std::ostream& stream, int quality,
+			RGBAPixel background = rgba(255, 255, 255, 255)) const;
 };
 
 template<typename Pixel>
@@ -19,17 +19,23 @@
 
 #include "manager.h"
 
+#include "rendermetrics.h"
+#include "scanindex.h"
+#include "tilemanifest.h"
 #include "tilerenderworker.h"
 #include "../thread/impl/singlethread.h"
 #include "../thread/impl/multithreading.h"
 #include "../thread/dispatcher.h"
 #include "../version.h"
 
+#include <chrono>
 #include <ctime>
 #include <cstring>
 #include <array>
 #include <fstream>
 #include <memory>
+#include <set>
+#include <sstream>
 #include <thread>
 
 namespace mapcrafter {
@@ -384,9 +390,184 @@ void RenderManager::increaseMaxZoom(const fs::path& dir,
 		base.writeJPEG((dir / "base.jpg").string(), jpeg_quality);
 }
 
+/**
+ * This method does the same like the method above with the tiles of a tile pack.
+ */
+void RenderManager::increaseMaxZoom(TilePack& pack,
+		std::string image_format, int jpeg_quality) const {
+	bool png = image_format == "png";
+	// move the old tile trees one zoom level deeper (1/... -> 1/4/... and so on)
+	pack.increaseMaxZoom();
+
+	// now read the images, which belong to the new top level tiles,
+	// and blit them to the images of the new tiles
+	RGBAImage img[4];
+	int s = 0;
+	for (int i = 0; i < 4; i++) {
+		std::string data;
+		if (pack.readTile(TilePath() + (i + 1) + (4 - i), data)) {
+			std::istringstream ss(data);
+			if (png)
+				img[i].readPNG(ss);
+			else
+				img[i].readJPEG(ss);
+		}
+		s = std::max(s, img[i].getWidth());
+	}
+
+	RGBAImage base_big(2*s, 2*s), base;
+	for (int i = 0; i < 4; i++) {
+		RGBAImage old, tile(s, s);
+		img[i].resizeHalf(old);
+		// the old tile is in the corner next to the center of the map
+		tile.simpleblit(old, i % 2 == 0 ? s/2 : 0, i < 2 ? s/2 : 0);
+		base_big.simpleblit(tile, i % 2 == 0 ? 0 : s, i < 2 ? 0 : s);
+
+		std::stringstream ss;
+		if (png)
+			tile.writePNG(ss);
+		else
+			tile.writeJPEG(ss, jpeg_quality);
+		pack.writeTile(TilePath() + (i + 1), ss.str());
+	}
+
+	// don't forget the base tile
+	base_big.resizeHalf(base);
+	std::stringstream ss;
+	if (png)
+		base.writePNG(ss);
+	else
+		base.writeJPEG(ss, jpeg_quality);
+	pack.writeTile(TilePath(), ss.str());
+}
+
+/**
+ * Returns the render tiles (positions in the tile set) of the default view and the
+ * render hotspots of a world, or the tile in the center of the map if there are none.
+ */
+std::vector<TilePos> RenderManager::getPriorityTiles(const config::WorldSection& world,
+		int rotation, const TileSet& tile_set) const {
+	std::vector<TilePos> tiles;
+	auto hotspots = world.getRenderHotspots();
+	for (auto it = hotspots.begin(); it != hotspots.end(); ++it) {
+		mc::ChunkPos chunk(*it);
+		chunk.rotate(rotation);
+		int section = std::min(std::max(util::floordiv(it->y, 16), 0), mc::CHUNK_HEIGHT - 1);
+		std::set<TilePos> section_tiles;
+		getChunkSectionTiles(chunk, section, section_tiles);
+		for (auto tile_it = section_tiles.begin(); tile_it != section_tiles.end(); ++tile_it)
+			tiles.push_back(*tile_it - tile_set.getTileOffset());
+	}
+	if (tiles.empty())
+		tiles.push_back(TilePos(0, 0));
+	return tiles;
+}
+
 /**
  * Starts the whole rendering thing.
  */
+void RenderManager::renderJobs(const std::vector<RenderJob>& jobs,
+		std::shared_ptr<RenderMetrics> metrics) const {
+	bool shard_render = opts.shards > 0 && !opts.merge_shards;
+
+	std::vector<RenderJob> remaining = jobs;
+	while (!remaining.empty()) {
+		// the maps can only be rendered together if they have the same required tiles,
+		// the other ones are rendered in the next passes
+		std::vector<RenderJob> group, others;
+		std::vector<TilePos> tiles = remaining[0].context.tile_set->getRequiredRenderTiles();
+		for (auto it = remaining.begin(); it != remaining.end(); ++it) {
+			if (it == remaining.begin()
+					|| it->context.tile_set->getRequiredRenderTiles() == tiles)
+				group.push_back(*it);
+			else
+				others.push_back(*it);
+		}
+		remaining = others;
+
+		RenderContext context = group[0].context;
+		std::string map_names = group[0].map_name;
+		for (size_t i = 1; i < group.size(); i++) {
+			RenderOutput output;
+			output.output_dir = group[i].context.output_dir;
+			output.map_config = group[i].context.map_config;
+			output.tile_pack = group[i].context.tile_pack;
+			output.tile_manifest = group[i].context.tile_manifest;
+			context.extra_outputs.push_back(output);
+			map_names += ", " + group[i].map_name;
+		}
+		if (jobs.size() > 1)
+			std::cout << "Rendering the tiles of " << (group.size() == 1 ? "map " : "maps ")
+					<< map_names << ":" << std::endl;
+
+		// the merge pass composes only a few tiles,
+		// only the multithreading dispatcher renders with priority (with one thread, too)
+		std::shared_ptr<thread::Dispatcher> dispatcher;
+		if ((opts.jobs == 1 && context.priority_tiles.empty()) || opts.merge_shards)
+			dispatcher = std::make_shared<thread::SingleThreadDispatcher>();
+		else
+			dispatcher = std::make_shared<thread::MultiThreadingDispatcher>(opts.jobs);
+
+		util::ProgressBar* progress_ptr = new util::ProgressBar;
+		progress_ptr->setAnimated(!opts.batch);
+		std::shared_ptr<util::ProgressBar> progress(progress_ptr);
+		// the render statistics of the maps rendered together are added to the
+		// rotation which was ready last
+		if (metrics)
+			metrics->beginRender();
+		util::ProfileCounters profile_start = util::Profiler::getCounters();
+		auto render_start = std::chrono::steady_clock::now();
+		// if the tiles were split at the root tile, there is nothing left to merge
+		if (!opts.merge_shards || context.shard_level > 0)
+			dispatcher->dispatch(context, progress);
+		progress->finish();
+		if (metrics)
+			metrics->endRender();
+		if (opts.profile) {
+			// the stages are nested, the time of rendering a tile contains the time
+			// spent reading the world, finding the visible blocks, drawing and blitting
+			std::cout << "Time spent in the render stages (summed up over all "
+					<< opts.jobs << " threads):" << std::endl;
+			std::cout << (util::Profiler::getCounters() - profile_start).format(
+					getElapsedSeconds(render_start) * opts.jobs);
+		}
+
+		for (auto job = group.begin(); job != group.end(); ++job) {
+			// the index of the tile pack is written only after the rendering, too,
+			// so the pack is still valid if the rendering is aborted
+			if (job->context.tile_pack && !job->context.tile_pack->flush())
+				std::cerr << "Warning: Unable to write the tile pack index!" << std::endl;
+
+			if (!job->shard_manifest_prefix.empty())
+				for (int shard = 1; shard <= opts.shards; shard++)
+					fs::remove(job->shard_manifest_prefix + util::str(shard) + ".dat");
+
+			// update the settings file with last render time
+			job->settings->rotations[job->rotation] = true;
+			job->settings->last_render[job->rotation] = job->render_time;
+			if (!shard_render)
+				job->settings->write(job->settings_filename);
+			// the chunk hashes are written only after the rendering,
+			// so changes are not lost if the rendering is aborted
+			if (job->chunk_hashes && !job->chunk_hashes->write(job->chunk_hashes_filename))
+				std::cerr << "Warning: Unable to write the chunk hashes file!" << std::endl;
+			// all render tiles are up to date now,
+			// a shard writes its own manifest which is used by the merge pass
+			job->context.tile_manifest->update(*job->context.tile_set, job->render_time);
+			if (!job->context.tile_manifest->write(shard_render
+					? job->shard_manifest_filename : job->manifest_filename))
+				std::cerr << "Warning: Unable to write the tile manifest file!" << std::endl;
+
+			int took = time(NULL) - job->time_start;
+			std::cout << job->progress;
+			std::cout << "Rendering rotation " << config::ROTATION_NAMES[job->rotation];
+			if (group.size() > 1)
+				std::cout << " of map " << job->map_name;
+			std::cout << " took " << took << " seconds." << std::endl << std::endl;
+		}
+	}
+}
+
 bool RenderManager::run() {
 
 	// ###
@@ -451,6 +632,15 @@ bool RenderManager::run() {
 	// ### Second big step: Scan the worlds
 	// ###
 
+	// the render metrics are only collected if they are written to a file
+	std::shared_ptr<RenderMetrics> metrics;
+	if (!opts.metrics_file.empty() || !opts.metrics_prometheus_file.empty())
+		metrics.reset(new RenderMetrics(opts.metrics_file, opts.metrics_prometheus_file));
+	util::Profiler::setEnabled(opts.profile);
+	// the processes rendering the shards share the output directory, so only the merge
+	// pass writes the files which do not belong to a single shard
+	bool shard_render = opts.shards > 0 && !opts.merge_shards;
+
 	std::cout << "Scanning worlds..." << std::endl;
 	for (auto world_it = config_worlds.begin(); world_it != config_worlds.end(); ++world_it) {
 		std::string world_name = world_it->first;
@@ -477,6 +667,7 @@ bool RenderManager::run() {
 		//    to allow a nice interactively rotatable map
 		int zoomlevels_max = 0;
 		auto rotations = confighelper.getUsedRotations(world_name);
+		auto scan_start = std::chrono::steady_clock::now();
 		for (auto rotation_it = rotations.begin(); rotation_it != rotations.end(); ++rotation_it) {
 			// load the world
 			mc::World world(world_it->second.getInputDir().string(),
@@ -487,6 +678,17 @@ bool RenderManager::run() {
 				std::cerr << "Unable to load world " << world_name << "!" << std::endl;
 				return false;
 			}
+			// update the scan index of this world,
+			// only the headers of new or modified region files need to be read
+			WorldScanIndex scan_index(world);
+			std::string scan_index_filename = config.getOutputPath("scanindex_" + world_name
+					+ "_" + config::ROTATION_NAMES_SHORT[*rotation_it] + ".dat");
+			scan_index.read(scan_index_filename);
+			if (scan_index.update() != 0 && !shard_render
+					&& !scan_index.write(scan_index_filename))
+				std::cerr << "Warning: Unable to write scan index file "
+						<< scan_index_filename << "!" << std::endl;
+
 			// create a tileset for this world
 			std::shared_ptr<TileSet> tile_set(new TileSet);
 			// and scan for tiles of this world,
@@ -495,10 +697,10 @@ bool RenderManager::run() {
 			//  - the ones with complete specified x- AND z-bounds
 			if (world_it->second.needsWorldCentering()) {
 				TilePos tile_offset;
-				tile_set->scan(world, true, tile_offset);
+				tile_set->scan(scan_index, true, tile_offset);
 				confighelper.setWorldTileOffset(world_name, *rotation_it, tile_offset);
 			} else {
-				tile_set->scan(world);
+				tile_set->scan(scan_index);
 			}
 			// update the highest max zoom level
 			zoomlevels_max = std::max(zoomlevels_max, tile_set->getMinDepth());
@@ -513,15 +715,47 @@ bool RenderManager::run() {
 			tile_sets[world_name][*rotation_it]->setDepth(zoomlevels_max);
 		// also give this highest max zoom level to the config helper
 		confighelper.setWorldZoomlevel(world_name, zoomlevels_max);
+		if (metrics)
+			metrics->setWorldScanTime(world_name, getElapsedSeconds(scan_start));
 	}
 
 	// write all template files
-	writeTemplates();
+	if (!shard_render)
+		writeTemplates();
 
 	// ###
 	// ### Third big step: Render the maps
 	// ###
 
+	// the maps which can share the visible blocks of their render tiles are rendered
+	// together (see TileRenderer::canShareVisibleBlocks): the rotation of such a map is
+	// rendered when the same rotation of the last map of its render group is ready
+	std::map<std::string, std::array<std::string, 4> > render_groups;
+	for (int rotation = 0; rotation < 4 && opts.shards == 0; rotation++) {
+		std::set<std::string> grouped;
+		for (size_t i = 0; i < config_maps.size(); i++) {
+			std::vector<std::string> group;
+			for (size_t j = i; j < config_maps.size(); j++) {
+				std::string map_name = config_maps[j].getShortName();
+				if (!grouped.count(map_name) && config_maps[j].getRotations().count(rotation)
+						&& confighelper.getRenderBehavior(map_name, rotation)
+							!= config::MapcrafterConfigHelper::RENDER_SKIP
+						&& TileRenderer::canShareVisibleBlocks(config_maps[i], config_maps[j]))
+					group.push_back(map_name);
+			}
+			if (group.size() < 2 || group[0] != config_maps[i].getShortName())
+				continue;
+			for (auto it = group.begin(); it != group.end(); ++it)
+				render_groups[*it][rotation] = group.back();
+			grouped.insert(group.begin(), group.end());
+		}
+	}
+	// the rotations waiting for the other maps of their render group,
+	// by the last map of the group and the rotation
+	std::map<std::pair<std::string, int>, std::vector<RenderJob> > pending_jobs;
+	// the settings of the maps are updated after rendering their rotations
+	std::map<std::string, MapSettings> map_settings;
+
 	// some progress and timing stuff
 	int progress_maps_all = config_maps.size();
 	int time_start_all = time(NULL);
@@ -548,7 +782,7 @@ bool RenderManager::run() {
 
 		// check if we have already an old settings file,
 		// but ignore the settings file if the whole map is force-rendered
-		MapSettings settings;
+		MapSettings& settings = map_settings[map_name];
 		std::string settings_filename = config.getOutputPath(map_name + "/map.settings");
 		bool old_settings = !confighelper.isCompleteRenderForce(map_name)
 				&& fs::exists(settings_filename);
@@ -584,7 +818,14 @@ bool RenderManager::run() {
 		int world_zoomlevels = confighelper.getWorldZoomlevel(world_name);
 		// check if the zoom level of the world has increased
 		// since the map was rendered last time (if it was already rendered)
-		if (old_settings && settings.max_zoom < world_zoomlevels) {
+		if (old_settings && settings.max_zoom < world_zoomlevels && opts.shards > 0) {
+			// the shards would move the files around at the same time
+			std::cerr << "Error: The max zoom level of the map was increased, this "
+					<< "can't be handled by sharded rendering." << std::endl;
+			std::cerr << "You have to render the map once without shards." << std::endl;
+			std::cerr << std::endl;
+			continue;
+		} else if (old_settings && settings.max_zoom < world_zoomlevels) {
 			std::cout << "The max zoom level was increased from " << settings.max_zoom;
 			std::cout << " to " << world_zoomlevels << "." << std::endl;
 			std::cout << "I will move some files around..." << std::endl;
@@ -594,6 +835,16 @@ bool RenderManager::run() {
 					++rotation_it) {
 				std::string output_dir = config.getOutputPath(map_name + "/"
 						+ config::ROTATION_NAMES_SHORT[*rotation_it]);
+				if (map.packTiles()) {
+					TilePack pack(output_dir);
+					if (!pack.open())
+						continue;
+					for (int i = settings.max_zoom; i < world_zoomlevels; i++)
+						increaseMaxZoom(pack, map.getImageFormatSuffix());
+					if (!pack.flush())
+						std::cerr << "Warning: Unable to write the tile pack index!" << std::endl;
+					continue;
+				}
 				for (int i = settings.max_zoom; i < world_zoomlevels; i++)
 					increaseMaxZoom(output_dir, map.getImageFormatSuffix());
 			}
@@ -606,10 +857,12 @@ bool RenderManager::run() {
 
 		// now write the (possibly new) max zoom level to the settings file
 		settings.max_zoom = world_zoomlevels;
-		settings.write(settings_filename);
+		if (!shard_render)
+			settings.write(settings_filename);
 		// and also update the template with the max zoom level
 		confighelper.setMapZoomlevel(map_name, settings.max_zoom);
-		writeTemplateIndexHtml();
+		if (!shard_render)
+			writeTemplateIndexHtml();
 
 		// again some progress stuff
 		int progress_rotations = 0;
@@ -642,22 +895,111 @@ bool RenderManager::run() {
 
 			std::string output_dir = config.getOutputPath(map_name + "/"
 					+ config::ROTATION_NAMES_SHORT[rotation]);
+			if (metrics)
+				metrics->beginRotation(map_name, rotation);
+			auto scan_start = std::chrono::steady_clock::now();
 			// if incremental render scan which tiles might have changed
 			std::shared_ptr<TileSet> tile_set(new TileSet(*tile_sets[world_name][rotation]));
+			std::string manifest_filename = config.getOutputPath(map_name
+					+ "/manifest_" + config::ROTATION_NAMES_SHORT[rotation] + ".dat");
+			// the tile manifest also contains the image hashes of the render tiles,
+			// so tiles whose images did not change are not written again
+			std::shared_ptr<TileManifest> manifest(new TileManifest);
 			if (confighelper.getRenderBehavior(map_name, rotation)
 					== config::MapcrafterConfigHelper::RENDER_AUTO) {
 				std::cout << "Scanning required tiles..." << std::endl;
-				// use the incremental check specified in the config
-				if (map.useImageModificationTimes())
+				// use the incremental check specified in the config,
+				// the tile manifest replaces the modification times of the images
+				// if it is available (it's not if the map was rendered with an old version)
+				// the shards can't use the modification times of the images, they would
+				// see the tiles already rendered by other shards
+				bool manifest_read = manifest->read(manifest_filename);
+				if (map.useImageModificationTimes() && manifest_read)
+					tile_set->scanRequiredByManifest(*manifest);
+				else if (map.useImageModificationTimes() && opts.shards == 0)
 					tile_set->scanRequiredByFiletimes(output_dir,
 							map.getImageFormatSuffix());
 				else
 					tile_set->scanRequiredByTimestamp(settings.last_render[rotation]);
 			}
 
+			// check which of the required tiles are actually changed
+			// with the content hashes of the chunks
+			std::string chunk_hashes_filename = config.getOutputPath(map_name
+					+ "/chunkhashes_" + config::ROTATION_NAMES_SHORT[rotation] + ".dat");
+			std::shared_ptr<mc::ChunkHashIndex> chunk_hashes(
+					new mc::ChunkHashIndex(map.getRendermode() != "normal"));
+			if (map.useChunkHashes()) {
+				std::cout << "Checking chunk contents..." << std::endl;
+				// when force-rendering we just create a new index
+				if (confighelper.getRenderBehavior(map_name, rotation)
+						== config::MapcrafterConfigHelper::RENDER_AUTO)
+					chunk_hashes->read(chunk_hashes_filename);
+				tile_set->scanRequiredByChunkHashes(worlds[world_name][rotation],
+						*chunk_hashes);
+			}
+
+			// split the required tiles into the shards, every shard renders the
+			// subtrees of a part of the required tiles of the shard level
+			int shard_level = -1;
+			std::string shard_manifest_prefix = manifest_filename.substr(0,
+					manifest_filename.size() - 4) + ".shard";
+			std::string shard_manifest_filename = shard_manifest_prefix
+					+ util::str(opts.shard) + ".dat";
+			if (opts.shards > 0)
+				shard_level = tile_set->getShardLevel(opts.shards);
+			if (shard_render) {
+				tile_set->restrictRequiredTiles(tile_set->getShardTiles(opts.shard - 1,
+						opts.shards));
+				std::cout << "Rendering shard " << opts.shard << "/" << opts.shards
+						<< " with " << tile_set->getRequiredRenderTilesCount()
+						<< " render tiles (split at zoom level " << shard_level << ")."
+						<< std::endl;
+				// a manifest left over by an older run of this shard must not be merged
+				fs::remove(shard_manifest_filename);
+			}
+
+			// the merge pass takes the image hashes of the render tiles from the
+			// manifests of the shards which rendered them
+			int render_time = start_scanning;
+			if (opts.merge_shards) {
+				bool shards_finished = true;
+				for (int shard = 1; shard <= opts.shards; shard++) {
+					TileManifest shard_manifest;
+					std::string filename = shard_manifest_prefix + util::str(shard) + ".dat";
+					if (!shard_manifest.read(filename)) {
+						std::cerr << "Error: Unable to read the manifest of shard " << shard
+								<< "/" << opts.shards << " (" << filename << ")!" << std::endl;
+						std::cerr << "Did the rendering of the shard finish?" << std::endl;
+						shards_finished = false;
+						break;
+					}
+
+					TileSet shard_tiles(*tile_set);
+					shard_tiles.restrictRequiredTiles(tile_set->getShardTiles(shard - 1,
+							opts.shards));
+					auto tiles = shard_tiles.getRequiredRenderTiles();
+					for (auto it = tiles.begin(); it != tiles.end(); ++it)
+						manifest->setTileHash(*it, shard_manifest.getTileHash(*it));
+					// all tiles of a shard manifest have the time the shard started,
+					// the world may have changed since the first shard was started
+					const std::vector<TilePos>& render_tiles = tile_set->getRenderTiles();
+					if (!render_tiles.empty() && shard_manifest.hasTile(render_tiles[0]))
+						render_time = std::min(render_time,
+								shard_manifest.getTile(render_tiles[0]).timestamp);
+				}
+				if (!shards_finished) {
+					std::cerr << std::endl;
+					continue;
+				}
+			}
+
 			int time_start = time(NULL);
+			if (metrics)
+				metrics->setScanTime(getElapsedSeconds(scan_start));
 
 			// create block images
+			auto sprites_start = std::chrono::steady_clock::now();
 			std::shared_ptr<BlockImages> block_images(new BlockImages);
 			block_images->setSettings(map.getTextureSize(), rotation, map.renderUnknownBlocks(),
 					map.renderLeavesTransparent(), map.getRendermode());
@@ -667,10 +1009,42 @@ bool RenderManager::run() {
 				std::cerr << "Skipping remaining rotations." << std::endl << std::endl;
 				break;
 			}
+			if (metrics)
+				metrics->setSpritesTime(getElapsedSeconds(sprites_start));
+
+			// open the tile pack if the tile images should be stored in one
+			std::shared_ptr<TilePack> tile_pack;
+			if (map.packTiles() && opts.shards > 0) {
+				// the index of the tile pack can't be written by multiple processes
+				std::cerr << "Error: Maps with packed tiles can't be rendered with shards!"
+						<< std::endl << std::endl;
+				continue;
+			} else if (map.packTiles()) {
+				tile_pack.reset(new TilePack(output_dir));
+				if (!tile_pack->open()) {
+					std::cerr << "Unable to open the tile pack in " << output_dir << "!"
+							<< std::endl << std::endl;
+					continue;
+				}
+			}
 
 			// render the map
-			if (tile_set->getRequiredRenderTilesCount() == 0) {
+			if (tile_set->getRequiredRenderTilesCount() == 0 && shard_render) {
 				std::cout << "No tiles need to get rendered." << std::endl;
+				manifest->update(*tile_set, render_time);
+				if (!manifest->write(shard_manifest_filename))
+					std::cerr << "Warning: Unable to write the tile manifest file!" << std::endl;
+				continue;
+			} else if (tile_set->getRequiredRenderTilesCount() == 0) {
+				std::cout << "No tiles need to get rendered." << std::endl;
+				if (opts.merge_shards)
+					for (int shard = 1; shard <= opts.shards; shard++)
+						fs::remove(shard_manifest_prefix + util::str(shard) + ".dat");
+				if (map.useChunkHashes())
+					chunk_hashes->write(chunk_hashes_filename);
+				manifest->update(*tile_set, render_time);
+				if (!manifest->write(manifest_filename))
+					std::cerr << "Warning: Unable to write the tile manifest file!" << std::endl;
 				continue;
 			}
 
@@ -682,35 +1056,73 @@ bool RenderManager::run() {
 			context.block_images = block_images;
 			context.world = worlds[world_name][rotation];
 			context.tile_set = tile_set;
+			context.tile_pack = tile_pack;
+			context.tile_manifest = manifest;
+			context.metrics = metrics;
+			context.shard_level = shard_level;
+			context.shard_merge = opts.merge_shards;
+			if (opts.priority && !opts.merge_shards) {
+				size_t hotspots = context.world_config.getRenderHotspots().size();
+				if (hotspots == 0)
+					std::cout << "Rendering the tiles around the center of the map first."
+							<< std::endl;
+				else
+					std::cout << "Rendering the tiles around " << hotspots
+							<< " position(s) first." << std::endl;
+				context.priority_tiles = getPriorityTiles(context.world_config, rotation,
+						*tile_set);
+			}
 
-			std::shared_ptr<thread::Dispatcher> dispatcher;
-			if (opts.jobs == 1)
-				dispatcher = std::make_shared<thread::SingleThreadDispatcher>();
-			else
-				dispatcher = std::make_shared<thread::MultiThreadingDispatcher>(opts.jobs);
-
-			util::ProgressBar* progress_ptr = new util::ProgressBar;
-			progress_ptr->setAnimated(!opts.batch);
-			std::shared_ptr<util::ProgressBar> progress(progress_ptr);
-			dispatcher->dispatch(context, progress);
-			progress->finish();
-
-			// update the settings file with last render time
-			settings.rotations[rotation] = true;
-			settings.last_render[rotation] = start_scanning;
-			settings.write(settings_filename);
-
-			int took = time(NULL) - time_start;
-			std::cout << "(" << progress_maps << "." << progress_rotations << "/";
-			std::cout << progress_maps << "." << progress_rotations_all << ") ";
-			std::cout << "Rendering rotation " << config::ROTATION_NAMES[*rotation_it];
-			std::cout << " took " << took << " seconds." << std::endl << std::endl;
-
+			RenderJob job;
+			job.map_name = map_name;
+			job.rotation = rotation;
+			job.progress = "(" + util::str(progress_maps) + "." + util::str(progress_rotations)
+					+ "/" + util::str(progress_maps) + "." + util::str(progress_rotations_all)
+					+ ") ";
+			job.context = context;
+			job.settings = &settings;
+			job.settings_filename = settings_filename;
+			job.manifest_filename = manifest_filename;
+			if (map.useChunkHashes() && !shard_render) {
+				job.chunk_hashes = chunk_hashes;
+				job.chunk_hashes_filename = chunk_hashes_filename;
+			}
+			if (opts.merge_shards)
+				job.shard_manifest_prefix = shard_manifest_prefix;
+			if (shard_render)
+				job.shard_manifest_filename = shard_manifest_filename;
+			job.render_time = render_time;
+			job.time_start = time_start;
+
+			// wait for the other maps of the render group
+			std::string group = render_groups[map_name][rotation];
+			if (group.empty()) {
+				renderJobs(std::vector<RenderJob>(1, job), metrics);
+				continue;
+			}
+			std::vector<RenderJob>& jobs = pending_jobs[std::make_pair(group, rotation)];
+			jobs.push_back(job);
+			if (group != map_name) {
+				std::cout << "The tiles are rendered together with map " << group << "."
+						<< std::endl << std::endl;
+				continue;
+			}
+			renderJobs(jobs, metrics);
+			pending_jobs.erase(std::make_pair(group, rotation));
 		}
 	}
 
+	// the last maps of some render groups might not have been rendered
+	for (auto it = pending_jobs.begin(); it != pending_jobs.end(); ++it) {
+		std::cout << "Rendering rotation " << config::ROTATION_NAMES[it->first.second]
+				<< " of the maps waiting for map " << it->first.first << ":" << std::endl;
+		renderJobs(it->second, metrics);
+	}
+
 	int took_all = time(NULL) - time_start_all;
 	std::cout << "Rendering all worlds took " << took_all << " seconds." << std::endl;
+	if (metrics)
+		metrics->write(true);
 
 	std::cout << std::endl << "Finished.....aaand it's gone!" << std::endl;
 	return true;
@@ -20,14 +20,21 @@
 #ifndef MANAGER_H_
 #define MANAGER_H_
 
+#include "rendermetrics.h"
+#include "tilepack.h"
 #include "tilerenderer.h"
+#include "tilerenderworker.h"
 #include "tileset.h"
 #include "../config/mapcrafterconfig.h"
 #include "../config/mapcrafterconfighelper.h"
+#include "../mc/chunkhashes.h"
 #include "../mc/world.h"
 #include "../mc/worldcache.h"
 #include "../util.h"
 
+#include <memory>
+#include <string>
+#include <vector>
 #include <boost/filesystem.hpp>
 
 namespace fs = boost::filesystem;
@@ -47,6 +54,21 @@ struct RenderOpts {
 
 	int jobs;
 	bool batch;
+
+	// files to write the render metrics to (as JSON/Prometheus text file), if not empty
+	std::string metrics_file, metrics_prometheus_file;
+
+	// whether to measure and show the time spent in the render stages
+	bool profile;
+
+	// sharded rendering: the count of shards (0 if the rendering is not sharded) and
+	// the number of the shard to render (1 to shards), or whether to run the merge pass
+	int shards, shard;
+	bool merge_shards;
+
+	// whether to render the tiles around the default view and the render hotspots of
+	// the worlds first
+	bool priority;
 };
 
 /**
@@ -74,6 +96,31 @@ struct MapSettings {
 	static MapSettings byMapConfig(const config::MapSection& map);
 };
 
+/**
+ * A rotation of a map whose required tiles are scanned and which is ready to render.
+ */
+struct RenderJob {
+	RenderJob() : rotation(0), settings(nullptr), render_time(0), time_start(0) {}
+
+	std::string map_name;
+	int rotation;
+	// the progress of the map and of the rotation like "(1.2/1.4) ", for output
+	std::string progress;
+
+	RenderContext context;
+
+	// the files which are updated after the rendering
+	MapSettings* settings;
+	std::string settings_filename, manifest_filename;
+	std::shared_ptr<mc::ChunkHashIndex> chunk_hashes;
+	std::string chunk_hashes_filename;
+	std::string shard_manifest_prefix, shard_manifest_filename;
+
+	// the time the rendered tiles are up to date with,
+	// and the time the rendering of the rotation was started
+	int render_time, time_start;
+};
+
 /**
  * This does the whole rendering process.
  */
@@ -92,6 +139,19 @@ private:
 
 	void increaseMaxZoom(const fs::path& dir, std::string image_format,
 			int jpeg_quality = 85) const;
+	void increaseMaxZoom(TilePack& pack, std::string image_format,
+			int jpeg_quality = 85) const;
+
+	std::vector<TilePos> getPriorityTiles(const config::WorldSection& world, int rotation,
+			const TileSet& tile_set) const;
+
+	/**
+	 * Renders the rotations of maps which can share the visible blocks of their render
+	 * tiles (or a single rotation of a map). The rotations with the same required tiles
+	 * as the first one are rendered together with it, the others are rendered alone.
+	 */
+	void renderJobs(const std::vector<RenderJob>& jobs,
+			std::shared_ptr<RenderMetrics> metrics) const;
 
 public:
 	RenderManager(const RenderOpts& opts);
@@ -0,0 +1,358 @@
+/*
+ * Copyright 2012-2014 Moritz Hilscher
+ *
+ * This file is part of Mapcrafter.
+ *
+ * Mapcrafter is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Mapcrafter is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Mapcrafter.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "rendermetrics.h"
+
+#include "../config/validation.h"
+#include "../util.h"
+#include "../version.h"
+
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
+namespace mapcrafter {
+namespace renderer {
+
+double getElapsedSeconds(const std::chrono::steady_clock::time_point& start) {
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+TileRenderStats::TileRenderStats()
+	: render_time(0), encode_time(0), write_time(0),
+	  render_tiles(0), render_tiles_unchanged(0), composite_tiles(0), bytes_written(0) {
+}
+
+TileRenderStats& TileRenderStats::operator+=(const TileRenderStats& other) {
+	render_time += other.render_time;
+	encode_time += other.encode_time;
+	write_time += other.write_time;
+	render_tiles += other.render_tiles;
+	render_tiles_unchanged += other.render_tiles_unchanged;
+	composite_tiles += other.composite_tiles;
+	bytes_written += other.bytes_written;
+	region_cache += other.region_cache;
+	chunk_cache += other.chunk_cache;
+	return *this;
+}
+
+RotationMetrics::RotationMetrics()
+	: rotation(0), scan_time(0), sprites_time(0), render_time(0), rendering(false) {
+}
+
+double RotationMetrics::getRenderTime() const {
+	if (rendering)
+		return getElapsedSeconds(render_start);
+	return render_time;
+}
+
+double RotationMetrics::getTilesPerSecond() const {
+	double time = getRenderTime();
+	if (time <= 0)
+		return 0;
+	return tiles.render_tiles / time;
+}
+
+/**
+ * Writes a file atomically (to a temporary file at first, which is renamed then), so
+ * programs reading the file periodically never see a half-written file.
+ */
+bool writeFileAtomically(const std::string& filename, const std::string& data) {
+	std::string tmp_filename = filename + ".tmp";
+	std::ofstream out(tmp_filename.c_str());
+	if (!out)
+		return false;
+	out << data;
+	out.close();
+	if (out.fail())
+		return false;
+	return std::rename(tmp_filename.c_str(), filename.c_str()) == 0;
+}
+
+double getHitRate(const mc::CacheStats& stats) {
+	if (stats.hits + stats.misses == 0)
+		return 0;
+	return (double) stats.hits / (stats.hits + stats.misses);
+}
+
+std::string cacheStatsToJSON(const mc::CacheStats& stats) {
+	std::ostringstream ss;
+	ss << "{\"hits\": " << stats.hits << ", \"misses\": " << stats.misses
+			<< ", \"hit_rate\": " << getHitRate(stats)
+			<< ", \"not_found\": " << stats.not_found + stats.region_not_found
+			<< ", \"invalid\": " << stats.invalid
+			<< ", \"decoded_bytes\": " << stats.decoded_bytes << "}";
+	return ss.str();
+}
+
+/**
+ * Escapes a label value for the Prometheus text format.
+ */
+std::string escapeLabel(const std::string& str) {
+	return util::replaceAll(util::replaceAll(util::replaceAll(str,
+			"\\", "\\\\"), "\"", "\\\""), "\n", "\\n");
+}
+
+RenderMetrics::RenderMetrics(const std::string& json_file, const std::string& prometheus_file)
+	: json_file(json_file), prometheus_file(prometheus_file), write_interval(30),
+	  time_start(time(NULL)), time_last_write(time_start), finished(false) {
+}
+
+RenderMetrics::~RenderMetrics() {
+}
+
+void RenderMetrics::setWriteInterval(int interval) {
+	std::unique_lock<std::mutex> lock(mutex);
+	write_interval = interval;
+}
+
+void RenderMetrics::setWorldScanTime(const std::string& world, double time) {
+	std::unique_lock<std::mutex> lock(mutex);
+	world_scan_times[world] = time;
+}
+
+void RenderMetrics::beginRotation(const std::string& map, int rotation) {
+	std::unique_lock<std::mutex> lock(mutex);
+	RotationMetrics metrics;
+	metrics.map = map;
+	metrics.rotation = rotation;
+	rotations.push_back(metrics);
+}
+
+void RenderMetrics::setScanTime(double time) {
+	std::unique_lock<std::mutex> lock(mutex);
+	if (!rotations.empty())
+		rotations.back().scan_time = time;
+}
+
+void RenderMetrics::setSpritesTime(double time) {
+	std::unique_lock<std::mutex> lock(mutex);
+	if (!rotations.empty())
+		rotations.back().sprites_time = time;
+}
+
+void RenderMetrics::beginRender() {
+	std::unique_lock<std::mutex> lock(mutex);
+	if (rotations.empty())
+		return;
+	rotations.back().rendering = true;
+	rotations.back().render_start = std::chrono::steady_clock::now();
+}
+
+void RenderMetrics::endRender() {
+	std::unique_lock<std::mutex> lock(mutex);
+	if (rotations.empty() || !rotations.back().rendering)
+		return;
+	rotations.back().rendering = false;
+	rotations.back().render_time = getElapsedSeconds(rotations.back().render_start);
+}
+
+void RenderMetrics::addTileRenderStats(const TileRenderStats& stats) {
+	std::unique_lock<std::mutex> lock(mutex);
+	if (rotations.empty())
+		return;
+	rotations.back().tiles += stats;
+
+	if (write_interval > 0 && time(NULL) - time_last_write >= write_interval)
+		writeUnlocked();
+}
+
+std::vector<RotationMetrics> RenderMetrics::getRotations() const {
+	std::unique_lock<std::mutex> lock(mutex);
+	return rotations;
+}
+
+std::string RenderMetrics::toJSON() const {
+	std::unique_lock<std::mutex> lock(mutex);
+	return toJSONUnlocked();
+}
+
+std::string RenderMetrics::toPrometheus() const {
+	std::unique_lock<std::mutex> lock(mutex);
+	return toPrometheusUnlocked();
+}
+
+bool RenderMetrics::write(bool finished) {
+	std::unique_lock<std::mutex> lock(mutex);
+	this->finished = finished;
+	return writeUnlocked();
+}
+
+std::string RenderMetrics::toJSONUnlocked() const {
+	std::ostringstream ss;
+	ss << std::fixed << std::setprecision(3);
+	ss << "{" << std::endl;
+	ss << "  \"version\": \"" << util::escapeJSON(MAPCRAFTER_VERSION) << "\"," << std::endl;
+	ss << "  \"time_start\": " << time_start << "," << std::endl;
+	ss << "  \"time_updated\": " << time(NULL) << "," << std::endl;
+	ss << "  \"finished\": " << (finished ? "true" : "false") << "," << std::endl;
+
+	ss << "  \"world_scan_times\": {";
+	for (auto it = world_scan_times.begin(); it != world_scan_times.end(); ++it)
+		ss << (it == world_scan_times.begin() ? "" : ", ")
+				<< "\"" << util::escapeJSON(it->first) << "\": " << it->second;
+	ss << "}," << std::endl;
+
+	ss << "  \"rotations\": [" << std::endl;
+	for (auto it = rotations.begin(); it != rotations.end(); ++it) {
+		const TileRenderStats& tiles = it->tiles;
+		ss << "    {" << std::endl;
+		ss << "      \"map\": \"" << util::escapeJSON(it->map) << "\"," << std::endl;
+		ss << "      \"rotation\": \"" << config::ROTATION_NAMES_SHORT[it->rotation]
+				<< "\"," << std::endl;
+		ss << "      \"phases\": {\"scan\": " << it->scan_time
+				<< ", \"sprites\": " << it->sprites_time
+				<< ", \"render\": " << it->getRenderTime()
+				<< ", \"tile_render\": " << tiles.render_time
+				<< ", \"encode\": " << tiles.encode_time
+				<< ", \"write\": " << tiles.write_time << "}," << std::endl;
+		ss << "      \"render_tiles\": " << tiles.render_tiles << "," << std::endl;
+		ss << "      \"render_tiles_unchanged\": " << tiles.render_tiles_unchanged
+				<< "," << std::endl;
+		ss << "      \"composite_tiles\": " << tiles.composite_tiles << "," << std::endl;
+		ss << "      \"tiles_per_second\": " << it->getTilesPerSecond() << "," << std::endl;
+		ss << "      \"bytes_written\": " << tiles.bytes_written << "," << std::endl;
+		ss << "      \"region_cache\": " << cacheStatsToJSON(tiles.region_cache)
+				<< "," << std::endl;
+		ss << "      \"chunk_cache\": " << cacheStatsToJSON(tiles.chunk_cache) << std::endl;
+		ss << "    }" << (it + 1 == rotations.end() ? "" : ",") << std::endl;
+	}
+	ss << "  ]" << std::endl;
+	ss << "}" << std::endl;
+	return ss.str();
+}
+
+std::string RenderMetrics::toPrometheusUnlocked() const {
+	std::ostringstream ss;
+	ss << std::fixed << std::setprecision(3);
+
+	ss << "# HELP mapcrafter_run_start_time_seconds Start time of the render run." << std::endl;
+	ss << "# TYPE mapcrafter_run_start_time_seconds gauge" << std::endl;
+	ss << "mapcrafter_run_start_time_seconds " << time_start << std::endl;
+	ss << "# HELP mapcrafter_run_finished Whether the render run is finished." << std::endl;
+	ss << "# TYPE mapcrafter_run_finished gauge" << std::endl;
+	ss << "mapcrafter_run_finished " << (finished ? 1 : 0) << std::endl;
+
+	ss << "# HELP mapcrafter_world_scan_seconds Time required to scan a world." << std::endl;
+	ss << "# TYPE mapcrafter_world_scan_seconds gauge" << std::endl;
+	for (auto it = world_scan_times.begin(); it != world_scan_times.end(); ++it)
+		ss << "mapcrafter_world_scan_seconds{world=\"" << escapeLabel(it->first) << "\"} "
+				<< it->second << std::endl;
+
+	// the metrics of the rotations, every metric is written for all rotations at once
+	std::vector<std::string> labels;
+	for (auto it = rotations.begin(); it != rotations.end(); ++it)
+		labels.push_back("map=\"" + escapeLabel(it->map) + "\",rotation=\""
+				+ config::ROTATION_NAMES_SHORT[it->rotation] + "\"");
+
+	ss << "# HELP mapcrafter_phase_seconds Wall clock time of the phases of rendering "
+			"a map rotation." << std::endl;
+	ss << "# TYPE mapcrafter_phase_seconds gauge" << std::endl;
+	for (size_t i = 0; i < rotations.size(); i++) {
+		ss << "mapcrafter_phase_seconds{" << labels[i] << ",phase=\"scan\"} "
+				<< rotations[i].scan_time << std::endl;
+		ss << "mapcrafter_phase_seconds{" << labels[i] << ",phase=\"sprites\"} "
+				<< rotations[i].sprites_time << std::endl;
+		ss << "mapcrafter_phase_seconds{" << labels[i] << ",phase=\"render\"} "
+				<< rotations[i].getRenderTime() << std::endl;
+	}
+
+	ss << "# HELP mapcrafter_tile_seconds Time spent rendering, encoding and writing "
+			"tiles (summed up over all threads)." << std::endl;
+	ss << "# TYPE mapcrafter_tile_seconds gauge" << std::endl;
+	for (size_t i = 0; i < rotations.size(); i++) {
+		const TileRenderStats& tiles = rotations[i].tiles;
+		ss << "mapcrafter_tile_seconds{" << labels[i] << ",stage=\"render\"} "
+				<< tiles.render_time << std::endl;
+		ss << "mapcrafter_tile_seconds{" << labels[i] << ",stage=\"encode\"} "
+				<< tiles.encode_time << std::endl;
+		ss << "mapcrafter_tile_seconds{" << labels[i] << ",stage=\"write\"} "
+				<< tiles.write_time << std::endl;
+	}
+
+	ss << "# HELP mapcrafter_tiles Count of rendered render tiles, of unchanged render "
+			"tiles and of written composite tiles." << std::endl;
+	ss << "# TYPE mapcrafter_tiles gauge" << std::endl;
+	for (size_t i = 0; i < rotations.size(); i++) {
+		const TileRenderStats& tiles = rotations[i].tiles;
+		ss << "mapcrafter_tiles{" << labels[i] << ",type=\"render\"} "
+				<< tiles.render_tiles << std::endl;
+		ss << "mapcrafter_tiles{" << labels[i] << ",type=\"render_unchanged\"} "
+				<< tiles.render_tiles_unchanged << std::endl;
+		ss << "mapcrafter_tiles{" << labels[i] << ",type=\"composite\"} "
+				<< tiles.composite_tiles << std::endl;
+	}
+
+	ss << "# HELP mapcrafter_tiles_per_second Rendered render tiles per second." << std::endl;
+	ss << "# TYPE mapcrafter_tiles_per_second gauge" << std::endl;
+	for (size_t i = 0; i < rotations.size(); i++)
+		ss << "mapcrafter_tiles_per_second{" << labels[i] << "} "
+				<< rotations[i].getTilesPerSecond() << std::endl;
+
+	ss << "# HELP mapcrafter_written_bytes Bytes of the written tile images." << std::endl;
+	ss << "# TYPE mapcrafter_written_bytes gauge" << std::endl;
+	for (size_t i = 0; i < rotations.size(); i++)
+		ss << "mapcrafter_written_bytes{" << labels[i] << "} "
+				<< rotations[i].tiles.bytes_written << std::endl;
+
+	std::string caches[] = {"region", "chunk"};
+	ss << "# HELP mapcrafter_cache_hits Hits of the world caches." << std::endl;
+	ss << "# TYPE mapcrafter_cache_hits gauge" << std::endl;
+	for (size_t i = 0; i < rotations.size(); i++)
+		for (int j = 0; j < 2; j++)
+			ss << "mapcrafter_cache_hits{" << labels[i] << ",cache=\"" << caches[j] << "\"} "
+					<< (j == 0 ? rotations[i].tiles.region_cache
+							: rotations[i].tiles.chunk_cache).hits << std::endl;
+	ss << "# HELP mapcrafter_cache_misses Misses of the world caches." << std::endl;
+	ss << "# TYPE mapcrafter_cache_misses gauge" << std::endl;
+	for (size_t i = 0; i < rotations.size(); i++)
+		for (int j = 0; j < 2; j++)
+			ss << "mapcrafter_cache_misses{" << labels[i] << ",cache=\"" << caches[j] << "\"} "
+					<< (j == 0 ? rotations[i].tiles.region_cache
+							: rotations[i].tiles.chunk_cache).misses << std::endl;
+
+	ss << "# HELP mapcrafter_decoded_bytes Bytes of the decoded (compressed) chunk data."
+			<< std::endl;
+	ss << "# TYPE mapcrafter_decoded_bytes gauge" << std::endl;
+	for (size_t i = 0; i < rotations.size(); i++)
+		ss << "mapcrafter_decoded_bytes{" << labels[i] << "} "
+				<< rotations[i].tiles.chunk_cache.decoded_bytes << std::endl;
+
+	return ss.str();
+}
+
+bool RenderMetrics::writeUnlocked() {
+	time_last_write = time(NULL);
+	bool ok = true;
+	if (!json_file.empty() && !writeFileAtomically(json_file, toJSONUnlocked())) {
+		std::cerr << "Warning: Unable to write metrics file " << json_file << "!" << std::endl;
+		ok = false;
+	}
+	if (!prometheus_file.empty()
+			&& !writeFileAtomically(prometheus_file, toPrometheusUnlocked())) {
+		std::cerr << "Warning: Unable to write metrics file " << prometheus_file << "!"
+				<< std::endl;
+		ok = false;
+	}
+	return ok;
+}
+
+}
+}
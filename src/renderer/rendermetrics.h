@@ -0,0 +1,164 @@
+/*
+ * Copyright 2012-2014 Moritz Hilscher
+ *
+ * This file is part of Mapcrafter.
+ *
+ * Mapcrafter is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Mapcrafter is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Mapcrafter.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RENDERMETRICS_H_
+#define RENDERMETRICS_H_
+
+#include "../mc/worldcache.h"
+
+#include <chrono>
+#include <ctime>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+namespace mapcrafter {
+namespace renderer {
+
+/**
+ * Returns the seconds elapsed since a time point of the steady clock.
+ */
+double getElapsedSeconds(const std::chrono::steady_clock::time_point& start);
+
+/**
+ * Statistics of rendering tiles, collected by the tile render workers.
+ */
+struct TileRenderStats {
+	TileRenderStats();
+
+	TileRenderStats& operator+=(const TileRenderStats& other);
+
+	// times (summed up over all threads) of rendering, encoding and writing tiles
+	double render_time, encode_time, write_time;
+
+	// count of rendered render tiles, of the ones of them which were not changed and of
+	// the written composite tiles
+	int render_tiles, render_tiles_unchanged, composite_tiles;
+	// count of bytes of the written tile images
+	uint64_t bytes_written;
+
+	// statistics of the world caches
+	mc::CacheStats region_cache, chunk_cache;
+};
+
+/**
+ * The metrics of rendering a rotation of a map.
+ */
+struct RotationMetrics {
+	RotationMetrics();
+
+	std::string map;
+	int rotation;
+
+	// wall clock times of the phases of rendering the rotation: scanning the required
+	// tiles, creating the block images and rendering the tiles
+	double scan_time, sprites_time, render_time;
+	// whether the tiles are being rendered at the moment, and since when
+	bool rendering;
+	std::chrono::steady_clock::time_point render_start;
+
+	TileRenderStats tiles;
+
+	/**
+	 * Returns the time of rendering the tiles and the rendered render tiles per second
+	 * (so far, if the tiles are being rendered at the moment).
+	 */
+	double getRenderTime() const;
+	double getTilesPerSecond() const;
+};
+
+/**
+ * This class collects metrics of the rendering process (timings of the different phases,
+ * tile throughput, cache hit rates, written bytes) and writes them as JSON file and as
+ * text file for the Prometheus node exporter.
+ *
+ * The files are written at the end of a run and periodically (when render statistics
+ * are added) during long renders. Adding statistics is thread-safe.
+ */
+class RenderMetrics {
+public:
+	RenderMetrics(const std::string& json_file = "", const std::string& prometheus_file = "");
+	~RenderMetrics();
+
+	/**
+	 * Sets the interval (in seconds) to write the metric files while rendering.
+	 */
+	void setWriteInterval(int interval);
+
+	/**
+	 * Sets the time required to scan a world (all used rotations).
+	 */
+	void setWorldScanTime(const std::string& world, double time);
+
+	/**
+	 * Begins the metrics of a map rotation. The following calls refer to this rotation.
+	 */
+	void beginRotation(const std::string& map, int rotation);
+
+	void setScanTime(double time);
+	void setSpritesTime(double time);
+
+	/**
+	 * Marks the begin/end of rendering the tiles of the current rotation.
+	 */
+	void beginRender();
+	void endRender();
+
+	/**
+	 * Adds the statistics of rendered tiles to the current rotation and writes the
+	 * metric files if the write interval has elapsed.
+	 */
+	void addTileRenderStats(const TileRenderStats& stats);
+
+	/**
+	 * Returns the metrics of all rendered rotations.
+	 */
+	std::vector<RotationMetrics> getRotations() const;
+
+	std::string toJSON() const;
+	std::string toPrometheus() const;
+
+	/**
+	 * Writes the metric files. The finished flag marks that the run is finished.
+	 */
+	bool write(bool finished = false);
+
+private:
+	std::string json_file, prometheus_file;
+	int write_interval;
+
+	time_t time_start, time_last_write;
+	bool finished;
+
+	std::map<std::string, double> world_scan_times;
+	std::vector<RotationMetrics> rotations;
+
+	mutable std::mutex mutex;
+
+	std::string toJSONUnlocked() const;
+	std::string toPrometheusUnlocked() const;
+	bool writeUnlocked();
+};
+
+}
+}
+
+#endif /* RENDERMETRICS_H_ */
@@ -23,66 +23,146 @@ namespace mapcrafter {
 namespace renderer {
 
 
+CaveChunkMask::CaveChunkMask()
+	: used(false) {
+}
+
 CaveRendermode::CaveRendermode(const RenderState& state)
-	: Rendermode(state) {
+	: Rendermode(state), transparency(4096 << 4, -1) {
 }
 
 CaveRendermode::~CaveRendermode() {
 }
 
-bool CaveRendermode::isLight(const mc::BlockPos& pos) {
-	return state.getBlock(pos, mc::GET_SKY_LIGHT).sky_light > 0;
+bool CaveRendermode::isTransparentBlock(uint16_t id, uint16_t data) {
+	if (id == 0)
+		return true;
+	// the transparency of the (raw chunk) block data values is cached
+	size_t index = (id << 4) | (data & 0xf);
+	if (data > 0xf || index >= transparency.size())
+		return state.images->isBlockTransparent(id, data);
+	if (transparency[index] == -1)
+		transparency[index] = state.images->isBlockTransparent(id, data);
+	return transparency[index];
 }
 
-bool CaveRendermode::isTransparentBlock(const mc::Block& block) const {
-	return block.id == 0 || state.images->isBlockTransparent(block.id, block.data);
-}
+/**
+ * Computes the visibility mask of the blocks of a chunk. The masks contain everything
+ * isHidden needs to know about the neighbor blocks, so the visibility test of a block
+ * doesn't need to look up any blocks.
+ */
+void CaveRendermode::computeChunkMask(CaveChunkMask& mask, const mc::ChunkPos& chunk) {
+	// the blocks of the chunk and the blocks directly next to it (x/z/y from -1 to 16/16/256)
+	const int SIZE = 18, HEIGHT = mc::CHUNK_HEIGHT * 16 + 2;
+	const uint8_t SKY = 1, TRANSPARENT = 2, WATER = 4;
+	std::vector<uint8_t> blocks(SIZE * SIZE * HEIGHT, SKY | TRANSPARENT);
+
+	// the chunk and its neighbors, which don't exist and blocks below or above the world
+	// are transparent and have sky light (like the world cache returns them)
+	mc::Chunk* chunks[3][3];
+	for (int dx = -1; dx <= 1; dx++)
+		for (int dz = -1; dz <= 1; dz++)
+			chunks[dx + 1][dz + 1] = (dx != 0 && dz != 0) ? nullptr
+					: state.world->getChunk(mc::ChunkPos(chunk.x + dx, chunk.z + dz));
+
+	for (int z = 0; z < SIZE; z++)
+		for (int x = 0; x < SIZE; x++) {
+			// the corner columns aren't neighbors of any block of the chunk
+			if ((x == 0 || x == SIZE - 1) && (z == 0 || z == SIZE - 1))
+				continue;
+			int cx = x == 0 ? 0 : (x == SIZE - 1 ? 2 : 1);
+			int cz = z == 0 ? 0 : (z == SIZE - 1 ? 2 : 1);
+			const mc::Chunk* column_chunk = chunks[cx][cz];
+			if (column_chunk == nullptr)
+				continue;
+			int local_x = (x + 15) % 16, local_z = (z + 15) % 16;
+			for (int y = 0; y < mc::CHUNK_HEIGHT * 16; y++) {
+				if (!column_chunk->hasSection(y / 16)) {
+					y += 15;
+					continue;
+				}
+				mc::LocalBlockPos local(local_x, local_z, y);
+				uint16_t id = column_chunk->getBlockID(local);
+				uint8_t flags = 0;
+				if (column_chunk->getSkyLight(local) > 0)
+					flags |= SKY;
+				if (isTransparentBlock(id, column_chunk->getBlockData(local)))
+					flags |= TRANSPARENT;
+				if (id == 8 || id == 9)
+					flags |= WATER;
+				blocks[((y + 1) * SIZE + z) * SIZE + x] = flags;
+			}
+		}
 
-bool CaveRendermode::isHidden(const mc::BlockPos& pos, uint16_t id, uint16_t data) {
 	mc::BlockPos directions[6] = {
 			mc::DIR_NORTH, mc::DIR_SOUTH, mc::DIR_EAST, mc::DIR_WEST,
 			mc::DIR_TOP, mc::DIR_BOTTOM
 	};
+	int offsets[6];
+	for (int i = 0; i < 6; i++)
+		offsets[i] = (directions[i].y * SIZE + directions[i].z) * SIZE + directions[i].x;
+	int south = (mc::DIR_SOUTH.y * SIZE + mc::DIR_SOUTH.z) * SIZE + mc::DIR_SOUTH.x;
+	int west = (mc::DIR_WEST.y * SIZE + mc::DIR_WEST.z) * SIZE + mc::DIR_WEST.x;
+	int top = SIZE * SIZE;
+
+	mask.pos = chunk;
+	mask.used = true;
+	mask.mask.resize(16 * 16 * mc::CHUNK_HEIGHT * 16);
+	for (int z = 0; z < 16; z++)
+		for (int x = 0; x < 16; x++) {
+			// whether the first non-water block above the current block has sky light
+			bool water_lit = false;
+			for (int y = mc::CHUNK_HEIGHT * 16 - 1; y >= 0; y--) {
+				int i = ((y + 1) * SIZE + z + 1) * SIZE + x + 1;
+				if (!(blocks[i + top] & WATER))
+					water_lit = blocks[i + top] & SKY;
+
+				uint8_t flags = 0;
+				for (int j = 0; j < 6; j++)
+					if (blocks[i + offsets[j]] & SKY)
+						flags |= CAVE_TOUCHES_SKY;
+				if (water_lit)
+					flags |= CAVE_WATER_LIT;
+				if (blocks[i + top] & WATER)
+					flags |= CAVE_TOP_WATER;
+				if ((blocks[i + south] | blocks[i + west] | blocks[i + top]) & TRANSPARENT)
+					flags |= CAVE_TRANSPARENT_NEIGHBOR;
+				mask.mask[(y * 16 + z) * 16 + x] = flags;
+			}
+		}
+}
+
+uint8_t CaveRendermode::getMask(const mc::BlockPos& pos) {
+	mc::ChunkPos chunk(pos);
+	CaveChunkMask& mask = masks[chunk.x & (MASK_SIZE - 1)][chunk.z & (MASK_SIZE - 1)];
+	if (!mask.used || mask.pos != chunk)
+		computeChunkMask(mask, chunk);
+	mc::LocalBlockPos local(pos);
+	return mask.mask[(local.y * 16 + local.z) * 16 + local.x];
+}
+
+bool CaveRendermode::isHidden(const mc::BlockPos& pos, uint16_t id, uint16_t data) {
+	// blocks outside the world height are never part of a cave
+	if (pos.y < 0 || pos.y >= mc::CHUNK_HEIGHT * 16)
+		return true;
+	uint8_t mask = getMask(pos);
+
 	// check if this block touches sky light
-	for (int i = 0; i < 6; i++) {
-		if (isLight(pos + directions[i]))
-			return true;
-	}
+	if (mask & CAVE_TOUCHES_SKY)
+		return true;
 
 	// water and blocks under water are a special case
 	// because water is transparent, the renderer thinks this is a visible part of a cave
 	// we need to check if there is sunlight on the surface of the water
 	// if yes => no cave, hide block
 	// if no  => lake in a cave, show it
-	mc::Block top = state.getBlock(pos + mc::DIR_TOP,
-			mc::GET_ID | mc::GET_DATA | mc::GET_SKY_LIGHT);
-	if (id == 8 || id == 9 || top.id == 8 || top.id == 9) {
-		mc::BlockPos p = pos + mc::DIR_TOP;
-		mc::Block block(top.id, top.data, 0, 0, top.sky_light);
-
-		while (block.id == 8 || block.id == 9) {
-			block = state.getBlock(p, mc::GET_ID | mc::GET_DATA | mc::GET_SKY_LIGHT);
-			p.y++;
-		}
-
-		if (block.sky_light > 0)
-			return true;
-	}
-
-	mc::Block south, west;
-	south = state.getBlock(pos + mc::DIR_SOUTH);
-	west = state.getBlock(pos + mc::DIR_WEST);
+	if ((id == 8 || id == 9 || (mask & CAVE_TOP_WATER)) && (mask & CAVE_WATER_LIT))
+		return true;
 
 	// show all blocks, which don't touch sunlight
 	// and have a transparent block on the south, west or top side
 	// south, west and top, because with this you can look in the caves
-	if (isTransparentBlock(south)
-			|| isTransparentBlock(west)
-			|| isTransparentBlock(top)) {
-		return false;
-	}
-
-	return true;
+	return !(mask & CAVE_TRANSPARENT_NEIGHBOR);
 }
 
 void CaveRendermode::draw(RGBAImage& image, const mc::BlockPos& pos,
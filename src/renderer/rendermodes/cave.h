@@ -22,13 +22,46 @@
 
 #include "base.h"
 
+#include <vector>
+
 namespace mapcrafter {
 namespace renderer {
 
+// bits of the visibility mask of a block in the cave rendermode
+// - one of the six neighbor blocks has sky light
+const uint8_t CAVE_TOUCHES_SKY = 1;
+// - the block above (or the first non-water block above the water above) has sky light
+const uint8_t CAVE_WATER_LIT = 2;
+// - the block above is water
+const uint8_t CAVE_TOP_WATER = 4;
+// - the south, west or top neighbor is transparent
+const uint8_t CAVE_TRANSPARENT_NEIGHBOR = 8;
+
+/**
+ * The visibility mask of the blocks of a chunk.
+ */
+struct CaveChunkMask {
+	mc::ChunkPos pos;
+	bool used;
+	std::vector<uint8_t> mask;
+
+	CaveChunkMask();
+};
+
 class CaveRendermode: public Rendermode {
 protected:
-	bool isLight(const mc::BlockPos& pos);
-	bool isTransparentBlock(const mc::Block& block) const;
+	// the visibility masks of the chunks, direct-mapped like the chunks of the world cache
+	static const int MASK_BITS = 3;
+	static const int MASK_SIZE = 1 << MASK_BITS;
+	CaveChunkMask masks[MASK_SIZE][MASK_SIZE];
+
+	// cached transparency of the blocks (index id << 4 | data), -1 means unknown
+	std::vector<int8_t> transparency;
+
+	bool isTransparentBlock(uint16_t id, uint16_t data);
+
+	void computeChunkMask(CaveChunkMask& mask, const mc::ChunkPos& chunk);
+	uint8_t getMask(const mc::BlockPos& pos);
 public:
 	CaveRendermode(const RenderState& state);
 	virtual ~CaveRendermode();
@@ -20,7 +20,9 @@
 #include "lighting.h"
 
 #include "../blockimages.h"
+#include "../../util.h"
 
+#include <algorithm>
 #include <cmath>
 
 namespace mapcrafter {
@@ -77,27 +79,23 @@ FaceCorners::FaceCorners(const CornerNeighbors& corner1)
 /**
  * Draws the bottom triangle.
  * This is the triangle with corners top left, bottom left and bottom right.
+ *
+ * The colors are interpolated with integer arithmetic only, see LightingColor.
  */
-void drawBottomTriangle(RGBAImage& image, int size, double c1, double c2,
-		double c3) {
-	double e1diff = c2 - c1;
-	double e2diff = c3 - c1;
-	double fy = 0;
-	double fyStep = (double) 1 / (size-1);
-	for (int y = 0; y < size; y++, fy+=fyStep) {
-		double color1 = c1 + e1diff*fy;
-		double color2 = c1 + e2diff*fy;
-		double colordiff = color2 - color1;
-		double fx = 0;
-		double fxStep = 0;
-		if (y != 0)
-			fxStep = (double) 1 / y;
-		else
-			fx = 1;
-		for (int x = 0; x <= y; x++, fx+=fxStep) {
-			double color = color1 + colordiff*fx;
-			//color += (1-color)*(1-LIGHTNING_INTENSITY);
-			image.pixel(x, y) = rgba(0, 0, 0, color * 255);
+void drawBottomTriangle(RGBAImage& image, int size, LightingColor c1, LightingColor c2,
+		LightingColor c3) {
+	int steps = std::max(size - 1, 1);
+	for (int y = 0; y < size; y++) {
+		LightingColor color1 = c1 + (c2 - c1) * y / steps;
+		LightingColor color2 = c1 + (c3 - c1) * y / steps;
+		if (y == 0) {
+			image.pixel(0, 0) = rgba(0, 0, 0, color2 >> LIGHTING_COLOR_SHIFT);
+			continue;
+		}
+		LightingColor colordiff = color2 - color1;
+		for (int x = 0; x <= y; x++) {
+			LightingColor color = color1 + colordiff * x / y;
+			image.pixel(x, y) = rgba(0, 0, 0, color >> LIGHTING_COLOR_SHIFT);
 		}
 	}
 }
@@ -106,56 +104,177 @@ void drawBottomTriangle(RGBAImage& image, int size, double c1, double c2,
  * Draws the top triangle.
  * This is the triangle with corners top left, top right and bottom right.
  */
-void drawTopTriangle(RGBAImage& image, int size, double c1, double c2, double c3) {
-	double e1diff = c2 - c1;
-	double e2diff = c3 - c1;
-	double fy = 0;
-	double fyStep = (double) 1 / (size-1);
-	for (int y = 0; y < size; y++, fy+=fyStep) {
-		double color1 = c1 + e1diff*fy;
-		double color2 = c1 + e2diff*fy;
-		double colordiff = color2 - color1;
-		double fx = 0;
-		double fxStep = 0;
-		if (y != 0)
-			fxStep = (double) 1 / y;
-		else
-			fx = 1;
-		for (int x = 0; x <= y; x++, fx+=fxStep) {
-			double color = color1 + colordiff*fx;
-			//color += (1-color)*(1-LIGHTNING_INTENSITY);
-			image.pixel(size-1-x, size-1-y) = rgba(0, 0, 0, color * 255);
+void drawTopTriangle(RGBAImage& image, int size, LightingColor c1, LightingColor c2,
+		LightingColor c3) {
+	int steps = std::max(size - 1, 1);
+	for (int y = 0; y < size; y++) {
+		LightingColor color1 = c1 + (c2 - c1) * y / steps;
+		LightingColor color2 = c1 + (c3 - c1) * y / steps;
+		if (y == 0) {
+			image.pixel(size-1, size-1) = rgba(0, 0, 0, color2 >> LIGHTING_COLOR_SHIFT);
+			continue;
+		}
+		LightingColor colordiff = color2 - color1;
+		for (int x = 0; x <= y; x++) {
+			LightingColor color = color1 + colordiff * x / y;
+			image.pixel(size-1-x, size-1-y) = rgba(0, 0, 0, color >> LIGHTING_COLOR_SHIFT);
 		}
 	}
 }
 
+/**
+ * Draws the shade of the corners by drawing two triangles with the supplied colors.
+ */
+void createShade(RGBAImage& image, const CornerColors& corners) {
+	int size = image.getWidth();
+	drawBottomTriangle(image, size, corners[0], corners[2], corners[3]);
+	drawTopTriangle(image, size, corners[3], corners[1], corners[0]);
+}
+
+ShadeCache::ShadeCache()
+	: size(-1) {
+}
+
+ShadeCache::~ShadeCache() {
+}
+
+/**
+ * Clears the cache and projects the faces for a new texture size.
+ */
+void ShadeCache::setSize(int size) {
+	this->size = size;
+	for (int face = 0; face < 3; face++) {
+		face_pixels[face].clear();
+		for (int i = 0; i < SHADES; i++)
+			entries[face][i].used = false;
+	}
+
+	for (SideFaceIterator it(size, SideFaceIterator::LEFT); !it.end(); it.next()) {
+		FacePixel pixel = {it.src_x, it.src_y, it.dest_x, it.dest_y + size/2};
+		face_pixels[(int) LightingFace::LEFT].push_back(pixel);
+	}
+	for (SideFaceIterator it(size, SideFaceIterator::RIGHT); !it.end(); it.next()) {
+		FacePixel pixel = {it.src_x, it.src_y, it.dest_x + size, it.dest_y + size/2};
+		face_pixels[(int) LightingFace::RIGHT].push_back(pixel);
+	}
+	for (TopFaceIterator it(size); !it.end(); it.next()) {
+		FacePixel pixel = {it.src_x, it.src_y, it.dest_x, it.dest_y};
+		face_pixels[(int) LightingFace::TOP].push_back(pixel);
+	}
+}
+
+const std::vector<FacePixel>& ShadeCache::getFacePixels(LightingFace face, int size) {
+	if (size != this->size)
+		setSize(size);
+	return face_pixels[(int) face];
+}
+
+const std::vector<uint8_t>& ShadeCache::getShade(LightingFace face, int size,
+		const CornerColors& colors) {
+	if (size != this->size)
+		setSize(size);
+
+	// we need to rotate the corners a bit to make them suitable for the TopFaceIterator
+	CornerColors corners = colors;
+	if (face == LightingFace::TOP)
+		corners = {{colors[1], colors[3], colors[0], colors[2]}};
+
+	// the corner colors are at most 255 << LIGHTING_COLOR_SHIFT, i.e. 16 bits each
+	uint64_t key = 0;
+	for (int i = 0; i < 4; i++)
+		key = (key << 16) | (corners[i] & 0xffff);
+
+	Entry& entry = entries[(int) face][(key * 0x9e3779b97f4a7c15ull)
+		>> (64 - SHADE_BITS)];
+	if (entry.used && entry.key == key)
+		return entry.shade;
+
+	RGBAImage tex(size, size);
+	createShade(tex, corners);
+
+	const std::vector<FacePixel>& pixels = face_pixels[(int) face];
+	entry.key = key;
+	entry.used = true;
+	entry.shade.resize(pixels.size());
+	for (size_t i = 0; i < pixels.size(); i++)
+		entry.shade[i] = rgba_alpha(tex.pixel(pixels[i].src_x, pixels[i].src_y));
+	return entry.shade;
+}
+
+LightField::LightField()
+	: sections_used(0), last_key(-1), last_section(nullptr) {
+}
+
+LightField::~LightField() {
+}
+
+void LightField::clear() {
+	section_index.clear();
+	sections_used = 0;
+	last_key = -1;
+	last_section = nullptr;
+}
+
+uint16_t* LightField::get(const mc::BlockPos& pos) {
+	if (pos.y < 0 || pos.y >= mc::CHUNK_HEIGHT * 16)
+		return nullptr;
+
+	// key of the section: chunk x (lower 24 bits are enough for any world),
+	// chunk z and the section y
+	int chunk_x = util::floordiv(pos.x, 16), chunk_z = util::floordiv(pos.z, 16);
+	uint64_t key = ((uint64_t) (uint32_t) chunk_x << 40)
+			| ((uint64_t) (uint32_t) chunk_z << 8) | (pos.y / 16);
+	if (key != last_key) {
+		auto it = section_index.find(key);
+		int index;
+		if (it != section_index.end()) {
+			index = it->second;
+		} else {
+			index = sections_used++;
+			if (index == (int) sections.size())
+				sections.push_back(std::vector<uint16_t>(16 * 16 * 16));
+			std::fill(sections[index].begin(), sections[index].end(), UNKNOWN);
+			section_index[key] = index;
+		}
+		last_key = key;
+		last_section = &sections[index][0];
+	}
+
+	int x = pos.x - chunk_x * 16, z = pos.z - chunk_z * 16, y = pos.y % 16;
+	return &last_section[(y * 16 + z) * 16 + x];
+}
+
 LightingRendermode::LightingRendermode(const RenderState& state, bool day,
 		double lighting_intensity, bool dimension_end)
 	: Rendermode(state), day(day), lighting_intensity(lighting_intensity),
 	  dimension_end(dimension_end) {
+	// precompute the lighting colors, so we don't need any floating point
+	// arithmetic while rendering
+	for (int block = 0; block < 16; block++)
+		for (int sky = 0; sky < 16; sky++) {
+			double color = calculateLightingColor(block, sky);
+			color += (1 - color) * (1 - lighting_intensity);
+			light_colors[block][sky] = color * (255 << LIGHTING_COLOR_SHIFT) + 0.5;
+		}
 }
 
 LightingRendermode::~LightingRendermode() {
 
 }
 
-/**
- * Draws the shade of the corners by drawing two triangles with the supplied colors.
- */
-void LightingRendermode::createShade(RGBAImage& image,
-		const CornerColors& corners) const {
-	int size = image.getWidth();
-	drawBottomTriangle(image, size, corners[0], corners[2], corners[3]);
-	drawTopTriangle(image, size, corners[3], corners[1], corners[0]);
+void LightingRendermode::start() {
+	light_field.clear();
 }
 
 /**
- * Calculates the color of the light of a block.
+ * Calculates the color of the light of a block (without the lighting intensity).
  *
  * This uses the formula 0.8**(15 - max(block_light, sky_light))
  * When calculating nightlight, the skylight is reduced by 11.
+ *
+ * It is only used to fill the lookup table of lighting colors.
  */
-LightingColor LightingRendermode::calculateLightingColor(uint8_t block_light,
+double LightingRendermode::calculateLightingColor(uint8_t block_light,
 		uint8_t sky_light) const {
 	if (day)
 		return pow(0.8, 15 - std::max(block_light, sky_light));
@@ -251,12 +370,19 @@ LightingData LightingRendermode::getBlockLight(const mc::BlockPos& pos) {
 }
 
 /**
- * Returns the lighting color of a block.
+ * Returns the lighting color of a block. The lighting colors are stored in the light
+ * field of the current tile, so they are calculated only once per block and tile.
  */
 LightingColor LightingRendermode::getLightingColor(const mc::BlockPos& pos) {
+	uint16_t* entry = light_field.get(pos);
+	if (entry != nullptr && *entry != LightField::UNKNOWN)
+		return *entry;
+
 	LightingData lighting = getBlockLight(pos);
-	LightingColor color = calculateLightingColor(lighting.block, lighting.sky);
-	return color + (1-color)*(1-lighting_intensity);
+	LightingColor color = light_colors[lighting.block & 15][lighting.sky & 15];
+	if (entry != nullptr)
+		*entry = color;
+	return color;
 }
 
 /**
@@ -266,11 +392,11 @@ LightingColor LightingRendermode::getLightingColor(const mc::BlockPos& pos) {
 LightingColor LightingRendermode::getCornerColor(const mc::BlockPos& pos,
 		const CornerNeighbors& corner) {
 	LightingColor color = 0;
-	color += getLightingColor(pos + corner.pos1) * 0.25;
-	color += getLightingColor(pos + corner.pos2) * 0.25;
-	color += getLightingColor(pos + corner.pos3) * 0.25;
-	color += getLightingColor(pos + corner.pos4) * 0.25;
-	return color;
+	color += getLightingColor(pos + corner.pos1);
+	color += getLightingColor(pos + corner.pos2);
+	color += getLightingColor(pos + corner.pos3);
+	color += getLightingColor(pos + corner.pos4);
+	return color / 4;
 }
 
 /**
@@ -288,37 +414,35 @@ CornerColors LightingRendermode::getCornerColors(const mc::BlockPos& pos,
 }
 
 /**
- * Adds smooth lighting to the left face of a block image.
+ * Multiplies the pixels of a face of a block image with the shade of the face. Only
+ * the face pixels with a texture row between ystart and yend are shaded.
  */
-void LightingRendermode::lightLeft(RGBAImage& image, const CornerColors& colors) {
+void LightingRendermode::applyShade(RGBAImage& image, LightingFace face,
+		const CornerColors& colors, int yoff, int ystart, int yend) {
 	int size = image.getWidth() / 2;
-	RGBAImage tex(size, size);
-	createShade(tex, colors);
+	const std::vector<uint8_t>& shade = shade_cache.getShade(face, size, colors);
+	const std::vector<FacePixel>& pixels = shade_cache.getFacePixels(face, size);
 
-	for (SideFaceIterator it(size, SideFaceIterator::LEFT); !it.end(); it.next()) {
-		uint32_t& pixel = image.pixel(it.dest_x, it.dest_y + size/2);
-		if (pixel != 0) {
-			uint8_t d = rgba_alpha(tex.pixel(it.src_x, it.src_y));
-			pixel = rgba_multiply(pixel, d, d, d);
-		}
+	for (size_t i = 0; i < pixels.size(); i++) {
+		if (pixels[i].src_y < ystart || pixels[i].src_y > yend)
+			continue;
+		uint32_t& pixel = image.pixel(pixels[i].dest_x, pixels[i].dest_y + yoff);
+		if (pixel != 0)
+			pixel = rgba_multiply(pixel, shade[i], shade[i], shade[i]);
 	}
 }
 
-void LightingRendermode::lightLeft(RGBAImage& image, const CornerColors& colors,
-		int ystart, int yend) {
+/**
+ * Adds smooth lighting to the left face of a block image.
+ */
+void LightingRendermode::lightLeft(RGBAImage& image, const CornerColors& colors) {
 	int size = image.getWidth() / 2;
-	RGBAImage tex(size, size);
-	createShade(tex, colors);
+	applyShade(image, LightingFace::LEFT, colors, 0, 0, size);
+}
 
-	for (SideFaceIterator it(size, SideFaceIterator::LEFT); !it.end(); it.next()) {
-		if (it.src_y < ystart || it.src_y > yend)
-			continue;
-		uint32_t& pixel = image.pixel(it.dest_x, it.dest_y + size/2);
-		if (pixel != 0) {
-			uint8_t d = rgba_alpha(tex.pixel(it.src_x, it.src_y));
-			pixel = rgba_multiply(pixel, d, d, d);
-		}
-	}
+void LightingRendermode::lightLeft(RGBAImage& image, const CornerColors& colors,
+		int ystart, int yend) {
+	applyShade(image, LightingFace::LEFT, colors, 0, ystart, yend);
 }
 
 /**
@@ -326,33 +450,12 @@ void LightingRendermode::lightLeft(RGBAImage& image, const CornerColors& colors,
  */
 void LightingRendermode::lightRight(RGBAImage& image, const CornerColors& colors) {
 	int size = image.getWidth() / 2;
-	RGBAImage tex(size, size);
-	createShade(tex, colors);
-
-	for (SideFaceIterator it(size, SideFaceIterator::RIGHT); !it.end(); it.next()) {
-		uint32_t& pixel = image.pixel(it.dest_x + size, it.dest_y + size/2);
-		if (pixel != 0) {
-			uint8_t d = rgba_alpha(tex.pixel(it.src_x, it.src_y));
-			pixel = rgba_multiply(pixel, d, d, d);
-		}
-	}
+	applyShade(image, LightingFace::RIGHT, colors, 0, 0, size);
 }
 
 void LightingRendermode::lightRight(RGBAImage& image, const CornerColors& colors,
 		int ystart, int yend) {
-	int size = image.getWidth() / 2;
-	RGBAImage tex(size, size);
-	createShade(tex, colors);
-
-	for (SideFaceIterator it(size, SideFaceIterator::RIGHT); !it.end(); it.next()) {
-		if (it.src_y < ystart || it.src_y > yend)
-			continue;
-		uint32_t& pixel = image.pixel(it.dest_x + size, it.dest_y + size/2);
-		if (pixel != 0) {
-			uint8_t d = rgba_alpha(tex.pixel(it.src_x, it.src_y));
-			pixel = rgba_multiply(pixel, d, d, d);
-		}
-	}
+	applyShade(image, LightingFace::RIGHT, colors, 0, ystart, yend);
 }
 
 /**
@@ -361,18 +464,7 @@ void LightingRendermode::lightRight(RGBAImage& image, const CornerColors& colors
 void LightingRendermode::lightTop(RGBAImage& image, const CornerColors& colors,
 		int yoff) {
 	int size = image.getWidth() / 2;
-	RGBAImage tex(size, size);
-	// we need to rotate the corners a bit to make them suitable for the TopFaceIterator
-	CornerColors rotated = {{colors[1], colors[3], colors[0], colors[2]}};
-	createShade(tex, rotated);
-
-	for (TopFaceIterator it(size); !it.end(); it.next()) {
-		uint32_t& pixel = image.pixel(it.dest_x, it.dest_y + yoff);
-		if (pixel != 0) {
-			uint8_t d = rgba_alpha(tex.pixel(it.src_x, it.src_y));
-			pixel = rgba_multiply(pixel, d, d, d);
-		}
-	}
+	applyShade(image, LightingFace::TOP, colors, yoff, 0, size);
 }
 
 /**
@@ -413,7 +505,7 @@ void LightingRendermode::doSlabLight(RGBAImage& image, const mc::BlockPos& pos,
  */
 void LightingRendermode::doSimpleLight(RGBAImage& image, const mc::BlockPos& pos,
 		uint16_t id, uint16_t data) {
-	uint8_t factor = getLightingColor(pos) * 255;
+	uint8_t factor = getLightingColor(pos) >> LIGHTING_COLOR_SHIFT;
 
 	int size = image.getWidth();
 	for (int x = 0; x < size; x++) {
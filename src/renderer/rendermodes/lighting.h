@@ -23,6 +23,8 @@
 #include "base.h"
 
 #include <array>
+#include <unordered_map>
+#include <vector>
 
 namespace mapcrafter {
 namespace renderer {
@@ -72,21 +74,135 @@ struct LightingData {
 	uint8_t block, sky;
 };
 
-typedef double LightingColor;
+/**
+ * Lighting colors are fixed-point numbers: the value of a color shifted right by
+ * LIGHTING_COLOR_SHIFT is the brightness 0 (black) to 255 (unchanged) of a pixel.
+ */
+typedef int LightingColor;
+const int LIGHTING_COLOR_SHIFT = 8;
 
 // corner colors of a face
 // - defined as array with corners top left / top right / bottom left / bottom right
 typedef std::array<LightingColor, 4> CornerColors;
 
+/**
+ * The faces of a block image which get smooth lighting.
+ */
+enum class LightingFace {
+	LEFT = 0,
+	RIGHT = 1,
+	TOP = 2
+};
+
+/**
+ * A pixel of a face in a block image: the position in the texture and the position in
+ * the block image. The top face positions don't contain its y-offset yet.
+ */
+struct FacePixel {
+	int src_x, src_y;
+	int dest_x, dest_y;
+};
+
+/**
+ * Caches the shades of block faces, already projected onto the block image.
+ *
+ * A shade depends only on the face and on the four corner colors, which are averages of
+ * the few precomputed lighting colors, so there are not many different shades. A shade
+ * is the brightness of every face pixel, in the order of the face pixels returned by
+ * getFacePixels.
+ *
+ * Like the world cache this is a direct-mapped cache with a fixed count of entries,
+ * so it needs at most 3 * SHADES * texture_size^2 bytes.
+ */
+class ShadeCache {
+public:
+	ShadeCache();
+	~ShadeCache();
+
+	/**
+	 * Returns the pixels of a face of a block image with the specified texture size.
+	 */
+	const std::vector<FacePixel>& getFacePixels(LightingFace face, int size);
+
+	/**
+	 * Returns the shade of a face with the specified corner colors. The corner colors
+	 * of the top face are expected to be the same as for the other faces, they are
+	 * rotated to match the top face here.
+	 */
+	const std::vector<uint8_t>& getShade(LightingFace face, int size,
+			const CornerColors& colors);
+
+	static const int SHADE_BITS = 10;
+	static const int SHADES = 1 << SHADE_BITS;
+
+private:
+	struct Entry {
+		uint64_t key;
+		bool used;
+		std::vector<uint8_t> shade;
+	};
+
+	int size;
+	std::vector<FacePixel> face_pixels[3];
+	Entry entries[3][SHADES];
+
+	void setSize(int size);
+};
+
+/**
+ * A lazily filled field with the lighting colors of the blocks around a tile.
+ *
+ * The corners of the faces of neighboring blocks share most of their light samples, so
+ * the lighting color of a block is needed a lot of times while rendering a tile. The
+ * field stores the lighting colors of every chunk section a tile needs in a dense
+ * array, so the light of every block has to be calculated only once per tile.
+ *
+ * The section arrays are reused when the field is cleared for the next tile.
+ */
+class LightField {
+public:
+	LightField();
+	~LightField();
+
+	/**
+	 * Forgets all lighting colors.
+	 */
+	void clear();
+
+	/**
+	 * Returns the entry of a block in the field, which is UNKNOWN if the lighting color
+	 * of the block wasn't stored yet. Returns a null pointer for blocks below or above
+	 * the world.
+	 */
+	uint16_t* get(const mc::BlockPos& pos);
+
+	static const uint16_t UNKNOWN = 0xffff;
+
+private:
+	// sections (with index into the sections array) of the field
+	std::unordered_map<uint64_t, int> section_index;
+	std::vector<std::vector<uint16_t>> sections;
+	int sections_used;
+
+	// the last accessed section, most accesses are in the same section
+	uint64_t last_key;
+	uint16_t* last_section;
+};
+
 class LightingRendermode : public Rendermode {
 private:
 	bool day;
 	double lighting_intensity;
 	bool dimension_end;
 
-	void createShade(RGBAImage& image, const CornerColors& corners) const;
-	
-	LightingColor calculateLightingColor(uint8_t block_light, uint8_t sky_light) const;
+	// lighting colors of all (block light, sky light) combinations,
+	// the lighting intensity is already applied
+	LightingColor light_colors[16][16];
+
+	ShadeCache shade_cache;
+	LightField light_field;
+
+	double calculateLightingColor(uint8_t block_light, uint8_t sky_light) const;
 	void estimateBlockLight(mc::Block& block, const mc::BlockPos& pos);
 	LightingData getBlockLight(const mc::BlockPos& pos);
 
@@ -96,6 +212,8 @@ private:
 	CornerColors getCornerColors(const mc::BlockPos& pos,
 			const FaceCorners& corners);
 	
+	void applyShade(RGBAImage& image, LightingFace face, const CornerColors& colors,
+			int yoff, int ystart, int yend);
 	void lightLeft(RGBAImage& image, const CornerColors& colors);
 	void lightLeft(RGBAImage& image, const CornerColors& colors,
 			int ystart, int yend);
@@ -116,6 +234,8 @@ public:
 			double lighting_intensity, bool dimension_end);
 	virtual ~LightingRendermode();
 
+	virtual void start();
+
 	virtual bool isHidden(const mc::BlockPos& pos,
 			uint16_t id, uint16_t data);
 	virtual void draw(RGBAImage& image, const mc::BlockPos& pos,
@@ -0,0 +1,276 @@
+/*
+ * Copyright 2012-2014 Moritz Hilscher
+ *
+ * This file is part of Mapcrafter.
+ *
+ * Mapcrafter is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Mapcrafter is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Mapcrafter.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "scanindex.h"
+
+#include "../mc/region.h"
+#include "../util.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+namespace mapcrafter {
+namespace renderer {
+
+// magic bytes and version of the index file format,
+// version 2: the chunk timestamps of older indexes were read from the wrong position
+const char SCANINDEX_MAGIC[4] = {'M', 'C', 'S', 'I'};
+const int SCANINDEX_VERSION = 2;
+
+RegionScanEntry::RegionScanEntry()
+	: mtime(0), size(0) {
+}
+
+WorldScanIndex::WorldScanIndex(const mc::World& world)
+	: world(world), scan_time(0) {
+	world_key = world.getRegionDir().string() + " rotation=" + util::str(world.getRotation())
+			+ " " + world.getWorldCrop().toString();
+}
+
+WorldScanIndex::~WorldScanIndex() {
+}
+
+bool WorldScanIndex::read(const std::string& filename) {
+	regions.clear();
+	tile_timestamps.clear();
+	scan_time = 0;
+
+	std::ifstream in(filename.c_str(), std::ios::binary);
+	if (!in)
+		return false;
+
+	char magic[4];
+	int32_t version, key_length;
+	if (!in.read(magic, 4) || std::memcmp(magic, SCANINDEX_MAGIC, 4) != 0
+			|| !util::readBigEndian(in, version) || version != SCANINDEX_VERSION
+			|| !util::readBigEndian(in, key_length))
+		return false;
+	// an index of another world is not used anyway, so a key with a different length
+	// (or a corrupted length) is rejected before reading it
+	if (key_length != (int32_t) world_key.size())
+		return false;
+	std::string key(key_length, ' ');
+	if (!in.read(&key[0], key_length) || key != world_key)
+		return false;
+
+	int64_t time;
+	int32_t region_count, tile_count;
+	bool ok = util::readBigEndian(in, time) && util::readBigEndian(in, region_count);
+	for (int32_t i = 0; ok && i < region_count; i++) {
+		mc::RegionPos pos;
+		RegionScanEntry entry;
+		int32_t chunk_count;
+		ok = util::readBigEndian(in, pos.x) && util::readBigEndian(in, pos.z)
+				&& util::readBigEndian(in, entry.mtime) && util::readBigEndian(in, entry.size)
+				&& util::readBigEndian(in, chunk_count);
+		for (int32_t j = 0; ok && j < chunk_count; j++) {
+			std::pair<uint16_t, uint32_t> chunk;
+			ok = util::readBigEndian(in, chunk.first) && util::readBigEndian(in, chunk.second);
+			entry.chunks.push_back(chunk);
+		}
+		regions[pos] = entry;
+	}
+
+	ok = ok && util::readBigEndian(in, tile_count);
+	for (int32_t i = 0; ok && i < tile_count; i++) {
+		int32_t x = 0, y = 0, timestamp = 0;
+		ok = util::readBigEndian(in, x) && util::readBigEndian(in, y)
+				&& util::readBigEndian(in, timestamp);
+		// the tiles are stored in order
+		tile_timestamps.insert(tile_timestamps.end(), std::make_pair(TilePos(x, y), timestamp));
+	}
+
+	if (!ok) {
+		regions.clear();
+		tile_timestamps.clear();
+		return false;
+	}
+	scan_time = time;
+	return true;
+}
+
+bool WorldScanIndex::write(const std::string& filename) const {
+	// write to a temporary file at first and rename it then,
+	// so an aborted write can't leave a corrupted index behind
+	std::string tmp_filename = filename + ".tmp";
+	std::ofstream out(tmp_filename.c_str(), std::ios::binary);
+	if (!out)
+		return false;
+
+	out.write(SCANINDEX_MAGIC, 4);
+	util::writeBigEndian<int32_t>(out, SCANINDEX_VERSION);
+	util::writeBigEndian<int32_t>(out, world_key.size());
+	out.write(world_key.c_str(), world_key.size());
+	util::writeBigEndian(out, scan_time);
+
+	util::writeBigEndian<int32_t>(out, regions.size());
+	for (auto it = regions.begin(); it != regions.end(); ++it) {
+		const RegionScanEntry& entry = it->second;
+		util::writeBigEndian<int32_t>(out, it->first.x);
+		util::writeBigEndian<int32_t>(out, it->first.z);
+		util::writeBigEndian(out, entry.mtime);
+		util::writeBigEndian(out, entry.size);
+		util::writeBigEndian<int32_t>(out, entry.chunks.size());
+		for (auto chunk_it = entry.chunks.begin(); chunk_it != entry.chunks.end(); ++chunk_it) {
+			util::writeBigEndian(out, chunk_it->first);
+			util::writeBigEndian(out, chunk_it->second);
+		}
+	}
+
+	util::writeBigEndian<int32_t>(out, tile_timestamps.size());
+	for (auto it = tile_timestamps.begin(); it != tile_timestamps.end(); ++it) {
+		util::writeBigEndian<int32_t>(out, it->first.getX());
+		util::writeBigEndian<int32_t>(out, it->first.getY());
+		util::writeBigEndian<int32_t>(out, it->second);
+	}
+
+	out.close();
+	if (out.fail())
+		return false;
+	return std::rename(tmp_filename.c_str(), filename.c_str()) == 0;
+}
+
+int WorldScanIndex::update() {
+	int64_t last_scan_time = scan_time;
+	scan_time = time(NULL);
+
+	// the changed (new, modified or removed) regions
+	// and the old entries of the modified or removed regions
+	std::set<mc::RegionPos> changed;
+	std::map<mc::RegionPos, RegionScanEntry> old_entries;
+
+	for (auto it = regions.begin(); it != regions.end(); ) {
+		if (world.hasRegion(it->first)) {
+			++it;
+			continue;
+		}
+		changed.insert(it->first);
+		old_entries[it->first] = it->second;
+		regions.erase(it++);
+	}
+
+	auto available_regions = world.getAvailableRegions();
+	for (auto it = available_regions.begin(); it != available_regions.end(); ++it) {
+		fs::path path = world.getRegionPath(*it);
+		RegionScanEntry entry;
+		entry.mtime = fs::last_write_time(path);
+		entry.size = fs::file_size(path);
+
+		// the region is unchanged if modification time and size are the same,
+		// but the region may be modified again in the same second it was scanned
+		auto old_it = regions.find(*it);
+		if (old_it != regions.end()) {
+			if (old_it->second.mtime == entry.mtime && old_it->second.size == entry.size
+					&& entry.mtime < last_scan_time)
+				continue;
+			old_entries[*it] = old_it->second;
+		}
+		changed.insert(*it);
+
+		// corrupted regions are just stored without chunks
+		mc::RegionFile region;
+		if (world.getRegion(*it, region) && region.readOnlyHeaders()) {
+			const mc::RegionFile::ChunkMap& chunks = region.getContainingChunks();
+			for (auto chunk_it = chunks.begin(); chunk_it != chunks.end(); ++chunk_it)
+				entry.chunks.push_back(std::make_pair(
+						chunk_it->getLocalZ() * 32 + chunk_it->getLocalX(),
+						region.getChunkTimestamp(*chunk_it)));
+		}
+		regions[*it] = entry;
+	}
+
+	if (changed.empty())
+		return 0;
+
+	// calculate all tiles again if there is nothing to update or nearly everything changed
+	if (tile_timestamps.empty() || changed.size() * 2 > regions.size()) {
+		tile_timestamps.clear();
+		for (auto it = regions.begin(); it != regions.end(); ++it)
+			addRegionTiles(it->first, it->second);
+		return changed.size();
+	}
+
+	// otherwise find the tiles of the old and new chunks of the changed regions...
+	std::set<TilePos> affected_tiles;
+	for (auto it = changed.begin(); it != changed.end(); ++it) {
+		std::vector<const RegionScanEntry*> entries;
+		if (old_entries.count(*it))
+			entries.push_back(&old_entries[*it]);
+		if (regions.count(*it))
+			entries.push_back(&regions[*it]);
+		for (size_t i = 0; i < entries.size(); i++) {
+			for (auto chunk_it = entries[i]->chunks.begin();
+					chunk_it != entries[i]->chunks.end(); ++chunk_it) {
+				mc::ChunkPos chunk(it->x * 32 + chunk_it->first % 32,
+						it->z * 32 + chunk_it->first / 32);
+				getChunkTiles(chunk, affected_tiles);
+			}
+		}
+	}
+
+	// ...and calculate them again with the chunks of the changed regions
+	// and their neighbors (tiles of chunks overlap only with adjacent regions)
+	for (auto it = affected_tiles.begin(); it != affected_tiles.end(); ++it)
+		tile_timestamps.erase(*it);
+	std::set<mc::RegionPos> update_regions;
+	for (auto it = changed.begin(); it != changed.end(); ++it)
+		for (int dx = -1; dx <= 1; dx++)
+			for (int dz = -1; dz <= 1; dz++) {
+				mc::RegionPos pos(it->x + dx, it->z + dz);
+				if (regions.count(pos))
+					update_regions.insert(pos);
+			}
+	for (auto it = update_regions.begin(); it != update_regions.end(); ++it)
+		addRegionTiles(*it, regions[*it], &affected_tiles);
+
+	return changed.size();
+}
+
+int WorldScanIndex::getRegionCount() const {
+	return regions.size();
+}
+
+const std::map<TilePos, int>& WorldScanIndex::getTileTimestamps() const {
+	return tile_timestamps;
+}
+
+void WorldScanIndex::addRegionTiles(const mc::RegionPos& pos,
+		const RegionScanEntry& entry, const std::set<TilePos>* only_tiles) {
+	for (auto chunk_it = entry.chunks.begin(); chunk_it != entry.chunks.end(); ++chunk_it) {
+		mc::ChunkPos chunk(pos.x * 32 + chunk_it->first % 32, pos.z * 32 + chunk_it->first / 32);
+		int timestamp = chunk_it->second;
+
+		std::set<TilePos> tiles;
+		getChunkTiles(chunk, tiles);
+		for (auto tile_it = tiles.begin(); tile_it != tiles.end(); ++tile_it) {
+			if (only_tiles != nullptr && !only_tiles->count(*tile_it))
+				continue;
+			auto timestamp_it = tile_timestamps.find(*tile_it);
+			if (timestamp_it == tile_timestamps.end())
+				tile_timestamps[*tile_it] = timestamp;
+			else
+				timestamp_it->second = std::max(timestamp_it->second, timestamp);
+		}
+	}
+}
+
+}
+}
@@ -0,0 +1,111 @@
+/*
+ * Copyright 2012-2014 Moritz Hilscher
+ *
+ * This file is part of Mapcrafter.
+ *
+ * Mapcrafter is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Mapcrafter is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Mapcrafter.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SCANINDEX_H_
+#define SCANINDEX_H_
+
+#include "tileset.h"
+#include "../mc/pos.h"
+#include "../mc/world.h"
+
+#include <ctime>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+#include <stdint.h>
+
+namespace mapcrafter {
+namespace renderer {
+
+/**
+ * The scanned information of a region file: The modification time and size of the file
+ * and the local indexes (z*32 + x, rotated) and timestamps of the contained chunks.
+ */
+struct RegionScanEntry {
+	RegionScanEntry();
+
+	int64_t mtime, size;
+	std::vector<std::pair<uint16_t, uint32_t> > chunks;
+};
+
+/**
+ * This class is a persistent index of a scanned world (with a specific rotation and world
+ * crop). It stores the headers of the region files and the render tiles derived from
+ * them, so only region files which were modified since the last scan need to be read
+ * and only the tiles of these regions need to be calculated again.
+ */
+class WorldScanIndex {
+public:
+	WorldScanIndex(const mc::World& world);
+	~WorldScanIndex();
+
+	/**
+	 * Reads the index from a file. Returns false if the file does not exist, is
+	 * corrupted or belongs to another world, rotation or world crop. The index is empty
+	 * in this case.
+	 */
+	bool read(const std::string& filename);
+
+	/**
+	 * Writes the index to a file. The file is replaced atomically.
+	 */
+	bool write(const std::string& filename) const;
+
+	/**
+	 * Updates the index with the current state of the world: Reads the headers of new
+	 * and modified region files and updates the tiles of them. Returns the count of
+	 * changed (new, modified or removed) regions.
+	 */
+	int update();
+
+	/**
+	 * Returns the count of regions in the index.
+	 */
+	int getRegionCount() const;
+
+	/**
+	 * Returns the render tiles of the world with their timestamps (= highest timestamp
+	 * of all chunks in a tile). The positions are not centered with a tile offset.
+	 */
+	const std::map<TilePos, int>& getTileTimestamps() const;
+
+private:
+	mc::World world;
+	// identifies the scanned world: region directory, rotation and world crop
+	std::string world_key;
+
+	// time when the index was updated the last time
+	int64_t scan_time;
+
+	std::map<mc::RegionPos, RegionScanEntry> regions;
+	std::map<TilePos, int> tile_timestamps;
+
+	/**
+	 * Adds the tiles of the chunks of a region to the tile timestamps. If only_tiles is
+	 * not null, only the tiles in this set are updated.
+	 */
+	void addRegionTiles(const mc::RegionPos& pos, const RegionScanEntry& entry,
+			const std::set<TilePos>* only_tiles = nullptr);
+};
+
+}
+}
+
+#endif /* SCANINDEX_H_ */
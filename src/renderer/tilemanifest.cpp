@@ -0,0 +1,154 @@
+/*
+ * Copyright 2012-2014 Moritz Hilscher
+ *
+ * This file is part of Mapcrafter.
+ *
+ * Mapcrafter is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Mapcrafter is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Mapcrafter.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "tilemanifest.h"
+
+#include "../util.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+namespace mapcrafter {
+namespace renderer {
+
+// magic bytes and version of the manifest file format
+const char TILEMANIFEST_MAGIC[4] = {'M', 'C', 'T', 'M'};
+const int TILEMANIFEST_VERSION = 2;
+
+TileManifestEntry::TileManifestEntry()
+	: timestamp(0), hash(0) {
+}
+
+TileManifestEntry::TileManifestEntry(int timestamp, uint64_t hash)
+	: timestamp(timestamp), hash(hash) {
+}
+
+TileManifest::TileManifest() {
+}
+
+TileManifest::~TileManifest() {
+}
+
+bool TileManifest::read(const std::string& filename) {
+	tiles.clear();
+
+	std::ifstream in(filename.c_str(), std::ios::binary);
+	if (!in)
+		return false;
+
+	char magic[4];
+	int32_t version, count;
+	if (!in.read(magic, 4) || std::memcmp(magic, TILEMANIFEST_MAGIC, 4) != 0
+			|| !util::readBigEndian(in, version) || version != TILEMANIFEST_VERSION
+			|| !util::readBigEndian(in, count) || count < 0)
+		return false;
+
+	for (int32_t i = 0; i < count; i++) {
+		int32_t x, y;
+		TileManifestEntry entry;
+		if (!util::readBigEndian(in, x) || !util::readBigEndian(in, y)
+				|| !util::readBigEndian(in, entry.timestamp)
+				|| !util::readBigEndian(in, entry.hash)) {
+			tiles.clear();
+			return false;
+		}
+		// the tiles are stored in order
+		tiles.insert(tiles.end(), std::make_pair(TilePos(x, y), entry));
+	}
+	return true;
+}
+
+bool TileManifest::write(const std::string& filename) const {
+	// write to a temporary file at first and rename it then,
+	// so an aborted write can't leave a corrupted manifest behind
+	std::string tmp_filename = filename + ".tmp";
+	std::ofstream out(tmp_filename.c_str(), std::ios::binary);
+	if (!out)
+		return false;
+
+	out.write(TILEMANIFEST_MAGIC, 4);
+	util::writeBigEndian<int32_t>(out, TILEMANIFEST_VERSION);
+	util::writeBigEndian<int32_t>(out, tiles.size());
+	for (auto it = tiles.begin(); it != tiles.end(); ++it) {
+		util::writeBigEndian<int32_t>(out, it->first.getX());
+		util::writeBigEndian<int32_t>(out, it->first.getY());
+		util::writeBigEndian<int32_t>(out, it->second.timestamp);
+		util::writeBigEndian<uint64_t>(out, it->second.hash);
+	}
+
+	out.close();
+	if (out.fail())
+		return false;
+	return std::rename(tmp_filename.c_str(), filename.c_str()) == 0;
+}
+
+bool TileManifest::empty() const {
+	return tiles.empty();
+}
+
+int TileManifest::getTilesCount() const {
+	return tiles.size();
+}
+
+bool TileManifest::hasTile(const TilePos& tile) const {
+	return tiles.count(tile);
+}
+
+const TileManifestEntry& TileManifest::getTile(const TilePos& tile) const {
+	return tiles.at(tile);
+}
+
+void TileManifest::setTile(const TilePos& tile, const TileManifestEntry& entry) {
+	tiles[tile] = entry;
+}
+
+uint64_t TileManifest::getTileHash(const TilePos& tile) const {
+	std::unique_lock<std::mutex> lock(mutex);
+	auto it = tiles.find(tile);
+	if (it == tiles.end())
+		return 0;
+	return it->second.hash;
+}
+
+void TileManifest::setTileHash(const TilePos& tile, uint64_t hash) {
+	std::unique_lock<std::mutex> lock(mutex);
+	tiles[tile].hash = hash;
+}
+
+void TileManifest::update(const TileSet& tile_set, int timestamp) {
+	const std::vector<TilePos>& render_tiles = tile_set.getRenderTiles();
+
+	std::map<TilePos, TileManifestEntry> updated;
+	for (auto it = render_tiles.begin(); it != render_tiles.end(); ++it) {
+		uint64_t hash = 0;
+		auto old_it = tiles.find(*it);
+		if (old_it != tiles.end())
+			hash = old_it->second.hash;
+		updated.insert(updated.end(), std::make_pair(*it, TileManifestEntry(timestamp, hash)));
+	}
+	tiles.swap(updated);
+}
+
+void TileManifest::clear() {
+	tiles.clear();
+}
+
+}
+}
@@ -0,0 +1,98 @@
+/*
+ * Copyright 2012-2014 Moritz Hilscher
+ *
+ * This file is part of Mapcrafter.
+ *
+ * Mapcrafter is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Mapcrafter is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Mapcrafter.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TILEMANIFEST_H_
+#define TILEMANIFEST_H_
+
+#include "tileset.h"
+
+#include <map>
+#include <mutex>
+#include <string>
+#include <stdint.h>
+
+namespace mapcrafter {
+namespace renderer {
+
+/**
+ * The manifest entry of a rendered tile: The time it was rendered the last time (or
+ * was known to be up to date) and the hash of the image (0 if not available).
+ */
+struct TileManifestEntry {
+	TileManifestEntry();
+	TileManifestEntry(int timestamp, uint64_t hash = 0);
+
+	int timestamp;
+	uint64_t hash;
+};
+
+/**
+ * This class is a persistent manifest of the rendered render tiles of a map rotation.
+ * It is used for incremental rendering instead of checking the modification time of
+ * every single tile image, so only one file needs to be read.
+ */
+class TileManifest {
+public:
+	TileManifest();
+	~TileManifest();
+
+	/**
+	 * Reads the manifest from a file. Returns false if the file does not exist or is
+	 * corrupted. The manifest is empty in this case.
+	 */
+	bool read(const std::string& filename);
+
+	/**
+	 * Writes the manifest to a file. The file is replaced atomically.
+	 */
+	bool write(const std::string& filename) const;
+
+	bool empty() const;
+	int getTilesCount() const;
+
+	bool hasTile(const TilePos& tile) const;
+	const TileManifestEntry& getTile(const TilePos& tile) const;
+	void setTile(const TilePos& tile, const TileManifestEntry& entry);
+
+	/**
+	 * Returns/sets the image hash of a render tile (0 if not available). These two
+	 * methods are thread-safe, so the tile renderers can use them while rendering to
+	 * find out whether the image of a render tile actually changed.
+	 */
+	uint64_t getTileHash(const TilePos& tile) const;
+	void setTileHash(const TilePos& tile, uint64_t hash);
+
+	/**
+	 * Marks all render tiles of a tile set as up to date at a specific time, after the
+	 * required tiles were rendered. Tiles not contained in the tile set are removed.
+	 * The image hashes (set while rendering) are kept.
+	 */
+	void update(const TileSet& tile_set, int timestamp);
+
+	void clear();
+
+private:
+	std::map<TilePos, TileManifestEntry> tiles;
+	mutable std::mutex mutex;
+};
+
+}
+}
+
+#endif /* TILEMANIFEST_H_ */
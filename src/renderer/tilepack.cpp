@@ -0,0 +1,335 @@
+/*
+ * Copyright 2012-2014 Moritz Hilscher
+ *
+ * This file is part of Mapcrafter.
+ *
+ * Mapcrafter is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Mapcrafter is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Mapcrafter.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "tilepack.h"
+
+#include "../util.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <utility>
+
+namespace mapcrafter {
+namespace renderer {
+
+// magic bytes and version of the index file format
+const char TILEPACK_INDEX_MAGIC[4] = {'M', 'C', 'T', 'I'};
+const int TILEPACK_INDEX_VERSION = 1;
+// count of index entries per page
+const int TILEPACK_INDEX_PAGE_SIZE = 1024;
+
+TilePackEntry::TilePackEntry()
+	: offset(0), size(0) {
+}
+
+TilePack::TilePack(const fs::path& dir)
+	: dir(dir), generation(0), pack_size(0), used_size(0), flushed_size(0) {
+}
+
+TilePack::~TilePack() {
+}
+
+bool TilePack::open() {
+	std::unique_lock<std::mutex> lock(mutex);
+	if (pack.is_open())
+		pack.close();
+	readers.clear();
+	if (!fs::is_directory(dir))
+		fs::create_directories(dir);
+
+	// use the existing pack if there is a valid index and the pack file has all tiles
+	bool existing = readIndex() && fs::exists(getPackPath(generation));
+	if (existing) {
+		uint64_t size = fs::file_size(getPackPath(generation));
+		for (auto it = tiles.begin(); it != tiles.end(); ++it)
+			if (it->second.offset + it->second.size > size)
+				existing = false;
+	}
+	if (!existing) {
+		tiles.clear();
+		generation = 0;
+	}
+
+	std::ios::openmode mode = std::ios::in | std::ios::out | std::ios::binary;
+	if (!existing)
+		mode |= std::ios::trunc;
+	pack.open(getPackPath(generation).string().c_str(), mode);
+	if (!pack)
+		return false;
+
+	// new tiles are just appended,
+	// the end of the pack might be unused if the rendering was aborted
+	pack.seekp(0, std::ios::end);
+	pack_size = flushed_size = pack.tellp();
+	used_size = 0;
+	for (auto it = tiles.begin(); it != tiles.end(); ++it)
+		used_size += it->second.size;
+	return true;
+}
+
+bool TilePack::flush() {
+	std::unique_lock<std::mutex> lock(mutex);
+	if (!pack.is_open())
+		return false;
+	pack.flush();
+	if (!pack)
+		return false;
+	flushed_size = pack_size;
+
+	// compact the pack file if more than half of it is unused,
+	// the old pack file is removed after the new index is written
+	int old_generation = generation;
+	if (pack_size > 2 * used_size && !compact())
+		return false;
+	if (!writeIndex())
+		return false;
+	if (generation != old_generation) {
+		boost::system::error_code error;
+		fs::remove(getPackPath(old_generation), error);
+	}
+	return true;
+}
+
+int TilePack::getTilesCount() const {
+	std::unique_lock<std::mutex> lock(mutex);
+	return tiles.size();
+}
+
+std::vector<TilePath> TilePack::getTiles() const {
+	std::unique_lock<std::mutex> lock(mutex);
+	std::vector<TilePath> paths;
+	for (auto it = tiles.begin(); it != tiles.end(); ++it)
+		paths.push_back(it->first);
+	return paths;
+}
+
+bool TilePack::hasTile(const TilePath& tile) const {
+	std::unique_lock<std::mutex> lock(mutex);
+	return tiles.count(tile);
+}
+
+bool TilePack::readTile(const TilePath& tile, std::string& data) const {
+	TilePackEntry entry;
+	int reader_generation;
+	std::unique_ptr<std::ifstream> reader;
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		auto it = tiles.find(tile);
+		if (it == tiles.end())
+			return false;
+		entry = it->second;
+
+		// the image might still be in the buffer of the writing stream
+		if (entry.offset + entry.size > flushed_size) {
+			pack.flush();
+			flushed_size = pack_size;
+		}
+		reader_generation = generation;
+		if (!readers.empty()) {
+			reader = std::move(readers.back());
+			readers.pop_back();
+		}
+	}
+
+	if (!reader)
+		reader.reset(new std::ifstream(getPackPath(reader_generation).string().c_str(),
+				std::ios::binary));
+	data.resize(entry.size);
+	reader->seekg(entry.offset);
+	reader->read(&data[0], data.size());
+	bool ok = !reader->fail();
+	reader->clear();
+
+	// streams of an old (compacted) pack file are not used again
+	std::unique_lock<std::mutex> lock(mutex);
+	if (ok && reader_generation == generation)
+		readers.push_back(std::move(reader));
+	return ok;
+}
+
+bool TilePack::writeTile(const TilePath& tile, const std::string& data) {
+	std::unique_lock<std::mutex> lock(mutex);
+	pack.seekp(pack_size);
+	pack.write(data.data(), data.size());
+	if (!pack) {
+		pack.clear();
+		return false;
+	}
+
+	TilePackEntry& entry = tiles[tile];
+	used_size = used_size - entry.size + data.size();
+	entry.offset = pack_size;
+	entry.size = data.size();
+	pack_size += data.size();
+	return true;
+}
+
+void TilePack::increaseMaxZoom() {
+	std::unique_lock<std::mutex> lock(mutex);
+	std::map<TilePath, TilePackEntry> moved;
+	for (auto it = tiles.begin(); it != tiles.end(); ++it) {
+		if (it->first.getDepth() == 0) {
+			used_size -= it->second.size;
+			continue;
+		}
+		// 1/... -> 1/4/..., 2/... -> 2/3/..., 3/... -> 3/2/..., 4/... -> 4/1/...
+		std::vector<int> parts = it->first.getPath();
+		TilePath path = (TilePath() + parts[0]) + (5 - parts[0]);
+		for (size_t i = 1; i < parts.size(); i++)
+			path += parts[i];
+		moved[path] = it->second;
+	}
+	tiles.swap(moved);
+}
+
+uint64_t TilePack::getTileKey(const TilePath& tile) {
+	return ((uint64_t) tile.getDepth() << 58) | tile.getCode();
+}
+
+fs::path TilePack::getIndexPath() const {
+	return dir / "tiles.idx";
+}
+
+fs::path TilePack::getPackPath(int generation) const {
+	return dir / ("tiles." + util::str(generation) + ".pack");
+}
+
+bool TilePack::readIndex() {
+	tiles.clear();
+	std::ifstream in(getIndexPath().string().c_str(), std::ios::binary);
+	if (!in)
+		return false;
+
+	char magic[4];
+	int32_t version, count, page_size, page_count;
+	if (!in.read(magic, 4) || std::memcmp(magic, TILEPACK_INDEX_MAGIC, 4) != 0
+			|| !util::readBigEndian(in, version) || version != TILEPACK_INDEX_VERSION
+			|| !util::readBigEndian(in, generation)
+			|| !util::readBigEndian(in, count) || count < 0
+			|| !util::readBigEndian(in, page_size)
+			|| !util::readBigEndian(in, page_count) || page_count < 0)
+		return false;
+
+	// the page table is only required by the web interface
+	in.seekg(page_count * 8, std::ios::cur);
+	for (int32_t i = 0; i < count; i++) {
+		uint64_t key;
+		TilePackEntry entry;
+		if (!util::readBigEndian(in, key) || !util::readBigEndian(in, entry.offset)
+				|| !util::readBigEndian(in, entry.size)) {
+			tiles.clear();
+			return false;
+		}
+		int depth = key >> 58;
+		if (depth > TilePath::MAX_DEPTH) {
+			tiles.clear();
+			return false;
+		}
+		tiles[TilePath::byCode(key, depth)] = entry;
+	}
+	return true;
+}
+
+bool TilePack::writeIndex() const {
+	// sort the tiles by zoom level and quadtree code,
+	// so the tiles of a zoom level which are next to each other are on the same pages
+	std::vector<std::pair<uint64_t, TilePackEntry> > entries;
+	entries.reserve(tiles.size());
+	for (auto it = tiles.begin(); it != tiles.end(); ++it)
+		entries.push_back(std::make_pair(getTileKey(it->first), it->second));
+	std::sort(entries.begin(), entries.end(),
+			[](const std::pair<uint64_t, TilePackEntry>& a,
+					const std::pair<uint64_t, TilePackEntry>& b) {
+		return a.first < b.first;
+	});
+	int page_count = (entries.size() + TILEPACK_INDEX_PAGE_SIZE - 1) / TILEPACK_INDEX_PAGE_SIZE;
+
+	// write to a temporary file at first and rename it then,
+	// so an aborted write can't leave a corrupted index behind
+	std::string filename = getIndexPath().string();
+	std::string tmp_filename = filename + ".tmp";
+	std::ofstream out(tmp_filename.c_str(), std::ios::binary);
+	if (!out)
+		return false;
+
+	out.write(TILEPACK_INDEX_MAGIC, 4);
+	util::writeBigEndian<int32_t>(out, TILEPACK_INDEX_VERSION);
+	util::writeBigEndian<int32_t>(out, generation);
+	util::writeBigEndian<int32_t>(out, entries.size());
+	util::writeBigEndian<int32_t>(out, TILEPACK_INDEX_PAGE_SIZE);
+	util::writeBigEndian<int32_t>(out, page_count);
+	// the page table: the key of the first tile of every page
+	for (int i = 0; i < page_count; i++)
+		util::writeBigEndian<uint64_t>(out, entries[i * TILEPACK_INDEX_PAGE_SIZE].first);
+	for (auto it = entries.begin(); it != entries.end(); ++it) {
+		util::writeBigEndian<uint64_t>(out, it->first);
+		util::writeBigEndian<uint64_t>(out, it->second.offset);
+		util::writeBigEndian<uint32_t>(out, it->second.size);
+	}
+
+	out.close();
+	if (out.fail())
+		return false;
+	return std::rename(tmp_filename.c_str(), filename.c_str()) == 0;
+}
+
+bool TilePack::compact() {
+	// copy all used tile images into a new pack file
+	std::string filename = getPackPath(generation + 1).string();
+	std::fstream compacted(filename.c_str(),
+			std::ios::in | std::ios::out | std::ios::binary | std::ios::trunc);
+	std::map<TilePath, TilePackEntry> compacted_tiles;
+	uint64_t offset = 0;
+	std::string data;
+	for (auto it = tiles.begin(); compacted && it != tiles.end(); ++it) {
+		data.resize(it->second.size);
+		pack.seekg(it->second.offset);
+		pack.read(&data[0], data.size());
+		if (!pack)
+			break;
+		compacted.write(data.data(), data.size());
+
+		TilePackEntry& entry = compacted_tiles[it->first];
+		entry.offset = offset;
+		entry.size = data.size();
+		offset += data.size();
+	}
+	compacted.flush();
+
+	if (!pack || !compacted) {
+		pack.clear();
+		compacted.close();
+		std::remove(filename.c_str());
+		return false;
+	}
+
+	// and use the new pack file from now on
+	pack.close();
+	pack.swap(compacted);
+	tiles.swap(compacted_tiles);
+	generation++;
+	pack_size = used_size = flushed_size = offset;
+	readers.clear();
+	return true;
+}
+
+}
+}
@@ -0,0 +1,142 @@
+/*
+ * Copyright 2012-2014 Moritz Hilscher
+ *
+ * This file is part of Mapcrafter.
+ *
+ * Mapcrafter is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Mapcrafter is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Mapcrafter.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TILEPACK_H_
+#define TILEPACK_H_
+
+#include "tileset.h"
+
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include <boost/filesystem.hpp>
+
+namespace fs = boost::filesystem;
+
+namespace mapcrafter {
+namespace renderer {
+
+/**
+ * The position of a tile image in a tile pack.
+ */
+struct TilePackEntry {
+	TilePackEntry();
+
+	uint64_t offset;
+	uint32_t size;
+};
+
+/**
+ * A tile pack stores all tile images of a map rotation in one file instead of one file
+ * per tile. The images are appended to the pack file (tiles.<generation>.pack), their
+ * positions are stored in an index file (tiles.idx).
+ *
+ * The index is only written when the pack is flushed. Images are never overwritten,
+ * so the old index stays valid if the rendering is aborted. If more than half of the
+ * pack file is unused, flushing compacts it into a new pack file (with the next
+ * generation number).
+ *
+ * The entries of the index file are sorted by zoom level and quadtree code of the tiles
+ * and split into pages, so the web interface can look up tiles by loading only a few
+ * pages of the index with HTTP range requests.
+ *
+ * Reading and writing tiles is thread-safe. The tile images are read with separate
+ * streams (one per reading thread), so reading threads hold the lock only to look up
+ * the index and don't wait for each other while seeking and reading.
+ */
+class TilePack {
+public:
+	TilePack(const fs::path& dir);
+	~TilePack();
+
+	/**
+	 * Opens the pack. Returns false if the pack file can't be opened. If there is no
+	 * (valid) index, a new empty pack is created.
+	 */
+	bool open();
+
+	/**
+	 * Writes the index of the pack and compacts the pack file if required.
+	 * The index is replaced atomically.
+	 */
+	bool flush();
+
+	int getTilesCount() const;
+
+	/**
+	 * Returns all tiles in the pack.
+	 */
+	std::vector<TilePath> getTiles() const;
+
+	bool hasTile(const TilePath& tile) const;
+
+	/**
+	 * Reads the (encoded) image of a tile.
+	 */
+	bool readTile(const TilePath& tile, std::string& data) const;
+
+	/**
+	 * Appends the (encoded) image of a tile to the pack.
+	 */
+	bool writeTile(const TilePath& tile, const std::string& data);
+
+	/**
+	 * Moves all tiles one zoom level deeper, like RenderManager::increaseMaxZoom does
+	 * with the tile directories: The tiles of the top left quarter are moved to the
+	 * bottom right quarter of the new top left tile (1/... -> 1/4/...) and so on.
+	 * The base tile is removed.
+	 */
+	void increaseMaxZoom();
+
+	/**
+	 * Returns the sort key of a tile in the index (zoom level and quadtree code).
+	 */
+	static uint64_t getTileKey(const TilePath& tile);
+
+private:
+	fs::path dir;
+	int generation;
+
+	std::map<TilePath, TilePackEntry> tiles;
+	// size of the pack file and how much of it is used by the tiles in the index
+	uint64_t pack_size, used_size;
+
+	mutable std::fstream pack;
+	// how much of the pack file is flushed and can be read by the reading streams
+	mutable uint64_t flushed_size;
+	// the streams which are currently not used by a reading thread
+	mutable std::vector<std::unique_ptr<std::ifstream> > readers;
+	mutable std::mutex mutex;
+
+	fs::path getIndexPath() const;
+	fs::path getPackPath(int generation) const;
+
+	bool readIndex();
+	bool writeIndex() const;
+	bool compact();
+};
+
+}
+}
+
+#endif /* TILEPACK_H_ */
@@ -21,6 +21,7 @@
 
 #include "rendermodes/base.h"
 #include "biomes.h"
+#include "../util.h"
 
 #include <fstream>
 #include <iostream>
@@ -124,6 +125,16 @@ mc::Block RenderState::getBlock(const mc::BlockPos& pos, int get) {
 	return world->getBlock(pos, chunk, get);
 }
 
+RenderBlock::RenderBlock()
+	: x(0), y(0), id(0), data(0), image(nullptr) {
+}
+
+const RGBAImage& RenderBlock::getImage() const {
+	if (image != nullptr)
+		return *image;
+	return biome_image;
+}
+
 bool RenderBlock::operator<(const RenderBlock& other) const {
 	return pos < other.pos;
 }
@@ -139,12 +150,40 @@ TileRenderer::TileRenderer(std::shared_ptr<mc::WorldCache> world,
 		: state(world, images), render_biomes(map_config.renderBiomes()),
 		  water_preblit(map_config.getRendermode() != "daylight"
 				  && map_config.getRendermode() != "nightlight") {
-	createRendermode(world_config, map_config, state, rendermodes);
+	addOutput(world_config, map_config);
 }
 
 TileRenderer::~TileRenderer() {
 }
 
+int TileRenderer::addOutput(const config::WorldSection& world_config,
+		const config::MapSection& map_config) {
+	outputs.push_back(RendermodeStack());
+	createRendermode(world_config, map_config, state, outputs.back());
+	return outputs.size() - 1;
+}
+
+int TileRenderer::getOutputCount() const {
+	return outputs.size();
+}
+
+bool TileRenderer::canShareVisibleBlocks(const config::MapSection& map1,
+		const config::MapSection& map2) {
+	// the lighting rendermodes use other block images and render water differently
+	std::string rendermode1 = map1.getRendermode(), rendermode2 = map2.getRendermode();
+	bool lighting1 = rendermode1 == "daylight" || rendermode1 == "nightlight";
+	bool lighting2 = rendermode2 == "daylight" || rendermode2 == "nightlight";
+	return map1.getWorld() == map2.getWorld()
+			&& map1.getTextureDir() == map2.getTextureDir()
+			&& map1.getTextureSize() == map2.getTextureSize()
+			&& map1.renderUnknownBlocks() == map2.renderUnknownBlocks()
+			&& map1.renderLeavesTransparent() == map2.renderLeavesTransparent()
+			&& map1.renderBiomes() == map2.renderBiomes()
+			// the cave rendermode hides blocks
+			&& rendermode1 != "cave" && rendermode2 != "cave"
+			&& lighting1 == lighting2;
+}
+
 Biome TileRenderer::getBiomeOfBlock(const mc::BlockPos& pos, const mc::Chunk* chunk) {
 	// return default biome if we don't want to render different biomes
 	if (!render_biomes)
@@ -429,12 +468,16 @@ uint16_t TileRenderer::checkNeighbors(const mc::BlockPos& pos, uint16_t id, uint
 	return data;
 }
 
-void TileRenderer::renderTile(const TilePos& tile_pos, const TilePos& tile_offset,
-		RGBAImage& tile) {
-	// some vars, set correct image size
+void TileRenderer::getVisibleBlocks(const TilePos& tile_pos, const TilePos& tile_offset,
+		std::vector<RenderBlock>& visible_blocks) {
+	util::ScopedTimer timer(util::ProfileStage::VISIBLE_BLOCKS);
+
+	// the rendermodes of the map decide which blocks are hidden
+	const RendermodeStack& rendermodes = outputs[0];
+
+	// some vars
 	int block_size = state.images->getBlockImageSize();
 	int tile_size = state.images->getTileSize();
-	tile.setSize(tile_size, tile_size);
 
 	// get the maximum count of water blocks
 	// blitted about each over, until they are nearly opaque
@@ -443,10 +486,6 @@ void TileRenderer::renderTile(const TilePos& tile_pos, const TilePos& tile_offse
 	// all visible blocks which are rendered in this tile
 	std::set<RenderBlock> blocks;
 
-	// call start method of the rendermodes
-	for (size_t i = 0; i < rendermodes.size(); i++)
-		rendermodes[i]->start();
-
 	// iterate over the highest blocks in the tile
 	// we use as tile position tile_pos+tile_offset because the offset means that
 	// we treat the tile position as tile_pos, but it's actually tile_pos+tile_offset
@@ -560,12 +599,10 @@ void TileRenderer::renderTile(const TilePos& tile_pos, const TilePos& tile_offse
 									data |= DATA_WEST;
 
 								// get image and replace the old render block with this
-								top.image = state.images->getOpaqueWater(neighbor_south,
+								top.image = &state.images->getOpaqueWater(neighbor_south,
 										neighbor_west);
-
-								// don't forget the rendermodes
-								for (size_t i = 0; i < rendermodes.size(); i++)
-									rendermodes[i]->draw(top.image, top.pos, id, data);
+								// the rendermodes draw it with the data of this block
+								top.data = data;
 
 								row_nodes.insert(top);
 								break;
@@ -586,26 +623,21 @@ void TileRenderer::renderTile(const TilePos& tile_pos, const TilePos& tile_offse
 			data = checkNeighbors(block.current, id, data);
 			//if (is_water && (data & DATA_WEST) && (data & DATA_SOUTH))
 			//	continue;
-			RGBAImage image;
 			bool transparent = state.images->isBlockTransparent(id, data);
 
-			// check for biome data
-			if (Biome::isBiomeBlock(id, data))
-				image = state.images->getBiomeDependBlock(id, data, getBiomeOfBlock(block.current, state.chunk));
-			else
-				image = state.images->getBlock(id, data);
-
 			RenderBlock node;
 			node.x = it.draw_x;
 			node.y = it.draw_y;
 			node.pos = block.current;
-			node.image = image;
 			node.id = id;
 			node.data = data;
 
-			// let the rendermodes do their magic with the block image
-			for (size_t i = 0; i < rendermodes.size(); i++)
-				rendermodes[i]->draw(node.image, node.pos, id, data);
+			// check for biome data
+			if (Biome::isBiomeBlock(id, data))
+				node.biome_image = state.images->getBiomeDependBlock(id, data,
+						getBiomeOfBlock(block.current, state.chunk));
+			else
+				node.image = &state.images->getBlock(id, data);
 
 			// insert into current row
 			row_nodes.insert(node);
@@ -632,16 +664,73 @@ void TileRenderer::renderTile(const TilePos& tile_pos, const TilePos& tile_offse
 		}
 	}
 
-	// now blit all blocks
-	for (std::set<RenderBlock>::const_iterator it = blocks.begin(); it != blocks.end();
-			++it) {
-		tile.alphablit(it->image, it->x, it->y);
+	visible_blocks.assign(blocks.begin(), blocks.end());
+}
+
+void TileRenderer::drawVisibleBlocks(const std::vector<RenderBlock>& blocks, int output,
+		RGBAImage& tile) {
+	const RendermodeStack& rendermodes = outputs[output];
+	int tile_size = state.images->getTileSize();
+	tile.setSize(tile_size, tile_size);
+
+	// let the rendermodes do their magic with the block images
+	std::vector<RGBAImage> images;
+	if (!rendermodes.empty()) {
+		// the timers are per tile, the clock is too slow to measure every block
+		util::ScopedTimer draw_timer(util::ProfileStage::RENDERMODE_DRAW);
+		images.resize(blocks.size());
+		for (size_t i = 0; i < blocks.size(); i++) {
+			images[i] = blocks[i].getImage();
+			for (size_t j = 0; j < rendermodes.size(); j++)
+				rendermodes[j]->draw(images[i], blocks[i].pos, blocks[i].id, blocks[i].data);
+		}
 	}
 
+	// now blit all blocks
+	util::ScopedTimer blit_timer(util::ProfileStage::BLIT);
+	for (size_t i = 0; i < blocks.size(); i++)
+		tile.alphablit(rendermodes.empty() ? blocks[i].getImage() : images[i],
+				blocks[i].x, blocks[i].y);
+}
+
+void TileRenderer::renderTile(const TilePos& tile_pos, const TilePos& tile_offset,
+		RGBAImage& tile) {
+	util::ScopedTimer timer(util::ProfileStage::RENDER_TILE);
+
+	// call start method of the rendermodes
+	const RendermodeStack& rendermodes = outputs[0];
+	for (size_t i = 0; i < rendermodes.size(); i++)
+		rendermodes[i]->start();
+
+	std::vector<RenderBlock> blocks;
+	getVisibleBlocks(tile_pos, tile_offset, blocks);
+	drawVisibleBlocks(blocks, 0, tile);
+
 	// call the end method of the rendermodes
 	for (size_t i = 0; i < rendermodes.size(); i++)
 		rendermodes[i]->end();
 }
 
+void TileRenderer::renderTile(const TilePos& tile_pos, const TilePos& tile_offset,
+		std::vector<RGBAImage>& tiles) {
+	util::ScopedTimer timer(util::ProfileStage::RENDER_TILE);
+
+	// call start method of the rendermodes
+	for (size_t i = 0; i < outputs.size(); i++)
+		for (size_t j = 0; j < outputs[i].size(); j++)
+			outputs[i][j]->start();
+
+	std::vector<RenderBlock> blocks;
+	getVisibleBlocks(tile_pos, tile_offset, blocks);
+	tiles.resize(outputs.size());
+	for (size_t i = 0; i < outputs.size(); i++)
+		drawVisibleBlocks(blocks, i, tiles[i]);
+
+	// call the end method of the rendermodes
+	for (size_t i = 0; i < outputs.size(); i++)
+		for (size_t j = 0; j < outputs[i].size(); j++)
+			outputs[i][j]->end();
+}
+
 }
 }
@@ -97,18 +97,26 @@ struct RenderState {
  * A block, which should get drawed on a tile.
  */
 struct RenderBlock {
+	RenderBlock();
 
 	// drawing position in pixels on the tile
 	int x, y;
-	bool transparent;
-	RGBAImage image;
 	mc::BlockPos pos;
-	uint8_t id, data;
+	// block id and data (with the neighbor data) the block is drawn with
+	uint16_t id, data;
+
+	// the image of the block, owned by the block images, or the image in biome_image
+	// if the block image depends on the biome
+	const RGBAImage* image;
+	RGBAImage biome_image;
+
+	const RGBAImage& getImage() const;
 
 	bool operator<(const RenderBlock& other) const;
 };
 
 class Rendermode;
+typedef std::vector<std::shared_ptr<Rendermode>> RendermodeStack;
 
 /**
  * Renders tiles from world data.
@@ -120,7 +128,9 @@ private:
 	bool render_biomes;
 	bool water_preblit;
 
-	std::vector<std::shared_ptr<Rendermode>> rendermodes;
+	// the rendermodes of the map and of the additional outputs (see addOutput),
+	// the rendermodes of the map decide which blocks are visible
+	std::vector<RendermodeStack> outputs;
 
 	Biome getBiomeOfBlock(const mc::BlockPos& pos, const mc::Chunk* chunk);
 
@@ -133,7 +143,47 @@ public:
 			const config::MapSection& map_config);
 	~TileRenderer();
 
+	/**
+	 * Adds the rendermodes of another map as additional output of the renderer. The
+	 * additional outputs are rendered from the visible blocks of the map of the renderer,
+	 * so the maps must be able to share them (see canShareVisibleBlocks).
+	 * Returns the index of the output, the map of the renderer itself is output 0.
+	 */
+	int addOutput(const config::WorldSection& world_config,
+			const config::MapSection& map_config);
+	int getOutputCount() const;
+
+	/**
+	 * Visibility stage: Collects the visible blocks of a tile in the order they are
+	 * drawn. This walks the block rows of the tile, checks the neighbors of the blocks
+	 * and uses the rendermodes of the map to hide blocks.
+	 */
+	void getVisibleBlocks(const TilePos& tile_pos, const TilePos& tile_offset,
+			std::vector<RenderBlock>& blocks);
+
+	/**
+	 * Shading/compositing stage: Draws the visible blocks of a tile with the rendermodes
+	 * of an output onto the tile image. The start/end methods of the rendermodes must be
+	 * called by the caller.
+	 */
+	void drawVisibleBlocks(const std::vector<RenderBlock>& blocks, int output,
+			RGBAImage& tile);
+
 	void renderTile(const TilePos& tile_pos, const TilePos& tile_offset, RGBAImage& tile);
+
+	/**
+	 * Renders the tile images of all outputs with one visibility stage.
+	 */
+	void renderTile(const TilePos& tile_pos, const TilePos& tile_offset,
+			std::vector<RGBAImage>& tiles);
+
+	/**
+	 * Returns whether the tiles of two maps can be rendered from the same visible blocks,
+	 * that's the case if they have the same world, block images and biome setting and if
+	 * their rendermodes don't hide blocks and handle water the same way.
+	 */
+	static bool canShareVisibleBlocks(const config::MapSection& map1,
+			const config::MapSection& map2);
 };
 
 }
@@ -19,6 +19,13 @@
 
 #include "tilerenderworker.h"
 
+#include "../util.h"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <sstream>
+
 namespace mapcrafter {
 namespace renderer {
 
@@ -31,6 +38,16 @@ TileRenderWorker::~TileRenderWorker() {
 
 void TileRenderWorker::setRenderContext(const RenderContext& context) {
 	render_context = context;
+	world_cache.reset();
+
+	RenderOutput output;
+	output.output_dir = context.output_dir;
+	output.map_config = context.map_config;
+	output.tile_pack = context.tile_pack;
+	output.tile_manifest = context.tile_manifest;
+	outputs.clear();
+	outputs.push_back(output);
+	outputs.insert(outputs.end(), context.extra_outputs.begin(), context.extra_outputs.end());
 }
 
 void TileRenderWorker::setRenderWork(const RenderWork& work) {
@@ -50,48 +67,99 @@ void TileRenderWorker::setProgressHandler(
 	this->finished = finished;
 }
 
-void TileRenderWorker::saveTile(const TilePath& tile, const RGBAImage& image) {
-	bool png = render_context.map_config.getImageFormat() == config::ImageFormat::PNG;
-	std::string suffix = std::string(".") + render_context.map_config.getImageFormatSuffix();
-	std::string filename = tile.toString() + suffix;
-	if (tile.getDepth() == 0)
-		filename = std::string("base") + suffix;
-	fs::path file = render_context.output_dir / filename;
-	if (!fs::exists(file.branch_path()))
-		fs::create_directories(file.branch_path());
+void TileRenderWorker::saveTile(const TilePath& tile, const RGBAImage& image, int output) {
+	const RenderOutput& out = outputs[output];
+	bool png = out.map_config.getImageFormat() == config::ImageFormat::PNG;
+	config::Color bg = render_context.background_color;
+	RGBAPixel background = rgba(bg.red, bg.green, bg.blue, 255);
+	int jpeg_quality = out.map_config.getJPEGQuality();
 
-	if (png && !image.writePNG(file.string()))
-		std::cout << "Unable to write " << file.string() << std::endl;
+	// encode the image at first, to measure encoding and writing separately
+	auto encode_start = std::chrono::steady_clock::now();
+	std::string data;
+	{
+		util::ScopedTimer timer(util::ProfileStage::ENCODE);
+		std::stringstream ss;
+		if ((png && !image.writePNG(ss))
+				|| (!png && !image.writeJPEG(ss, jpeg_quality, background))) {
+			std::cout << "Unable to encode tile " << tile.toString() << std::endl;
+			return;
+		}
+		data = ss.str();
+	}
+	stats.encode_time += getElapsedSeconds(encode_start);
+	if (tile.getDepth() != render_context.tile_set->getDepth())
+		stats.composite_tiles++;
 
-	config::Color bg = render_context.background_color;
-	if (!png && !image.writeJPEG(file.string(),
-			render_context.map_config.getJPEGQuality(), rgba(bg.red, bg.green, bg.blue, 255)))
-		std::cout << "Unable to write " << file.string() << std::endl;
+	auto write_start = std::chrono::steady_clock::now();
+	util::ScopedTimer timer(util::ProfileStage::WRITE);
+	if (out.tile_pack) {
+		if (!out.tile_pack->writeTile(tile, data))
+			std::cout << "Unable to write tile " << tile.toString() << " to the tile pack"
+					<< std::endl;
+	} else {
+		std::string suffix = std::string(".") + out.map_config.getImageFormatSuffix();
+		std::string filename = tile.toString() + suffix;
+		if (tile.getDepth() == 0)
+			filename = std::string("base") + suffix;
+		fs::path file = out.output_dir / filename;
+		if (!fs::exists(file.branch_path()))
+			fs::create_directories(file.branch_path());
+
+		std::ofstream stream(file.string().c_str(), std::ios::binary);
+		stream.write(data.data(), data.size());
+		stream.close();
+		if (!stream)
+			std::cout << "Unable to write " << file.string() << std::endl;
+	}
+	stats.write_time += getElapsedSeconds(write_start);
+	stats.bytes_written += data.size();
+}
+
+bool TileRenderWorker::loadTile(const TilePath& tile, RGBAImage& image, int output) {
+	const RenderOutput& out = outputs[output];
+	bool png = out.map_config.getImageFormat() == config::ImageFormat::PNG;
+	if (out.tile_pack) {
+		std::string data;
+		if (!out.tile_pack->readTile(tile, data))
+			return false;
+		std::istringstream ss(data);
+		return png ? image.readPNG(ss) : image.readJPEG(ss);
+	}
+
+	fs::path file = out.output_dir
+			/ (tile.toString() + "." + out.map_config.getImageFormatSuffix());
+	return png ? image.readPNG(file.string()) : image.readJPEG(file.string());
 }
 
-void TileRenderWorker::renderRecursive(const TilePath& tile, RGBAImage& image) {
+bool TileRenderWorker::renderRecursive(const TilePath& tile, std::vector<RGBAImage>& images,
+		bool force) {
+	images.resize(outputs.size());
+	bool skip = render_work.tiles_skip.count(tile);
 	// if this is tile is not required or we should skip it, try to load it from file
-	if (!render_context.tile_set->isTileRequired(tile)
-			|| render_work.tiles_skip.count(tile)) {
-		bool png = render_context.map_config.getImageFormat() == config::ImageFormat::PNG;
-		fs::path file = render_context.output_dir
-				/ (tile.toString() + "." + render_context.map_config.getImageFormatSuffix());
-		if ((png && image.readPNG(file.string()))
-				|| (!png && image.readJPEG(file.string()))) {
-			if (render_work.tiles_skip.count(tile))
+	if (!force && (!render_context.tile_set->isTileRequired(tile) || skip)) {
+		bool loaded = true;
+		for (size_t i = 0; i < outputs.size() && loaded; i++)
+			loaded = loadTile(tile, images[i], i);
+		if (loaded) {
+			if (skip)
 				progress->setValue(progress->getValue()
 						+ render_context.tile_set->getContainingRenderTiles(tile));
-			return;
+			return skip && render_work.tiles_skip_changed.count(tile);
 		}
 
 		std::cout << "Unable to read tile " << tile.toString();
 		std::cout << ", I will just render it again." << std::endl;
+		force = true;
 	}
 
 	if (tile.getDepth() == render_context.tile_set->getDepth()) {
 		// this tile is a render tile, render it
+		auto render_start = std::chrono::steady_clock::now();
 		renderer.renderTile(tile.getTilePos(),
-				render_context.tile_set->getTileOffset(), image);
+				render_context.tile_set->getTileOffset(), images);
+		stats.render_time += getElapsedSeconds(render_start);
+		stats.render_tiles++;
 		render_work_result.tiles_rendered++;
 
 		/*
@@ -106,42 +174,81 @@ void TileRenderWorker::renderRecursive(const TilePath& tile, RGBAImage& image) {
 			}
 		*/
 
-		// save it
-		saveTile(tile, image);
+		// check whether the images are pixel-identical to the already rendered ones,
+		// and save the changed ones
+		bool changed = false;
+		for (size_t i = 0; i < outputs.size(); i++) {
+			bool image_changed = true;
+			if (outputs[i].tile_manifest) {
+				uint64_t hash = images[i].hash();
+				image_changed = force
+						|| outputs[i].tile_manifest->getTileHash(tile.getTilePos()) != hash;
+				outputs[i].tile_manifest->setTileHash(tile.getTilePos(), hash);
+			}
+			if (image_changed)
+				saveTile(tile, images[i], i);
+			changed = changed || image_changed;
+		}
+		if (!changed) {
+			render_work_result.tiles_unchanged++;
+			stats.render_tiles_unchanged++;
+		}
 
 		// update progress
 		progress->setValue(progress->getValue() + 1);
-	} else {
-		// this tile is a composite tile, we need to compose it from its children
-		// just check, if children 1, 2, 3, 4 exists, render it, resize it to the half size
-		// and blit it to the properly position
-		int size = render_context.map_config.getTextureSize() * 32 * TILE_WIDTH;
+		flushStats();
+		return changed;
+	}
+
+	// this tile is a composite tile, we need to compose it from its children:
+	// at first render the required children, if none of them was changed this tile
+	// doesn't change either
+	// the children are rendered along the Hilbert curve, so successive render tiles
+	// are neighbors and the chunks they need are mostly still in the world cache
+	std::vector<RGBAImage> children[4];
+	bool changed = force;
+	int order[4] = {0, 1, 2, 3};
+	uint64_t hilbert[4];
+	for (int i = 0; i < 4; i++)
+		hilbert[i] = (tile + (i + 1)).getHilbertCode();
+	std::sort(order, order + 4, [&hilbert](int a, int b) {
+		return hilbert[a] < hilbert[b];
+	});
+	for (int j = 0; j < 4; j++) {
+		int i = order[j];
+		TilePath child = tile + (i + 1);
+		children[i].resize(outputs.size());
+		if (render_context.tile_set->hasTile(child)
+				&& render_context.tile_set->isTileRequired(child))
+			changed = renderRecursive(child, children[i]) || changed;
+	}
+	if (!changed)
+		return false;
+
+	// then load the other children, resize them to the half size
+	// and blit them to the properly position
+	for (size_t output = 0; output < outputs.size(); output++) {
+		RGBAImage& image = images[output];
+		int size = outputs[output].map_config.getTextureSize() * 32 * TILE_WIDTH;
 		image.setSize(size, size);
 
-		RGBAImage other;
 		RGBAImage resized;
-		if (render_context.tile_set->hasTile(tile + 1)) {
-			renderRecursive(tile + 1, other);
-			other.resizeHalf(resized);
-			image.simpleblit(resized, 0, 0);
-			other.clear();
-		}
-		if (render_context.tile_set->hasTile(tile + 2)) {
-			renderRecursive(tile + 2, other);
-			other.resizeHalf(resized);
-			image.simpleblit(resized, size / 2, 0);
-			other.clear();
-		}
-		if (render_context.tile_set->hasTile(tile + 3)) {
-			renderRecursive(tile + 3, other);
-			other.resizeHalf(resized);
-			image.simpleblit(resized, 0, size / 2);
-			other.clear();
-		}
-		if (render_context.tile_set->hasTile(tile + 4)) {
-			renderRecursive(tile + 4, other);
-			other.resizeHalf(resized);
-			image.simpleblit(resized, size / 2, size / 2);
+		for (int i = 0; i < 4; i++) {
+			TilePath child = tile + (i + 1);
+			if (!render_context.tile_set->hasTile(child))
+				continue;
+			if (children[i][output].getWidth() == 0
+					&& !loadTile(child, children[i][output], output)) {
+				std::cout << "Unable to read tile " << child.toString();
+				std::cout << ", I will just render it again." << std::endl;
+				renderRecursive(child, children[i], true);
+			}
+			{
+				util::ScopedTimer timer(util::ProfileStage::DOWNSAMPLE);
+				children[i][output].resizeHalf(resized);
+			}
+			util::ScopedTimer timer(util::ProfileStage::BLIT);
+			image.simpleblit(resized, i % 2 == 0 ? 0 : size / 2, i < 2 ? 0 : size / 2);
 		}
 
 		/*
@@ -156,16 +263,38 @@ void TileRenderWorker::renderRecursive(const TilePath& tile, RGBAImage& image) {
 		*/
 
 		// then save the tile
-		saveTile(tile, image);
+		saveTile(tile, image, output);
 	}
+	return true;
+}
+
+void TileRenderWorker::flushStats() {
+	if (!render_context.metrics)
+		return;
+	// the statistics of the world cache are cumulative, add only the new ones
+	if (world_cache) {
+		stats.region_cache = world_cache->getRegionCacheStats() - region_cache_reported;
+		stats.chunk_cache = world_cache->getChunkCacheStats() - chunk_cache_reported;
+		region_cache_reported = world_cache->getRegionCacheStats();
+		chunk_cache_reported = world_cache->getChunkCacheStats();
+	}
+	render_context.metrics->addTileRenderStats(stats);
+	stats = TileRenderStats();
 }
 
 void TileRenderWorker::operator()() {
-	// TODO
-	// really create world cache here?
-	std::shared_ptr<mc::WorldCache> world_cache(new mc::WorldCache(render_context.world));
-	renderer = TileRenderer(world_cache, render_context.block_images,
-			render_context.world_config, render_context.map_config);
+	// the world cache is kept for all render work of this worker, so the chunks
+	// shared with the tiles of the previous render work don't need to be loaded again
+	if (!world_cache) {
+		world_cache.reset(new mc::WorldCache(render_context.world));
+		world_cache->setRegionPrefetcher(render_context.region_prefetcher);
+		region_cache_reported = mc::CacheStats();
+		chunk_cache_reported = mc::CacheStats();
+		renderer = TileRenderer(world_cache, render_context.block_images,
+				render_context.world_config, render_context.map_config);
+		for (size_t i = 1; i < outputs.size(); i++)
+			renderer.addOutput(render_context.world_config, outputs[i].map_config);
+	}
 	
 	int work = 0;
 	for (auto it = render_work.tiles.begin(); it != render_work.tiles.end(); ++it)
@@ -174,16 +303,18 @@ void TileRenderWorker::operator()() {
 	progress->setValue(0);
 	*finished = false;
 	
-	RGBAImage image;
+	std::vector<RGBAImage> images;
 	// iterate through the start composite tiles
 	for (auto it = render_work.tiles.begin(); it != render_work.tiles.end(); ++it) {
 		// render this composite tile
-		renderRecursive(*it, image);
+		if (renderRecursive(*it, images))
+			render_work_result.tiles_changed.insert(*it);
 
-		// clear image
-		image.clear();
+		// clear images
+		images.clear();
 	}
 
+	flushStats();
 	*finished = true;
 }
 
@@ -21,9 +21,13 @@
 #define TILERENDERWORKER_H_
 
 #include "blockimages.h"
+#include "rendermetrics.h"
 #include "tilerenderer.h"
+#include "tilemanifest.h"
+#include "tilepack.h"
 #include "tileset.h"
 #include "../config/mapcrafterconfig.h"
+#include "../mc/regionprefetcher.h"
 #include "../mc/world.h"
 #include "../mc/worldcache.h"
 #include "../renderer/blockimages.h"
@@ -32,6 +36,7 @@
 
 #include <memory> // shared_ptr
 #include <set>
+#include <vector>
 #include <boost/filesystem.hpp>
 
 namespace fs = boost::filesystem;
@@ -39,7 +44,21 @@ namespace fs = boost::filesystem;
 namespace mapcrafter {
 namespace renderer {
 
+/**
+ * A map the tile render workers write tile images to.
+ */
+struct RenderOutput {
+	fs::path output_dir;
+	config::MapSection map_config;
+	// if set, the tile images are stored in this tile pack instead of the output directory
+	std::shared_ptr<renderer::TilePack> tile_pack;
+	// the image hashes of the render tiles, see RenderContext::tile_manifest
+	std::shared_ptr<renderer::TileManifest> tile_manifest;
+};
+
 struct RenderContext {
+	RenderContext() : shard_level(-1), shard_merge(false) {}
+
 	fs::path output_dir;
 	config::Color background_color;
 	config::WorldSection world_config;
@@ -48,18 +67,51 @@ struct RenderContext {
 
 	mc::World world;
 	std::shared_ptr<renderer::TileSet> tile_set;
+	// if set, the tile images are stored in this tile pack instead of the output directory
+	std::shared_ptr<renderer::TilePack> tile_pack;
+	// the image hashes of the render tiles, if set, render tiles whose images did not
+	// change are not written again and don't cause their parent tiles to be composed
+	std::shared_ptr<renderer::TileManifest> tile_manifest;
+	// other maps which are rendered together with this map: their render tiles are drawn
+	// from the visible blocks of the render tiles of this map, so the maps must be able to
+	// share them (see TileRenderer::canShareVisibleBlocks) and must have the same world,
+	// rotation and required tiles
+	std::vector<RenderOutput> extra_outputs;
+	// if set, the workers add their statistics to these metrics
+	std::shared_ptr<renderer::RenderMetrics> metrics;
+	// if set, the world caches of the workers take the regions from this prefetcher
+	std::shared_ptr<mc::RegionPrefetcher> region_prefetcher;
+
+	// the zoom level the tile set was sharded at (-1 if the rendering is not sharded):
+	// a shard renders only the subtrees of the required tiles of this zoom level, the
+	// merge pass (shard_merge) composes only the tiles above from the rendered ones
+	int shard_level;
+	bool shard_merge;
+
+	// if not empty, the render tiles around these tiles (positions in the tile set)
+	// are rendered first and the composite tiles above them are composed as soon as
+	// possible, so the map is usable there long before the rendering is finished
+	std::vector<renderer::TilePos> priority_tiles;
 };
 
 struct RenderWork {
 	std::set<renderer::TilePath> tiles, tiles_skip;
+	// the skipped tiles whose images were changed when they were rendered
+	std::set<renderer::TilePath> tiles_skip_changed;
+	// the regions the render tiles need, used to prefetch them
+	std::vector<mc::RegionPos> regions;
 };
 
 struct RenderWorkResult {
-	RenderWorkResult() : tiles_rendered(0) {}
+	RenderWorkResult() : tiles_rendered(0), tiles_unchanged(0) {}
 
 	RenderWork render_work;
+	// the tiles of the render work whose images were changed
+	std::set<renderer::TilePath> tiles_changed;
 
 	int tiles_rendered;
+	// count of rendered render tiles which were pixel-identical to the old ones
+	int tiles_unchanged;
 };
 
 class TileRenderWorker {
@@ -74,13 +126,36 @@ public:
 	void setProgressHandler(std::shared_ptr<util::IProgressHandler> progress,
 			std::shared_ptr<bool> finished = std::shared_ptr<bool>(new bool));
 
-	void saveTile(const TilePath& tile, const RGBAImage& image);
-	void renderRecursive(const TilePath& path, RGBAImage& image);
+	/**
+	 * Saves/loads the image of a tile of an output (0 is the map of the render context,
+	 * the others are its extra outputs).
+	 */
+	void saveTile(const TilePath& tile, const RGBAImage& image, int output = 0);
+	bool loadTile(const TilePath& tile, RGBAImage& image, int output = 0);
+	/**
+	 * Renders a tile recursively and returns whether its image was changed (and
+	 * written). The images of the tile are stored in the images vector, one image per
+	 * output. The images of an unchanged composite tile are not composed, so they are
+	 * empty then and must be loaded if they are required. The force parameter makes sure
+	 * that a tile is rendered and written even if it is not required or unchanged.
+	 *
+	 * If there are multiple outputs, a tile is changed if one of its images was changed.
+	 * All images of a changed composite tile are composed and written then.
+	 */
+	bool renderRecursive(const TilePath& path, std::vector<RGBAImage>& images,
+			bool force = false);
 
 	void operator()();
 
 private:
+	/**
+	 * Adds the collected statistics to the render metrics (if available).
+	 */
+	void flushStats();
+
 	RenderContext render_context;
+	// the map of the render context and its extra outputs
+	std::vector<RenderOutput> outputs;
 	RenderWork render_work;
 	RenderWorkResult render_work_result;
 
@@ -88,7 +163,12 @@ private:
 	std::shared_ptr<util::IProgressHandler> progress;
 	std::shared_ptr<bool> finished;
 
+	std::shared_ptr<mc::WorldCache> world_cache;
 	TileRenderer renderer;
+
+	// statistics not yet added to the render metrics
+	TileRenderStats stats;
+	mc::CacheStats region_cache_reported, chunk_cache_reported;
 };
 
 } /* namespace render */
@@ -19,6 +19,9 @@
 
 #include "tileset.h"
 
+#include "scanindex.h"
+#include "tilemanifest.h"
+
 #include "../mc/pos.h"
 #include "../util.h"
 
@@ -82,126 +85,159 @@ bool TilePos::operator<(const TilePos& other) const {
 	return x < other.x;
 }
 
-TilePath::TilePath() {
+// the lowest bits of the packed path are the zoom level
+const int TILEPATH_DEPTH_BITS = 6;
+const uint64_t TILEPATH_DEPTH_MASK = (1ULL << TILEPATH_DEPTH_BITS) - 1;
+
+TilePath::TilePath()
+	: data(0) {
 }
 
 TilePath::TilePath(const std::vector<int>& path)
-	: path(path) {
+	: data(0) {
+	for (size_t i = 0; i < path.size(); i++)
+		*this += path[i];
 }
 
 TilePath::~TilePath() {
 }
 
 int TilePath::getDepth() const {
-	return path.size();
+	return data & TILEPATH_DEPTH_MASK;
 }
 
-const std::vector<int>& TilePath::getPath() const {
+std::vector<int> TilePath::getPath() const {
+	std::vector<int> path;
+	int depth = getDepth();
+	for (int i = 0; i < depth; i++)
+		path.push_back(((data >> (62 - 2*i)) & 3) + 1);
 	return path;
 }
 
 TilePath TilePath::parent() const {
-	TilePath copy(path);
-	copy.path.pop_back();
+	int depth = getDepth();
+	if (depth == 0)
+		return *this;
+	// remove the last part and decrease the zoom level
+	TilePath copy;
+	copy.data = (data & ~TILEPATH_DEPTH_MASK & ~(3ULL << (62 - 2*(depth-1)))) | (depth - 1);
 	return copy;
 }
 
 TilePos TilePath::getTilePos() const {
-	// calculate the radius of all tiles on the top zoom level (2^zoomlevel / 2)
-	int radius = pow(2, path.size()) / 2;
-	// the startpoint is top left
-	int x = -radius;
-	int y = -radius;
-	for (size_t i = 0; i < path.size(); i++) {
-		// now for every zoom level:
-		// get the current tile
-		int tile = path[i];
-		// increase x by the radius if this tile is on the right side (2 or 4)
-		if (tile == 2 || tile == 4)
-			x += radius;
-		// increase y by the radius if this tile is on the bottom side (3 or 4)
-		if (tile == 3 || tile == 4)
-			y += radius;
-		// divide size by two, because the next zoom level has only the half radius
-		radius /= 2;
+	// the parts of the path are the bits of the tile position
+	// relative to the top left corner of the quadtree:
+	// part - 1 = (x bit) + 2 * (y bit), beginning with the highest bits
+	int depth = getDepth();
+	uint64_t code = getCode();
+	int x = 0;
+	int y = 0;
+	for (int i = depth - 1; i >= 0; i--) {
+		x = (x << 1) | ((code >> (2*i)) & 1);
+		y = (y << 1) | ((code >> (2*i + 1)) & 1);
 	}
-	return TilePos(x, y);
+	// the top left corner is -radius, -radius (radius = 2^zoomlevel / 2)
+	int radius = (1 << depth) / 2;
+	return TilePos(x - radius, y - radius);
 }
 
 TilePath TilePath::byTilePos(const TilePos& tile, int depth) {
-	TilePath path;
-
 	// at first calculate the radius in tiles of this zoom level
-	int radius = pow(2, depth) / 2;
+	int radius = (1 << depth) / 2;
 	// check if the tile is in this bounds
-	if (tile.getX() > radius  || tile.getY() > radius
+	if (depth > MAX_DEPTH || tile.getX() > radius  || tile.getY() > radius
 			|| tile.getX() < -radius || tile.getY() < -radius)
 		throw std::runtime_error("Invalid tile position " + util::str(tile.getX())
 			+ ":" + util::str(tile.getY()) + " on depth " + util::str(depth));
-	// the tactic is here to calculate the bounds where the tile is inside
-	int bounds_left = -radius;
-	int bounds_right = radius;
-	int bounds_top = radius;
-	int bounds_bottom = -radius;
-
-	for (int level = 1; level <= depth; level++) {
-		// for each zoom level (but we already have the 1st zoom level):
-		// calculate the midpoint in the bounds
-		int middle_x = (bounds_right + bounds_left) / 2;
-		int middle_y = (bounds_top + bounds_bottom) / 2;
-		// with this midpoint we can decide what the next part in the path is
-		// when tile x < midpoint x:
-		//   and tile y < midpoint y -> top left tile
-		//   and tile y >= midpoint y -> bottom left tile
-		// when tile y >= midpoint y:
-		//   and tile y < midpoint y -> top right tile
-		//   and tile y >= midpoint y -> bottom right tile
-
-		// if we have a midpoint, we update the bounds with the midpoint
-		// the (smaller) bounds are now the part of the path, we found out
-		if (tile.getX() < middle_x) {
-			if (tile.getY() < middle_y) {
-				path += 1;
-				bounds_right = middle_x;
-				bounds_top = middle_y;
-			} else {
-				path += 3;
-				bounds_right = middle_x;
-				bounds_bottom = middle_y;
-			}
-		} else {
-			if (tile.getY() < middle_y) {
-				path += 2;
-				bounds_left = middle_x;
-				bounds_top = middle_y;
-			} else {
-				path += 4;
-				bounds_left = middle_x;
-				bounds_bottom = middle_y;
+
+	// calculate the position relative to the top left corner of the quadtree,
+	// tiles on the right/bottom border belong to the tiles left/above of them
+	int size = 1 << depth;
+	uint64_t x = std::min(tile.getX() + radius, size - 1);
+	uint64_t y = std::min(tile.getY() + radius, size - 1);
+	// and interleave the bits of the coordinates to get the parts of the path
+	uint64_t code = 0;
+	for (int i = depth - 1; i >= 0; i--)
+		code = (code << 2) | (((y >> i) & 1) << 1) | ((x >> i) & 1);
+	return byCode(code, depth);
+}
+
+uint64_t TilePath::getCode() const {
+	int depth = getDepth();
+	if (depth == 0)
+		return 0;
+	return data >> (64 - 2*depth);
+}
+
+TilePath TilePath::byCode(uint64_t code, int depth) {
+	if (depth < 0 || depth > MAX_DEPTH)
+		throw std::runtime_error("Invalid tile path depth " + util::str(depth));
+	TilePath path;
+	if (depth != 0)
+		path.data = ((code & ((1ULL << (2*depth)) - 1)) << (64 - 2*depth)) | depth;
+	return path;
+}
+
+uint64_t TilePath::getHilbertCode() const {
+	int depth = getDepth();
+	uint64_t code = getCode();
+	uint32_t x = 0, y = 0;
+	for (int i = depth - 1; i >= 0; i--) {
+		x = (x << 1) | ((code >> (2*i)) & 1);
+		y = (y << 1) | ((code >> (2*i + 1)) & 1);
+	}
+
+	// go through the quadrants from the biggest to the smallest one,
+	// the quadrants of a level are visited in the order (0, 0) (0, 1) (1, 1) (1, 0),
+	// the coordinates are rotated/flipped so the curve continues in the sub quadrants
+	uint64_t hilbert = 0;
+	uint32_t n = 1U << depth;
+	for (uint32_t s = n / 2; s > 0; s /= 2) {
+		uint32_t rx = (x & s) ? 1 : 0;
+		uint32_t ry = (y & s) ? 1 : 0;
+		hilbert += (uint64_t) s * s * ((3 * rx) ^ ry);
+		if (ry == 0) {
+			if (rx == 1) {
+				x = n - 1 - x;
+				y = n - 1 - y;
 			}
+			std::swap(x, y);
 		}
 	}
-
-	return path;
+	return hilbert;
 }
 
 TilePath& TilePath::operator+=(int node) {
-	path.push_back(node);
+	int depth = getDepth();
+	if (depth >= MAX_DEPTH)
+		throw std::runtime_error("Tile path exceeds the maximum depth "
+				+ util::str(MAX_DEPTH));
+	data = (data & ~TILEPATH_DEPTH_MASK) | ((uint64_t) (node - 1) << (62 - 2*depth))
+			| (depth + 1);
 	return *this;
 }
 
 TilePath TilePath::operator+(int node) const {
-	TilePath copy(path);
-	copy.path.push_back(node);
-	return copy;
+	TilePath copy = *this;
+	return copy += node;
 }
 
 bool TilePath::operator==(const TilePath& other) const {
-	return path == other.path;
+	return data == other.data;
+}
+
+bool TilePath::operator!=(const TilePath& other) const {
+	return data != other.data;
 }
 
 bool TilePath::operator<(const TilePath& other) const {
-	return path < other.path;
+	return data < other.data;
+}
+
+size_t TilePath::hash() const {
+	// mix the bits, the lowest bits of the packed path are mostly the same
+	uint64_t h = data * 0x9e3779b97f4a7c15ULL;
+	return h ^ (h >> 32);
 }
 
 std::ostream& operator<<(std::ostream& stream, const TilePos& tile) {
@@ -215,21 +251,31 @@ std::ostream& operator<<(std::ostream& stream, const TilePath& path) {
 }
 
 std::string TilePath::toString() const {
-	std::stringstream ss;
-	for (size_t i = 0; i < path.size(); i++) {
-		ss << path[i];
-		if (i != path.size() - 1)
-			ss << "/";
+	char buffer[STRING_BUFFER_SIZE];
+	int length = toString(buffer);
+	return std::string(buffer, length);
+}
+
+int TilePath::toString(char* buffer) const {
+	int depth = getDepth();
+	char* ptr = buffer;
+	for (int i = 0; i < depth; i++) {
+		if (i != 0)
+			*ptr++ = '/';
+		*ptr++ = '1' + ((data >> (62 - 2*i)) & 3);
 	}
-	return ss.str();
+	*ptr = '\0';
+	return ptr - buffer;
 }
 
 TileSet::TileSet()
-	: min_depth(0), depth(0) {
+	: min_depth(0), depth(0), required_render_tiles_count(0),
+	  required_composite_tiles_count(0) {
 }
 
 TileSet::TileSet(const mc::World& world)
-	: min_depth(0), depth(0) {
+	: min_depth(0), depth(0), required_render_tiles_count(0),
+	  required_composite_tiles_count(0) {
 	scan(world);
 }
 
@@ -261,9 +307,6 @@ void addRowColTiles(int row, int col, std::set<TilePos>& tiles) {
 		tiles.insert(TilePos(x-1, y-1));
 }
 
-/**
- * This function calculates the tiles a chunk covers.
- */
 void getChunkTiles(const mc::ChunkPos& chunk, std::set<TilePos>& tiles) {
 	// at first get row and column of the top of the chunk
 	int row = chunk.getRow();
@@ -280,11 +323,43 @@ void getChunkTiles(const mc::ChunkPos& chunk, std::set<TilePos>& tiles) {
 		addRowColTiles(row + 2*i, col, tiles);
 }
 
-void TileSet::findRenderTiles(const mc::World& world, bool auto_center,
+void getTileChunks(const TilePos& tile, std::set<mc::ChunkPos>& chunks) {
+	// go through the rows and columns around the tile which cover it (the tiles are
+	// 2 * TILE_WIDTH columns wide and 4 * TILE_WIDTH rows tall), and add the chunks
+	// which have the top of one of their sections in these rows/columns
+	int col_min = 2 * TILE_WIDTH * tile.getX() - 2, col_max = col_min + 2 * TILE_WIDTH + 4;
+	int row_min = 4 * TILE_WIDTH * tile.getY() - 4, row_max = row_min + 4 * TILE_WIDTH + 8;
+	for (int col = col_min; col <= col_max; col++)
+		for (int row = row_min; row <= row_max; row++) {
+			std::set<TilePos> tiles;
+			addRowColTiles(row, col, tiles);
+			if (!tiles.count(tile))
+				continue;
+			// row and column of a chunk are always both even or odd
+			for (int i = 0; i <= mc::CHUNK_HEIGHT; i++)
+				if (((row - 2*i + col) & 1) == 0)
+					chunks.insert(mc::ChunkPos::byRowCol(row - 2*i, col));
+		}
+}
+
+void getChunkSectionTiles(const mc::ChunkPos& chunk, int section,
+		std::set<TilePos>& tiles) {
+	int row = chunk.getRow();
+	int col = chunk.getCol();
+
+	// like above: the top of the highest section is the top of the chunk,
+	// the bottom of a section is the top of the section below
+	int top = mc::CHUNK_HEIGHT - 1 - section;
+	addRowColTiles(row + 2*top, col, tiles);
+	addRowColTiles(row + 2*(top+1), col, tiles);
+}
+
+void TileSet::findRenderTiles(const WorldScanIndex& index, bool auto_center,
 		TilePos& tile_offset) {
 	// clear maybe already calculated tiles
 	render_tiles.clear();
-	required_render_tiles.clear();
+	render_tiles_timestamps.clear();
+	render_tiles_required.clear();
 
 	// the min/max x/y coordinates of the tiles in the world
 	int tiles_x_min = std::numeric_limits<int>::max(),
@@ -292,70 +367,37 @@ void TileSet::findRenderTiles(const mc::World& world, bool auto_center,
 	    tiles_y_min = std::numeric_limits<int>::max(),
 	    tiles_y_max = std::numeric_limits<int>::min();
 
-	// go through all chunks in the world
-	auto regions = world.getAvailableRegions();
-	for (auto region_it = regions.begin(); region_it != regions.end(); ++region_it) {
-		mc::RegionFile region;
-		if (!world.getRegion(*region_it, region) || !region.readOnlyHeaders())
-			continue;
-		const std::set<mc::ChunkPos>& region_chunks = region.getContainingChunks();
-		for (auto chunk_it = region_chunks.begin(); chunk_it != region_chunks.end();
-		        ++chunk_it) {
-			int timestamp = region.getChunkTimestamp(*chunk_it);
-
-			// now get all tiles of the chunk
-			std::set<TilePos> tiles;
-			getChunkTiles(*chunk_it, tiles);
-			for (std::set<TilePos>::const_iterator tile_it = tiles.begin();
-			        tile_it != tiles.end(); ++tile_it) {
-
-				// and update the bounds
-				tiles_x_min = std::min(tiles_x_min, tile_it->getX());
-				tiles_x_max = std::max(tiles_x_max, tile_it->getX());
-				tiles_y_min = std::min(tiles_y_min, tile_it->getY());
-				tiles_y_max = std::max(tiles_y_max, tile_it->getY());
-
-				// update tile timestamp
-				if (!render_tiles.count(*tile_it))
-					tile_timestamps[*tile_it] = timestamp;
-				else
-					tile_timestamps[*tile_it] = std::max(tile_timestamps[*tile_it], timestamp);
-
-				// insert the tile to the set of available render tiles
-				// and also make it required by default
-				render_tiles.insert(*tile_it);
-				required_render_tiles.insert(*tile_it);
-			}
-		}
+	// go through all tiles of the scanned world and update the bounds
+	const std::map<TilePos, int>& timestamps = index.getTileTimestamps();
+	for (auto it = timestamps.begin(); it != timestamps.end(); ++it) {
+		tiles_x_min = std::min(tiles_x_min, it->first.getX());
+		tiles_x_max = std::max(tiles_x_max, it->first.getX());
+		tiles_y_min = std::min(tiles_y_min, it->first.getY());
+		tiles_y_max = std::max(tiles_y_max, it->first.getY());
 	}
 
-	// center tiles
-	if (auto_center || tile_offset != TilePos(0, 0)) {
-		// find a tile center if we should do it automatically
-		if (auto_center)
-			tile_offset = TilePos((tiles_x_min + tiles_x_max) / 2, (tiles_y_min + tiles_y_max) / 2);
-
-		// update all tile positions
-		std::set<TilePos> render_tiles_tmp, required_render_tiles_tmp;
-		std::map<TilePos, int> tile_timestamps_tmp;
-		for (auto it = render_tiles.begin(); it != render_tiles.end(); ++it)
-			render_tiles_tmp.insert(*it - tile_offset);
-		for (auto it = required_render_tiles.begin(); it != required_render_tiles.end(); ++it)
-			required_render_tiles_tmp.insert(*it - tile_offset);
-		for (auto it = tile_timestamps.begin(); it != tile_timestamps.end(); ++it)
-			tile_timestamps_tmp[it->first - tile_offset] = it->second;
-
-		render_tiles = render_tiles_tmp;
-		required_render_tiles = required_render_tiles_tmp;
-		tile_timestamps = tile_timestamps_tmp;
-		this->tile_offset = tile_offset;
+	// find a tile center if we should do it automatically
+	if (auto_center)
+		tile_offset = TilePos((tiles_x_min + tiles_x_max) / 2, (tiles_y_min + tiles_y_max) / 2);
+	this->tile_offset = tile_offset;
+
+	// insert the (centered) tiles to the available render tiles
+	// and also make them required by default,
+	// the order of the tiles stays the same, so they are still sorted
+	render_tiles.reserve(timestamps.size());
+	render_tiles_timestamps.reserve(timestamps.size());
+	for (auto it = timestamps.begin(); it != timestamps.end(); ++it) {
+		render_tiles.push_back(it->first - tile_offset);
+		render_tiles_timestamps.push_back(it->second);
 	}
+	render_tiles_required.assign(render_tiles.size(), true);
+	required_render_tiles_count = render_tiles.size();
 
 	// now get the necessary depth of the tile quadtree
-	for (min_depth = 0; min_depth < 32; min_depth++) {
+	for (min_depth = 0; min_depth < TilePath::MAX_DEPTH; min_depth++) {
 		// for each level calculate the radius and check if the tiles fit in this bounds
 		// also don't forget the tile offset
-		int radius = pow(2, min_depth) / 2;
+		int radius = (1 << min_depth) / 2;
 		if (tiles_x_min - tile_offset.getX() > -radius
 				&& tiles_x_max - tile_offset.getX() < radius
 				&& tiles_y_min - tile_offset.getY() > -radius
@@ -364,42 +406,91 @@ void TileSet::findRenderTiles(const mc::World& world, bool auto_center,
 	}
 }
 
-void TileSet::findRequiredCompositeTiles(const std::set<TilePos>& render_tiles,
-		std::set<TilePath>& tiles) {
+int TileSet::findRenderTile(const TilePos& tile) const {
+	auto it = std::lower_bound(render_tiles.begin(), render_tiles.end(), tile);
+	if (it == render_tiles.end() || *it != tile)
+		return -1;
+	return it - render_tiles.begin();
+}
+
+int TileSet::findCompositeTile(const TilePath& tile) const {
+	if (tile.getDepth() >= depth)
+		return -1;
+	const std::vector<uint64_t>& codes = composite_levels[tile.getDepth()].codes;
+	uint64_t code = tile.getCode();
+	auto it = std::lower_bound(codes.begin(), codes.end(), code);
+	if (it == codes.end() || *it != code)
+		return -1;
+	return it - codes.begin();
+}
 
-	// iterate through the render tiles on the max zoom level
-	// add their parent composite tiles
-	for (std::set<TilePos>::iterator it = render_tiles.begin(); it != render_tiles.end(); ++it) {
-		TilePath path = TilePath::byTilePos(*it, depth);
-		tiles.insert(path.parent());
+void TileSet::updateCompositeTiles() {
+	composite_levels.clear();
+	composite_levels.resize(depth);
+	if (depth == 0) {
+		updateContainingRenderTiles();
+		return;
 	}
 
-	// now iterate through the composite tiles from bottom to top
-	// and also add their parent composite tiles
+	// the composite tiles of the lowest composite zoom level are the parents of the
+	// render tiles, their sorted codes are the unique render tile codes >> 2
+	std::vector<uint64_t> codes;
+	codes.reserve(render_tiles.size());
+	for (auto it = render_tiles.begin(); it != render_tiles.end(); ++it)
+		codes.push_back(TilePath::byTilePos(*it, depth).getCode() >> 2);
+	std::sort(codes.begin(), codes.end());
+	codes.erase(std::unique(codes.begin(), codes.end()), codes.end());
+	composite_levels[depth - 1].codes.swap(codes);
+
+	// then go through the zoom levels from bottom to top,
+	// the codes are sorted, so the parent codes are sorted as well
 	for (int d = depth - 1; d > 0; d--) {
-		std::set<TilePath> tmp;
-		for (std::set<TilePath>::iterator it = tiles.begin(); it != tiles.end(); ++it) {
-			if (it->getDepth() == d)
-				tmp.insert(it->parent());
-		}
-		for (std::set<TilePath>::iterator it = tmp.begin(); it != tmp.end(); ++it)
-			tiles.insert(*it);
+		const std::vector<uint64_t>& children = composite_levels[d].codes;
+		std::vector<uint64_t>& parents = composite_levels[d - 1].codes;
+		for (auto it = children.begin(); it != children.end(); ++it)
+			if (parents.empty() || parents.back() != (*it >> 2))
+				parents.push_back(*it >> 2);
 	}
+
+	updateContainingRenderTiles();
 }
 
 void TileSet::updateContainingRenderTiles() {
-	containing_render_tiles.clear();
 	// initialize every composite tile with 0
-	for (auto it = composite_tiles.begin(); it != composite_tiles.end(); ++it)
-		containing_render_tiles[*it] = 0;
+	for (auto it = composite_levels.begin(); it != composite_levels.end(); ++it)
+		it->containing_render_tiles.assign(it->codes.size(), 0);
+	required_composite_tiles_count = 0;
+	if (depth == 0)
+		return;
+
 	// go through all required render tiles
-	// set the containing render tiles for every parent composite tile +1
-	// to have the number of required render tiles in every composite tile
-	for (auto it = required_render_tiles.begin(); it != required_render_tiles.end(); ++it) {
-		TilePath tile = TilePath::byTilePos(*it, depth);
-		while (tile.getDepth() != 0) {
-			tile = tile.parent();
-			containing_render_tiles[tile]++;
+	// and count them in their parent composite tiles
+	CompositeLevel& bottom = composite_levels[depth - 1];
+	for (size_t i = 0; i < render_tiles.size(); i++) {
+		if (!render_tiles_required[i])
+			continue;
+		uint64_t code = TilePath::byTilePos(render_tiles[i], depth).getCode() >> 2;
+		auto it = std::lower_bound(bottom.codes.begin(), bottom.codes.end(), code);
+		bottom.containing_render_tiles[it - bottom.codes.begin()]++;
+	}
+
+	// then add the counts of every composite tile to its parent,
+	// the parents of the sorted tiles are sorted as well, so we can just walk through
+	// the parent zoom level
+	for (int d = depth - 1; d >= 0; d--) {
+		const CompositeLevel& level = composite_levels[d];
+		for (size_t i = 0; i < level.codes.size(); i++)
+			if (level.containing_render_tiles[i] > 0)
+				required_composite_tiles_count++;
+		if (d == 0)
+			break;
+
+		CompositeLevel& parents = composite_levels[d - 1];
+		size_t j = 0;
+		for (size_t i = 0; i < level.codes.size(); i++) {
+			while (parents.codes[j] != (level.codes[i] >> 2))
+				j++;
+			parents.containing_render_tiles[j] += level.containing_render_tiles[i];
 		}
 	}
 }
@@ -411,39 +502,166 @@ void TileSet::scan(const mc::World& world) {
 }
 
 void TileSet::scan(const mc::World& world, bool auto_center, TilePos& tile_offset) {
-	findRenderTiles(world, auto_center, tile_offset);
-	setDepth(min_depth);
+	WorldScanIndex index(world);
+	index.update();
+	scan(index, auto_center, tile_offset);
 }
 
-void TileSet::scanRequiredByTimestamp(int last_change) {
-	required_render_tiles.clear();
+void TileSet::scan(const WorldScanIndex& index) {
+	TilePos tile_offset(0, 0);
+	scan(index, false, tile_offset);
+}
 
-	for (std::map<TilePos, int>::iterator it = tile_timestamps.begin();
-			it != tile_timestamps.end(); ++it) {
-		if (it->second >= last_change)
-			required_render_tiles.insert(it->first);
-	}
+void TileSet::scan(const WorldScanIndex& index, bool auto_center, TilePos& tile_offset) {
+	findRenderTiles(index, auto_center, tile_offset);
+	depth = min_depth;
+	updateCompositeTiles();
+}
 
-	required_composite_tiles.clear();
-	findRequiredCompositeTiles(required_render_tiles, required_composite_tiles);
+void TileSet::scanRequiredByTimestamp(int last_change) {
+	required_render_tiles_count = 0;
+	for (size_t i = 0; i < render_tiles.size(); i++) {
+		render_tiles_required[i] = render_tiles_timestamps[i] >= last_change;
+		if (render_tiles_required[i])
+			required_render_tiles_count++;
+	}
 
 	updateContainingRenderTiles();
 }
 
 void TileSet::scanRequiredByFiletimes(const fs::path& output_dir,
 		std::string image_format) {
-	required_render_tiles.clear();
-
-	for (std::map<TilePos, int>::iterator it = tile_timestamps.begin();
-			it != tile_timestamps.end(); ++it) {
-		TilePath path = TilePath::byTilePos(it->first, depth);
+	required_render_tiles_count = 0;
+	for (size_t i = 0; i < render_tiles.size(); i++) {
+		TilePath path = TilePath::byTilePos(render_tiles[i], depth);
 		fs::path file = output_dir / (path.toString() + "." + image_format);
-		if (!fs::exists(file) || fs::last_write_time(file) <= it->second)
-			required_render_tiles.insert(it->first);
+		render_tiles_required[i] = !fs::exists(file)
+				|| fs::last_write_time(file) <= render_tiles_timestamps[i];
+		if (render_tiles_required[i])
+			required_render_tiles_count++;
 	}
 
-	required_composite_tiles.clear();
-	findRequiredCompositeTiles(required_render_tiles, required_composite_tiles);
+	updateContainingRenderTiles();
+}
+
+void TileSet::scanRequiredByManifest(const TileManifest& manifest) {
+	required_render_tiles_count = 0;
+	for (size_t i = 0; i < render_tiles.size(); i++) {
+		render_tiles_required[i] = !manifest.hasTile(render_tiles[i])
+				|| manifest.getTile(render_tiles[i]).timestamp <= render_tiles_timestamps[i];
+		if (render_tiles_required[i])
+			required_render_tiles_count++;
+	}
+
+	updateContainingRenderTiles();
+}
+
+void TileSet::scanRequiredByChunkHashes(const mc::World& world,
+		mc::ChunkHashIndex& index) {
+	// an empty index (for example when rendering the first time) is just filled
+	bool fill_only = index.empty();
+
+	// the tiles overlapping sections which changed, and the tiles of adjacent chunks
+	// whose rendering depends on the changed sections
+	std::set<TilePos> changed_tiles, neighbor_tiles;
+	mc::ChunkHashIndex new_index(index.isIncludingLight());
+
+	auto regions = world.getAvailableRegions();
+	for (auto region_it = regions.begin(); region_it != regions.end(); ++region_it) {
+		mc::RegionFile region;
+		if (!world.getRegion(*region_it, region) || !region.readOnlyHeaders())
+			continue;
+
+		// find the chunks which need to get hashed:
+		// the ones which are not in the index and the ones which overlap required tiles
+		std::vector<mc::ChunkPos> chunks;
+		const std::set<mc::ChunkPos>& region_chunks = region.getContainingChunks();
+		for (auto chunk_it = region_chunks.begin(); chunk_it != region_chunks.end();
+				++chunk_it) {
+			if (fill_only || !index.hasChunk(*chunk_it)) {
+				chunks.push_back(*chunk_it);
+				continue;
+			}
+
+			std::set<TilePos> tiles;
+			getChunkTiles(*chunk_it, tiles);
+			bool required = false;
+			for (auto tile_it = tiles.begin(); tile_it != tiles.end(); ++tile_it)
+				if (isRenderTileRequired(*tile_it - tile_offset)) {
+					required = true;
+					break;
+				}
+
+			if (required)
+				chunks.push_back(*chunk_it);
+			else
+				new_index.setChunk(*chunk_it, index.getChunk(*chunk_it));
+		}
+
+		if (chunks.empty())
+			continue;
+		if (!region.read()) {
+			// the region is corrupted, so just leave all its tiles required
+			for (auto chunk_it = chunks.begin(); chunk_it != chunks.end(); ++chunk_it)
+				getChunkTiles(*chunk_it, changed_tiles);
+			continue;
+		}
+
+		for (auto chunk_it = chunks.begin(); chunk_it != chunks.end(); ++chunk_it) {
+			mc::Chunk chunk;
+			if (region.loadChunk(*chunk_it, chunk) != mc::RegionFile::CHUNK_OK) {
+				getChunkTiles(*chunk_it, changed_tiles);
+				continue;
+			}
+
+			mc::ChunkHashes hashes = mc::ChunkHashes::byChunk(chunk,
+					index.isIncludingLight());
+			new_index.setChunk(*chunk_it, hashes);
+
+			// every section is changed if the chunk is new
+			uint16_t changed = 0xffff;
+			if (index.hasChunk(*chunk_it))
+				changed = hashes.compare(index.getChunk(*chunk_it));
+			for (int i = 0; i < mc::CHUNK_HEIGHT; i++) {
+				if (!(changed & (1 << i)))
+					continue;
+				// the rendering of a block depends on the blocks around it (hidden faces,
+				// fences/panes/leaves, water, lighting), so the sections above and below
+				// and the same sections of the adjacent chunks are changed, too
+				for (int j = std::max(i - 1, 0);
+						j <= std::min(i + 1, mc::CHUNK_HEIGHT - 1); j++)
+					getChunkSectionTiles(*chunk_it, j, changed_tiles);
+				int x = chunk_it->x, z = chunk_it->z;
+				getChunkSectionTiles(mc::ChunkPos(x - 1, z), i, neighbor_tiles);
+				getChunkSectionTiles(mc::ChunkPos(x + 1, z), i, neighbor_tiles);
+				getChunkSectionTiles(mc::ChunkPos(x, z - 1), i, neighbor_tiles);
+				getChunkSectionTiles(mc::ChunkPos(x, z + 1), i, neighbor_tiles);
+			}
+		}
+	}
+
+	// the tiles of removed chunks are changed as well
+	const std::map<mc::ChunkPos, mc::ChunkHashes>& old_chunks = index.getChunks();
+	for (auto it = old_chunks.begin(); it != old_chunks.end(); ++it)
+		if (!new_index.hasChunk(it->first))
+			getChunkTiles(it->first, changed_tiles);
+
+	index = new_index;
+	if (fill_only)
+		return;
+
+	// now keep only the required tiles which are actually changed, the tiles of the
+	// adjacent chunks of changed sections are required even if their chunks didn't change
+	required_render_tiles_count = 0;
+	for (size_t i = 0; i < render_tiles.size(); i++) {
+		TilePos tile = render_tiles[i] + tile_offset;
+		if (neighbor_tiles.count(tile))
+			render_tiles_required[i] = true;
+		else if (render_tiles_required[i] && !changed_tiles.count(tile))
+			render_tiles_required[i] = false;
+		if (render_tiles_required[i])
+			required_render_tiles_count++;
+	}
 
 	updateContainingRenderTiles();
 }
@@ -462,15 +680,7 @@ void TileSet::setDepth(int depth) {
 		return;
 
 	this->depth = depth;
-
-	// clear already calculated composite tiles and recalculate them
-	composite_tiles.clear();
-	required_composite_tiles.clear();
-
-	findRequiredCompositeTiles(render_tiles, composite_tiles);
-	findRequiredCompositeTiles(required_render_tiles, required_composite_tiles);
-
-	updateContainingRenderTiles();
+	updateCompositeTiles();
 }
 
 const TilePos& TileSet::getTileOffset() const {
@@ -479,34 +689,127 @@ const TilePos& TileSet::getTileOffset() const {
 
 bool TileSet::hasTile(const TilePath& path) const {
 	if (path.getDepth() == depth)
-		return render_tiles.count(path.getTilePos()) != 0;
-	return composite_tiles.count(path) != 0;
+		return findRenderTile(path.getTilePos()) != -1;
+	return findCompositeTile(path) != -1;
 }
 
 bool TileSet::isTileRequired(const TilePath& path) const {
-	if(path.getDepth() == depth)
-		return required_render_tiles.count(path.getTilePos()) != 0;
-	return required_composite_tiles.count(path) != 0;
+	if (path.getDepth() == depth)
+		return isRenderTileRequired(path.getTilePos());
+	int index = findCompositeTile(path);
+	return index != -1
+			&& composite_levels[path.getDepth()].containing_render_tiles[index] > 0;
+}
+
+bool TileSet::isRenderTileRequired(const TilePos& tile) const {
+	int index = findRenderTile(tile);
+	return index != -1 && render_tiles_required[index];
+}
+
+const std::vector<TilePos>& TileSet::getRenderTiles() const {
+	return render_tiles;
 }
 
 int TileSet::getRequiredRenderTilesCount() const {
-	return required_render_tiles.size();
+	return required_render_tiles_count;
 }
 
-const std::set<TilePos>& TileSet::getRequiredRenderTiles() const {
-	return required_render_tiles;
+std::vector<TilePos> TileSet::getRequiredRenderTiles() const {
+	std::vector<TilePos> tiles;
+	tiles.reserve(required_render_tiles_count);
+	for (size_t i = 0; i < render_tiles.size(); i++)
+		if (render_tiles_required[i])
+			tiles.push_back(render_tiles[i]);
+	return tiles;
 }
 
 int TileSet::getRequiredCompositeTilesCount() const {
-	return required_composite_tiles.size();
+	return required_composite_tiles_count;
 }
 
-const std::set<TilePath>& TileSet::getRequiredCompositeTiles() const {
-	return required_composite_tiles;
+std::vector<TilePath> TileSet::getRequiredCompositeTiles(int zoom_level) const {
+	std::vector<TilePath> tiles;
+	if (zoom_level < 0 || zoom_level >= depth)
+		return tiles;
+	const CompositeLevel& level = composite_levels[zoom_level];
+	for (size_t i = 0; i < level.codes.size(); i++)
+		if (level.containing_render_tiles[i] > 0)
+			tiles.push_back(TilePath::byCode(level.codes[i], zoom_level));
+	return tiles;
 }
 
 int TileSet::getContainingRenderTiles(const TilePath& tile) const {
-	return containing_render_tiles.at(tile);
+	if (tile.getDepth() == depth)
+		return isTileRequired(tile) ? 1 : 0;
+	int index = findCompositeTile(tile);
+	if (index == -1)
+		return 0;
+	return composite_levels[tile.getDepth()].containing_render_tiles[index];
+}
+
+int TileSet::getShardLevel(int shards) const {
+	int max_level = std::max(0, depth - 2);
+	for (int level = 0; level < max_level; level++) {
+		const CompositeLevel& composite = composite_levels[level];
+		int required = 0;
+		for (size_t i = 0; i < composite.codes.size(); i++)
+			if (composite.containing_render_tiles[i] > 0)
+				required++;
+		if (required >= 16 * shards)
+			return level;
+	}
+	return max_level;
+}
+
+std::vector<TilePath> TileSet::getShardTiles(int shard, int shards) const {
+	std::vector<TilePath> shard_tiles;
+	// a tile set without composite tiles has only the root render tile
+	if (depth == 0) {
+		if (shard == 0 && required_render_tiles_count > 0)
+			shard_tiles.push_back(TilePath());
+		return shard_tiles;
+	}
+
+	std::vector<TilePath> tiles = getRequiredCompositeTiles(getShardLevel(shards));
+	std::vector<int> counts(tiles.size());
+	int64_t total = 0;
+	for (size_t i = 0; i < tiles.size(); i++) {
+		counts[i] = getContainingRenderTiles(tiles[i]);
+		total += counts[i];
+	}
+
+	// every tile is assigned to the shard its middle falls into, when the required
+	// render tiles of all (sorted) tiles are lined up and divided into equal parts
+	int64_t before = 0;
+	for (size_t i = 0; i < tiles.size(); i++) {
+		if ((2 * before + counts[i]) * shards / (2 * total) == shard)
+			shard_tiles.push_back(tiles[i]);
+		before += counts[i];
+	}
+	return shard_tiles;
+}
+
+void TileSet::restrictRequiredTiles(const std::vector<TilePath>& tiles) {
+	std::set<TilePath> tiles_set(tiles.begin(), tiles.end());
+	std::set<int> tiles_depths;
+	for (auto it = tiles.begin(); it != tiles.end(); ++it)
+		tiles_depths.insert(it->getDepth());
+
+	required_render_tiles_count = 0;
+	for (size_t i = 0; i < render_tiles.size(); i++) {
+		if (!render_tiles_required[i])
+			continue;
+		// check whether one of the parent tiles is one of the specified tiles
+		uint64_t code = TilePath::byTilePos(render_tiles[i], depth).getCode();
+		bool contained = false;
+		for (auto it = tiles_depths.begin(); it != tiles_depths.end() && !contained; ++it)
+			contained = tiles_set.count(TilePath::byCode(code >> (2 * (depth - *it)), *it));
+		render_tiles_required[i] = contained;
+		if (contained)
+			required_render_tiles_count++;
+	}
+
+	updateContainingRenderTiles();
 }
 
 }
@@ -20,10 +20,14 @@
 #ifndef TILE_H_
 #define TILE_H_
 
+#include "../mc/chunkhashes.h"
 #include "../mc/world.h"
 
+#include <functional>
 #include <set>
+#include <string>
 #include <vector>
+#include <stdint.h>
 #include <boost/filesystem.hpp>
 
 namespace fs = boost::filesystem;
@@ -46,7 +50,8 @@ namespace fs = boost::filesystem;
  * render tiles the maximum zoom level.
  *
  * The TileSet class manages the tiles for the rendering process. The render tiles are
- * stored as tile positions, all other composite tiles as tile paths. The tile set scans
+ * stored as tile positions, all other composite tiles as quadtree codes of their tile
+ * paths (sorted arrays per zoom level, to handle huge maps). The tile set scans
  * the world and all chunks, calculates the maximum needed zoom level and finds out, which
  * tiles exist and which tiles need to get rendered (useful for incremental rendering,
  * when only a few chunks where changed).
@@ -95,9 +100,17 @@ private:
  * This class represents the path of a tile in the quadtree.
  * Every part in the path is a 1, 2, 3 or 4.
  * The length of the path is the zoom level of the tile.
+ *
+ * The path is packed into a 64 bit integer (2 bits per part and the zoom level), so
+ * paths can be copied, compared and hashed without allocating any memory.
  */
 class TilePath {
 public:
+	// the maximum zoom level a path can have
+	static const int MAX_DEPTH = 29;
+	// the buffer size required for the string representation of every path
+	static const int STRING_BUFFER_SIZE = 2 * MAX_DEPTH + 1;
+
 	TilePath();
 	TilePath(const std::vector<int>& path);
 	~TilePath();
@@ -110,7 +123,7 @@ public:
 	/**
 	 * Returns the path.
 	 */
-	const std::vector<int>& getPath() const;
+	std::vector<int> getPath() const;
 
 	/**
 	 * Returns the path of the parent tile.
@@ -129,6 +142,28 @@ public:
 	 */
 	static TilePath byTilePos(const TilePos& tile, int depth);
 
+	/**
+	 * Returns the quadtree code of the path: Every part is encoded with 2 bits
+	 * (part - 1), the first part in the highest bits. The codes of the tiles of a zoom
+	 * level have the same order like the paths, the code of the parent tile is the
+	 * code >> 2.
+	 */
+	uint64_t getCode() const;
+
+	/**
+	 * Creates the path (with a specified zoom level) of a quadtree code.
+	 * Opposite of getCode-method.
+	 */
+	static TilePath byCode(uint64_t code, int depth);
+
+	/**
+	 * Returns the index of the tile on a Hilbert curve through all tiles of its zoom
+	 * level. Successive tiles on the curve are always neighbors, so tiles rendered in
+	 * this order need mostly the same chunks. Like with the quadtree code, the index of
+	 * the parent tile is the index >> 2.
+	 */
+	uint64_t getHilbertCode() const;
+
 	/**
 	 * Adds a node to the path.
 	 */
@@ -137,19 +172,53 @@ public:
 
 	// some more comparison operations
 	bool operator==(const TilePath& other) const;
+	bool operator!=(const TilePath& other) const;
 	bool operator<(const TilePath& other) const;
 
+	/**
+	 * Returns a hash value of the path.
+	 */
+	size_t hash() const;
+
 	/**
 	 * Returns the string representation of the path, for example "1/2/3/4".
 	 */
 	std::string toString() const;
+
+	/**
+	 * Writes the null-terminated string representation of the path into a buffer
+	 * (with at least STRING_BUFFER_SIZE bytes) and returns the length of the string.
+	 */
+	int toString(char* buffer) const;
 private:
-	std::vector<int> path;
+	// the parts of the path (2 bits each, beginning with the highest bits),
+	// the lowest bits are the zoom level, so the order of the integers is the
+	// lexicographical order of the paths
+	uint64_t data;
 };
 
 std::ostream& operator<<(std::ostream& stream, const TilePath& path);
 std::ostream& operator<<(std::ostream& stream, const TilePos& tile);
 
+/**
+ * Calculates the render tiles a chunk covers and adds them to a set.
+ */
+void getChunkTiles(const mc::ChunkPos& chunk, std::set<TilePos>& tiles);
+
+/**
+ * Calculates the chunks a render tile covers and adds them to a set.
+ * Opposite of getChunkTiles-function.
+ */
+void getTileChunks(const TilePos& tile, std::set<mc::ChunkPos>& chunks);
+
+/**
+ * Calculates the render tiles a single section of a chunk covers and adds them to a set.
+ */
+void getChunkSectionTiles(const mc::ChunkPos& chunk, int section, std::set<TilePos>& tiles);
+
+class TileManifest;
+class WorldScanIndex;
+
 /**
  * This class manages all tiles required to render a world.
  */
@@ -172,6 +241,13 @@ public:
 	void scan(const mc::World& world);
 	void scan(const mc::World& world, bool auto_center, TilePos& tile_offset);
 
+	/**
+	 * Scans the tiles of a world by using an already updated world scan index, so the
+	 * region headers do not need to be read again.
+	 */
+	void scan(const WorldScanIndex& index);
+	void scan(const WorldScanIndex& index, bool auto_center, TilePos& tile_offset);
+
 	/**
 	 * Scans which tiles are required by testing which tiles were probably changed since
 	 * the timestamp last_change.
@@ -185,6 +261,27 @@ public:
 	void scanRequiredByFiletimes(const fs::path& output_dir,
 			std::string image_format = "png");
 
+	/**
+	 * Scans which tiles are required by using the render times stored in the tile
+	 * manifest of the already rendered tiles. This is the same like using the
+	 * modification times of the tile images, but without accessing every single file.
+	 */
+	void scanRequiredByManifest(const TileManifest& manifest);
+
+	/**
+	 * Refines the required tiles (found with one of the other scanRequired* methods)
+	 * by using content hashes of the chunk sections: Only tiles which overlap chunk
+	 * sections whose content actually changed since the hashes were stored in the
+	 * index stay required. Because the rendering of a block depends on the blocks
+	 * around it, the sections above and below a changed section and the same sections
+	 * of the adjacent chunks count as changed as well, and the tiles of the adjacent
+	 * chunks become required. Only chunks overlapping required tiles are loaded.
+	 *
+	 * The index is updated with the new hashes. If the index is empty, all chunks are
+	 * hashed and the required tiles are not changed.
+	 */
+	void scanRequiredByChunkHashes(const mc::World& world, mc::ChunkHashIndex& index);
+
 	/**
 	 * Returns the minimum maximum zoom level required to render all render tiles.
 	 */
@@ -216,15 +313,25 @@ public:
 	 */
 	bool isTileRequired(const TilePath& path) const;
 
+	/**
+	 * Returns if a specific render tile is required.
+	 */
+	bool isRenderTileRequired(const TilePos& tile) const;
+
+	/**
+	 * Returns all available render tiles (sorted).
+	 */
+	const std::vector<TilePos>& getRenderTiles() const;
+
 	/**
 	 * Returns the count of required render tiles.
 	 */
 	int getRequiredRenderTilesCount() const;
 
 	/**
-	 * Returns the required render tiles.
+	 * Returns the required render tiles (sorted).
 	 */
-	const std::set<TilePos>& getRequiredRenderTiles() const;
+	std::vector<TilePos> getRequiredRenderTiles() const;
 
 	/**
 	 * Returns the count of required composite tiles.
@@ -232,15 +339,37 @@ public:
 	int getRequiredCompositeTilesCount() const;
 
 	/**
-	 * Returns the required composite tiles.
+	 * Returns the required composite tiles of a specific zoom level.
 	 */
-	const std::set<TilePath>& getRequiredCompositeTiles() const;
+	std::vector<TilePath> getRequiredCompositeTiles(int zoom_level) const;
 
 	/**
 	 * Returns the count of required render tiles a specific composite tiles contains.
 	 */
 	int getContainingRenderTiles(const TilePath& tile) const;
 
+	/**
+	 * Returns the zoom level the required tiles are split at when the rendering is
+	 * sharded across multiple processes: The lowest zoom level with at least 16 required
+	 * composite tiles per shard, but at most the zoom level the multithreading
+	 * dispatcher starts its jobs at.
+	 */
+	int getShardLevel(int shards) const;
+
+	/**
+	 * Returns the required composite tiles of the shard level (see getShardLevel) a
+	 * shard (0 <= shard < shards) renders. Every shard gets a contiguous range of these
+	 * tiles, the ranges are balanced by the count of required render tiles. This is
+	 * deterministic, so every process with the same tile set gets the same shards.
+	 */
+	std::vector<TilePath> getShardTiles(int shard, int shards) const;
+
+	/**
+	 * Marks only the required render tiles which are contained in one of the specified
+	 * tiles as required, e.g. to render just the tiles of a shard.
+	 */
+	void restrictRequiredTiles(const std::vector<TilePath>& tiles);
+
 private:
 	// the minimum maximum zoom level which would be required to render all tiles
 	int min_depth;
@@ -252,42 +381,58 @@ private:
 	// but are actually rendered as pos+tile_offset
 	TilePos tile_offset;
 
-	// all available render tiles
-	// (= tiles with the highest zoom level, tree leaves in the quadtree)
-	std::set<TilePos> render_tiles;
-	// the render tiles which actually need to get rendered
-	std::set<TilePos> required_render_tiles;
-	// timestamps of render tiles required to re-render a tile
-	// (= highest timestamp of all chunks in a tile)
-	std::map<TilePos, int> tile_timestamps;
+	// all available render tiles (= tiles with the highest zoom level, tree leaves in
+	// the quadtree), sorted, and for every render tile its timestamp required to
+	// re-render it (= highest timestamp of all chunks in a tile) and whether it actually
+	// needs to get rendered
+	std::vector<TilePos> render_tiles;
+	std::vector<int> render_tiles_timestamps;
+	std::vector<bool> render_tiles_required;
+	int required_render_tiles_count;
 
-	// same here for composite tiles
-	std::set<TilePath> composite_tiles;
-	std::set<TilePath> required_composite_tiles;
+	/**
+	 * The composite tiles of one zoom level: The sorted quadtree codes of the tiles
+	 * (2 bits per zoom level, like the tile paths) and the count of required render
+	 * tiles every composite tile contains. A composite tile is required if it contains
+	 * at least one required render tile.
+	 */
+	struct CompositeLevel {
+		std::vector<uint64_t> codes;
+		std::vector<int> containing_render_tiles;
+	};
 
-	// count of required render tiles contained in a composite tile
-	std::map<TilePath, int> containing_render_tiles;
+	// the composite tiles of the zoom levels 0 to depth-1
+	std::vector<CompositeLevel> composite_levels;
+	int required_composite_tiles_count;
 
 	/**
-	 * This method finds out which render level tiles a world has and which maximum
-	 * zoom level would be required to render them.
+	 * This method finds out (with a world scan index) which render level tiles a
+	 * world has and which maximum zoom level would be required to render them.
 	 *
 	 * The auto_center parameter describes whether it should automatically center the
 	 * found tiles. If set to false (default), it will use tile_offset as center.
 	 */
-	void findRenderTiles(const mc::World& world, bool auto_center, TilePos& tile_offset);
+	void findRenderTiles(const WorldScanIndex& index, bool auto_center, TilePos& tile_offset);
+
+	/**
+	 * Returns the index of a render tile, or -1 if the tile does not exist.
+	 */
+	int findRenderTile(const TilePos& tile) const;
 
 	/**
-	 * This method finds out which composite tiles are needed, depending on a
-	 * list of available/required render tiles, and puts them into a set.
-	 * So we can find out which composite tiles are available and which composite tiles
-	 * need to get rendered.
+	 * Returns the index of a composite tile in its zoom level,
+	 * or -1 if the tile does not exist.
 	 */
-	void findRequiredCompositeTiles(const std::set<TilePos>& render_tiles,
-			std::set<TilePath>& tiles);
+	int findCompositeTile(const TilePath& tile) const;
 
 	/**
-	 * Updates the containing_render_tiles map.
+	 * This method finds out which composite tiles are needed, depending on the
+	 * available render tiles and the current depth.
+	 */
+	void updateCompositeTiles();
+
+	/**
+	 * Updates the count of required render tiles contained in every composite tile.
 	 */
 	void updateContainingRenderTiles();
 };
@@ -295,4 +440,15 @@ private:
 }
 }
 
+namespace std {
+
+template <>
+struct hash<mapcrafter::renderer::TilePath> {
+	size_t operator()(const mapcrafter::renderer::TilePath& path) const {
+		return path.hash();
+	}
+};
+
+}
+
 #endif /* TILE_H_ */
@@ -97,3 +97,27 @@ BOOST_AUTO_TEST_CASE(config_testFieldValidation) {
 	BOOST_CHECK(field2.isLoaded());
 	BOOST_CHECK_EQUAL(field2.getValue(), "foobar");
 }
+
+BOOST_AUTO_TEST_CASE(config_testRenderHotspots) {
+	config::INIConfigSection section("world", "world");
+	section.set("input_dir", "data");
+	section.set("default_view", "100, -20, 64");
+	section.set("render_hotspots", "1,2,3  -4,-5,70");
+
+	config::ValidationList validation;
+	config::WorldSection world;
+	world.setConfigDir(".");
+	BOOST_CHECK(world.parse(section, validation));
+	const std::vector<mapcrafter::mc::BlockPos>& hotspots = world.getRenderHotspots();
+	BOOST_REQUIRE_EQUAL(hotspots.size(), 3);
+	BOOST_CHECK_EQUAL(hotspots[0].x, 100);
+	BOOST_CHECK_EQUAL(hotspots[0].z, -20);
+	BOOST_CHECK_EQUAL(hotspots[0].y, 64);
+	BOOST_CHECK_EQUAL(hotspots[2].x, -4);
+	BOOST_CHECK_EQUAL(hotspots[2].z, -5);
+	BOOST_CHECK_EQUAL(hotspots[2].y, 70);
+
+	section.set("render_hotspots", "1,2,3 1,2");
+	validation.clear();
+	BOOST_CHECK(!world.parse(section, validation));
+}
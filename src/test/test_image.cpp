@@ -20,6 +20,8 @@
 #include "../renderer/image.h"
 
 #include <cstdlib>
+#include <set>
+#include <sstream>
 #include <boost/test/unit_test.hpp>
 
 namespace renderer = mapcrafter::renderer;
@@ -50,3 +52,48 @@ BOOST_AUTO_TEST_CASE(image_testIO) {
 		}
 	}
 }
+
+BOOST_AUTO_TEST_CASE(image_testStreamIO) {
+	renderer::RGBAImage src(64, 32);
+	for(int x = 0; x < src.getWidth(); x++)
+		for(int y = 0; y < src.getHeight(); y++)
+			src.setPixel(x, y, renderer::rgba(x * 4, y * 8, 128, 255));
+
+	std::stringstream png;
+	renderer::RGBAImage dest;
+	BOOST_CHECK(src.writePNG(png));
+	BOOST_CHECK(dest.readPNG(png));
+	BOOST_CHECK_EQUAL(dest.getWidth(), src.getWidth());
+	BOOST_CHECK_EQUAL(dest.getHeight(), src.getHeight());
+	for(int x = 0; x < dest.getWidth(); x++)
+		for(int y = 0; y < dest.getHeight(); y++)
+			if(src.getPixel(x, y) != dest.getPixel(x, y))
+				BOOST_ERROR("Images aren't equal!");
+
+	std::stringstream jpeg;
+	renderer::RGBAImage dest2;
+	BOOST_CHECK(src.writeJPEG(jpeg, 90));
+	BOOST_CHECK(dest2.readJPEG(jpeg));
+	BOOST_CHECK_EQUAL(dest2.getWidth(), src.getWidth());
+	BOOST_CHECK_EQUAL(dest2.getHeight(), src.getHeight());
+}
+
+BOOST_AUTO_TEST_CASE(image_testHash) {
+	renderer::RGBAImage image1(32, 32), image2(32, 32), image3(16, 64);
+	BOOST_CHECK_EQUAL(image1.hash(), image2.hash());
+	BOOST_CHECK(image1.hash() != image3.hash());
+	BOOST_CHECK(image1.hash() != 0);
+
+	image2.setPixel(31, 31, renderer::rgba(255, 0, 0, 255));
+	BOOST_CHECK(image1.hash() != image2.hash());
+	image2.setPixel(31, 31, 0);
+	BOOST_CHECK_EQUAL(image1.hash(), image2.hash());
+
+	// the upper 32 bits of the hash are used as well
+	std::set<uint64_t> high_bits;
+	for (int i = 0; i < 16; i++) {
+		image2.setPixel(0, 0, renderer::rgba(i, 0, 0, 255));
+		high_bits.insert(image2.hash() >> 32);
+	}
+	BOOST_CHECK_GT(high_bits.size(), 1);
+}
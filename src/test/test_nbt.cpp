@@ -40,7 +40,7 @@ BOOST_AUTO_TEST_CASE(nbt_testIO) {
 	};
 	for (size_t i = 0; i < 3; i++) {
 		nbt::Compression compression = compressions[i];
-		BOOST_MESSAGE(std::string("Testing NBT with") + (compression == nbt::Compression::NO_COMPRESSION ? "out compression." : (compression == nbt::Compression::GZIP ? " Gzip compression." : " Zlib compression.")));
+		BOOST_TEST_MESSAGE(std::string("Testing NBT with") + (compression == nbt::Compression::NO_COMPRESSION ? "out compression." : (compression == nbt::Compression::GZIP ? " Gzip compression." : " Zlib compression.")));
 		
 		std::stringstream stream;
 		
@@ -98,3 +98,194 @@ BOOST_AUTO_TEST_CASE(nbt_testIO) {
 		BOOST_CHECK(intarray_data == in.findTag<nbt::TagIntArray>("intarray").payload);
 	}
 }
+
+BOOST_AUTO_TEST_CASE(nbt_testBuffer) {
+	std::vector<int32_t> intarray_data(10000);
+	for (size_t i = 0; i < intarray_data.size(); i++)
+		intarray_data[i] = i * 7919 - 5000;
+
+	nbt::NBTFile out("TestNBTFile");
+	out.addTag("intarray", nbt::TagIntArray(intarray_data));
+	out.addTag("string", nbt::TagString("foobar"));
+
+	nbt::Compression compressions[] = {
+		nbt::Compression::NO_COMPRESSION,
+		nbt::Compression::GZIP,
+		nbt::Compression::ZLIB
+	};
+	for (size_t i = 0; i < 3; i++) {
+		std::vector<char> buffer;
+		out.writeNBT(buffer, compressions[i]);
+
+		// the compressed data has the header of the format
+		if (compressions[i] == nbt::Compression::GZIP) {
+			BOOST_REQUIRE_GT(buffer.size(), 10);
+			BOOST_CHECK_EQUAL((uint8_t) buffer[0], 0x1f);
+			BOOST_CHECK_EQUAL((uint8_t) buffer[1], 0x8b);
+			BOOST_CHECK_EQUAL((uint8_t) buffer[2], 0x08);
+		} else if (compressions[i] == nbt::Compression::ZLIB) {
+			BOOST_REQUIRE_GT(buffer.size(), 2);
+			BOOST_CHECK_EQUAL((uint8_t) buffer[0], 0x78);
+			BOOST_CHECK_EQUAL((((uint8_t) buffer[0] << 8) | (uint8_t) buffer[1]) % 31, 0);
+		}
+
+		nbt::NBTFile in;
+		in.readNBT(buffer.data(), buffer.size(), compressions[i]);
+		BOOST_CHECK_EQUAL(in.getName(), "TestNBTFile");
+		REQUIRE_TAG(in.hasArray<nbt::TagIntArray>("intarray", intarray_data.size()), "intarray");
+		BOOST_CHECK(intarray_data == in.findTag<nbt::TagIntArray>("intarray").payload);
+		BOOST_CHECK_EQUAL(in.findTag<nbt::TagString>("string").payload, "foobar");
+
+		// truncated data
+		nbt::NBTFile truncated;
+		BOOST_CHECK_THROW(truncated.readNBT(buffer.data(), buffer.size() / 2,
+				compressions[i]), nbt::NBTError);
+	}
+}
+
+/**
+ * The uncompressed NBT data of a compound 'test' with an int 'int' (0x12345678) and a
+ * string 'str' ("foobar"), and the same data compressed by gzip and zlib (Python's
+ * gzip.compress(data, mtime=0) and zlib.compress(data)).
+ */
+static const uint8_t FIXTURE_NBT[] = {
+	0x0a, 0x00, 0x04, 0x74, 0x65, 0x73, 0x74, 0x03, 0x00, 0x03, 0x69, 0x6e, 0x74,
+	0x12, 0x34, 0x56, 0x78, 0x08, 0x00, 0x03, 0x73, 0x74, 0x72, 0x00, 0x06, 0x66,
+	0x6f, 0x6f, 0x62, 0x61, 0x72, 0x00
+};
+
+static const uint8_t FIXTURE_GZIP[] = {
+	0x1f, 0x8b, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x03, 0xe3, 0x62, 0x60,
+	0x29, 0x49, 0x2d, 0x2e, 0x61, 0x66, 0x60, 0xce, 0xcc, 0x2b, 0x11, 0x32, 0x09,
+	0xab, 0xe0, 0x60, 0x60, 0x2e, 0x2e, 0x29, 0x62, 0x60, 0x4b, 0xcb, 0xcf, 0x4f,
+	0x4a, 0x2c, 0x62, 0x00, 0x00, 0x79, 0x4f, 0xd2, 0x72, 0x20, 0x00, 0x00, 0x00
+};
+
+static const uint8_t FIXTURE_ZLIB[] = {
+	0x78, 0x9c, 0xe3, 0x62, 0x60, 0x29, 0x49, 0x2d, 0x2e, 0x61, 0x66, 0x60, 0xce,
+	0xcc, 0x2b, 0x11, 0x32, 0x09, 0xab, 0xe0, 0x60, 0x60, 0x2e, 0x2e, 0x29, 0x62,
+	0x60, 0x4b, 0xcb, 0xcf, 0x4f, 0x4a, 0x2c, 0x62, 0x00, 0x00, 0x7a, 0x92, 0x08,
+	0x17
+};
+
+BOOST_AUTO_TEST_CASE(nbt_testFixture) {
+	struct {
+		const uint8_t* data;
+		size_t size;
+		nbt::Compression compression;
+	} fixtures[] = {
+		{FIXTURE_NBT, sizeof(FIXTURE_NBT), nbt::Compression::NO_COMPRESSION},
+		{FIXTURE_GZIP, sizeof(FIXTURE_GZIP), nbt::Compression::GZIP},
+		{FIXTURE_ZLIB, sizeof(FIXTURE_ZLIB), nbt::Compression::ZLIB},
+	};
+	for (size_t i = 0; i < 3; i++) {
+		const char* data = reinterpret_cast<const char*>(fixtures[i].data);
+
+		nbt::NBTFile file;
+		file.readNBT(data, fixtures[i].size, fixtures[i].compression);
+		BOOST_CHECK_EQUAL(file.getName(), "test");
+		REQUIRE_TAG(file.hasTag<nbt::TagInt>("int"), "int");
+		BOOST_CHECK_EQUAL(file.findTag<nbt::TagInt>("int").payload, 0x12345678);
+		REQUIRE_TAG(file.hasTag<nbt::TagString>("str"), "str");
+		BOOST_CHECK_EQUAL(file.findTag<nbt::TagString>("str").payload, "foobar");
+
+		// the same data is read by the stream interface and the document
+		std::stringstream stream(std::string(data, fixtures[i].size));
+		nbt::NBTFile file_stream;
+		file_stream.readNBT(stream, fixtures[i].compression);
+		BOOST_CHECK_EQUAL(file_stream.findTag<nbt::TagInt>("int").payload, 0x12345678);
+
+		nbt::Document document;
+		document.readNBT(data, fixtures[i].size, fixtures[i].compression);
+		BOOST_CHECK_EQUAL(document.getRoot().getName(), "test");
+		const nbt::TagNode* tag = document.getRoot().getTag<nbt::TagInt>("int");
+		BOOST_REQUIRE(tag != nullptr);
+		BOOST_CHECK_EQUAL(tag->getInt(), 0x12345678);
+	}
+
+	// and writing the file again gives exactly the same bytes
+	nbt::NBTFile out("test");
+	out.addTag("int", nbt::TagInt(0x12345678));
+	out.addTag("str", nbt::TagString("foobar"));
+	std::vector<char> buffer;
+	out.writeNBT(buffer, nbt::Compression::NO_COMPRESSION);
+	BOOST_CHECK(buffer == std::vector<char>(FIXTURE_NBT, FIXTURE_NBT + sizeof(FIXTURE_NBT)));
+}
+
+BOOST_AUTO_TEST_CASE(nbt_testDocument) {
+	std::vector<int32_t> intarray_data = {1, -1, 2, 3, 5, 8, 13, 21};
+	std::vector<int8_t> bytearray_data = {'H', 'e', 'l', 'l', 'o', '!'};
+
+	nbt::NBTFile out("TestNBTFile");
+	out.addTag("byte", nbt::TagByte(-42));
+	out.addTag("short", nbt::TagShort(-1337));
+	out.addTag("long", nbt::TagLong(-1234567890123ll));
+	out.addTag("float", nbt::TagFloat(3.1415926));
+	out.addTag("double", nbt::TagDouble(2.7182818));
+	out.addTag("string", nbt::TagString("foobar"));
+	out.addTag("bytearray", nbt::TagByteArray(bytearray_data));
+	out.addTag("intarray", nbt::TagIntArray(intarray_data));
+
+	nbt::TagList list(nbt::TagCompound::TAG_TYPE);
+	for (int i = 0; i < 3; i++) {
+		nbt::TagCompound compound;
+		compound.addTag("i", nbt::TagInt(i));
+		list.payload.push_back(nbt::TagPtr(compound.clone()));
+	}
+	out.addTag("list", list);
+
+	std::stringstream stream;
+	out.writeNBT(stream, nbt::Compression::ZLIB);
+	std::string data = stream.str();
+
+	nbt::Document in;
+	in.readNBT(data.c_str(), data.size(), nbt::Compression::ZLIB);
+	const nbt::TagNode& root = in.getRoot();
+	BOOST_CHECK_EQUAL(root.getName(), "TestNBTFile");
+	BOOST_CHECK_EQUAL(root.getLength(), 9);
+
+	// the tags are only found with the right type
+	BOOST_CHECK(root.getTag<nbt::TagInt>("byte") == nullptr);
+	BOOST_CHECK(root.getTag<nbt::TagByte>("foo") == nullptr);
+	BOOST_CHECK(root.getArray<nbt::TagByteArray>("bytearray", 5) == nullptr);
+	BOOST_CHECK(root.getList<nbt::TagString>("list") == nullptr);
+
+	REQUIRE_TAG(root.getTag<nbt::TagByte>("byte"), "byte");
+	REQUIRE_TAG(root.getTag<nbt::TagShort>("short"), "short");
+	REQUIRE_TAG(root.getTag<nbt::TagLong>("long"), "long");
+	REQUIRE_TAG(root.getTag<nbt::TagFloat>("float"), "float");
+	REQUIRE_TAG(root.getTag<nbt::TagDouble>("double"), "double");
+	REQUIRE_TAG(root.getTag<nbt::TagString>("string"), "string");
+	REQUIRE_TAG(root.getArray<nbt::TagByteArray>("bytearray", bytearray_data.size()), "bytearray");
+	REQUIRE_TAG(root.getArray<nbt::TagIntArray>("intarray", intarray_data.size()), "intarray");
+	REQUIRE_TAG(root.getList<nbt::TagCompound>("list"), "list");
+
+	BOOST_CHECK_EQUAL(root.getTag<nbt::TagByte>("byte")->getInt(), -42);
+	BOOST_CHECK_EQUAL(root.getTag<nbt::TagShort>("short")->getInt(), -1337);
+	BOOST_CHECK_EQUAL(root.getTag<nbt::TagLong>("long")->getInt(), -1234567890123ll);
+	BOOST_CHECK_CLOSE(root.getTag<nbt::TagFloat>("float")->getDouble(), 3.1415926, 0.0001);
+	BOOST_CHECK_CLOSE(root.getTag<nbt::TagDouble>("double")->getDouble(), 2.7182818, 0.0001);
+	BOOST_CHECK_EQUAL(root.getTag<nbt::TagString>("string")->getString(), "foobar");
+
+	const nbt::TagNode* bytearray = root.getTag<nbt::TagByteArray>("bytearray");
+	BOOST_CHECK(std::vector<int8_t>(bytearray->getBytes(),
+			bytearray->getBytes() + bytearray->getLength()) == bytearray_data);
+	const nbt::TagNode* intarray = root.getTag<nbt::TagIntArray>("intarray");
+	for (size_t i = 0; i < intarray_data.size(); i++)
+		BOOST_CHECK_EQUAL(intarray->getIntArrayEntry(i), intarray_data[i]);
+
+	const nbt::TagNode* tag_list = root.getList<nbt::TagCompound>("list");
+	BOOST_REQUIRE_EQUAL(tag_list->getLength(), 3);
+	int i = 0;
+	for (const nbt::TagNode* tag = tag_list->begin(); tag != tag_list->end(); ++tag, ++i) {
+		REQUIRE_TAG(tag->getTag<nbt::TagInt>("i"), "i");
+		BOOST_CHECK_EQUAL(tag->getTag<nbt::TagInt>("i")->getInt(), i);
+	}
+
+	// truncated data
+	std::stringstream uncompressed;
+	out.writeNBT(uncompressed, nbt::Compression::NO_COMPRESSION);
+	std::string truncated = uncompressed.str().substr(0, 40);
+	BOOST_CHECK_THROW(in.readNBT(truncated.c_str(), truncated.size(),
+			nbt::Compression::NO_COMPRESSION), nbt::NBTError);
+}
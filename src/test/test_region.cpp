@@ -19,13 +19,21 @@
 
 #include "../util.h"
 #include "../mc/chunk.h"
+#include "../mc/chunkhashes.h"
 #include "../mc/region.h"
+#include "../mc/regionprefetcher.h"
+#include "../mc/worldcache.h"
+#include "../mc/worldgenerator.h"
 
+#include <chrono>
 #include <iostream>
 #include <fstream>
 #include <sstream>
+#include <thread>
+#include <boost/filesystem.hpp>
 #include <boost/test/unit_test.hpp>
 
+namespace fs = boost::filesystem;
 namespace mc = mapcrafter::mc;
 
 BOOST_AUTO_TEST_CASE(region_testReadWrite) {
@@ -51,3 +59,142 @@ BOOST_AUTO_TEST_CASE(region_testReadWrite) {
 	}
 
 }
+
+BOOST_AUTO_TEST_CASE(region_testReadChunks) {
+	mc::RegionFile full("data/region/r.-1.0.mca");
+	BOOST_CHECK(full.read());
+
+	// read only every second chunk of the region
+	mc::RegionFile::ChunkMap wanted;
+	auto chunks = full.getContainingChunks();
+	int i = 0;
+	for (auto it = chunks.begin(); it != chunks.end(); ++it, ++i)
+		if (i % 2 == 0)
+			wanted.insert(*it);
+
+	mc::RegionFile partial("data/region/r.-1.0.mca");
+	BOOST_CHECK(partial.readChunks(wanted));
+	BOOST_CHECK_EQUAL(partial.getContainingChunksCount(), 120);
+	for (auto it = chunks.begin(); it != chunks.end(); ++it) {
+		if (wanted.count(*it)) {
+			BOOST_CHECK(partial.getChunkData(*it) == full.getChunkData(*it));
+			BOOST_CHECK_EQUAL(partial.getChunkDataCompression(*it),
+					full.getChunkDataCompression(*it));
+		} else
+			BOOST_CHECK(partial.getChunkData(*it).empty());
+	}
+}
+
+BOOST_AUTO_TEST_CASE(region_testChunkHashes) {
+	mc::RegionFile region("data/region/r.-1.0.mca");
+	BOOST_CHECK(region.read());
+
+	mc::ChunkHashIndex index1;
+	auto chunks = region.getContainingChunks();
+	for (auto it = chunks.begin(); it != chunks.end(); ++it) {
+		mc::Chunk chunk;
+		BOOST_CHECK(region.loadChunk(*it, chunk) == mc::RegionFile::CHUNK_OK);
+		index1.setChunk(*it, mc::ChunkHashes::byChunk(chunk));
+	}
+	fs::path file = fs::temp_directory_path() / fs::unique_path();
+	BOOST_CHECK(index1.write(file.string()));
+
+	mc::ChunkHashIndex index2;
+	BOOST_CHECK(index2.read(file.string()));
+	BOOST_CHECK_EQUAL(index2.getChunksCount(), 120);
+	for (auto it = chunks.begin(); it != chunks.end(); ++it) {
+		BOOST_REQUIRE(index2.hasChunk(*it));
+		BOOST_CHECK_EQUAL(index1.getChunk(*it).compare(index2.getChunk(*it)), 0);
+	}
+
+	// an index with different hashed data must not be used
+	mc::ChunkHashIndex index3(false);
+	BOOST_CHECK(!index3.read(file.string()));
+	BOOST_CHECK(index3.empty());
+
+	fs::remove(file);
+}
+
+BOOST_AUTO_TEST_CASE(region_testWorldGenerator) {
+	mc::WorldGeneratorSettings settings;
+	BOOST_CHECK(settings.setPreset("stress"));
+	BOOST_CHECK(!settings.setPreset("foobar"));
+	BOOST_CHECK(settings.setPreset("stress"));
+	settings.width = 40;
+	settings.length = 3;
+
+	// the same settings must always generate the same chunks
+	mc::WorldGenerator generator(settings);
+	BOOST_CHECK(generator.generateChunkData(mc::ChunkPos(-3, 1))
+			== mc::WorldGenerator(settings).generateChunkData(mc::ChunkPos(-3, 1)));
+	BOOST_CHECK_EQUAL(generator.getRegions().size(), 4);
+
+	fs::path dir = fs::temp_directory_path() / fs::unique_path();
+	BOOST_REQUIRE(generator.generate(dir, 2));
+	mc::World world(dir.string());
+	BOOST_REQUIRE(world.load());
+	BOOST_CHECK_EQUAL(world.getAvailableRegionCount(), 4);
+
+	mc::WorldCache cache(world);
+	int chunks = 0;
+	auto regions = world.getAvailableRegions();
+	for (auto it = regions.begin(); it != regions.end(); ++it) {
+		mc::RegionFile* region = cache.getRegion(*it);
+		BOOST_REQUIRE(region != nullptr);
+		chunks += region->getContainingChunksCount();
+	}
+	BOOST_CHECK_EQUAL(chunks, 40 * 3);
+
+	for (int x = -20 * 16; x < 20 * 16; x += 7) {
+		// bedrock at the bottom and sky light at the top of the world
+		mc::Chunk* chunk = cache.getChunk(mc::ChunkPos(mc::BlockPos(x, 1, 0)));
+		BOOST_REQUIRE(chunk != nullptr);
+		BOOST_CHECK_EQUAL(chunk->getBlockID(mc::LocalBlockPos(mc::BlockPos(x, 1, 0))), 7);
+		BOOST_CHECK_EQUAL(chunk->getSkyLight(mc::LocalBlockPos(mc::BlockPos(x, 1, 255))), 15);
+	}
+	BOOST_CHECK(cache.getChunk(mc::ChunkPos(20, 0)) == nullptr);
+
+	fs::remove_all(dir);
+}
+
+BOOST_AUTO_TEST_CASE(region_testPrefetcher) {
+	mc::World world("data");
+	BOOST_REQUIRE(world.load());
+	mc::RegionPos pos(-1, 0);
+	BOOST_REQUIRE(world.hasRegion(pos));
+
+	mc::RegionFile expected;
+	BOOST_REQUIRE(world.getRegion(pos, expected));
+	BOOST_REQUIRE(expected.read());
+
+	// a prefetched region must be the same like a read one
+	// (getRegion waits if the region is just being read)
+	mc::RegionPrefetcher prefetcher(world, 1, 2);
+	prefetcher.prefetch(pos);
+	prefetcher.prefetch(mc::RegionPos(42, 42));
+	for (int i = 0; i < 500 && !prefetcher.hasRegion(pos); i++)
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	BOOST_CHECK(prefetcher.hasRegion(pos));
+	mc::RegionFile region;
+	BOOST_REQUIRE(prefetcher.getRegion(pos, region));
+	BOOST_CHECK_EQUAL(prefetcher.getHits(), 1);
+	BOOST_CHECK_EQUAL(region.getContainingChunksCount(), expected.getContainingChunksCount());
+	auto chunks = expected.getContainingChunks();
+	for (auto it = chunks.begin(); it != chunks.end(); ++it)
+		BOOST_CHECK(region.getChunkData(*it) == expected.getChunkData(*it));
+
+	// regions which were not prefetched (or don't exist) must be read by the caller
+	BOOST_CHECK(!prefetcher.getRegion(mc::RegionPos(42, 42), region));
+	BOOST_CHECK(!prefetcher.getRegion(mc::RegionPos(0, 0), region));
+
+	// the world cache takes the region from the prefetcher
+	std::shared_ptr<mc::RegionPrefetcher> shared_prefetcher(
+			new mc::RegionPrefetcher(world, 1, 2));
+	shared_prefetcher->prefetch(pos);
+	for (int i = 0; i < 500 && !shared_prefetcher->hasRegion(pos); i++)
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	mc::WorldCache cache(world);
+	cache.setRegionPrefetcher(shared_prefetcher);
+	BOOST_CHECK(cache.getRegion(pos) != nullptr);
+	BOOST_CHECK_EQUAL(shared_prefetcher->getHits(), 1);
+}
@@ -0,0 +1,221 @@
+/*
+ * Copyright 2012-2014 Moritz Hilscher
+ *
+ * This file is part of Mapcrafter.
+ *
+ * Mapcrafter is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Mapcrafter is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Mapcrafter.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "../config/iniconfig.h"
+#include "../config/sections/map.h"
+#include "../config/sections/world.h"
+#include "../renderer/blockimages.h"
+#include "../renderer/blocktextures.h"
+#include "../renderer/tilerenderer.h"
+#include "../renderer/tilerenderworker.h"
+#include "../renderer/tileset.h"
+#include "../mc/world.h"
+#include "../mc/worldcache.h"
+#include "../util.h"
+
+#include <fstream>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <boost/filesystem.hpp>
+#include <boost/test/unit_test.hpp>
+
+namespace fs = boost::filesystem;
+namespace config = mapcrafter::config;
+namespace renderer = mapcrafter::renderer;
+namespace mc = mapcrafter::mc;
+namespace util = mapcrafter::util;
+
+/**
+ * Returns an image with a pattern of colors which depends on a seed.
+ */
+static renderer::RGBAImage createTestImage(int width, int height, int seed,
+		bool transparent) {
+	renderer::RGBAImage image(width, height);
+	for (int x = 0; x < width; x++)
+		for (int y = 0; y < height; y++) {
+			int value = (x * 31 + y * 17 + seed * 101) % 256;
+			uint8_t alpha = transparent && (x + y) % 3 == 0 ? 128 : 255;
+			image.setPixel(x, y, renderer::rgba(value, 255 - value, seed % 256, alpha));
+		}
+	return image;
+}
+
+/**
+ * Writes all texture files the block images need to a directory.
+ */
+static bool createTestTextures(const fs::path& dir) {
+	fs::create_directories(dir / "blocks");
+	fs::create_directories(dir / "chest");
+	fs::create_directories(dir / "colormap");
+	bool ok = createTestImage(64, 64, 1, false).writePNG((dir / "chest/normal.png").string())
+		&& createTestImage(128, 64, 2, false).writePNG((dir / "chest/normal_double.png").string())
+		&& createTestImage(64, 64, 3, false).writePNG((dir / "chest/ender.png").string())
+		&& createTestImage(256, 256, 4, false).writePNG((dir / "colormap/foliage.png").string())
+		&& createTestImage(256, 256, 5, false).writePNG((dir / "colormap/grass.png").string())
+		&& createTestImage(16, 16, 6, false).writePNG((dir / "endportal.png").string());
+
+	renderer::BlockTextures textures;
+	for (size_t i = 0; ok && i < textures.textures.size(); i++) {
+		std::string name = textures.textures[i]->getName();
+		bool transparent = name.find("glass") != std::string::npos
+				|| name.find("water") != std::string::npos
+				|| name.find("leaves") != std::string::npos;
+		ok = createTestImage(16, 16, 100 + i, transparent).writePNG(
+				(dir / "blocks" / (name + ".png")).string());
+	}
+	return ok;
+}
+
+static config::MapSection createMapConfig(const std::string& rendermode) {
+	config::INIConfigSection section("map", "test");
+	section.set("rendermode", rendermode);
+	section.set("texture_size", "6");
+
+	config::ValidationList validation;
+	config::MapSection map_config(true);
+	map_config.parse(section, validation);
+	return map_config;
+}
+
+static bool equalImages(const renderer::RGBAImage& image1,
+		const renderer::RGBAImage& image2) {
+	if (image1.getWidth() != image2.getWidth() || image1.getHeight() != image2.getHeight())
+		return false;
+	for (int x = 0; x < image1.getWidth(); x++)
+		for (int y = 0; y < image1.getHeight(); y++)
+			if (image1.getPixel(x, y) != image2.getPixel(x, y))
+				return false;
+	return true;
+}
+
+/**
+ * Returns the contents of all files in a directory, by their paths relative to it.
+ */
+static std::map<std::string, std::string> readFiles(const fs::path& dir) {
+	std::map<std::string, std::string> files;
+	fs::recursive_directory_iterator end;
+	for (fs::recursive_directory_iterator it(dir); it != end; ++it) {
+		if (!fs::is_regular_file(it->path()))
+			continue;
+		std::ifstream in(it->path().string().c_str(), std::ios::binary);
+		std::stringstream ss;
+		ss << in.rdbuf();
+		files[it->path().string().substr(dir.string().size())] = ss.str();
+	}
+	return files;
+}
+
+/**
+ * Renders all tiles of a tile set with a render worker.
+ */
+static void renderTiles(renderer::RenderContext context) {
+	renderer::RenderWork work;
+	work.tiles.insert(renderer::TilePath());
+	renderer::TileRenderWorker worker;
+	worker.setRenderContext(context);
+	worker.setRenderWork(work);
+	worker();
+}
+
+BOOST_AUTO_TEST_CASE(render_testMultipleOutputs) {
+	fs::path dir = fs::temp_directory_path() / fs::unique_path();
+	BOOST_REQUIRE(createTestTextures(dir / "textures"));
+
+	mc::World world("data");
+	BOOST_REQUIRE(world.load());
+	std::shared_ptr<renderer::TileSet> tile_set(new renderer::TileSet(world));
+
+	// the lighting rendermodes use the same block images
+	std::shared_ptr<renderer::BlockImages> images(new renderer::BlockImages);
+	images->setSettings(6, 0, false, false, "daylight");
+	BOOST_REQUIRE(images->loadAll((dir / "textures").string()));
+
+	config::WorldSection world_config(true);
+	config::MapSection map_day = createMapConfig("daylight");
+	config::MapSection map_night = createMapConfig("nightlight");
+	BOOST_CHECK(renderer::TileRenderer::canShareVisibleBlocks(map_day, map_night));
+	BOOST_CHECK(!renderer::TileRenderer::canShareVisibleBlocks(map_day,
+			createMapConfig("normal")));
+	BOOST_CHECK(!renderer::TileRenderer::canShareVisibleBlocks(map_day,
+			createMapConfig("cave")));
+
+	// the tiles rendered with multiple outputs are the same as the ones rendered
+	// with one renderer per map
+	std::shared_ptr<mc::WorldCache> world_cache(new mc::WorldCache(world));
+	renderer::TileRenderer renderer_day(world_cache, images, world_config, map_day);
+	renderer::TileRenderer renderer_night(world_cache, images, world_config, map_night);
+	renderer::TileRenderer renderer_both(world_cache, images, world_config, map_day);
+	BOOST_CHECK_EQUAL(renderer_both.addOutput(world_config, map_night), 1);
+	BOOST_CHECK_EQUAL(renderer_both.getOutputCount(), 2);
+
+	const std::vector<renderer::TilePos>& tiles = tile_set->getRenderTiles();
+	BOOST_REQUIRE(!tiles.empty());
+	int different = 0;
+	for (size_t i = 0; i < tiles.size(); i += 7) {
+		renderer::RGBAImage tile_day, tile_night;
+		std::vector<renderer::RGBAImage> tiles_both;
+		renderer_day.renderTile(tiles[i], tile_set->getTileOffset(), tile_day);
+		renderer_night.renderTile(tiles[i], tile_set->getTileOffset(), tile_night);
+		renderer_both.renderTile(tiles[i], tile_set->getTileOffset(), tiles_both);
+		BOOST_REQUIRE_EQUAL(tiles_both.size(), 2);
+		BOOST_CHECK(equalImages(tiles_both[0], tile_day));
+		BOOST_CHECK(equalImages(tiles_both[1], tile_night));
+		if (!equalImages(tile_day, tile_night))
+			different++;
+	}
+	// (some tiles at the border of the world are empty)
+	BOOST_CHECK_GT(different, 0);
+
+	// and a render worker with an extra output writes the same files
+	// as one render worker per map
+	renderer::RenderContext context;
+	context.background_color = {"#ffffff", 255, 255, 255};
+	context.world_config = world_config;
+	context.block_images = images;
+	context.world = world;
+	context.tile_set = tile_set;
+
+	renderer::RenderContext context_day = context, context_night = context;
+	context_day.output_dir = dir / "day";
+	context_day.map_config = map_day;
+	context_night.output_dir = dir / "night";
+	context_night.map_config = map_night;
+	renderTiles(context_day);
+	renderTiles(context_night);
+
+	renderer::RenderContext context_both = context_day;
+	context_both.output_dir = dir / "both_day";
+	renderer::RenderOutput output_night;
+	output_night.output_dir = dir / "both_night";
+	output_night.map_config = map_night;
+	context_both.extra_outputs.push_back(output_night);
+	renderTiles(context_both);
+
+	std::map<std::string, std::string> files_day = readFiles(dir / "day");
+	std::map<std::string, std::string> files_night = readFiles(dir / "night");
+	// all render tiles and the composite tiles above them
+	BOOST_CHECK_GT(files_day.size(), tile_set->getRequiredRenderTilesCount());
+	BOOST_CHECK(files_day == readFiles(dir / "both_day"));
+	BOOST_CHECK(files_night == readFiles(dir / "both_night"));
+
+	fs::remove_all(dir);
+}
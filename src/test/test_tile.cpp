@@ -17,12 +17,31 @@
  * along with Mapcrafter.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include "../renderer/scanindex.h"
+#include "../renderer/tilemanifest.h"
+#include "../renderer/tilepack.h"
 #include "../renderer/tileset.h"
+#include "../mc/chunkhashes.h"
+#include "../mc/world.h"
+#include "../thread/impl/multithreading.h"
 
+#include <algorithm>
+#include <ctime>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <limits>
 #include <map>
+#include <set>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <vector>
 #include <boost/test/unit_test.hpp>
 
 namespace renderer = mapcrafter::renderer;
+namespace mc = mapcrafter::mc;
+namespace thread = mapcrafter::thread;
 
 #define PATH(a, b, c, d) ((((renderer::TilePath() + a) + b) + c) + d)
 
@@ -51,3 +70,484 @@ BOOST_AUTO_TEST_CASE(test_tilepos) {
 	}
 	BOOST_CHECK_EQUAL(paths.size(), 256);
 }
+
+BOOST_AUTO_TEST_CASE(test_tilepath) {
+	renderer::TilePath path = PATH(1, 2, 3, 4);
+	BOOST_CHECK_EQUAL(path.getDepth(), 4);
+	BOOST_CHECK_EQUAL(path.toString(), "1/2/3/4");
+	BOOST_CHECK_EQUAL(path.parent().toString(), "1/2/3");
+	BOOST_CHECK_EQUAL(path.parent().parent().parent().parent(), renderer::TilePath());
+	BOOST_CHECK_EQUAL(renderer::TilePath().toString(), "");
+	BOOST_CHECK_EQUAL(renderer::TilePath(path.getPath()), path);
+	BOOST_CHECK_EQUAL(renderer::TilePath::byCode(path.getCode(), 4), path);
+	BOOST_CHECK_EQUAL(path.getCode() >> 2, path.parent().getCode());
+
+	char buffer[renderer::TilePath::STRING_BUFFER_SIZE];
+	BOOST_CHECK_EQUAL(path.toString(buffer), 7);
+	BOOST_CHECK_EQUAL(std::string(buffer), "1/2/3/4");
+
+	// the order of the paths must be the lexicographical order of the path parts
+	std::vector<renderer::TilePath> paths;
+	for (int a = 1; a <= 4; a++) {
+		paths.push_back(renderer::TilePath() + a);
+		for (int b = 1; b <= 4; b++)
+			paths.push_back((renderer::TilePath() + a) + b);
+	}
+	for (size_t i = 0; i < paths.size(); i++)
+		for (size_t j = 0; j < paths.size(); j++) {
+			BOOST_CHECK_EQUAL(paths[i] < paths[j], paths[i].getPath() < paths[j].getPath());
+			BOOST_CHECK_EQUAL(paths[i] == paths[j], i == j);
+		}
+
+	std::unordered_set<renderer::TilePath> hashed(paths.begin(), paths.end());
+	BOOST_CHECK_EQUAL(hashed.size(), paths.size());
+}
+
+BOOST_AUTO_TEST_CASE(test_tilepath_hilbert) {
+	// the Hilbert curve must visit every tile of a zoom level once,
+	// successive tiles must be neighbors and the tiles of a parent must be successive
+	int depth = 5;
+	std::map<uint64_t, renderer::TilePath> curve;
+	for (uint64_t code = 0; code < (1ULL << (2 * depth)); code++) {
+		renderer::TilePath path = renderer::TilePath::byCode(code, depth);
+		curve[path.getHilbertCode()] = path;
+		BOOST_CHECK_EQUAL(path.getHilbertCode() >> 2, path.parent().getHilbertCode());
+	}
+	BOOST_CHECK_EQUAL(curve.size(), 1U << (2 * depth));
+	BOOST_CHECK_EQUAL(curve.rbegin()->first, curve.size() - 1);
+
+	for (auto it = std::next(curve.begin()); it != curve.end(); ++it) {
+		renderer::TilePos diff = it->second.getTilePos()
+				- std::prev(it)->second.getTilePos();
+		BOOST_CHECK_EQUAL(std::abs(diff.getX()) + std::abs(diff.getY()), 1);
+	}
+}
+
+BOOST_AUTO_TEST_CASE(test_tilechunks) {
+	// the chunks of a tile must be exactly the chunks which cover the tile
+	renderer::TilePos tile(3, -2);
+	std::set<mc::ChunkPos> chunks;
+	renderer::getTileChunks(tile, chunks);
+	BOOST_CHECK(!chunks.empty());
+	for (int x = -40; x <= 40; x++)
+		for (int z = -40; z <= 40; z++) {
+			mc::ChunkPos chunk(x, z);
+			std::set<renderer::TilePos> tiles;
+			renderer::getChunkTiles(chunk, tiles);
+			BOOST_CHECK_EQUAL(tiles.count(tile), chunks.count(chunk));
+		}
+}
+
+/**
+ * Finds the render tiles of a world with their timestamps by reading the headers of all
+ * region files directly, without a scan index.
+ */
+std::map<renderer::TilePos, int> scanTileTimestamps(const mc::World& world) {
+	std::map<renderer::TilePos, int> timestamps;
+	auto regions = world.getAvailableRegions();
+	for (auto region_it = regions.begin(); region_it != regions.end(); ++region_it) {
+		mc::RegionFile region;
+		BOOST_REQUIRE(world.getRegion(*region_it, region) && region.readOnlyHeaders());
+		const mc::RegionFile::ChunkMap& chunks = region.getContainingChunks();
+		for (auto chunk_it = chunks.begin(); chunk_it != chunks.end(); ++chunk_it) {
+			std::set<renderer::TilePos> tiles;
+			renderer::getChunkTiles(*chunk_it, tiles);
+			int timestamp = region.getChunkTimestamp(*chunk_it);
+			for (auto tile_it = tiles.begin(); tile_it != tiles.end(); ++tile_it)
+				if (!timestamps.count(*tile_it) || timestamps[*tile_it] < timestamp)
+					timestamps[*tile_it] = timestamp;
+		}
+	}
+	return timestamps;
+}
+
+BOOST_AUTO_TEST_CASE(test_scanindex) {
+	fs::path dir = fs::temp_directory_path() / fs::unique_path();
+	fs::path region_file = dir / "world/region/r.-1.0.mca";
+	std::string index_file = (dir / "scanindex.dat").string();
+	fs::create_directories(region_file.parent_path());
+	fs::copy_file("data/region/r.-1.0.mca", region_file);
+	// regions modified in the second of the last scan are always scanned again
+	std::time_t now = std::time(NULL);
+	fs::last_write_time(region_file, now - 100);
+
+	mc::World world((dir / "world").string());
+	BOOST_REQUIRE(world.load());
+
+	renderer::WorldScanIndex index1(world);
+	BOOST_CHECK_EQUAL(index1.update(), 1);
+	BOOST_CHECK_EQUAL(index1.getRegionCount(), 1);
+	BOOST_CHECK(index1.write(index_file));
+
+	// the index must contain the same tiles as found by reading the region headers
+	std::map<renderer::TilePos, int> timestamps = scanTileTimestamps(world);
+	BOOST_REQUIRE(!timestamps.empty());
+	BOOST_CHECK(index1.getTileTimestamps() == timestamps);
+	renderer::TileSet tileset;
+	tileset.scan(index1);
+	std::vector<renderer::TilePos> render_tiles;
+	for (auto it = timestamps.begin(); it != timestamps.end(); ++it)
+		render_tiles.push_back(it->first);
+	BOOST_CHECK(tileset.getRenderTiles() == render_tiles);
+
+	renderer::WorldScanIndex index2(world);
+	BOOST_CHECK(index2.read(index_file));
+	BOOST_CHECK(index2.getTileTimestamps() == timestamps);
+	BOOST_CHECK_EQUAL(index2.update(), 0);
+
+	// a region is scanned again if its modification time changed
+	fs::last_write_time(region_file, now - 50);
+	BOOST_CHECK_EQUAL(index2.update(), 1);
+	BOOST_CHECK(index2.getTileTimestamps() == timestamps);
+
+	// and the tiles of its modified chunks get the new timestamps
+	mc::RegionFile region(region_file.string());
+	BOOST_REQUIRE(region.read());
+	mc::ChunkPos chunk = *region.getContainingChunks().begin();
+	region.setChunkTimestamp(chunk, now - 10);
+	BOOST_REQUIRE(region.write());
+	fs::last_write_time(region_file, now - 20);
+	BOOST_CHECK_EQUAL(index2.update(), 1);
+	timestamps = scanTileTimestamps(world);
+	BOOST_CHECK(index2.getTileTimestamps() == timestamps);
+	std::set<renderer::TilePos> chunk_tiles;
+	renderer::getChunkTiles(chunk, chunk_tiles);
+	for (auto it = chunk_tiles.begin(); it != chunk_tiles.end(); ++it)
+		BOOST_CHECK_EQUAL(index2.getTileTimestamps().at(*it), now - 10);
+
+	// a corrupted key length is rejected (without allocating the key)
+	fs::path corrupted_file = dir / "corrupted.dat";
+	fs::copy_file(index_file, corrupted_file);
+	std::fstream corrupted(corrupted_file.string().c_str(),
+			std::ios::in | std::ios::out | std::ios::binary);
+	corrupted.seekp(8);
+	corrupted.write("\x7f\xff\xff\xff", 4);
+	corrupted.close();
+	renderer::WorldScanIndex index4(world);
+	BOOST_CHECK(!index4.read(corrupted_file.string()));
+	BOOST_CHECK_EQUAL(index4.getRegionCount(), 0);
+
+	// an index of another rotation must not be used
+	world.setRotation(1);
+	renderer::WorldScanIndex index3(world);
+	BOOST_CHECK(!index3.read(index_file));
+	BOOST_CHECK_EQUAL(index3.getRegionCount(), 0);
+
+	fs::remove_all(dir);
+}
+
+BOOST_AUTO_TEST_CASE(test_tilemanifest) {
+	mc::World world("data");
+	BOOST_REQUIRE(world.load());
+	renderer::TileSet tileset(world);
+	int count = tileset.getRequiredRenderTilesCount();
+
+	renderer::TileManifest manifest1;
+	manifest1.update(tileset, 0);
+	BOOST_CHECK_EQUAL(manifest1.getTilesCount(), count);
+	// the image hashes are stored with all 64 bits
+	renderer::TilePos tile = tileset.getRenderTiles()[0];
+	manifest1.setTileHash(tile, 0x123456789abcdef0ULL);
+	fs::path file = fs::temp_directory_path() / fs::unique_path();
+	BOOST_CHECK(manifest1.write(file.string()));
+
+	renderer::TileManifest manifest2;
+	BOOST_CHECK(manifest2.read(file.string()));
+	BOOST_CHECK_EQUAL(manifest2.getTilesCount(), count);
+	BOOST_CHECK_EQUAL(manifest2.getTileHash(tile), 0x123456789abcdef0ULL);
+
+	// the tiles were rendered before the chunks were modified
+	tileset.scanRequiredByManifest(manifest2);
+	BOOST_CHECK_EQUAL(tileset.getRequiredRenderTilesCount(), count);
+
+	// and now the tiles are up to date
+	manifest2.update(tileset, std::numeric_limits<int>::max());
+	tileset.scanRequiredByManifest(manifest2);
+	BOOST_CHECK_EQUAL(tileset.getRequiredRenderTilesCount(), 0);
+
+	fs::remove(file);
+}
+
+BOOST_AUTO_TEST_CASE(test_tilepack) {
+	fs::path dir = fs::temp_directory_path() / fs::unique_path();
+
+	renderer::TilePack pack1(dir);
+	BOOST_REQUIRE(pack1.open());
+	BOOST_CHECK(pack1.writeTile(renderer::TilePath(), "base"));
+	BOOST_CHECK(pack1.writeTile(PATH(1, 2, 3, 4), "tile 1/2/3/4"));
+	BOOST_CHECK(pack1.writeTile(PATH(4, 3, 2, 1), "tile 4/3/2/1"));
+	BOOST_CHECK(pack1.writeTile(PATH(4, 3, 2, 1), "tile 4/3/2/1 again"));
+	BOOST_CHECK(pack1.flush());
+
+	renderer::TilePack pack2(dir);
+	BOOST_REQUIRE(pack2.open());
+	BOOST_CHECK_EQUAL(pack2.getTilesCount(), 3);
+	std::string data;
+	BOOST_CHECK(pack2.readTile(PATH(1, 2, 3, 4), data));
+	BOOST_CHECK_EQUAL(data, "tile 1/2/3/4");
+	BOOST_CHECK(pack2.readTile(PATH(4, 3, 2, 1), data));
+	BOOST_CHECK_EQUAL(data, "tile 4/3/2/1 again");
+	BOOST_CHECK(!pack2.readTile(PATH(1, 1, 1, 1), data));
+
+	// tiles written without flushing the pack are not in the index
+	BOOST_CHECK(pack2.writeTile(PATH(1, 1, 1, 1), "tile 1/1/1/1"));
+	BOOST_CHECK(pack2.readTile(PATH(1, 1, 1, 1), data));
+	BOOST_CHECK_EQUAL(data, "tile 1/1/1/1");
+	renderer::TilePack pack3(dir);
+	BOOST_REQUIRE(pack3.open());
+	BOOST_CHECK(!pack3.hasTile(PATH(1, 1, 1, 1)));
+
+	// the pack file is compacted if more than half of it is unused
+	for (int i = 0; i < 10; i++)
+		BOOST_CHECK(pack3.writeTile(renderer::TilePath(), "new base"));
+	BOOST_CHECK(pack3.flush());
+	BOOST_CHECK(!fs::exists(dir / "tiles.0.pack"));
+	BOOST_CHECK_EQUAL(fs::file_size(dir / "tiles.1.pack"), 38);
+	BOOST_CHECK(pack3.readTile(renderer::TilePath(), data));
+	BOOST_CHECK_EQUAL(data, "new base");
+
+	// multiple threads can read tiles at the same time
+	std::vector<std::thread> threads;
+	std::vector<int> read_errors(4, 0);
+	for (int i = 0; i < 4; i++)
+		threads.push_back(std::thread([&pack3, &read_errors, i]() {
+			std::string data;
+			for (int j = 0; j < 1000; j++) {
+				bool base = (i + j) % 2 == 0;
+				if (!pack3.readTile(base ? renderer::TilePath() : PATH(1, 2, 3, 4), data)
+						|| data != (base ? "new base" : "tile 1/2/3/4"))
+					read_errors[i]++;
+			}
+		}));
+	for (size_t i = 0; i < threads.size(); i++) {
+		threads[i].join();
+		BOOST_CHECK_EQUAL(read_errors[i], 0);
+	}
+
+	// the tile trees are moved one zoom level deeper, the base tile is removed
+	pack3.increaseMaxZoom();
+	BOOST_CHECK_EQUAL(pack3.getTilesCount(), 2);
+	BOOST_CHECK(pack3.readTile((PATH(1, 4, 2, 3) + 4), data));
+	BOOST_CHECK_EQUAL(data, "tile 1/2/3/4");
+	BOOST_CHECK(pack3.readTile((PATH(4, 1, 3, 2) + 1), data));
+	BOOST_CHECK_EQUAL(data, "tile 4/3/2/1 again");
+
+	// the tiles are sorted by zoom level in the index
+	BOOST_CHECK(renderer::TilePack::getTileKey(PATH(4, 4, 4, 4))
+			< renderer::TilePack::getTileKey(PATH(1, 1, 1, 1) + 1));
+
+	fs::remove_all(dir);
+}
+
+BOOST_AUTO_TEST_CASE(test_tileset) {
+	mc::World world("data");
+	BOOST_REQUIRE(world.load());
+	renderer::TileSet tileset(world);
+	tileset.setDepth(tileset.getMinDepth() + 1);
+	int depth = tileset.getDepth();
+
+	// find the composite tiles with the tile paths of the render tiles
+	std::set<renderer::TilePath> composite_tiles;
+	const std::vector<renderer::TilePos>& render_tiles = tileset.getRenderTiles();
+	for (auto it = render_tiles.begin(); it != render_tiles.end(); ++it) {
+		renderer::TilePath path = renderer::TilePath::byTilePos(*it, depth);
+		BOOST_CHECK(tileset.hasTile(path));
+		BOOST_CHECK(tileset.isTileRequired(path));
+		BOOST_CHECK(path.getTilePos() == *it);
+		while (path.getDepth() > 0) {
+			path = path.parent();
+			composite_tiles.insert(path);
+		}
+	}
+
+	BOOST_CHECK_EQUAL(tileset.getRequiredCompositeTilesCount(), composite_tiles.size());
+	BOOST_CHECK_EQUAL(tileset.getContainingRenderTiles(renderer::TilePath()),
+			render_tiles.size());
+	for (auto it = composite_tiles.begin(); it != composite_tiles.end(); ++it) {
+		BOOST_CHECK(tileset.hasTile(*it));
+		BOOST_CHECK(tileset.isTileRequired(*it));
+	}
+	BOOST_CHECK(!tileset.hasTile(PATH(1, 1, 1, 1) + 1));
+
+	int count = 0;
+	for (int level = 0; level < depth; level++) {
+		auto tiles = tileset.getRequiredCompositeTiles(level);
+		for (auto it = tiles.begin(); it != tiles.end(); ++it) {
+			BOOST_CHECK_EQUAL(it->getDepth(), level);
+			BOOST_CHECK(composite_tiles.count(*it));
+		}
+		count += tiles.size();
+	}
+	BOOST_CHECK_EQUAL(count, composite_tiles.size());
+
+	// no tiles are required if nothing changed
+	tileset.scanRequiredByTimestamp(std::numeric_limits<int>::max());
+	BOOST_CHECK_EQUAL(tileset.getRequiredRenderTilesCount(), 0);
+	BOOST_CHECK_EQUAL(tileset.getRequiredCompositeTilesCount(), 0);
+	BOOST_CHECK(!tileset.isTileRequired(renderer::TilePath()));
+	BOOST_CHECK(tileset.hasTile(renderer::TilePath()));
+}
+
+BOOST_AUTO_TEST_CASE(test_tileset_shards) {
+	mc::World world("data");
+	BOOST_REQUIRE(world.load());
+	renderer::TileSet tileset(world);
+	tileset.setDepth(tileset.getMinDepth() + 1);
+
+	// every required render tile must be rendered by exactly one shard
+	for (int shards = 1; shards <= 5; shards++) {
+		int level = tileset.getShardLevel(shards);
+		BOOST_CHECK(level >= 0 && level <= std::max(0, tileset.getDepth() - 2));
+
+		std::map<renderer::TilePos, int> rendered;
+		for (int shard = 0; shard < shards; shard++) {
+			auto tiles = tileset.getShardTiles(shard, shards);
+			BOOST_CHECK(tiles == tileset.getShardTiles(shard, shards));
+
+			renderer::TileSet shard_tileset(tileset);
+			shard_tileset.restrictRequiredTiles(tiles);
+			BOOST_CHECK(shard_tileset.getRequiredCompositeTiles(level) == tiles);
+			auto render_tiles = shard_tileset.getRequiredRenderTiles();
+			for (auto it = render_tiles.begin(); it != render_tiles.end(); ++it)
+				rendered[*it]++;
+		}
+
+		BOOST_CHECK_EQUAL(rendered.size(), tileset.getRequiredRenderTilesCount());
+		for (auto it = rendered.begin(); it != rendered.end(); ++it)
+			BOOST_CHECK_EQUAL(it->second, 1);
+	}
+}
+
+BOOST_AUTO_TEST_CASE(test_tileset_chunkhashes) {
+	mc::World world("data");
+	BOOST_REQUIRE(world.load());
+	renderer::TileSet tileset(world);
+	const renderer::TilePos& offset = tileset.getTileOffset();
+	const std::vector<renderer::TilePos>& render_tiles = tileset.getRenderTiles();
+
+	// an empty index is just filled
+	mc::ChunkHashIndex index;
+	tileset.scanRequiredByChunkHashes(world, index);
+	BOOST_CHECK_EQUAL(tileset.getRequiredRenderTilesCount(), render_tiles.size());
+	BOOST_REQUIRE_EQUAL(index.getChunksCount(), 120);
+
+	// find a section of a chunk and a render tile of the same section of an adjacent
+	// chunk which the changed section and the sections above and below it don't overlap
+	mc::ChunkPos chunk, neighbor;
+	int section = -1;
+	renderer::TilePos neighbor_tile;
+	const std::map<mc::ChunkPos, mc::ChunkHashes>& chunks = index.getChunks();
+	for (auto it = chunks.begin(); it != chunks.end() && section == -1; ++it) {
+		int x = it->first.x, z = it->first.z;
+		mc::ChunkPos neighbors[] = {
+			mc::ChunkPos(x - 1, z), mc::ChunkPos(x + 1, z),
+			mc::ChunkPos(x, z - 1), mc::ChunkPos(x, z + 1)
+		};
+		for (int i = 0; i < mc::CHUNK_HEIGHT && section == -1; i++) {
+			if (it->second.sections[i] == 0)
+				continue;
+			std::set<renderer::TilePos> chunk_tiles;
+			for (int j = std::max(i - 1, 0);
+					j <= std::min(i + 1, mc::CHUNK_HEIGHT - 1); j++)
+				renderer::getChunkSectionTiles(it->first, j, chunk_tiles);
+			for (int n = 0; n < 4 && section == -1; n++) {
+				if (!index.hasChunk(neighbors[n]))
+					continue;
+				std::set<renderer::TilePos> tiles;
+				renderer::getChunkSectionTiles(neighbors[n], i, tiles);
+				for (auto tile_it = tiles.begin(); tile_it != tiles.end(); ++tile_it)
+					if (!chunk_tiles.count(*tile_it) && std::binary_search(
+							render_tiles.begin(), render_tiles.end(), *tile_it - offset)) {
+						chunk = it->first;
+						neighbor = neighbors[n];
+						section = i;
+						neighbor_tile = *tile_it - offset;
+						break;
+					}
+			}
+		}
+	}
+	BOOST_REQUIRE(section != -1);
+
+	// change the section in the index, now the tiles of the section and of the
+	// adjacent chunk are required, but not the other ones
+	mc::ChunkHashes hashes = index.getChunk(chunk);
+	hashes.sections[section] ^= 1;
+	index.setChunk(chunk, hashes);
+	renderer::TileSet tileset_changed(tileset);
+	tileset_changed.scanRequiredByChunkHashes(world, index);
+	BOOST_CHECK(tileset_changed.isRenderTileRequired(neighbor_tile));
+	std::set<renderer::TilePos> section_tiles;
+	renderer::getChunkSectionTiles(chunk, section, section_tiles);
+	for (auto it = section_tiles.begin(); it != section_tiles.end(); ++it)
+		if (std::binary_search(render_tiles.begin(), render_tiles.end(), *it - offset))
+			BOOST_CHECK(tileset_changed.isRenderTileRequired(*it - offset));
+	BOOST_CHECK_GT(tileset_changed.getRequiredRenderTilesCount(), 0);
+	BOOST_CHECK_LT(tileset_changed.getRequiredRenderTilesCount(), render_tiles.size());
+
+	// the index contains the actual hashes again, so nothing changed
+	renderer::TileSet tileset_unchanged(tileset);
+	tileset_unchanged.scanRequiredByChunkHashes(world, index);
+	BOOST_CHECK_EQUAL(tileset_unchanged.getRequiredRenderTilesCount(), 0);
+}
+
+BOOST_AUTO_TEST_CASE(test_tileset_priority) {
+	std::vector<renderer::TilePos> priority = {renderer::TilePos(0, 0)};
+
+	// the tiles of every zoom level containing the priority tile are in ring 0, the
+	// tiles around them (in tiles of the zoom level) in ring 1 and so on
+	int depth = 4;
+	for (int level = depth; level >= 1; level--) {
+		int radius = (1 << level) / 2;
+		for (int x = -radius; x < radius; x++)
+			for (int y = -radius; y < radius; y++) {
+				renderer::TilePath tile = renderer::TilePath::byTilePos(
+						renderer::TilePos(x, y), level);
+				int ring = std::max(std::abs(x), std::abs(y));
+				BOOST_CHECK_EQUAL(thread::getPriorityRing(tile, depth, priority), ring);
+			}
+	}
+	BOOST_CHECK_EQUAL(thread::getPriorityRing(renderer::TilePath(), depth, priority), 0);
+	// the nearest of multiple priority tiles is used
+	priority.push_back(renderer::TilePos(6, 6));
+	BOOST_CHECK_EQUAL(thread::getPriorityRing(renderer::TilePath::byTilePos(
+			renderer::TilePos(5, 4), 4), 4, priority), 2);
+	BOOST_CHECK_EQUAL(thread::getPriorityRing(renderer::TilePath::byTilePos(
+			renderer::TilePos(1, 1), 2), 4, priority), 0);
+	BOOST_CHECK_EQUAL(thread::getPriorityRing(renderer::TilePath::byTilePos(
+			renderer::TilePos(-2, 1), 3), 4, priority), 2);
+
+	mc::World world("data");
+	BOOST_REQUIRE(world.load());
+	renderer::TileSet tileset(world);
+	tileset.setDepth(tileset.getMinDepth() + 2);
+	depth = tileset.getDepth();
+	std::vector<renderer::TilePath> required = tileset.getRequiredCompositeTiles(depth - 2);
+	BOOST_REQUIRE_GT(required.size(), 4);
+
+	// without priority, the jobs are ordered along the Hilbert curve
+	std::vector<renderer::TilePath> jobs = thread::getJobTiles(tileset,
+			std::vector<renderer::TilePos>());
+	BOOST_REQUIRE_EQUAL(jobs.size(), required.size());
+	for (size_t i = 1; i < jobs.size(); i++)
+		BOOST_CHECK_LT(jobs[i - 1].getHilbertCode(), jobs[i].getHilbertCode());
+
+	// with the tile of the default view (a render hotspot in the middle of the
+	// world) as priority tile, the job containing it comes first and the other ones
+	// follow ring by ring
+	const std::vector<renderer::TilePos>& render_tiles = tileset.getRenderTiles();
+	priority = {render_tiles[render_tiles.size() / 2]};
+	jobs = thread::getJobTiles(tileset, priority);
+	BOOST_REQUIRE_EQUAL(jobs.size(), required.size());
+	BOOST_CHECK(std::is_permutation(jobs.begin(), jobs.end(), required.begin()));
+	BOOST_CHECK_EQUAL(jobs[0],
+			renderer::TilePath::byTilePos(priority[0], depth).parent().parent());
+	BOOST_CHECK_EQUAL(thread::getPriorityRing(jobs[0], depth, priority), 0);
+	for (size_t i = 1; i < jobs.size(); i++) {
+		int ring1 = thread::getPriorityRing(jobs[i - 1], depth, priority);
+		int ring2 = thread::getPriorityRing(jobs[i], depth, priority);
+		BOOST_CHECK_GT(ring2, 0);
+		BOOST_CHECK(ring1 < ring2 || (ring1 == ring2
+				&& jobs[i - 1].getHilbertCode() < jobs[i].getHilbertCode()));
+	}
+}
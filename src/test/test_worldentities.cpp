@@ -0,0 +1,66 @@
+/*
+ * Copyright 2012-2014 Moritz Hilscher
+ *
+ * This file is part of Mapcrafter.
+ *
+ * Mapcrafter is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Mapcrafter is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Mapcrafter.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "../mc/world.h"
+#include "../mc/worldentities.h"
+
+#include <boost/filesystem.hpp>
+#include <boost/test/unit_test.hpp>
+
+namespace fs = boost::filesystem;
+namespace mc = mapcrafter::mc;
+
+BOOST_AUTO_TEST_CASE(worldentities_testCache) {
+	fs::remove_all("data/entities");
+	fs::create_directories("data/entities/region");
+	fs::copy_file("data/region/r.-1.0.mca", "data/entities/region/r.-1.0.mca");
+
+	mc::World world("data/entities");
+	BOOST_REQUIRE(world.load());
+
+	// scan the region
+	mc::WorldEntitiesCache cache1(world);
+	cache1.update();
+	std::vector<mc::SignEntity> signs1 = cache1.getSigns();
+	BOOST_CHECK(fs::exists("data/entities/region/entities.idx"));
+
+	// and read the signs from the cache
+	mc::WorldEntitiesCache cache2(world);
+	cache2.update(false, 2);
+	std::vector<mc::SignEntity> signs2 = cache2.getSigns();
+	BOOST_REQUIRE_EQUAL(signs1.size(), signs2.size());
+	for (size_t i = 0; i < signs1.size(); i++) {
+		BOOST_CHECK_EQUAL(signs1[i].getPos().x, signs2[i].getPos().x);
+		BOOST_CHECK_EQUAL(signs1[i].getPos().z, signs2[i].getPos().z);
+		BOOST_CHECK_EQUAL(signs1[i].getPos().y, signs2[i].getPos().y);
+		BOOST_CHECK_EQUAL(signs1[i].getText(), signs2[i].getText());
+	}
+
+	// the region is outside of this world crop
+	mc::WorldCrop worldcrop;
+	worldcrop.setMinX(0);
+	mc::World cropped("data/entities");
+	cropped.setWorldCrop(worldcrop);
+	BOOST_REQUIRE(cropped.load());
+	mc::WorldEntitiesCache cache3(cropped);
+	cache3.update();
+	BOOST_CHECK(cache3.getSigns().empty());
+
+	fs::remove_all("data/entities");
+}
@@ -22,13 +22,54 @@
 #include "../../mc/worldcache.h"
 #include "../../renderer/tileset.h"
 
+#include <algorithm>
 #include <cstdlib>
 
 namespace mapcrafter {
 namespace thread {
 
-ThreadManager::ThreadManager()
-	: finished(false) {
+int getPriorityRing(const renderer::TilePath& tile, int depth,
+		const std::vector<renderer::TilePos>& priority_tiles) {
+	// compare the centers of the tiles with twice the coordinates of the render tiles
+	int scale = 1 << (depth - tile.getDepth());
+	renderer::TilePos pos = tile.getTilePos();
+	int x = 2 * scale * pos.getX() + scale, y = 2 * scale * pos.getY() + scale;
+	int ring = -1;
+	for (auto it = priority_tiles.begin(); it != priority_tiles.end(); ++it) {
+		int distance = std::max(std::abs(x - 2 * it->getX() - 1),
+				std::abs(y - 2 * it->getY() - 1));
+		// the centers of the render tiles of this tile are less than scale away
+		// from its center, the ones of the next ring less than 3 * scale and so on
+		int tile_ring = (distance + scale) / (2 * scale);
+		if (ring == -1 || tile_ring < ring)
+			ring = tile_ring;
+	}
+	return ring;
+}
+
+std::vector<renderer::TilePath> getJobTiles(const renderer::TileSet& tile_set,
+		const std::vector<renderer::TilePos>& priority_tiles) {
+	// the jobs are ordered along the Hilbert curve, so the successive jobs of a worker
+	// are neighbors and need mostly the same chunks
+	// when rendering with priority, they are ordered by the rings around the priority
+	// tiles at first, so the subtrees around the priority tiles are rendered first
+	int depth = tile_set.getDepth();
+	auto tiles = tile_set.getRequiredCompositeTiles(depth - 2);
+	std::vector<std::pair<std::pair<int, uint64_t>, renderer::TilePath> > sorted_tiles;
+	for (auto tile_it = tiles.begin(); tile_it != tiles.end(); ++tile_it) {
+		int ring = priority_tiles.empty() ? 0
+				: getPriorityRing(*tile_it, depth, priority_tiles);
+		sorted_tiles.push_back(std::make_pair(std::make_pair(ring,
+				tile_it->getHilbertCode()), *tile_it));
+	}
+	std::sort(sorted_tiles.begin(), sorted_tiles.end());
+	for (size_t i = 0; i < sorted_tiles.size(); i++)
+		tiles[i] = sorted_tiles[i].second;
+	return tiles;
+}
+
+ThreadManager::ThreadManager(int workers)
+	: workers(workers), keep_order(false), finished(false) {
 }
 
 ThreadManager::~ThreadManager() {
@@ -36,7 +77,7 @@ ThreadManager::~ThreadManager() {
 
 void ThreadManager::addWork(const renderer::RenderWork& work) {
 	std::unique_lock<std::mutex> lock(mutex);
-	work_queue.push(work);
+	work_list.push_back(work);
 }
 
 void ThreadManager::addExtraWork(const renderer::RenderWork& work) {
@@ -45,6 +86,16 @@ void ThreadManager::addExtraWork(const renderer::RenderWork& work) {
 	condition_wait_jobs.notify_one();
 }
 
+void ThreadManager::setRegionPrefetcher(std::shared_ptr<mc::RegionPrefetcher> prefetcher) {
+	std::unique_lock<std::mutex> lock(mutex);
+	this->prefetcher = prefetcher;
+}
+
+void ThreadManager::setKeepOrder(bool keep_order) {
+	std::unique_lock<std::mutex> lock(mutex);
+	this->keep_order = keep_order;
+}
+
 void ThreadManager::setFinished() {
 	std::unique_lock<std::mutex> lock(mutex);
 	this->finished = true;
@@ -54,14 +105,53 @@ void ThreadManager::setFinished() {
 
 bool ThreadManager::getWork(renderer::RenderWork& work) {
 	std::unique_lock<std::mutex> lock(mutex);
-	while (!finished && (work_queue.empty() && work_extra_queue.empty()))
+	// split the work into contiguous parts of about the same size,
+	// or put all of it into one shared part if its order should be kept
+	if (work_parts.empty()) {
+		int parts = keep_order ? 1 : workers;
+		work_parts.resize(parts);
+		size_t size = work_list.size();
+		for (size_t i = 0; i < size; i++)
+			work_parts[i * parts / size].push_back(work_list[i]);
+		work_list.clear();
+	}
+	auto part_it = worker_parts.find(std::this_thread::get_id());
+	if (part_it == worker_parts.end())
+		part_it = worker_parts.insert(std::make_pair(std::this_thread::get_id(),
+				worker_parts.size() % work_parts.size())).first;
+	std::deque<renderer::RenderWork>& part = work_parts[part_it->second];
+
+	// find the biggest part to take work from if the own part is empty
+	std::deque<renderer::RenderWork>* biggest = &part;
+	while (!finished) {
+		if (!work_extra_queue.empty() || !part.empty())
+			break;
+		for (size_t i = 0; i < work_parts.size(); i++)
+			if (work_parts[i].size() > biggest->size())
+				biggest = &work_parts[i];
+		if (!biggest->empty())
+			break;
 		condition_wait_jobs.wait(lock);
+	}
 	if (finished)
 		return false;
 	if (!work_extra_queue.empty())
 		work = work_extra_queue.pop();
-	else if (!work_queue.empty())
-		work = work_queue.pop();
+	else if (!part.empty()) {
+		work = part.front();
+		part.pop_front();
+	} else {
+		work = biggest->back();
+		biggest->pop_back();
+	}
+
+	// prefetch the regions of the work the worker probably takes next
+	const std::deque<renderer::RenderWork>& next = part.empty() ? *biggest : part;
+	if (prefetcher && !next.empty()) {
+		const renderer::RenderWork& next_work = part.empty() ? next.back() : next.front();
+		for (auto it = next_work.regions.begin(); it != next_work.regions.end(); ++it)
+			prefetcher->prefetch(*it);
+	}
 	return true;
 }
 
@@ -107,7 +197,7 @@ void ThreadWorker::operator()() {
 }
 
 MultiThreadingDispatcher::MultiThreadingDispatcher(int threads)
-	: thread_count(threads) {
+	: thread_count(threads), manager(threads) {
 }
 
 MultiThreadingDispatcher::~MultiThreadingDispatcher() {
@@ -115,59 +205,120 @@ MultiThreadingDispatcher::~MultiThreadingDispatcher() {
 
 void MultiThreadingDispatcher::dispatch(const renderer::RenderContext& context,
 		std::shared_ptr<util::IProgressHandler> progress) {
-	auto tiles = context.tile_set->getRequiredCompositeTiles();
-	if (tiles.size() == 0)
+	if (context.tile_set->getRequiredCompositeTilesCount() == 0)
 		return;
 
+	// when rendering with priority, the workers take the jobs in their order, so the
+	// subtrees around the priority tiles are rendered and composed first
+	int depth = context.tile_set->getDepth();
+	bool priority = !context.priority_tiles.empty();
+	auto tiles = getJobTiles(*context.tile_set, context.priority_tiles);
+	manager.setKeepOrder(priority);
 	int jobs = 0;
-	for (auto tile_it = tiles.begin(); tile_it != tiles.end(); ++tile_it)
-		if (tile_it->getDepth() == context.tile_set->getDepth() - 2) {
-			renderer::RenderWork work;
-			work.tiles.insert(*tile_it);
-			manager.addWork(work);
-			jobs++;
-		}
+	for (auto tile_it = tiles.begin(); tile_it != tiles.end(); ++tile_it) {
+		renderer::RenderWork work;
+		work.tiles.insert(*tile_it);
+
+		// find the regions of the render tiles of this job (in the order they are needed)
+		std::set<mc::ChunkPos> chunks;
+		for (int i = 1; i <= 4; i++)
+			for (int j = 1; j <= 4; j++) {
+				renderer::TilePath path = (*tile_it + i) + j;
+				if (path.getDepth() == depth && context.tile_set->isTileRequired(path))
+					renderer::getTileChunks(path.getTilePos()
+							+ context.tile_set->getTileOffset(), chunks);
+			}
+		std::set<mc::RegionPos> regions;
+		for (auto chunk_it = chunks.begin(); chunk_it != chunks.end(); ++chunk_it)
+			if (regions.insert(chunk_it->getRegion()).second)
+				work.regions.push_back(chunk_it->getRegion());
+
+		manager.addWork(work);
+		jobs++;
+	}
+
+	// the regions of the next job of every worker are read by a few I/O threads while
+	// the workers are rendering, so they don't have to wait for the disk
+	renderer::RenderContext render_context = context;
+	render_context.region_prefetcher.reset(new mc::RegionPrefetcher(context.world,
+			2, 4 * thread_count + 4));
+	manager.setRegionPrefetcher(render_context.region_prefetcher);
 
 	int render_tiles = context.tile_set->getRequiredRenderTilesCount();
 	std::cout << thread_count << " threads will render " << render_tiles;
 	std::cout << " render tiles." << std::endl;
 
 	for (int i = 0; i < thread_count; i++)
-		threads.push_back(std::thread(ThreadWorker(manager, context)));
+		threads.push_back(std::thread(ThreadWorker(manager, render_context)));
+
+	// the tiles are composed up to the root tile, or up to the tiles of the shard level
+	// if only the tiles of a shard are rendered
+	int top_level = 0, top_tiles = 1, top_tiles_rendered = 0;
+	if (context.shard_level > 0) {
+		top_level = context.shard_level;
+		top_tiles = context.tile_set->getRequiredCompositeTiles(top_level).size();
+	}
 
 	progress->setMax(context.tile_set->getRequiredRenderTilesCount());
 	renderer::RenderWorkResult result;
+	int tiles_unchanged = 0;
 	while (manager.getResult(result)) {
 		progress->setValue(progress->getValue() + result.tiles_rendered);
+		tiles_unchanged += result.tiles_unchanged;
 		for (auto tile_it = result.render_work.tiles.begin();
 				tile_it != result.render_work.tiles.end(); ++tile_it) {
-			rendered_tiles.insert(*tile_it);
-			if (*tile_it == renderer::TilePath()) {
-				manager.setFinished();
-				continue;
-			}
+			renderer::TilePath tile = *tile_it;
+			bool changed = result.tiles_changed.count(tile);
 
-			renderer::TilePath parent = tile_it->parent();
-			bool childs_rendered = true;
-			for (int i = 1; i <= 4; i++)
-				if (context.tile_set->isTileRequired(parent + i)
-						&& !rendered_tiles.count(parent + i)) {
-					childs_rendered = false;
+			// if all children of a parent tile are rendered, the parent tile can be
+			// composed -- unless none of the children was changed, then the parent tile
+			// doesn't change either and is just marked as rendered, too
+			while (true) {
+				rendered_tiles.insert(tile);
+				if (changed)
+					changed_tiles.insert(tile);
+				if (tile.getDepth() == top_level) {
+					if (++top_tiles_rendered == top_tiles)
+						manager.setFinished();
+					break;
 				}
 
-			if (childs_rendered) {
-				renderer::RenderWork work;
-				work.tiles.insert(parent);
-				for (int i = 1; i <= 4; i++)
-					if (context.tile_set->hasTile(parent + i))
-						work.tiles_skip.insert(parent + i);
-				manager.addExtraWork(work);
+				renderer::TilePath parent = tile.parent();
+				bool childs_rendered = true, childs_changed = false;
+				for (int i = 1; i <= 4; i++) {
+					if (context.tile_set->isTileRequired(parent + i)
+							&& !rendered_tiles.count(parent + i)) {
+						childs_rendered = false;
+					}
+					if (changed_tiles.count(parent + i))
+						childs_changed = true;
+				}
+
+				if (!childs_rendered)
+					break;
+				if (childs_changed) {
+					renderer::RenderWork work;
+					work.tiles.insert(parent);
+					for (int i = 1; i <= 4; i++) {
+						if (context.tile_set->hasTile(parent + i))
+							work.tiles_skip.insert(parent + i);
+						if (changed_tiles.count(parent + i))
+							work.tiles_skip_changed.insert(parent + i);
+					}
+					manager.addExtraWork(work);
+					break;
+				}
+				tile = parent;
+				changed = false;
 			}
 		}
 	}
 
 	for (int i = 0; i < thread_count; i++)
 		threads[i].join();
+
+	if (tiles_unchanged != 0)
+		std::cout << tiles_unchanged << " render tiles were unchanged." << std::endl;
 }
 
 } /* namespace thread */
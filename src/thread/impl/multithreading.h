@@ -26,6 +26,9 @@
 #include "../../renderer/tilerenderworker.h"
 
 #include <condition_variable>
+#include <deque>
+#include <map>
+#include <memory>
 #include <mutex>
 #include <set>
 #include <thread>
@@ -34,23 +37,73 @@
 namespace mapcrafter {
 namespace thread {
 
+/**
+ * Returns the distance of a tile to the nearest priority tile (render tiles of a tile set
+ * with the specified depth), measured in tiles of the zoom level of the tile in square
+ * rings around the priority tiles like subtrees of the quadtree. The tiles containing a
+ * priority tile are in ring 0.
+ */
+int getPriorityRing(const renderer::TilePath& tile, int depth,
+		const std::vector<renderer::TilePos>& priority_tiles);
+
+/**
+ * Returns the required tiles two zoom levels above the render tiles, which are the jobs
+ * of the worker threads, in the order they should be rendered: Along the Hilbert curve,
+ * and if there are priority tiles, by their priority rings at first.
+ */
+std::vector<renderer::TilePath> getJobTiles(const renderer::TileSet& tile_set,
+		const std::vector<renderer::TilePos>& priority_tiles);
+
+/**
+ * Manages the render work of the worker threads. The work added with addWork should be
+ * ordered by locality (e.g. along a space-filling curve). It is split into one contiguous
+ * part per worker thread, so every worker renders neighboring tiles after each other and
+ * its world cache can be reused. When a worker finished its part, it takes work from
+ * the end of the biggest remaining part. Extra work is preferred and taken by any
+ * worker.
+ *
+ * If the order of the work should be kept (e.g. because the most important tiles are
+ * added first), all workers take the work from the front of one shared part.
+ */
 class ThreadManager : public WorkerManager<renderer::RenderWork, renderer::RenderWorkResult> {
 public:
-	ThreadManager();
+	ThreadManager(int workers = 1);
 	virtual ~ThreadManager();
 
 	void addWork(const renderer::RenderWork& work);
 	void addExtraWork(const renderer::RenderWork& work);
 	void setFinished();
 
+	/**
+	 * Sets whether the workers take the work in the order it was added, instead of
+	 * splitting it into a part per worker. Must be called before the work is taken.
+	 */
+	void setKeepOrder(bool keep_order);
+
+	/**
+	 * Sets a prefetcher which reads the regions of the work a worker takes next, while
+	 * the worker is still busy with its current work.
+	 */
+	void setRegionPrefetcher(std::shared_ptr<mc::RegionPrefetcher> prefetcher);
+
 	virtual bool getWork(renderer::RenderWork& work);
 	virtual void workFinished(const renderer::RenderWork& work, const renderer::RenderWorkResult& result);
 
 	bool getResult(renderer::RenderWorkResult& result);
 private:
-	ConcurrentQueue<renderer::RenderWork> work_queue, work_extra_queue;
+	ConcurrentQueue<renderer::RenderWork> work_extra_queue;
 	ConcurrentQueue<renderer::RenderWorkResult> result_queue;
 
+	// the added work, split into the parts of the workers when the first work is taken
+	std::deque<renderer::RenderWork> work_list;
+	std::vector<std::deque<renderer::RenderWork> > work_parts;
+	// the part of every worker thread
+	std::map<std::thread::id, int> worker_parts;
+	int workers;
+	bool keep_order;
+
+	std::shared_ptr<mc::RegionPrefetcher> prefetcher;
+
 	bool finished;
 	std::mutex mutex;
 	std::condition_variable condition_wait_jobs, condition_wait_results;
@@ -83,7 +136,7 @@ private:
 	ThreadManager manager;
 	std::vector<std::thread> threads;
 
-	std::set<renderer::TilePath> rendered_tiles;
+	std::set<renderer::TilePath> rendered_tiles, changed_tiles;
 };
 
 } /* namespace thread */
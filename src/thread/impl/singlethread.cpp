@@ -38,17 +38,35 @@ void SingleThreadDispatcher::dispatch(const renderer::RenderContext& context,
 	if (render_tiles == 0)
 		return;
 
-	std::cout << "Single thread will render " << render_tiles;
-	std::cout << " render tiles." << std::endl;
-
 	renderer::RenderWork work;
-	work.tiles.insert(renderer::TilePath());
+	if (context.shard_merge) {
+		// the shards rendered the tiles of the shard level already, they are just
+		// loaded and all of them are assumed to be changed
+		std::cout << "Single thread will compose the tiles above zoom level "
+				<< context.shard_level << "." << std::endl;
+		work.tiles.insert(renderer::TilePath());
+		auto tiles = context.tile_set->getRequiredCompositeTiles(context.shard_level);
+		work.tiles_skip.insert(tiles.begin(), tiles.end());
+		work.tiles_skip_changed.insert(tiles.begin(), tiles.end());
+	} else {
+		std::cout << "Single thread will render " << render_tiles;
+		std::cout << " render tiles." << std::endl;
+		if (context.shard_level > 0) {
+			auto tiles = context.tile_set->getRequiredCompositeTiles(context.shard_level);
+			work.tiles.insert(tiles.begin(), tiles.end());
+		} else
+			work.tiles.insert(renderer::TilePath());
+	}
 
 	renderer::TileRenderWorker worker;
 	worker.setRenderContext(context);
 	worker.setRenderWork(work);
 	worker.setProgressHandler(progress);
 	worker();
+
+	int tiles_unchanged = worker.getRenderWorkResult().tiles_unchanged;
+	if (tiles_unchanged != 0)
+		std::cout << tiles_unchanged << " render tiles were unchanged." << std::endl;
 }
 
 } /* namespace thread */
@@ -0,0 +1,518 @@
+/*
+ * Copyright 2012-2014 Moritz Hilscher
+ *
+ * This file is part of Mapcrafter.
+ *
+ * Mapcrafter is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Mapcrafter is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Mapcrafter.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "../util.h"
+#include "../version.h"
+#include "../config/iniconfig.h"
+#include "../config/sections/map.h"
+#include "../config/sections/world.h"
+#include "../mc/chunk.h"
+#include "../mc/nbt.h"
+#include "../mc/region.h"
+#include "../mc/world.h"
+#include "../mc/worldcache.h"
+#include "../renderer/blockimages.h"
+#include "../renderer/blocktextures.h"
+#include "../renderer/image.h"
+#include "../renderer/rendermetrics.h"
+#include "../renderer/tilerenderer.h"
+#include "../renderer/tileset.h"
+#include "../renderer/rendermodes/lighting.h"
+
+#include <algorithm>
+#include <chrono>
+#include <ctime>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <boost/program_options.hpp>
+#include <boost/filesystem.hpp>
+
+namespace po = boost::program_options;
+namespace fs = boost::filesystem;
+
+namespace config = mapcrafter::config;
+namespace mc = mapcrafter::mc;
+namespace renderer = mapcrafter::renderer;
+namespace util = mapcrafter::util;
+
+// results of the benchmarked functions are accumulated here,
+// so the compiler can not optimize the benchmarked code away
+volatile uint32_t bench_sink = 0;
+
+/**
+ * A single benchmark. The run function executes one iteration and returns the count of
+ * processed items (chunks, blocks, tiles, ...), which is used to calculate a throughput.
+ */
+struct Benchmark {
+	std::string name;
+	std::string unit;
+	std::function<size_t()> run;
+};
+
+/**
+ * The measured times (in seconds) of the iterations of a benchmark.
+ */
+struct BenchmarkResult {
+	std::string name;
+	std::string unit;
+	size_t items;
+	std::vector<double> times;
+
+	double getMean() const {
+		double sum = 0;
+		for (size_t i = 0; i < times.size(); i++)
+			sum += times[i];
+		return sum / times.size();
+	}
+
+	double getMedian() const {
+		std::vector<double> sorted = times;
+		std::sort(sorted.begin(), sorted.end());
+		size_t n = sorted.size();
+		if (n % 2 == 0)
+			return (sorted[n / 2 - 1] + sorted[n / 2]) / 2;
+		return sorted[n / 2];
+	}
+
+	double getMin() const {
+		return *std::min_element(times.begin(), times.end());
+	}
+
+	double getMax() const {
+		return *std::max_element(times.begin(), times.end());
+	}
+
+	double getItemsPerSecond() const {
+		double median = getMedian();
+		return median > 0 ? items / median : 0;
+	}
+};
+
+/**
+ * Runs a benchmark: One warmup iteration, then iterations until at least min_time
+ * seconds passed (and at least min_iterations iterations were done). If iterations is
+ * set, exactly this count of iterations is measured.
+ */
+BenchmarkResult runBenchmark(const Benchmark& benchmark, double min_time,
+		int min_iterations, int iterations) {
+	BenchmarkResult result;
+	result.name = benchmark.name;
+	result.unit = benchmark.unit;
+	result.items = benchmark.run();
+
+	double total = 0;
+	while (true) {
+		if (iterations > 0 && (int) result.times.size() >= iterations)
+			break;
+		if (iterations <= 0 && total >= min_time
+				&& (int) result.times.size() >= min_iterations)
+			break;
+		auto start = std::chrono::steady_clock::now();
+		benchmark.run();
+		double time = renderer::getElapsedSeconds(start);
+		result.times.push_back(time);
+		total += time;
+	}
+	return result;
+}
+
+/**
+ * Creates a synthetic image with a fixed seed: Areas of random colors, some of them
+ * transparent, similar to a rendered tile.
+ */
+renderer::RGBAImage createSyntheticImage(int width, int height, unsigned int seed) {
+	std::mt19937 random(seed);
+	renderer::RGBAImage image(width, height);
+	for (int y = 0; y < height; y += 8)
+		for (int x = 0; x < width; x += 8) {
+			uint32_t value = random();
+			uint8_t alpha = (value & 0xff) < 32 ? 0 : ((value & 0xff) < 64 ? 128 : 255);
+			image.fill(renderer::rgba(value >> 8, value >> 16, value >> 24, alpha),
+					x, y, std::min(8, width - x), std::min(8, height - y));
+		}
+	return image;
+}
+
+/**
+ * Writes synthetic textures (with a fixed seed) for all required texture files
+ * to a directory, so the block images can be created without a Minecraft jar.
+ */
+bool createSyntheticTextures(const fs::path& dir) {
+	if (!fs::create_directories(dir / "blocks") || !fs::create_directories(dir / "chest")
+			|| !fs::create_directories(dir / "colormap"))
+		return false;
+
+	bool ok = createSyntheticImage(64, 64, 1).writePNG((dir / "chest/normal.png").string())
+		&& createSyntheticImage(128, 64, 2).writePNG((dir / "chest/normal_double.png").string())
+		&& createSyntheticImage(64, 64, 3).writePNG((dir / "chest/ender.png").string())
+		&& createSyntheticImage(256, 256, 4).writePNG((dir / "colormap/foliage.png").string())
+		&& createSyntheticImage(256, 256, 5).writePNG((dir / "colormap/grass.png").string())
+		&& createSyntheticImage(16, 16, 6).writePNG((dir / "endportal.png").string());
+
+	renderer::BlockTextures textures;
+	for (size_t i = 0; ok && i < textures.textures.size(); i++) {
+		std::string name = textures.textures[i]->getName();
+		renderer::RGBAImage texture = createSyntheticImage(16, 16, 100 + i);
+		// glass, water, leaves etc. are not completely opaque
+		if (name.find("glass") == std::string::npos && name.find("water") == std::string::npos
+				&& name.find("leaves") == std::string::npos)
+			for (int x = 0; x < 16; x++)
+				for (int y = 0; y < 16; y++)
+					texture.setPixel(x, y, texture.getPixel(x, y) | 0xff000000);
+		ok = texture.writePNG((dir / "blocks" / (name + ".png")).string());
+	}
+	return ok;
+}
+
+/**
+ * Creates the map configuration section for the tile renderer with a rendermode.
+ */
+config::MapSection createMapConfig(const std::string& rendermode, int texture_size) {
+	config::INIConfigSection section("map", "bench");
+	section.set("rendermode", rendermode);
+	section.set("texture_size", util::str(texture_size));
+
+	config::ValidationList validation;
+	config::MapSection map_config(true);
+	map_config.parse(section, validation);
+	return map_config;
+}
+
+std::string toJSON(const std::vector<BenchmarkResult>& results, const std::string& world,
+		int texture_size) {
+	std::ostringstream ss;
+	ss << std::fixed << std::setprecision(9);
+	ss << "{" << std::endl;
+	ss << "  \"version\": \"" << util::escapeJSON(mapcrafter::MAPCRAFTER_VERSION)
+			<< "\"," << std::endl;
+	ss << "  \"time\": " << time(NULL) << "," << std::endl;
+	ss << "  \"world\": \"" << util::escapeJSON(world) << "\"," << std::endl;
+	ss << "  \"texture_size\": " << texture_size << "," << std::endl;
+	ss << "  \"benchmarks\": [" << std::endl;
+	for (auto it = results.begin(); it != results.end(); ++it) {
+		ss << "    {\"name\": \"" << util::escapeJSON(it->name) << "\""
+				<< ", \"unit\": \"" << util::escapeJSON(it->unit) << "\""
+				<< ", \"items_per_iteration\": " << it->items
+				<< ", \"iterations\": " << it->times.size()
+				<< ", \"mean\": " << it->getMean()
+				<< ", \"median\": " << it->getMedian()
+				<< ", \"min\": " << it->getMin()
+				<< ", \"max\": " << it->getMax()
+				<< ", \"items_per_second\": " << it->getItemsPerSecond() << "}"
+				<< (it + 1 == results.end() ? "" : ",") << std::endl;
+	}
+	ss << "  ]" << std::endl;
+	ss << "}" << std::endl;
+	return ss.str();
+}
+
+int main(int argc, char** argv) {
+	std::string data_dir, world_dir, texture_dir, filter, output_file;
+	double min_time;
+	int iterations, texture_size;
+
+	po::options_description all("Allowed options");
+	all.add_options()
+		("help,h", "shows this help message")
+		("list,l", "lists the available benchmarks")
+
+		("filter,f", po::value<std::string>(&filter),
+			"runs only the benchmarks whose names contain this string")
+		("data-dir,d", po::value<std::string>(&data_dir)->default_value(BENCH_DATA_DIR),
+			"the directory with the test fixtures (region/r.-1.0.mca)")
+		("world,w", po::value<std::string>(&world_dir),
+			"the world directory used for the world cache and tile rendering "
+			"benchmarks, for example one generated with mapcrafter_worldgen "
+			"(default: the test fixtures directory)")
+		("texture-dir,t", po::value<std::string>(&texture_dir),
+			"the texture directory (default: synthetic textures)")
+		("texture-size,s", po::value<int>(&texture_size)->default_value(12),
+			"the texture size used to render tiles")
+		("min-time,m", po::value<double>(&min_time)->default_value(0.5),
+			"the minimum time in seconds to run every benchmark")
+		("iterations,i", po::value<int>(&iterations)->default_value(0),
+			"runs every benchmark exactly this count of iterations")
+		("output,o", po::value<std::string>(&output_file),
+			"writes the results as JSON to this file");
+
+	po::variables_map vm;
+	try {
+		po::store(po::parse_command_line(argc, argv, all), vm);
+	} catch (po::error& ex) {
+		std::cout << "There is a problem parsing the command line arguments: "
+				<< ex.what() << std::endl << std::endl;
+		std::cout << all << std::endl;
+		return 1;
+	}
+
+	po::notify(vm);
+
+	if (vm.count("help")) {
+		std::cout << all << std::endl;
+		return 1;
+	}
+
+	if (!vm.count("world"))
+		world_dir = data_dir;
+
+	// the raw chunk data of the region fixture
+	mc::RegionFile region((fs::path(data_dir) / "region" / "r.-1.0.mca").string());
+	if (!region.read()) {
+		std::cerr << "Unable to read region file " << region.getFilename() << "!" << std::endl;
+		return 1;
+	}
+	std::vector<mc::ChunkPos> region_chunks(region.getContainingChunks().begin(),
+			region.getContainingChunks().end());
+
+	mc::World world(world_dir);
+	if (!world.load()) {
+		std::cerr << "Unable to load world " << world_dir << "!" << std::endl;
+		return 1;
+	}
+	std::shared_ptr<mc::WorldCache> world_cache(new mc::WorldCache(world));
+
+	// the chunks of the world used for block access, and the tiles to render
+	renderer::TileSet tile_set(world);
+	std::vector<mc::ChunkPos> world_chunks;
+	auto regions = world.getAvailableRegions();
+	for (auto it = regions.begin(); it != regions.end() && world_chunks.size() < 32; ++it) {
+		mc::RegionFile* file = world_cache->getRegion(*it);
+		if (file == nullptr)
+			continue;
+		auto chunks = file->getContainingChunks();
+		for (auto it2 = chunks.begin(); it2 != chunks.end() && world_chunks.size() < 32; ++it2)
+			world_chunks.push_back(*it2);
+	}
+	std::vector<renderer::TilePos> tiles(tile_set.getRenderTiles().begin(),
+			tile_set.getRenderTiles().begin()
+			+ std::min<size_t>(4, tile_set.getRenderTiles().size()));
+
+	// the block images, with synthetic textures if no texture directory is specified
+	fs::path synthetic_textures;
+	if (!vm.count("texture-dir")) {
+		synthetic_textures = fs::temp_directory_path() / fs::unique_path("mapcrafter-bench-%%%%%%%%");
+		if (!createSyntheticTextures(synthetic_textures)) {
+			std::cerr << "Unable to create synthetic textures in " << synthetic_textures
+					<< "!" << std::endl;
+			return 1;
+		}
+		texture_dir = synthetic_textures.string();
+	}
+	std::shared_ptr<renderer::BlockImages> images(new renderer::BlockImages);
+	images->setSettings(texture_size, 0, true, true, "daylight");
+	bool images_ok = images->loadAll(texture_dir);
+	if (!synthetic_textures.empty())
+		fs::remove_all(synthetic_textures);
+	if (!images_ok) {
+		std::cerr << "Unable to load the block images from " << texture_dir << "!" << std::endl;
+		return 1;
+	}
+
+	config::WorldSection world_config(true);
+	config::MapSection map_normal = createMapConfig("normal", texture_size);
+	config::MapSection map_daylight = createMapConfig("daylight", texture_size);
+	renderer::TileRenderer renderer_normal(world_cache, images, world_config, map_normal);
+	renderer::TileRenderer renderer_daylight(world_cache, images, world_config, map_daylight);
+	// renders a daylight and a nightlight tile from the same visible blocks
+	renderer::TileRenderer renderer_day_night(world_cache, images, world_config, map_daylight);
+	renderer_day_night.addOutput(world_config, createMapConfig("nightlight", texture_size));
+
+	// visible blocks (blocks with air above them) to draw the lighting on
+	std::vector<mc::BlockPos> lighting_blocks;
+	std::vector<mc::Block> lighting_block_ids;
+	for (size_t i = 0; i < world_chunks.size() && lighting_blocks.size() < 4096; i++) {
+		mc::Chunk* chunk = world_cache->getChunk(world_chunks[i]);
+		if (chunk == nullptr)
+			continue;
+		for (int x = 0; x < 16; x++)
+			for (int z = 0; z < 16; z++)
+				for (int y = 255; y > 0; y--) {
+					mc::BlockPos pos(world_chunks[i].x * 16 + x, world_chunks[i].z * 16 + z, y);
+					mc::Block block = world_cache->getBlock(pos, chunk);
+					if (block.id == 0)
+						continue;
+					lighting_blocks.push_back(pos);
+					lighting_block_ids.push_back(block);
+					break;
+				}
+	}
+	std::vector<renderer::RGBAImage> lighting_images;
+	for (size_t i = 0; i < lighting_block_ids.size(); i++)
+		lighting_images.push_back(images->getBlock(lighting_block_ids[i].id,
+				lighting_block_ids[i].data));
+	renderer::RenderState lighting_state(world_cache, images);
+	renderer::LightingRendermode lighting(lighting_state, true, 1.0, false);
+
+	// synthetic images for the image operations
+	int tile_size = images->getTileSize();
+	renderer::RGBAImage tile_image = createSyntheticImage(tile_size, tile_size, 42);
+	renderer::RGBAImage composite_image = createSyntheticImage(tile_size * 2, tile_size * 2, 43);
+	renderer::RGBAImage sprite = createSyntheticImage(images->getBlockImageSize(),
+			images->getBlockImageSize(), 44);
+	std::vector<std::pair<int, int>> sprite_positions;
+	std::mt19937 random(45);
+	for (int i = 0; i < 4096; i++)
+		sprite_positions.push_back(std::make_pair(
+				(int) (random() % tile_size) - sprite.getWidth() / 2,
+				(int) (random() % tile_size) - sprite.getHeight() / 2));
+
+	std::vector<Benchmark> benchmarks;
+	benchmarks.push_back({"nbt_read", "chunks", [&]() {
+		for (size_t i = 0; i < region_chunks.size(); i++) {
+			const std::vector<uint8_t>& data = region.getChunkData(region_chunks[i]);
+			mc::nbt::NBTFile nbt;
+			nbt.readNBT(reinterpret_cast<const char*>(&data[0]), data.size(),
+					(mc::nbt::Compression) region.getChunkDataCompression(region_chunks[i]));
+			bench_sink += nbt.hasTag("Level");
+		}
+		return region_chunks.size();
+	}});
+	benchmarks.push_back({"nbt_document_read", "chunks", [&]() {
+		for (size_t i = 0; i < region_chunks.size(); i++) {
+			const std::vector<uint8_t>& data = region.getChunkData(region_chunks[i]);
+			mc::nbt::Document nbt;
+			nbt.readNBT(reinterpret_cast<const char*>(&data[0]), data.size(),
+					(mc::nbt::Compression) region.getChunkDataCompression(region_chunks[i]));
+			bench_sink += nbt.getRoot().getTag<mc::nbt::TagCompound>("Level") != nullptr;
+		}
+		return region_chunks.size();
+	}});
+	benchmarks.push_back({"chunk_read", "chunks", [&]() {
+		for (size_t i = 0; i < region_chunks.size(); i++) {
+			const std::vector<uint8_t>& data = region.getChunkData(region_chunks[i]);
+			mc::Chunk chunk;
+			chunk.readNBT(reinterpret_cast<const char*>(&data[0]), data.size(),
+					(mc::nbt::Compression) region.getChunkDataCompression(region_chunks[i]));
+			bench_sink += chunk.getBlockID(mc::LocalBlockPos(0, 0, 0));
+		}
+		return region_chunks.size();
+	}});
+	benchmarks.push_back({"worldcache_getblock", "blocks", [&]() {
+		size_t count = 0;
+		for (size_t i = 0; i < world_chunks.size(); i++) {
+			mc::Chunk* chunk = world_cache->getChunk(world_chunks[i]);
+			for (int x = 0; x < 16; x++)
+				for (int z = 0; z < 16; z++)
+					for (int y = 0; y < 256; y++, count++) {
+						mc::BlockPos pos(world_chunks[i].x * 16 + x, world_chunks[i].z * 16 + z, y);
+						bench_sink += world_cache->getBlock(pos, chunk).id;
+					}
+		}
+		return count;
+	}});
+	benchmarks.push_back({"tile_render_normal", "tiles", [&]() {
+		renderer::RGBAImage tile;
+		for (size_t i = 0; i < tiles.size(); i++)
+			renderer_normal.renderTile(tiles[i], tile_set.getTileOffset(), tile);
+		bench_sink += tile.getPixel(0, 0);
+		return tiles.size();
+	}});
+	benchmarks.push_back({"tile_render_daylight", "tiles", [&]() {
+		renderer::RGBAImage tile;
+		for (size_t i = 0; i < tiles.size(); i++)
+			renderer_daylight.renderTile(tiles[i], tile_set.getTileOffset(), tile);
+		bench_sink += tile.getPixel(0, 0);
+		return tiles.size();
+	}});
+	benchmarks.push_back({"tile_render_day_night", "tiles", [&]() {
+		std::vector<renderer::RGBAImage> tiles_day_night;
+		for (size_t i = 0; i < tiles.size(); i++)
+			renderer_day_night.renderTile(tiles[i], tile_set.getTileOffset(), tiles_day_night);
+		bench_sink += tiles_day_night[1].getPixel(0, 0);
+		return tiles.size();
+	}});
+	benchmarks.push_back({"lighting_draw", "blocks", [&]() {
+		// every iteration is like rendering a new tile
+		lighting.start();
+		for (size_t i = 0; i < lighting_blocks.size(); i++)
+			lighting.draw(lighting_images[i], lighting_blocks[i],
+					lighting_block_ids[i].id, lighting_block_ids[i].data);
+		return lighting_blocks.size();
+	}});
+	benchmarks.push_back({"image_alphablit", "blits", [&]() {
+		renderer::RGBAImage tile(tile_size, tile_size);
+		for (size_t i = 0; i < sprite_positions.size(); i++)
+			tile.alphablit(sprite, sprite_positions[i].first, sprite_positions[i].second);
+		bench_sink += tile.getPixel(tile_size / 2, tile_size / 2);
+		return sprite_positions.size();
+	}});
+	benchmarks.push_back({"image_resizeHalf", "images", [&]() {
+		renderer::RGBAImage tile;
+		composite_image.resizeHalf(tile);
+		bench_sink += tile.getPixel(0, 0);
+		return (size_t) 1;
+	}});
+	benchmarks.push_back({"image_writePNG", "images", [&]() {
+		std::ostringstream out;
+		tile_image.writePNG(out);
+		bench_sink += out.str().size();
+		return (size_t) 1;
+	}});
+	benchmarks.push_back({"image_writeJPEG", "images", [&]() {
+		std::ostringstream out;
+		tile_image.writeJPEG(out, 85);
+		bench_sink += out.str().size();
+		return (size_t) 1;
+	}});
+
+	if (vm.count("list")) {
+		for (auto it = benchmarks.begin(); it != benchmarks.end(); ++it)
+			std::cout << it->name << std::endl;
+		return 0;
+	}
+
+	std::cout << std::left << std::setw(24) << "benchmark" << std::right
+			<< std::setw(8) << "iters" << std::setw(14) << "median [ms]"
+			<< std::setw(14) << "min [ms]" << std::setw(14) << "max [ms]"
+			<< std::setw(16) << "throughput" << std::endl;
+	std::cout << std::fixed;
+
+	std::vector<BenchmarkResult> results;
+	for (auto it = benchmarks.begin(); it != benchmarks.end(); ++it) {
+		if (!filter.empty() && it->name.find(filter) == std::string::npos)
+			continue;
+		BenchmarkResult result = runBenchmark(*it, min_time, 5, iterations);
+		results.push_back(result);
+
+		std::cout << std::left << std::setw(24) << result.name << std::right
+				<< std::setw(8) << result.times.size() << std::setprecision(3)
+				<< std::setw(14) << result.getMedian() * 1000
+				<< std::setw(14) << result.getMin() * 1000
+				<< std::setw(14) << result.getMax() * 1000
+				<< std::setprecision(0) << std::setw(10) << result.getItemsPerSecond()
+				<< " " << result.unit << "/s" << std::endl;
+	}
+
+	if (!output_file.empty()) {
+		std::ofstream out(output_file.c_str());
+		out << toJSON(results, world_dir, texture_size);
+		if (!out) {
+			std::cerr << "Unable to write results to " << output_file << "!" << std::endl;
+			return 1;
+		}
+	}
+	return 0;
+}
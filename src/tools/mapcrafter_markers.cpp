@@ -10,6 +10,7 @@
 #include <string>
 #include <vector>
 #include <map>
+#include <set>
 #include <boost/program_options.hpp>
 #include <boost/filesystem.hpp>
 
@@ -28,7 +29,7 @@ struct Marker {
 		std::string json = "{";
 		json += "\"pos\": [" + util::str(pos.x) + "," + util::str(pos.z) + "," + util::str(pos.y) + "], ";
 		json += "\"title\": \"" + util::escapeJSON(title) + "\", ";
-		json += "\"text\": \"" + util::escapeJSON(text) + "\", ";
+		json += "\"text\": \"" + util::escapeJSON(text) + "\"";
 		return json + "}";
 	}
 };
@@ -36,8 +37,11 @@ struct Marker {
 // map (marker group name -> map ( world name -> array of markers) )
 typedef std::map<std::string, std::map<std::string, std::vector<Marker> > > Markers;
 
+// map ( (bucket x, bucket z) -> array of markers in this area of the world)
+typedef std::map<std::pair<int, int>, std::vector<Marker> > MarkerBuckets;
+
 void findMarkers(const config::MapcrafterConfig& config, Markers& markers_found,
-		bool verbose = false) {
+		bool verbose = false, int jobs = 1) {
 	auto worlds = config.getWorlds();
 	auto markers = config.getMarkers();
 	for (auto world_it = worlds.begin(); world_it != worlds.end(); ++world_it) {
@@ -51,7 +55,7 @@ void findMarkers(const config::MapcrafterConfig& config, Markers& markers_found,
 		}
 
 		mc::WorldEntitiesCache entities(world);
-		entities.update(verbose);
+		entities.update(verbose, jobs);
 
 		// use name of the world section as world name, not the world_name
 		std::string world_name = world_it->second.getShortName();
@@ -75,56 +79,155 @@ void findMarkers(const config::MapcrafterConfig& config, Markers& markers_found,
 	}
 }
 
-std::string createMarkersJSON(const config::MapcrafterConfig& config,
-		const Markers& markers_found) {
+MarkerBuckets createMarkerBuckets(const std::vector<Marker>& markers, int bucket_size) {
+	MarkerBuckets buckets;
+	for (auto it = markers.begin(); it != markers.end(); ++it) {
+		std::pair<int, int> bucket(util::floordiv(it->pos.x, bucket_size),
+				util::floordiv(it->pos.z, bucket_size));
+		buckets[bucket].push_back(*it);
+	}
+	return buckets;
+}
+
+/**
+ * Writes the markers-generated.js file. If a bucket size is specified, the markers are
+ * not written into this file, only which buckets of the worlds have markers.
+ */
+void writeMarkersJSON(std::ostream& out, const config::MapcrafterConfig& config,
+		const Markers& markers_found, int bucket_size = 0) {
 	auto markers = config.getMarkers();
-	std::stringstream ss;
 
-	ss << "// This file is automatically generated. Do not edit this file." << std::endl;
-	ss << "// Use the markers.js for your own markers instead." << std::endl << std::endl;
-	ss << "MAPCRAFTER_MARKERS_GENERATED = [" << std::endl;
+	out << "// This file is automatically generated. Do not edit this file." << std::endl;
+	out << "// Use the markers.js for your own markers instead." << std::endl << std::endl;
+	out << "MAPCRAFTER_MARKERS_GENERATED = [" << std::endl;
 	for (auto marker_config_it = markers.begin(); marker_config_it != markers.end();
 			++marker_config_it) {
 		config::MarkerSection marker_config = *marker_config_it;
 		std::string group = marker_config.getShortName();
-		ss << "  {" << std::endl;
-		ss << "    \"id\" : \"" << group << "\"," << std::endl;
-		ss << "    \"name\" : \"" << marker_config.getLongName() << "\"," << std::endl;
+		out << "  {" << std::endl;
+		out << "    \"id\" : \"" << group << "\"," << std::endl;
+		out << "    \"name\" : \"" << marker_config.getLongName() << "\"," << std::endl;
 		if (!marker_config.getIcon().empty()) {
-			ss << "    \"icon\" : \"" << marker_config.getIcon() << "\"," << std::endl;
+			out << "    \"icon\" : \"" << marker_config.getIcon() << "\"," << std::endl;
 			if (!marker_config.getIconSize().empty())
-				ss << "    \"iconSize\" : " << marker_config.getIconSize() << "," << std::endl;
+				out << "    \"iconSize\" : " << marker_config.getIconSize() << "," << std::endl;
+		}
+		out << "    \"showDefault\" : ";
+		out << (marker_config.isShownByDefault() ? "true" : "false") << "," << std::endl;
+
+		if (bucket_size > 0) {
+			// the web interface loads the buckets with markers when they are visible
+			out << "    \"markers\" : {}," << std::endl;
+			out << "    \"bucketSize\" : " << bucket_size << "," << std::endl;
+			out << "    \"buckets\" : {" << std::endl;
+			if (markers_found.count(group)) {
+				for (auto world_it = markers_found.at(group).begin();
+						world_it != markers_found.at(group).end(); ++world_it) {
+					out << "      \"" << world_it->first << "\" : [";
+					MarkerBuckets buckets = createMarkerBuckets(world_it->second, bucket_size);
+					for (auto bucket_it = buckets.begin(); bucket_it != buckets.end(); ++bucket_it)
+						out << "[" << bucket_it->first.first << ","
+							<< bucket_it->first.second << "],";
+					out << "]," << std::endl;
+				}
+			}
+			out << "    }," << std::endl;
+			out << "  }," << std::endl;
+			continue;
 		}
-		ss << "    \"showDefault\" : ";
-		ss << (marker_config.isShownByDefault() ? "true" : "false") << "," << std::endl;
-		ss << "    \"markers\" : {" << std::endl;
+
+		out << "    \"markers\" : {" << std::endl;
 
 		if (!markers_found.count(group)) {
-			ss << "    }," << std::endl;
-			ss << "  }," << std::endl;
+			out << "    }," << std::endl;
+			out << "  }," << std::endl;
 			continue;
 		}
 
 		for (auto world_it = markers_found.at(group).begin();
 				world_it != markers_found.at(group).end(); ++world_it) {
-			ss << "      \"" << world_it->first << "\" : [" << std::endl;
+			out << "      \"" << world_it->first << "\" : [" << std::endl;
 			for (auto marker_it = world_it->second.begin();
 					marker_it != world_it->second.end(); ++marker_it) {
-				ss << "        " << marker_it->toJSON() << "," << std::endl;
+				out << "        " << marker_it->toJSON() << "," << std::endl;
 			}
-			ss << "      ]," << std::endl;
+			out << "      ]," << std::endl;
 		}
-		ss << "    }," << std::endl;
-		ss << "  }," << std::endl;
+		out << "    }," << std::endl;
+		out << "  }," << std::endl;
 	}
-	ss << "];" << std::endl;
+	out << "];" << std::endl;
+}
+
+/**
+ * Writes the markers of every marker group and world into JSON files per bucket
+ * (<dir>/<group>/<world>/<bucket x>.<bucket z>.json). Only the files whose markers
+ * changed are written, files of buckets without markers anymore are removed.
+ */
+bool writeMarkerBuckets(const fs::path& dir, const Markers& markers_found,
+		int bucket_size) {
+	std::set<fs::path> bucket_files;
+	bool ok = true;
+	for (auto group_it = markers_found.begin(); group_it != markers_found.end(); ++group_it) {
+		for (auto world_it = group_it->second.begin(); world_it != group_it->second.end();
+				++world_it) {
+			fs::path world_dir = dir / group_it->first / world_it->first;
+			if (!fs::is_directory(world_dir))
+				fs::create_directories(world_dir);
+
+			MarkerBuckets buckets = createMarkerBuckets(world_it->second, bucket_size);
+			for (auto bucket_it = buckets.begin(); bucket_it != buckets.end(); ++bucket_it) {
+				fs::path file = world_dir / (util::str(bucket_it->first.first) + "."
+						+ util::str(bucket_it->first.second) + ".json");
+				bucket_files.insert(file);
 
-	return ss.str();
+				std::string json = "[\n";
+				for (auto marker_it = bucket_it->second.begin();
+						marker_it != bucket_it->second.end(); ++marker_it) {
+					if (marker_it != bucket_it->second.begin())
+						json += ",\n";
+					json += marker_it->toJSON();
+				}
+				json += "\n]\n";
+
+				// don't touch the file if the markers are still the same
+				if (fs::exists(file) && fs::file_size(file) == json.size()) {
+					std::ifstream in(file.string().c_str(), std::ios::binary);
+					std::string old_json(json.size(), '\0');
+					if (in.read(&old_json[0], old_json.size()) && old_json == json)
+						continue;
+				}
+
+				std::ofstream out(file.string().c_str(), std::ios::binary);
+				out << json;
+				out.close();
+				if (!out) {
+					std::cerr << "Error: Unable to write to file '" << file.string()
+							<< "'!" << std::endl;
+					ok = false;
+				}
+			}
+		}
+	}
+
+	// remove the files of old buckets
+	if (fs::is_directory(dir)) {
+		std::vector<fs::path> old_files;
+		for (fs::recursive_directory_iterator it(dir), end; it != end; ++it)
+			if (fs::is_regular_file(it->path()) && it->path().extension() == ".json"
+					&& !bucket_files.count(it->path()))
+				old_files.push_back(it->path());
+		for (auto it = old_files.begin(); it != old_files.end(); ++it)
+			fs::remove(*it);
+	}
+	return ok;
 }
 
 int main(int argc, char** argv) {
 	std::string config_file;
 	std::string output_file;
+	int jobs;
+	int bucket_size;
  
 	po::options_description all("Allowed options");
 	all.add_options()
@@ -135,7 +238,13 @@ int main(int argc, char** argv) {
 			"the path to the configuration file (required)")
 		("output-file,o", po::value<std::string>(&output_file),
 			"file to write the generated markers to, "
-			"defaults to markers-generated.js in the output directory.");
+			"defaults to markers-generated.js in the output directory.")
+		("jobs,j", po::value<int>(&jobs)->default_value(1),
+			"the count of threads to scan the world regions")
+		("bucket-size,b", po::value<int>(&bucket_size)->default_value(0),
+			"splits the markers into files per world area of this size (in blocks), "
+			"the web interface loads only the visible ones. The files are written to the "
+			"directory 'markers' next to the output file.");
 
 	po::variables_map vm;
 	try {
@@ -174,21 +283,34 @@ int main(int argc, char** argv) {
 		}
 	}
 
+	if (bucket_size < 0 || (bucket_size > 0 && output_file == "-")) {
+		std::cerr << "You have to specify a positive bucket size and an output file "
+				<< "to split the markers!" << std::endl;
+		return 1;
+	}
+
 	Markers markers_found;
-	findMarkers(config, markers_found, vm.count("verbose"));
-	std::string markers_json = createMarkersJSON(config, markers_found);
-
-	if (output_file == "-")
-		std::cout << markers_json;
-	else {
-		if (output_file == "")
-			output_file = config.getOutputPath("markers-generated.js");
-		std::ofstream out(output_file);
-		out << markers_json;
-		out.close();
-		if (!out) {
-			std::cerr << "Error: Unable to write to file '" << output_file << "'!" << std::endl;
+	findMarkers(config, markers_found, vm.count("verbose"), jobs);
+
+	if (output_file == "-") {
+		writeMarkersJSON(std::cout, config, markers_found);
+		return 0;
+	}
+
+	if (output_file == "")
+		output_file = config.getOutputPath("markers-generated.js");
+	if (bucket_size > 0) {
+		fs::path markers_dir = fs::absolute(output_file).parent_path() / "markers";
+		if (!writeMarkerBuckets(markers_dir, markers_found, bucket_size))
 			return 1;
-		}
 	}
+
+	std::ofstream out(output_file);
+	writeMarkersJSON(out, config, markers_found, bucket_size);
+	out.close();
+	if (!out) {
+		std::cerr << "Error: Unable to write to file '" << output_file << "'!" << std::endl;
+		return 1;
+	}
+	return 0;
 }
@@ -0,0 +1,118 @@
+/*
+ * Copyright 2012-2014 Moritz Hilscher
+ *
+ * This file is part of Mapcrafter.
+ *
+ * Mapcrafter is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Mapcrafter is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Mapcrafter.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "../util.h"
+#include "../renderer/tilepack.h"
+
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <boost/program_options.hpp>
+#include <boost/filesystem.hpp>
+
+namespace po = boost::program_options;
+namespace fs = boost::filesystem;
+
+namespace renderer = mapcrafter::renderer;
+
+/**
+ * Returns the file extension of an encoded tile image.
+ */
+std::string getImageSuffix(const std::string& data) {
+	if (data.compare(0, 4, "\x89PNG") == 0)
+		return "png";
+	return "jpg";
+}
+
+int main(int argc, char** argv) {
+	std::string pack_dir, output_dir;
+
+	po::options_description all("Allowed options");
+	all.add_options()
+		("help,h", "shows this help message")
+
+		("pack,p", po::value<std::string>(&pack_dir),
+			"the directory with the tile pack (tiles.idx), "
+			"for example output/<map>/<rotation> (required)")
+		("output-dir,o", po::value<std::string>(&output_dir),
+			"the directory to write the tile images to (required)");
+
+	po::variables_map vm;
+	try {
+		po::store(po::parse_command_line(argc, argv, all), vm);
+	} catch (po::error& ex) {
+		std::cout << "There is a problem parsing the command line arguments: "
+				<< ex.what() << std::endl << std::endl;
+		std::cout << all << std::endl;
+		return 1;
+	}
+
+	po::notify(vm);
+
+	if (vm.count("help")) {
+		std::cout << all << std::endl;
+		return 1;
+	}
+
+	if (!vm.count("pack") || !vm.count("output-dir")) {
+		std::cerr << "You have to specify a tile pack and an output directory!" << std::endl;
+		return 1;
+	}
+
+	if (!fs::exists(fs::path(pack_dir) / "tiles.idx")) {
+		std::cerr << "Error: There is no tile pack in '" << pack_dir << "'!" << std::endl;
+		return 1;
+	}
+
+	renderer::TilePack pack(pack_dir);
+	if (!pack.open()) {
+		std::cerr << "Error: Unable to open the tile pack in '" << pack_dir << "'!" << std::endl;
+		return 1;
+	}
+
+	std::vector<renderer::TilePath> tiles = pack.getTiles();
+	int written = 0;
+	for (auto it = tiles.begin(); it != tiles.end(); ++it) {
+		std::string data;
+		if (!pack.readTile(*it, data)) {
+			std::cerr << "Warning: Unable to read tile " << *it << "!" << std::endl;
+			continue;
+		}
+
+		std::string suffix = std::string(".") + getImageSuffix(data);
+		fs::path file = fs::path(output_dir) / (it->toString() + suffix);
+		if (it->getDepth() == 0)
+			file = fs::path(output_dir) / (std::string("base") + suffix);
+		if (!fs::exists(file.branch_path()))
+			fs::create_directories(file.branch_path());
+
+		std::ofstream out(file.string().c_str(), std::ios::binary);
+		out.write(data.data(), data.size());
+		out.close();
+		if (!out) {
+			std::cerr << "Error: Unable to write to file '" << file.string() << "'!" << std::endl;
+			return 1;
+		}
+		written++;
+	}
+
+	std::cout << "Extracted " << written << " of " << tiles.size() << " tiles." << std::endl;
+	return 0;
+}
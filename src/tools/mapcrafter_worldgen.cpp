@@ -0,0 +1,137 @@
+/*
+ * Copyright 2012-2014 Moritz Hilscher
+ *
+ * This file is part of Mapcrafter.
+ *
+ * Mapcrafter is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Mapcrafter is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Mapcrafter.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "../util.h"
+#include "../mc/worldgenerator.h"
+
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <boost/program_options.hpp>
+#include <boost/filesystem.hpp>
+
+namespace po = boost::program_options;
+namespace fs = boost::filesystem;
+
+namespace mc = mapcrafter::mc;
+namespace util = mapcrafter::util;
+
+int main(int argc, char** argv) {
+	std::string output_dir, preset, terrain;
+	int size, jobs;
+	mc::WorldGeneratorSettings settings;
+
+	po::options_description all("Allowed options");
+	all.add_options()
+		("help,h", "shows this help message")
+
+		("output-dir,o", po::value<std::string>(&output_dir),
+			"the world directory to generate (required)")
+		("preset,p", po::value<std::string>(&preset)->default_value("flat"),
+			"the kind of world to generate: flat, noise, caves, water, biomes, "
+			"transparent or stress (all combined)")
+		("seed", po::value<uint32_t>(&settings.seed),
+			"the seed of the world (default: 0)")
+		("size,s", po::value<int>(&size),
+			"the width and length of the world in chunks (default: 64)")
+		("width", po::value<int>(&settings.width),
+			"the width (x direction) of the world in chunks")
+		("length", po::value<int>(&settings.length),
+			"the length (z direction) of the world in chunks")
+		("terrain", po::value<std::string>(&terrain),
+			"the terrain type (flat or noise)")
+		("height", po::value<int>(&settings.height),
+			"the (average) height of the terrain (default: 64)")
+		("amplitude", po::value<int>(&settings.amplitude),
+			"the maximum height difference of the noise terrain (default: 24)")
+		("caves", po::value<double>(&settings.caves),
+			"the fraction (0 to 1) of the underground carved out as caves")
+		("water-level", po::value<int>(&settings.water_level),
+			"the height up to which the terrain is filled with water (0: no water)")
+		("biomes", po::value<bool>(&settings.biomes),
+			"whether to generate many different biomes (true/false)")
+		("transparent", po::value<double>(&settings.transparent),
+			"the fraction (0 to 1) of the surface with transparent blocks "
+			"(trees, glass, tall grass)")
+		("timestamp", po::value<uint32_t>(&settings.timestamp),
+			"the timestamp of the generated chunks (default: now)")
+		("jobs,j", po::value<int>(&jobs)->default_value(1),
+			"the count of threads to use");
+
+	po::variables_map vm;
+	try {
+		po::store(po::parse_command_line(argc, argv, all), vm);
+	} catch (po::error& ex) {
+		std::cout << "There is a problem parsing the command line arguments: "
+				<< ex.what() << std::endl << std::endl;
+		std::cout << all << std::endl;
+		return 1;
+	}
+
+	// the preset must be applied before the other options overwrite its settings
+	if (vm.count("preset") && !settings.setPreset(vm["preset"].as<std::string>())) {
+		std::cerr << "Unknown preset '" << vm["preset"].as<std::string>() << "'!" << std::endl;
+		return 1;
+	}
+	po::notify(vm);
+
+	if (vm.count("help")) {
+		std::cout << all << std::endl;
+		return 0;
+	}
+
+	if (!vm.count("output-dir")) {
+		std::cerr << "You have to specify an output directory!" << std::endl;
+		return 1;
+	}
+
+	if (vm.count("size"))
+		settings.width = settings.length = size;
+	if (vm.count("terrain")) {
+		if (terrain == "flat")
+			settings.terrain = mc::GeneratorTerrain::FLAT;
+		else if (terrain == "noise")
+			settings.terrain = mc::GeneratorTerrain::NOISE;
+		else {
+			std::cerr << "Unknown terrain type '" << terrain << "'!" << std::endl;
+			return 1;
+		}
+	}
+	if (settings.width <= 0 || settings.length <= 0) {
+		std::cerr << "The size of the world must be positive!" << std::endl;
+		return 1;
+	}
+
+	mc::WorldGenerator generator(settings);
+	std::cout << "Generating world with " << settings.width << "x" << settings.length
+			<< " chunks (" << generator.getRegions().size() << " regions) in "
+			<< output_dir << " ..." << std::endl;
+
+	auto start = std::chrono::steady_clock::now();
+	util::ProgressBar progress;
+	if (!generator.generate(output_dir, jobs, &progress))
+		return 1;
+	progress.finish();
+
+	int seconds = std::chrono::duration_cast<std::chrono::seconds>(
+			std::chrono::steady_clock::now() - start).count();
+	std::cout << "Generated " << (int64_t) settings.width * settings.length
+			<< " chunks in " << util::format_eta(seconds) << "." << std::endl;
+	return 0;
+}
@@ -29,8 +29,8 @@ int main(int argc, char** argv) {
 		}
 	}
 	
-	nbt::NBTFile f;
+	nbt::Document f;
 	f.readNBT(filename.c_str(), cmpr);
-	f.dump(std::cout);
+	f.getRoot().dump(std::cout);
 	return 0;
 }
@@ -65,5 +65,6 @@ private:
 #include "util/progress.h"
 #include "util/math.h"
 #include "util/other.h"
+#include "util/profiler.h"
 
 #endif /* UTIL_H_ */
@@ -20,8 +20,10 @@
 #ifndef OTHER_H_
 #define OTHER_H_
 
+#include <iostream>
 #include <string>
 #include <sstream>
+#include <stdint.h>
 #include <boost/filesystem.hpp>
 
 namespace fs = boost::filesystem;
@@ -34,6 +36,34 @@ int16_t bigEndian16(int16_t x);
 int32_t bigEndian32(int32_t x);
 int64_t bigEndian64(int64_t x);
 
+/**
+ * Reads an integer in big endian byte order from a binary stream.
+ * Returns false if the stream does not have enough data.
+ */
+template<typename T>
+bool readBigEndian(std::istream& in, T& value) {
+	uint8_t bytes[sizeof(T)];
+	if (!in.read(reinterpret_cast<char*>(bytes), sizeof(T)))
+		return false;
+	uint64_t tmp = 0;
+	for (size_t i = 0; i < sizeof(T); i++)
+		tmp = (tmp << 8) | bytes[i];
+	value = static_cast<T>(tmp);
+	return true;
+}
+
+/**
+ * Writes an integer in big endian byte order to a binary stream.
+ */
+template<typename T>
+void writeBigEndian(std::ostream& out, T value) {
+	uint64_t tmp = static_cast<uint64_t>(value);
+	uint8_t bytes[sizeof(T)];
+	for (size_t i = 0; i < sizeof(T); i++)
+		bytes[sizeof(T) - i - 1] = (tmp >> (8 * i)) & 0xff;
+	out.write(reinterpret_cast<char*>(bytes), sizeof(T));
+}
+
 template<typename T>
 std::string str(T value) {
 	std::stringstream ss;
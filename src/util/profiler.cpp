@@ -0,0 +1,139 @@
+/*
+ * Copyright 2012-2014 Moritz Hilscher
+ *
+ * This file is part of Mapcrafter.
+ *
+ * Mapcrafter is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Mapcrafter is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Mapcrafter.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "profiler.h"
+
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <vector>
+
+namespace mapcrafter {
+namespace util {
+
+const char* PROFILE_STAGE_NAMES[PROFILE_STAGES_COUNT] = {
+	"region read",
+	"decompression",
+	"nbt parse",
+	"render tile",
+	"visible blocks",
+	"rendermode draw",
+	"blit",
+	"downsample",
+	"encode",
+	"write"
+};
+
+ProfileCounters::ProfileCounters() {
+	for (int i = 0; i < PROFILE_STAGES_COUNT; i++)
+		time[i] = calls[i] = 0;
+}
+
+ProfileCounters ProfileCounters::operator-(const ProfileCounters& other) const {
+	ProfileCounters result;
+	for (int i = 0; i < PROFILE_STAGES_COUNT; i++) {
+		result.time[i] = time[i] - other.time[i];
+		result.calls[i] = calls[i] - other.calls[i];
+	}
+	return result;
+}
+
+std::string ProfileCounters::format(double thread_time) const {
+	std::ostringstream ss;
+	ss << std::fixed;
+	ss << "  " << std::left << std::setw(18) << "stage" << std::right
+			<< std::setw(12) << "calls" << std::setw(12) << "time [s]"
+			<< std::setw(14) << "per call [us]" << std::setw(9) << "share" << std::endl;
+	for (int i = 0; i < PROFILE_STAGES_COUNT; i++) {
+		double seconds = time[i] / 1e9;
+		ss << "  " << std::left << std::setw(18) << PROFILE_STAGE_NAMES[i] << std::right
+				<< std::setw(12) << calls[i]
+				<< std::setw(12) << std::setprecision(3) << seconds
+				<< std::setw(14) << std::setprecision(2)
+				<< (calls[i] == 0 ? 0 : time[i] / 1e3 / calls[i])
+				<< std::setw(8) << std::setprecision(1)
+				<< (thread_time > 0 ? seconds / thread_time * 100 : 0) << "%" << std::endl;
+	}
+	return ss.str();
+}
+
+/**
+ * The counters of one thread. Only the thread itself writes them, so no atomic
+ * read-modify-write operations are needed, the atomics make sure that other threads
+ * can read them at any time.
+ */
+struct ThreadCounters {
+	std::atomic<uint64_t> time[PROFILE_STAGES_COUNT];
+	std::atomic<uint64_t> calls[PROFILE_STAGES_COUNT];
+
+	ThreadCounters() {
+		for (int i = 0; i < PROFILE_STAGES_COUNT; i++) {
+			time[i].store(0);
+			calls[i].store(0);
+		}
+	}
+};
+
+// the counters of all threads, they are kept after a thread finished
+std::mutex thread_counters_mutex;
+std::vector<std::unique_ptr<ThreadCounters>> thread_counters;
+
+/**
+ * Returns the counters of the current thread. The counters are registered when a
+ * thread uses the profiler for the first time.
+ */
+ThreadCounters& getThreadCounters() {
+	thread_local ThreadCounters* counters = nullptr;
+	if (counters == nullptr) {
+		std::unique_lock<std::mutex> lock(thread_counters_mutex);
+		thread_counters.push_back(std::unique_ptr<ThreadCounters>(new ThreadCounters));
+		counters = thread_counters.back().get();
+	}
+	return *counters;
+}
+
+std::atomic<bool> Profiler::enabled(false);
+
+void Profiler::setEnabled(bool enabled) {
+	Profiler::enabled.store(enabled);
+}
+
+void Profiler::add(ProfileStage stage, uint64_t nanoseconds) {
+	ThreadCounters& counters = getThreadCounters();
+	int i = static_cast<int>(stage);
+	counters.time[i].store(counters.time[i].load(std::memory_order_relaxed) + nanoseconds,
+			std::memory_order_relaxed);
+	counters.calls[i].store(counters.calls[i].load(std::memory_order_relaxed) + 1,
+			std::memory_order_relaxed);
+}
+
+ProfileCounters Profiler::getCounters() {
+	ProfileCounters result;
+	std::unique_lock<std::mutex> lock(thread_counters_mutex);
+	for (size_t i = 0; i < thread_counters.size(); i++)
+		for (int j = 0; j < PROFILE_STAGES_COUNT; j++) {
+			result.time[j] += thread_counters[i]->time[j].load(std::memory_order_relaxed);
+			result.calls[j] += thread_counters[i]->calls[j].load(std::memory_order_relaxed);
+		}
+	return result;
+}
+
+} /* namespace util */
+} /* namespace mapcrafter */
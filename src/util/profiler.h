@@ -0,0 +1,138 @@
+/*
+ * Copyright 2012-2014 Moritz Hilscher
+ *
+ * This file is part of Mapcrafter.
+ *
+ * Mapcrafter is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Mapcrafter is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Mapcrafter.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef PROFILER_H_
+#define PROFILER_H_
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <stdint.h>
+
+namespace mapcrafter {
+namespace util {
+
+/**
+ * The stages of the rendering process which are measured by the profiler.
+ */
+enum class ProfileStage {
+	REGION_READ = 0,
+	DECOMPRESS,
+	NBT_PARSE,
+	RENDER_TILE,
+	VISIBLE_BLOCKS,
+	RENDERMODE_DRAW,
+	BLIT,
+	DOWNSAMPLE,
+	ENCODE,
+	WRITE
+};
+
+const int PROFILE_STAGES_COUNT = 10;
+
+/**
+ * The names of the profile stages, used for output.
+ */
+extern const char* PROFILE_STAGE_NAMES[PROFILE_STAGES_COUNT];
+
+/**
+ * The time (in nanoseconds) spent in every stage and how often every stage was entered.
+ */
+struct ProfileCounters {
+	ProfileCounters();
+
+	uint64_t time[PROFILE_STAGES_COUNT];
+	uint64_t calls[PROFILE_STAGES_COUNT];
+
+	ProfileCounters operator-(const ProfileCounters& other) const;
+
+	/**
+	 * Returns a table with the times of all stages. The thread time (wall time times
+	 * count of threads) is used to show which share of the time a stage took.
+	 */
+	std::string format(double thread_time) const;
+};
+
+/**
+ * A low-overhead profiler for the hot paths of the rendering.
+ *
+ * Every thread has its own counters, which are only written by the thread itself and
+ * read (without locks) by the thread which collects the counters. If the profiler is
+ * not enabled, measuring a stage costs only a check of a flag.
+ */
+class Profiler {
+public:
+	/**
+	 * Enables/disables the profiler. This should be set before the rendering starts.
+	 */
+	static void setEnabled(bool enabled);
+
+	static bool isEnabled() {
+		return enabled.load(std::memory_order_relaxed);
+	}
+
+	/**
+	 * Adds a call of a stage which took some nanoseconds to the counters of the
+	 * current thread.
+	 */
+	static void add(ProfileStage stage, uint64_t nanoseconds);
+
+	/**
+	 * Returns the sum of the counters of all threads (also of already finished ones).
+	 */
+	static ProfileCounters getCounters();
+
+private:
+	static std::atomic<bool> enabled;
+};
+
+/**
+ * Measures the time of a stage from its creation until its destruction:
+ *
+ * {
+ *     ScopedTimer timer(ProfileStage::BLIT);
+ *     ...
+ * }
+ *
+ * Nested stages are included in the time of the outer stage.
+ */
+class ScopedTimer {
+public:
+	ScopedTimer(ProfileStage stage)
+		: stage(stage), running(Profiler::isEnabled()) {
+		if (running)
+			start = std::chrono::steady_clock::now();
+	}
+
+	~ScopedTimer() {
+		if (running)
+			Profiler::add(stage, std::chrono::duration_cast<std::chrono::nanoseconds>(
+					std::chrono::steady_clock::now() - start).count());
+	}
+
+private:
+	ProfileStage stage;
+	bool running;
+	std::chrono::steady_clock::time_point start;
+};
+
+} /* namespace util */
+} /* namespace mapcrafter */
+
+#endif /* PROFILER_H_ */